@@ -0,0 +1,20 @@
+#pragma once
+
+void CommandListBenchmark();
+void ProfilerBenchmark();
+void LightCullingBenchmark();
+void OcclusionBenchmark();
+void FrustumBenchmark();
+void BvhBenchmark();
+void TransformBenchmark();
+void EntityBenchmark();
+void SoftwareRasterizerBenchmark();
+void SceneGeneratorBenchmark();
+void VertexBenchmark();
+void CullBenchmark();
+void SortBenchmark();
+void UniformBenchmark();
+void TextureDecodeBenchmark();
+void JsonBenchmark();
+void AllocationBenchmark();
+void LogBenchmark();
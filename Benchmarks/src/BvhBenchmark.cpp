@@ -0,0 +1,140 @@
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "Bvh.h"
+#include "Harness.h"
+#include "JobSystem.h"
+
+// Rolling terrain grid with small triangles scattered above it, half of the triangles each
+static void BuildTestScene(uint32_t triangles, std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices)
+{
+	std::mt19937 rng(triangles);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	uint32_t cells = (uint32_t)std::sqrt((double)triangles / 4.0);
+	float cellSize = 200.0f / cells;
+	for (uint32_t z = 0; z <= cells; z++)
+	{
+		for (uint32_t x = 0; x <= cells; x++)
+		{
+			float height = std::sin(x * 0.05f) * std::cos(z * 0.07f) * 5.0f;
+			positions.push_back(glm::vec3(x * cellSize - 100.0f, height, z * cellSize - 100.0f));
+		}
+	}
+	for (uint32_t z = 0; z < cells; z++)
+	{
+		for (uint32_t x = 0; x < cells; x++)
+		{
+			uint32_t i = z * (cells + 1) + x;
+			indices.insert(indices.end(), { i, i + cells + 1, i + 1, i + 1, i + cells + 1, i + cells + 2 });
+		}
+	}
+
+	uint32_t scattered = triangles - cells * cells * 2;
+	for (uint32_t t = 0; t < scattered; t++)
+	{
+		glm::vec3 base(unit(rng) * 200.0f - 100.0f, 5.0f + unit(rng) * 20.0f, unit(rng) * 200.0f - 100.0f);
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			indices.push_back((uint32_t)positions.size());
+			positions.push_back(base + glm::vec3(unit(rng), unit(rng), unit(rng)) * 0.8f);
+		}
+	}
+}
+
+// Camera rays over a grid are coherent; random origins and directions are not
+static void BuildRays(uint32_t count, bool coherent, std::vector<Ray>& rays)
+{
+	std::mt19937 rng(count + coherent);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	uint32_t side = (uint32_t)std::sqrt((double)count);
+
+	rays.resize(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		Ray& ray = rays[i];
+		if (coherent)
+		{
+			float x = (float)(i % side) / side * 2.0f - 1.0f;
+			float y = (float)(i / side) / side * 2.0f - 1.0f;
+			ray.origin = glm::vec3(0.0f, 40.0f, 120.0f);
+			ray.direction = glm::normalize(glm::vec3(x, y * 0.6f - 0.5f, -1.0f));
+		}
+		else
+		{
+			ray.origin = glm::vec3(unit(rng) * 200.0f - 100.0f, unit(rng) * 30.0f, unit(rng) * 200.0f - 100.0f);
+			float cosTheta = unit(rng) * 2.0f - 1.0f;
+			float phi = unit(rng) * 6.2831853f;
+			float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+			ray.direction = glm::vec3(sinTheta * std::cos(phi), cosTheta, sinTheta * std::sin(phi));
+		}
+		ray.tMax = 500.0f;
+	}
+}
+
+// Build time, then closest hit and any hit rays on 1 and N threads
+void BvhBenchmark()
+{
+	const uint32_t rayCount = 1u << 19;
+
+	Harness::PrintHeader();
+	for (uint32_t triangles : { 100000u, 1000000u })
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+		BuildTestScene(triangles, positions, indices);
+
+		std::string scene = "bvh/" + std::to_string(triangles) + " tris ";
+		Bvh bvh;
+		Harness::RunSlow((scene + "build").c_str(), triangles, [&]()
+		{
+			bvh.Build(positions, indices);
+		});
+		const BvhStats& stats = bvh.Stats();
+		std::cout << "  " << stats.nodes << " nodes, " << stats.leaves << " leaves, depth " << stats.depth << ", "
+			<< std::fixed << std::setprecision(1) << stats.bytes / (1024.0 * 1024.0) << " MB" << std::defaultfloat << std::setprecision(6) << std::endl;
+
+		std::vector<Ray> rays;
+		std::vector<RayHit> hits(rayCount);
+		std::vector<uint8_t> occluded(rayCount);
+		for (bool coherent : { true, false })
+		{
+			BuildRays(rayCount, coherent, rays);
+			for (uint32_t threads : { 1u, JobSystem::DefaultWorkerCount() + 1 })
+			{
+				JobSystem jobs;
+				jobs.Init(threads - 1);
+
+				std::string suffix = (coherent ? " camera " : " random ") + std::to_string(threads) + "t";
+				Harness::RunSlow((scene + "closest" + suffix).c_str(), rayCount, [&]()
+				{
+					bvh.IntersectBatch(rays.data(), hits.data(), rayCount, jobs);
+				});
+				Harness::RunSlow((scene + "any" + suffix).c_str(), rayCount, [&]()
+				{
+					bvh.OccludedBatch(rays.data(), occluded.data(), rayCount, jobs);
+				});
+
+				if (threads == 1 && JobSystem::DefaultWorkerCount() == 0)
+					break;
+			}
+
+			uint32_t hitCount = 0;
+			uint32_t occludedCount = 0;
+			for (uint32_t i = 0; i < rayCount; i++)
+			{
+				hitCount += hits[i].Hit();
+				occludedCount += occluded[i];
+			}
+			std::cout << "  " << (coherent ? "camera" : "random") << " rays: " << std::fixed << std::setprecision(1)
+				<< 100.0 * hitCount / rayCount << "% closest hit, " << 100.0 * occludedCount / rayCount << "% occluded"
+				<< std::defaultfloat << std::setprecision(6) << std::endl;
+		}
+	}
+}
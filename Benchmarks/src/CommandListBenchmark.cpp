@@ -0,0 +1,88 @@
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Benchmarks.h"
+#include "CommandList.h"
+#include "Harness.h"
+#include "JobSystem.h"
+#include "RenderSnapshot.h"
+
+// Records a large synthetic scene into per chunk command lists with 1..16 threads
+void CommandListBenchmark()
+{
+	const uint32_t meshCount = 2000;
+	const uint32_t instanceCount = 500000;
+	const uint32_t chunkSize = 256;
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+
+	std::vector<DrawBinding> bindings(meshCount);
+	for (uint32_t i = 0; i < meshCount; i++)
+	{
+		bindings[i].vao = 1 + i;
+		bindings[i].indexCount = 300 + (i % 64) * 30;
+		bindings[i].textureCount = 1 + i % 3;
+		for (uint32_t t = 0; t < bindings[i].textureCount; t++)
+			bindings[i].textures[t] = { (int32_t)t + 10, t, 1 + (i * 3 + t) % 97 };
+	}
+
+	SceneUniforms uniforms;
+	uniforms.program = 1;
+	uniforms.drawIndex = 0;
+
+	RenderSnapshot snapshot;
+	snapshot.items.reserve(instanceCount);
+	snapshot.visible.reserve(instanceCount);
+	for (uint32_t i = 0; i < instanceCount; i++)
+	{
+		glm::mat4 world = glm::translate(glm::mat4(1.0f), glm::vec3(position(rng), position(rng), position(rng)));
+		snapshot.items.push_back({ (uint32_t)(rng() % meshCount), world });
+		snapshot.visible.push_back(i);
+	}
+
+	uint32_t chunks = (instanceCount + chunkSize - 1) / chunkSize;
+	snapshot.commandLists.resize(1 + chunks);
+
+	std::cout << "  " << instanceCount << " instances, " << meshCount << " meshes, " << chunks << " lists" << std::endl;
+
+	Harness::PrintHeader();
+	double baseline = 0.0;
+	for (uint32_t threads : { 1u, 2u, 4u, 8u, 12u, 16u })
+	{
+		JobSystem jobs;
+		jobs.Init(threads - 1);
+
+		std::string name = "commands/record " + std::to_string(threads) + "t";
+		double ns = Harness::RunSlow(name.c_str(), instanceCount, [&]()
+		{
+			RecordFrameSetup(snapshot.commandLists[0], uniforms);
+			jobs.ParallelFor(instanceCount, chunkSize, [&](uint32_t begin, uint32_t end)
+			{
+				CommandList& list = snapshot.commandLists[1 + begin / chunkSize];
+				list.Reset();
+				RecordMeshDraws(list, bindings, uniforms, snapshot.items.data(), snapshot.visible.data() + begin, end - begin);
+			});
+		}).medianNs;
+
+		if (threads == 1)
+		{
+			uint64_t commands = 0;
+			for (const CommandList& list : snapshot.commandLists)
+				commands += list.CommandCount();
+			std::cout << "  " << commands << " commands" << std::endl;
+			baseline = ns;
+		}
+		else
+		{
+			std::cout << "  " << std::fixed << std::setprecision(2) << baseline / ns << "x the single thread speed"
+				<< std::defaultfloat << std::setprecision(6) << std::endl;
+		}
+	}
+}
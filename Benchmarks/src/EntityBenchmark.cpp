@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Benchmarks.h"
+#include "Entities.h"
+#include "Harness.h"
+
+struct Position
+{
+	glm::vec3 value;
+};
+
+struct Velocity
+{
+	glm::vec3 value;
+};
+
+struct Health
+{
+	float value;
+};
+
+// 1M entities: every one has a Position, half a Velocity, a tenth Health
+void EntityBenchmark()
+{
+	const uint32_t count = 1000000;
+
+	// A fresh registry hands out the same handles every time
+	Registry registry;
+	std::vector<Entity> entities(count);
+	auto create = [&]()
+	{
+		for (uint32_t i = 0; i < count; i++)
+		{
+			entities[i] = registry.Create();
+			registry.Add(entities[i], Position{ glm::vec3((float)i) });
+		}
+	};
+	auto addOthers = [&]()
+	{
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (i % 2 == 0)
+				registry.Add(entities[i], Velocity{ glm::vec3(1.0f) });
+			if (i % 10 == 0)
+				registry.Add(entities[i], Health{ 100.0f });
+		}
+	};
+
+	Harness::PrintHeader();
+	Harness::RunSlow("entities/create + add Position", count, [&]()
+	{
+		registry = Registry();
+	}, create);
+
+	Harness::RunSlow("entities/add Velocity, Health", count, [&]()
+	{
+		for (Entity entity : entities)
+		{
+			registry.Remove<Velocity>(entity);
+			registry.Remove<Health>(entity);
+		}
+	}, addOthers);
+
+	float sink = 0.0f;
+	Harness::Run("entities/each Position", count, [&]()
+	{
+		registry.Each<Position>([&](Entity, Position& position) { position.value.y += 1.0f; });
+	});
+
+	Harness::Run("entities/each Position + Velocity", count / 2, [&]()
+	{
+		registry.Each<Position, Velocity>([&](Entity, Position& position, Velocity& velocity) { position.value += velocity.value * 0.016f; });
+	});
+
+	Harness::Run("entities/each Pos + Vel + Health", count / 10, [&]()
+	{
+		registry.Each<Position, Velocity, Health>([&](Entity, Position& position, Velocity&, Health& health) { sink += position.value.x * health.value; });
+		DoNotOptimize(sink);
+	});
+
+	// Reference: the same update over a plain array of structs
+	struct Object
+	{
+		glm::vec3 position;
+		glm::vec3 velocity;
+		float health;
+		bool moving;
+	};
+	std::vector<Object> objects(count);
+	for (uint32_t i = 0; i < count; i++)
+		objects[i] = { glm::vec3((float)i), glm::vec3(1.0f), 100.0f, i % 2 == 0 };
+	Harness::Run("entities/array of structs, moving", count / 2, [&]()
+	{
+		for (Object& object : objects)
+		{
+			if (object.moving)
+				object.position += object.velocity * 0.016f;
+		}
+		DoNotOptimize(objects.data());
+	});
+
+	std::mt19937 rng(40);
+	std::vector<Entity> shuffled = entities;
+	std::shuffle(shuffled.begin(), shuffled.end(), rng);
+	Harness::RunSlow("entities/remove Velocity, random", count, [&]()
+	{
+		for (uint32_t i = 0; i < count; i += 2)
+			registry.Add(entities[i], Velocity{ glm::vec3(1.0f) });
+	}, [&]()
+	{
+		for (Entity entity : shuffled)
+			registry.Remove<Velocity>(entity);
+	});
+
+	auto destroyHalf = [&]()
+	{
+		for (uint32_t i = 0; i < count / 2; i++)
+			registry.Destroy(shuffled[i]);
+	};
+	Harness::RunSlow("entities/destroy half, random", count / 2, [&]()
+	{
+		registry = Registry();
+		create();
+		addOthers();
+	}, destroyHalf);
+
+	uint32_t stale = 0;
+	for (uint32_t i = 0; i < count / 2; i++)
+		stale += registry.Alive(shuffled[i]) ? 0 : 1;
+	Harness::Check(stale == count / 2, "destroyed handles are no longer alive");
+
+	Harness::RunSlow("entities/create half, reused slots", count / 2, [&]()
+	{
+		registry = Registry();
+		create();
+		addOthers();
+		destroyHalf();
+	}, [&]()
+	{
+		for (uint32_t i = 0; i < count / 2; i++)
+			registry.Add(registry.Create(), Position{ glm::vec3(0.0f) });
+	});
+
+	// Every destroyed index is in use again; the old handles must not reach the new entities
+	uint32_t attached = 0;
+	for (uint32_t i = 0; i < count / 2; i++)
+	{
+		attached += registry.Add(shuffled[i], Health{ 0.0f }) ? 1 : 0;
+		attached += registry.Get<Position>(shuffled[i]) ? 1 : 0;
+	}
+	Harness::Check(attached == 0, "stale handles can't add or get components of reused indices");
+
+	std::cout << "  stale handles rejected: " << stale << " of " << count / 2 << ", alive " << registry.AliveCount() << std::endl;
+}
@@ -0,0 +1,56 @@
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Benchmarks.h"
+#include "FrustumCulling.h"
+#include "Harness.h"
+#include "JobSystem.h"
+
+// 10k, 100k and 1M boxes scattered around the camera, about a sixth of them in view
+void FrustumBenchmark()
+{
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+
+	FrustumCuller culler;
+	culler.SetFrustum(projection * view);
+
+	Harness::PrintHeader();
+	for (uint32_t count : { 10000u, 100000u, 1000000u })
+	{
+		std::mt19937 rng(count);
+		std::uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+		std::uniform_real_distribution<float> size(0.5f, 5.0f);
+
+		BoundsSoA bounds;
+		bounds.Resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			glm::vec3 min(position(rng), position(rng) * 0.1f, position(rng));
+			bounds.Set(i, min, min + glm::vec3(size(rng), size(rng), size(rng)));
+		}
+
+		std::vector<uint32_t> visible;
+		for (uint32_t threads : { 1u, JobSystem::DefaultWorkerCount() + 1 })
+		{
+			JobSystem jobs;
+			jobs.Init(threads - 1);
+
+			std::string name = "frustum/" + std::to_string(count) + " boxes " + std::to_string(threads) + "t";
+			Harness::Run(name.c_str(), count, [&]()
+			{
+				culler.Cull(bounds, jobs, visible);
+				DoNotOptimize(visible.data());
+			});
+
+			if (threads == 1 && JobSystem::DefaultWorkerCount() == 0)
+				break;
+		}
+		std::cout << "  " << visible.size() << " of " << count << " visible" << std::endl;
+	}
+}
@@ -0,0 +1,133 @@
+#include "Harness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include <json.hpp>
+
+static double Median(std::vector<double> values)
+{
+	if (values.empty())
+		return 0.0;
+	size_t middle = values.size() / 2;
+	std::nth_element(values.begin(), values.begin() + middle, values.end());
+	double median = values[middle];
+	if (values.size() % 2 == 0)
+		median = (median + *std::max_element(values.begin(), values.begin() + middle)) * 0.5;
+	return median;
+}
+
+bool Harness::Check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		std::cout << "  FAILED: " << what << std::endl;
+		s_failures++;
+	}
+	return condition;
+}
+
+void Harness::PrintHeader()
+{
+	std::cout << "  " << std::left << std::setw(34) << "benchmark" << std::right
+		<< "  iterations  kept     median ns    +-%        min ns        cycles   ns/item" << std::endl;
+}
+
+const HarnessResult& Harness::Record(const char* name, uint64_t items, uint64_t iterations,
+	const std::vector<double>& ns, const std::vector<double>& cycles)
+{
+	// Scaled so the MAD estimates the standard deviation for normal noise
+	double median = Median(ns);
+	std::vector<double> deviations(ns.size());
+	for (size_t i = 0; i < ns.size(); i++)
+		deviations[i] = std::abs(ns[i] - median);
+	double limit = s_options.outlierMads * 1.4826 * Median(deviations);
+
+	std::vector<double> keptNs, keptCycles;
+	for (size_t i = 0; i < ns.size(); i++)
+	{
+		if (limit <= 0.0 || std::abs(ns[i] - median) <= limit)
+		{
+			keptNs.push_back(ns[i]);
+			keptCycles.push_back(cycles[i]);
+			s_totalNs += ns[i];
+			s_totalCycles += cycles[i];
+		}
+	}
+
+	HarnessResult result;
+	result.name = name;
+	result.iterations = iterations;
+	result.items = items;
+	result.samples = (uint32_t)ns.size();
+	result.kept = (uint32_t)keptNs.size();
+	if (!keptNs.empty())
+	{
+		double sum = 0.0, squares = 0.0;
+		for (double value : keptNs)
+		{
+			sum += value;
+			squares += value * value;
+		}
+		double mean = sum / keptNs.size();
+		result.medianNs = Median(keptNs) / iterations;
+		result.meanNs = mean / iterations;
+		result.minNs = *std::min_element(keptNs.begin(), keptNs.end()) / iterations;
+		result.stdDevNs = std::sqrt(std::max(squares / keptNs.size() - mean * mean, 0.0)) / iterations;
+		result.cycles = Median(keptCycles) / iterations;
+	}
+
+	std::cout << "  " << std::left << std::setw(34) << result.name << std::right
+		<< std::setw(12) << result.iterations << std::setw(6) << result.kept
+		<< std::fixed << std::setprecision(1) << std::setw(14) << result.medianNs
+		<< std::setw(7) << (result.meanNs > 0.0 ? result.stdDevNs / result.meanNs * 100.0 : 0.0)
+		<< std::setw(14) << result.minNs << std::setw(14) << result.cycles
+		<< std::setprecision(3) << std::setw(10) << (items > 0 ? result.medianNs / items : 0.0)
+		<< std::defaultfloat << std::setprecision(6) << std::endl;
+
+	s_results.push_back(result);
+	return s_results.back();
+}
+
+bool Harness::WriteJson(const std::string& file)
+{
+	nlohmann::json doc;
+	doc["options"]["warmup"] = s_options.warmup;
+	doc["options"]["repetitions"] = s_options.repetitions;
+	doc["options"]["min_sample_ms"] = s_options.minSampleMs;
+	doc["options"]["outlier_mads"] = s_options.outlierMads;
+	doc["options"]["slow_repetitions"] = s_options.slowRepetitions;
+	doc["tsc_ghz"] = s_totalNs > 0.0 ? s_totalCycles / s_totalNs : 0.0;
+	doc["failures"] = s_failures;
+
+	doc["results"] = nlohmann::json::array();
+	for (const HarnessResult& result : s_results)
+	{
+		nlohmann::json entry;
+		entry["name"] = result.name;
+		entry["iterations"] = result.iterations;
+		entry["items"] = result.items;
+		entry["samples"] = result.samples;
+		entry["kept"] = result.kept;
+		entry["median_ns"] = result.medianNs;
+		entry["mean_ns"] = result.meanNs;
+		entry["min_ns"] = result.minNs;
+		entry["stddev_ns"] = result.stdDevNs;
+		entry["cycles"] = result.cycles;
+		entry["ns_per_item"] = result.items > 0 ? result.medianNs / result.items : 0.0;
+		doc["results"].push_back(entry);
+	}
+
+	std::ofstream stream(file);
+	if (!stream)
+	{
+		std::cout << "Failed to write results: " << file << std::endl;
+		return false;
+	}
+	stream << doc.dump(1, '\t') << std::endl;
+	std::cout << s_results.size() << " results written to " << file << std::endl;
+	return (bool)stream;
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+struct HarnessOptions
+{
+	uint32_t warmup = 3;		// samples run and thrown away first
+	uint32_t repetitions = 21;	// samples taken, before outlier rejection
+	double minSampleMs = 2.0;	// iterations per sample are doubled until a sample takes this long
+	double outlierMads = 3.0;	// samples further than this many scaled MADs from the median are dropped
+	uint32_t slowRepetitions = 5;	// samples taken by RunSlow
+};
+
+// Figures are per iteration over the kept samples
+struct HarnessResult
+{
+	std::string name;
+	uint64_t iterations = 0;	// per sample
+	uint64_t items = 0;			// processed per iteration, for the per item figures
+	uint32_t samples = 0;
+	uint32_t kept = 0;
+	double medianNs = 0.0;
+	double meanNs = 0.0;
+	double minNs = 0.0;
+	double stdDevNs = 0.0;
+	double cycles = 0.0;		// median, in time stamp counter ticks; 0 without one
+};
+
+// Keeps the compiler from optimizing away a value a benchmark computes
+template <typename T>
+inline void DoNotOptimize(const T& value)
+{
+#if defined(_MSC_VER)
+	static volatile const void* sink;
+	sink = &value;
+	_ReadWriteBarrier();
+#else
+	asm volatile("" : : "r,m"(value) : "memory");
+#endif
+}
+
+// Runner for small hot paths: calibrates the iterations per sample, warms up, takes
+// repeated samples, drops outliers by median absolute deviation and reports ns and
+// cycles per iteration. Results accumulate over the whole run for WriteJson.
+class Harness
+{
+public:
+	static void SetOptions(const HarnessOptions& options) { s_options = options; }
+	static const HarnessOptions& Options() { return s_options; }
+
+	template <typename Fn>
+	static const HarnessResult& Run(const char* name, uint64_t items, Fn&& fn)
+	{
+		// Short samples are dominated by timer resolution
+		uint64_t iterations = 1;
+		double minNs = s_options.minSampleMs * 1e6;
+		while (Sample(fn, iterations, nullptr) < minNs && iterations < (1ull << 32))
+			iterations *= 2;
+
+		for (uint32_t i = 0; i < s_options.warmup; i++)
+			Sample(fn, iterations, nullptr);
+
+		std::vector<double> ns(s_options.repetitions);
+		std::vector<double> cycles(s_options.repetitions);
+		for (uint32_t i = 0; i < s_options.repetitions; i++)
+			ns[i] = Sample(fn, iterations, &cycles[i]);
+
+		return Record(name, items, iterations, ns, cycles);
+	}
+
+	// Fixed iterations per sample and untimed reset work after each, for state that runs
+	// out, like a bounded queue that must be drained between samples
+	template <typename Fn, typename Reset>
+	static const HarnessResult& RunFixed(const char* name, uint64_t items, uint64_t iterations, Fn&& fn, Reset&& reset)
+	{
+		auto none = []() {};
+		return Measure(name, items, iterations, s_options.warmup, s_options.repetitions, none, fn, reset);
+	}
+
+	// Whole scenes, frames and batches that take milliseconds each: one iteration per
+	// sample, one warmup and only slowRepetitions samples. Setup runs untimed before each
+	// sample, so the state the last sample left behind is there for the next benchmark.
+	template <typename Setup, typename Fn>
+	static const HarnessResult& RunSlow(const char* name, uint64_t items, Setup&& setup, Fn&& fn)
+	{
+		auto none = []() {};
+		return Measure(name, items, 1, 1, s_options.slowRepetitions, setup, fn, none);
+	}
+
+	template <typename Fn>
+	static const HarnessResult& RunSlow(const char* name, uint64_t items, Fn&& fn)
+	{
+		return RunSlow(name, items, []() {}, fn);
+	}
+
+	// Correctness checks alongside the timings; a failed one fails the run
+	static bool Check(bool condition, const char* what);
+	static uint32_t Failures() { return s_failures; }
+
+	static void PrintHeader();
+	static const std::vector<HarnessResult>& Results() { return s_results; }
+	// Every result so far, with the options and the measured time stamp counter rate
+	static bool WriteJson(const std::string& file);
+
+	static uint64_t Cycles()
+	{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return 0;
+#endif
+	}
+
+private:
+	template <typename Fn>
+	static double Sample(Fn& fn, uint64_t iterations, double* cycles)
+	{
+		auto start = std::chrono::steady_clock::now();
+		uint64_t startCycles = Cycles();
+		for (uint64_t i = 0; i < iterations; i++)
+			fn();
+		uint64_t endCycles = Cycles();
+		double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+		if (cycles)
+			*cycles = (double)(endCycles - startCycles);
+		return ns;
+	}
+
+	template <typename Setup, typename Fn, typename Reset>
+	static const HarnessResult& Measure(const char* name, uint64_t items, uint64_t iterations, uint32_t warmup, uint32_t repetitions,
+		Setup& setup, Fn& fn, Reset& reset)
+	{
+		for (uint32_t i = 0; i < warmup; i++)
+		{
+			setup();
+			Sample(fn, iterations, nullptr);
+			reset();
+		}
+
+		std::vector<double> ns(repetitions);
+		std::vector<double> cycles(repetitions);
+		for (uint32_t i = 0; i < repetitions; i++)
+		{
+			setup();
+			ns[i] = Sample(fn, iterations, &cycles[i]);
+			reset();
+		}
+
+		return Record(name, items, iterations, ns, cycles);
+	}
+
+	static const HarnessResult& Record(const char* name, uint64_t items, uint64_t iterations,
+		const std::vector<double>& ns, const std::vector<double>& cycles);
+
+	static inline HarnessOptions s_options;
+	static inline std::vector<HarnessResult> s_results;
+	static inline double s_totalNs = 0.0;
+	static inline double s_totalCycles = 0.0;
+	static inline uint32_t s_failures = 0;
+};
@@ -0,0 +1,535 @@
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <json.hpp>
+#include <stb_image.h>
+
+#include "Benchmarks.h"
+#include "CommandList.h"
+#include "FrameArena.h"
+#include "FrustumCulling.h"
+#include "Harness.h"
+#include "JobSystem.h"
+#include "LightCulling.h"
+#include "RenderSnapshot.h"
+#include "SoftwareRasterizer.h"
+
+// Small engine paths under the harness, single threaded and without GL. Each reports
+// per iteration; the items column is what the per item figure divides by.
+
+void VertexBenchmark()
+{
+	const uint32_t count = 65536;
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<Vertex> vertices(count);
+	for (Vertex& vertex : vertices)
+	{
+		vertex.Position = glm::vec3(unit(rng), unit(rng), unit(rng)) * 10.0f;
+		vertex.Normal = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + glm::vec3(0.0f, 0.0f, 2.0f));
+	}
+
+	glm::mat4 world = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(3.0f, 0.0f, -20.0f)), 0.7f, glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+	glm::mat4 clip = viewProjection * world;
+	glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(world)));
+	glm::vec3 sun = glm::normalize(glm::vec3(-0.4f, -1.0f, -0.3f));
+
+	std::vector<glm::vec4> positions(count);
+	std::vector<float> light(count);
+
+	Harness::PrintHeader();
+	// What the software rasterizer's vertex stage does per vertex
+	Harness::Run("vertex/clip + light 64k", count, [&]()
+	{
+		for (uint32_t i = 0; i < count; i++)
+		{
+			positions[i] = clip * glm::vec4(vertices[i].Position, 1.0f);
+			light[i] = 0.3f + glm::max(glm::dot(normalMatrix * vertices[i].Normal, -sun), 0.0f);
+		}
+		DoNotOptimize(positions.data());
+	});
+
+	// What the model does per instance to get its world bounds
+	Harness::Run("vertex/world bounds 64k", count, [&]()
+	{
+		glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+		for (const Vertex& vertex : vertices)
+		{
+			glm::vec3 p = glm::vec3(world * glm::vec4(vertex.Position, 1.0f));
+			min = glm::min(min, p);
+			max = glm::max(max, p);
+		}
+		DoNotOptimize(min);
+		DoNotOptimize(max);
+	});
+}
+
+void CullBenchmark()
+{
+	JobSystem jobs;
+	jobs.Init(0);
+	std::mt19937 rng(2);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+
+	const uint32_t instances = 100000;
+	BoundsSoA bounds;
+	bounds.Resize(instances);
+	for (uint32_t i = 0; i < instances; i++)
+	{
+		glm::vec3 min(position(rng), position(rng) * 0.1f, position(rng));
+		bounds.Set(i, min, min + glm::vec3(1.0f + unit(rng) * 4.0f));
+	}
+	FrustumCuller frustum;
+	frustum.SetFrustum(projection * view);
+	std::vector<uint32_t> visible;
+
+	const uint32_t lightCount = 1024;
+	std::vector<Light> lights(lightCount);
+	for (Light& light : lights)
+	{
+		light.type = unit(rng) < 0.25f ? LightType::Spot : LightType::Point;
+		light.position = glm::vec3(position(rng), position(rng) * 0.1f, position(rng)) * 0.2f;
+		light.range = 2.0f + unit(rng) * 10.0f;
+		light.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+		light.outerCos = 0.8f;
+		light.innerCos = 0.9f;
+	}
+	LightCuller lightCuller;
+	lightCuller.SetProjection(projection, 0.1f, 1000.0f);
+	ClusterLightLists lists;
+
+	Harness::PrintHeader();
+	Harness::Run("cull/frustum 100k instances", instances, [&]()
+	{
+		frustum.Cull(bounds, jobs, visible);
+		DoNotOptimize(visible.data());
+	});
+	Harness::Run("cull/clustered lights 1k", lightCount, [&]()
+	{
+		lightCuller.Cull(lights, view, jobs, lists);
+		DoNotOptimize(lists.indices.data());
+	});
+}
+
+void SortBenchmark()
+{
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> depth(0.1f, 1000.0f);
+
+	Harness::PrintHeader();
+	for (uint32_t count : { 10000u, 100000u })
+	{
+		// Mesh in the high bits to group state changes, then front to back; positive
+		// floats keep their order as integers
+		std::vector<uint64_t> keys(count);
+		std::vector<RenderItem> items(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			float z = depth(rng);
+			uint32_t zBits;
+			std::memcpy(&zBits, &z, sizeof(zBits));
+			items[i].mesh = rng() % 500;
+			keys[i] = (uint64_t)items[i].mesh << 32 | zBits;
+		}
+		std::vector<uint64_t> sortedKeys(count);
+		std::vector<uint32_t> visible(count), sortedVisible(count);
+		for (uint32_t i = 0; i < count; i++)
+			visible[i] = i;
+
+		// Both include copying the unsorted input back
+		std::string name = "sort/draw keys " + std::to_string(count / 1000) + "k";
+		Harness::Run(name.c_str(), count, [&]()
+		{
+			sortedKeys = keys;
+			std::sort(sortedKeys.begin(), sortedKeys.end());
+			DoNotOptimize(sortedKeys.data());
+		});
+
+		name = "sort/visible by mesh " + std::to_string(count / 1000) + "k";
+		Harness::Run(name.c_str(), count, [&]()
+		{
+			sortedVisible = visible;
+			std::sort(sortedVisible.begin(), sortedVisible.end(), [&](uint32_t a, uint32_t b) { return items[a].mesh < items[b].mesh; });
+			DoNotOptimize(sortedVisible.data());
+		});
+	}
+}
+
+void UniformBenchmark()
+{
+	const uint32_t meshCount = 64;
+	const uint32_t count = 1024;
+	std::vector<DrawBinding> bindings(meshCount);
+	for (uint32_t i = 0; i < meshCount; i++)
+	{
+		bindings[i].vao = 1 + i;
+		bindings[i].indexCount = 300 + i * 30;
+		bindings[i].textureCount = 1 + i % 3;
+		for (uint32_t t = 0; t < bindings[i].textureCount; t++)
+			bindings[i].textures[t] = { (int32_t)t + 10, t, 1 + (i * 3 + t) % 17 };
+	}
+
+	SceneUniforms uniforms;
+	uniforms.program = 1;
+	uniforms.drawIndex = 0;
+
+	std::mt19937 rng(4);
+	RenderSnapshot snapshot;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		snapshot.items.push_back({ (uint32_t)(rng() % meshCount), glm::translate(glm::mat4(1.0f), glm::vec3((float)i)) });
+		snapshot.visible.push_back(i);
+	}
+
+	CommandList list;
+	Harness::PrintHeader();
+	Harness::Run("uniforms/frame setup", 1, [&]()
+	{
+		list.Reset();
+		RecordFrameSetup(list, uniforms);
+		DoNotOptimize(list);
+	});
+	Harness::Run("uniforms/record draws 1k", count, [&]()
+	{
+		list.Reset();
+		RecordMeshDraws(list, bindings, uniforms, snapshot.items.data(), snapshot.visible.data(), count);
+		DoNotOptimize(list);
+	});
+	Harness::Run("uniforms/set mat4 1k", count, [&]()
+	{
+		list.Reset();
+		for (uint32_t i = 0; i < count; i++)
+			list.SetUniformMat4(3, snapshot.items[i].world);
+		DoNotOptimize(list);
+	});
+}
+
+// Minimal PNG writer so decoding has realistic input without shipping an image: rows
+// use the Sub filter and the zlib stream uses fixed Huffman codes with greedy matches.
+class PngWriter
+{
+public:
+	std::vector<uint8_t> Encode(const std::vector<uint32_t>& texels, uint32_t width, uint32_t height)
+	{
+		std::vector<uint8_t> filtered;
+		filtered.reserve((size_t)height * (width * 4 + 1));
+		const uint8_t* pixels = reinterpret_cast<const uint8_t*>(texels.data());
+		for (uint32_t y = 0; y < height; y++)
+		{
+			filtered.push_back(1);
+			const uint8_t* row = pixels + (size_t)y * width * 4;
+			for (uint32_t x = 0; x < width * 4; x++)
+				filtered.push_back((uint8_t)(row[x] - (x >= 4 ? row[x - 4] : 0)));
+		}
+
+		std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		uint8_t header[13] = { 0, 0, 0, 0, 0, 0, 0, 0, 8, 6, 0, 0, 0 };
+		WriteBigEndian(header, width);
+		WriteBigEndian(header + 4, height);
+		Chunk(png, "IHDR", header, sizeof(header));
+		std::vector<uint8_t> zlib = Deflate(filtered);
+		Chunk(png, "IDAT", zlib.data(), zlib.size());
+		Chunk(png, "IEND", nullptr, 0);
+		return png;
+	}
+
+private:
+	std::vector<uint8_t> m_out;
+	uint32_t m_bits = 0;
+	uint32_t m_bitCount = 0;
+
+	static void WriteBigEndian(uint8_t* out, uint32_t value)
+	{
+		out[0] = (uint8_t)(value >> 24);
+		out[1] = (uint8_t)(value >> 16);
+		out[2] = (uint8_t)(value >> 8);
+		out[3] = (uint8_t)value;
+	}
+
+	static uint32_t Crc(const uint8_t* data, size_t size, uint32_t crc)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			crc ^= data[i];
+			for (uint32_t bit = 0; bit < 8; bit++)
+				crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+		}
+		return crc;
+	}
+
+	static void Chunk(std::vector<uint8_t>& png, const char* type, const uint8_t* data, size_t size)
+	{
+		uint8_t word[4];
+		WriteBigEndian(word, (uint32_t)size);
+		png.insert(png.end(), word, word + 4);
+		png.insert(png.end(), type, type + 4);
+		if (size > 0)
+			png.insert(png.end(), data, data + size);
+		uint32_t crc = Crc(reinterpret_cast<const uint8_t*>(type), 4, 0xFFFFFFFFu);
+		WriteBigEndian(word, Crc(data, size, crc) ^ 0xFFFFFFFFu);
+		png.insert(png.end(), word, word + 4);
+	}
+
+	void Bits(uint32_t value, uint32_t count)
+	{
+		m_bits |= value << m_bitCount;
+		m_bitCount += count;
+		while (m_bitCount >= 8)
+		{
+			m_out.push_back((uint8_t)m_bits);
+			m_bits >>= 8;
+			m_bitCount -= 8;
+		}
+	}
+
+	// Huffman codes go most significant bit first
+	void Code(uint32_t code, uint32_t length)
+	{
+		uint32_t reversed = 0;
+		for (uint32_t i = 0; i < length; i++)
+			reversed |= ((code >> i) & 1) << (length - 1 - i);
+		Bits(reversed, length);
+	}
+
+	void Symbol(uint32_t symbol)
+	{
+		if (symbol < 144)
+			Code(0x30 + symbol, 8);
+		else if (symbol < 256)
+			Code(0x190 + symbol - 144, 9);
+		else if (symbol < 280)
+			Code(symbol - 256, 7);
+		else
+			Code(0xC0 + symbol - 280, 8);
+	}
+
+	void Match(uint32_t length, uint32_t distance)
+	{
+		static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		static const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		static const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		static const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+		uint32_t code = 28;
+		while (lengthBase[code] > length)
+			code--;
+		Symbol(257 + code);
+		Bits(length - lengthBase[code], lengthExtra[code]);
+
+		code = 29;
+		while (distanceBase[code] > distance)
+			code--;
+		Code(code, 5);
+		Bits(distance - distanceBase[code], distanceExtra[code]);
+	}
+
+	std::vector<uint8_t> Deflate(const std::vector<uint8_t>& data)
+	{
+		m_out = { 0x78, 0x01 };
+		m_bits = 0;
+		m_bitCount = 0;
+		Bits(1, 1);		// final block
+		Bits(1, 2);		// fixed codes
+
+		const uint32_t window = 32768;
+		std::vector<int32_t> head(1 << 15, -1);
+		auto hash = [&](size_t i) { return ((data[i] << 10) ^ (data[i + 1] << 5) ^ data[i + 2]) & 0x7FFF; };
+		size_t i = 0;
+		while (i < data.size())
+		{
+			uint32_t length = 0;
+			uint32_t distance = 0;
+			if (i + 3 <= data.size())
+			{
+				int32_t candidate = head[hash(i)];
+				head[hash(i)] = (int32_t)i;
+				if (candidate >= 0 && i - candidate <= window)
+				{
+					size_t limit = std::min<size_t>(258, data.size() - i);
+					while (length < limit && data[candidate + length] == data[i + length])
+						length++;
+					distance = (uint32_t)(i - candidate);
+				}
+			}
+
+			if (length >= 3)
+			{
+				Match(length, distance);
+				for (size_t j = i + 1; j < i + length && j + 3 <= data.size(); j++)
+					head[hash(j)] = (int32_t)j;
+				i += length;
+			}
+			else
+			{
+				Symbol(data[i]);
+				i++;
+			}
+		}
+		Symbol(256);
+		if (m_bitCount > 0)
+			Bits(0, 8 - m_bitCount);
+
+		uint32_t a = 1, b = 0;
+		for (uint8_t byte : data)
+		{
+			a = (a + byte) % 65521;
+			b = (b + a) % 65521;
+		}
+		uint8_t adler[4];
+		WriteBigEndian(adler, (b << 16) | a);
+		m_out.insert(m_out.end(), adler, adler + 4);
+		return m_out;
+	}
+};
+
+void TextureDecodeBenchmark()
+{
+	// Gradients with a little noise, about as compressible as a diffuse texture
+	const uint32_t size = 512;
+	std::mt19937 rng(5);
+	std::vector<uint32_t> texels((size_t)size * size);
+	for (uint32_t y = 0; y < size; y++)
+	{
+		for (uint32_t x = 0; x < size; x++)
+		{
+			uint32_t noise = rng() % 8;
+			uint32_t r = (x / 2 + noise) & 0xFF;
+			uint32_t g = (y / 2 + noise) & 0xFF;
+			uint32_t b = (((x / 32 + y / 32) & 1) ? 200 : 60) + noise;
+			texels[(size_t)y * size + x] = 0xFF000000u | b << 16 | g << 8 | r;
+		}
+	}
+	PngWriter writer;
+	std::vector<uint8_t> png = writer.Encode(texels, size, size);
+
+	SoftwareRasterizer rasterizer;
+	Harness::PrintHeader();
+	std::string name = "decode/png 512x512 (" + std::to_string(png.size() / 1024) + " KB)";
+	Harness::Run(name.c_str(), (uint64_t)size * size, [&]()
+	{
+		int32_t width, height, components;
+		uint8_t* data = stbi_load_from_memory(png.data(), (int32_t)png.size(), &width, &height, &components, 4);
+		DoNotOptimize(data);
+		stbi_image_free(data);
+	});
+	// Box filtered mip chain, the rest of loading a texture for the software rasterizer
+	Harness::Run("decode/software mips 512x512", (uint64_t)size * size, [&]()
+	{
+		rasterizer.AddTexture(size, size, texels.data());
+		DoNotOptimize(rasterizer);
+	});
+}
+
+void JsonBenchmark()
+{
+	// The keys the game reads from config.json at startup
+	const char* config = R"({
+		"win_title": "Scene Demo", "screen_width": 1280, "screen_height": 720, "fullscreen": false,
+		"vsync": true, "adaptive_vsync": true, "frame_cap": 0, "update_rate": 60, "idle_mode": false,
+		"idle_timeout": 100, "stats_interval": 0, "render_thread": true, "sim_load_ms": 0, "render_load_ms": 0,
+		"worker_threads": -1, "frames_in_flight": 3, "gpu_profiler": true, "trace_file": "trace.json",
+		"overlay": true, "stress_lights": 0, "render_path": "forward", "shadows": true, "shadow_cascades": 4,
+		"shadow_resolution": 2048, "shadow_distance": 0.3, "frustum_culling": true, "occlusion_culling": true,
+		"occluder_triangles": 16384, "scene_bvh": true, "headless": false, "headless_frames": 600,
+		"capture_directory": "", "capture_interval": 60, "software_renderer": false, "benchmark_frames": 1000,
+		"camera_path": "", "scene": "scene/fbx/from_steve.fbx", "generate_scene": ""
+	})";
+	const char* keys[] = { "screen_width", "screen_height", "vsync", "update_rate", "worker_threads", "render_path", "shadow_distance", "scene" };
+
+	// A scene benchmark result: three series of 1000 samples
+	std::mt19937 rng(6);
+	std::uniform_real_distribution<double> frame(3.0, 5.0);
+	nlohmann::json results;
+	for (const char* series : { "frame_ms", "cpu_ms", "gpu_ms" })
+	{
+		std::vector<double> samples(1000);
+		for (double& sample : samples)
+			sample = frame(rng);
+		results[series]["samples"] = samples;
+	}
+	std::string resultsText = results.dump(1, '\t');
+
+	Harness::PrintHeader();
+	// Parsed and read the way ParseConfig does
+	Harness::Run("json/config", 1, [&]()
+	{
+		nlohmann::json doc = nlohmann::json::parse(config, nullptr, false);
+		int32_t found = 0;
+		for (const char* key : keys)
+			found += doc.contains(key) ? 1 : 0;
+		DoNotOptimize(found);
+	});
+	std::string name = "json/bench results (" + std::to_string(resultsText.size() / 1024) + " KB)";
+	Harness::Run(name.c_str(), 3000, [&]()
+	{
+		nlohmann::json doc = nlohmann::json::parse(resultsText);
+		DoNotOptimize(doc);
+	});
+}
+
+void AllocationBenchmark()
+{
+	const uint32_t count = 1024;
+	std::vector<RenderItem> reused;
+	std::vector<Texture> textures = { { 1, "texture_diffuse", "" }, { 2, "texture_specular", "" }, { 3, "texture_normal", "" } };
+
+	Harness::PrintHeader();
+	Harness::Run("alloc/new delete 64 B", 1, [&]()
+	{
+		void* memory = ::operator new(64);
+		DoNotOptimize(memory);
+		::operator delete(memory);
+	});
+	Harness::Run("alloc/vector growth 1k items", count, [&]()
+	{
+		std::vector<RenderItem> items;
+		for (uint32_t i = 0; i < count; i++)
+			items.push_back({ i, glm::mat4(1.0f) });
+		DoNotOptimize(items.data());
+	});
+	// What the snapshot does every frame once its capacity settled
+	Harness::Run("alloc/vector reused 1k items", count, [&]()
+	{
+		reused.clear();
+		for (uint32_t i = 0; i < count; i++)
+			reused.push_back({ i, glm::mat4(1.0f) });
+		DoNotOptimize(reused.data());
+	});
+	// Growing in the frame arena: no heap, and the arena rewinds instead of freeing
+	Harness::Run("alloc/arena vector growth 1k items", count, [&]()
+	{
+		ArenaScope scope;
+		FrameVector<RenderItem> items;
+		for (uint32_t i = 0; i < count; i++)
+			items.push_back({ i, glm::mat4(1.0f) });
+		DoNotOptimize(items.data());
+	});
+	// The sampler names Mesh::Draw built for every texture of every draw, now once per mesh
+	Harness::Run("alloc/sampler name strings", (uint64_t)textures.size(), [&]()
+	{
+		int32_t diffuseNr = 1, specularNr = 1;
+		size_t length = 0;
+		for (const Texture& texture : textures)
+		{
+			std::string number;
+			if (texture.type == "texture_diffuse")
+				number = std::to_string(diffuseNr++);
+			else if (texture.type == "texture_specular")
+				number = std::to_string(specularNr++);
+			length += ("material." + texture.type + number).size();
+		}
+		DoNotOptimize(length);
+	});
+}
@@ -0,0 +1,65 @@
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Benchmarks.h"
+#include "Harness.h"
+#include "JobSystem.h"
+#include "LightCulling.h"
+
+// Assigns 256..16k point and spot lights scattered through the view to the cluster grid
+void LightCullingBenchmark()
+{
+	const float farPlane = 200.0f;
+
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(0.0f, 10.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, farPlane);
+
+	Harness::PrintHeader();
+	for (uint32_t lightCount : { 256u, 1024u, 4096u, 16384u })
+	{
+		std::mt19937 rng(lightCount);
+		std::uniform_real_distribution<float> across(-farPlane * 0.5f, farPlane * 0.5f);
+		std::uniform_real_distribution<float> depth(-farPlane, 0.0f);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		std::vector<Light> lights(lightCount);
+		for (Light& light : lights)
+		{
+			light.type = unit(rng) < 0.25f ? LightType::Spot : LightType::Point;
+			light.position = glm::vec3(across(rng), across(rng) * 0.2f + 10.0f, depth(rng));
+			light.range = 2.0f + unit(rng) * 8.0f;
+			light.direction = glm::normalize(glm::vec3(unit(rng) - 0.5f, -1.0f, unit(rng) - 0.5f));
+			light.outerCos = std::cos(glm::radians(20.0f + unit(rng) * 25.0f));
+			light.innerCos = light.outerCos + (1.0f - light.outerCos) * 0.5f;
+		}
+
+		ClusterLightLists lists;
+		for (uint32_t threads : { 1u, JobSystem::DefaultWorkerCount() + 1 })
+		{
+			JobSystem jobs;
+			jobs.Init(threads - 1);
+
+			LightCuller culler;
+			culler.SetProjection(projection, 0.1f, farPlane);
+
+			std::string name = "lights/" + std::to_string(lightCount) + " lights " + std::to_string(threads) + "t";
+			Harness::Run(name.c_str(), lightCount, [&]()
+			{
+				culler.Cull(lights, view, jobs, lists);
+				DoNotOptimize(lists.indices.data());
+			});
+
+			if (threads == 1 && JobSystem::DefaultWorkerCount() == 0)
+				break;
+		}
+		std::cout << "  " << std::fixed << std::setprecision(2) << (double)lists.indices.size() / LightCuller::ClusterCount
+			<< std::defaultfloat << std::setprecision(6) << " lights per cluster" << std::endl;
+	}
+}
@@ -0,0 +1,72 @@
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "Benchmarks.h"
+#include "Harness.h"
+#include "Log.h"
+
+// What a log call costs the thread making it, against the synchronous flush it replaced.
+// The writer goes to a scratch file so the table stays readable.
+void LogBenchmark()
+{
+	const char* logFile = "log_benchmark.txt";
+	const char* streamFile = "log_benchmark_stream.txt";
+	// Bursts that fit the ring, drained between samples, so nothing is dropped
+	const uint64_t burst = Log::SlotCount / 8;
+	uint32_t frame = 0;
+	double ms = 16.6;
+
+	Harness::PrintHeader();
+	Harness::Run("log/compiled out", 1, [&]()
+	{
+		LOG_TRACE("Frame " << frame++ << " took " << ms << "ms");
+		DoNotOptimize(frame);
+	});
+
+	Log::SetLevel(LogLevel::Warn);
+	Harness::Run("log/filtered at run time", 1, [&]()
+	{
+		LOG_INFO("Frame " << frame++ << " took " << ms << "ms");
+		DoNotOptimize(frame);
+	});
+	Log::SetLevel(LogLevel::Trace);
+
+	if (!Log::Init(logFile))
+		return;
+	Harness::RunFixed("log/short line, async", 1, burst, [&]()
+	{
+		LOG_INFO("Loading scene");
+	}, Log::Flush);
+	Harness::RunFixed("log/formatted line, async", 1, burst, [&]()
+	{
+		LOG_INFO("Frame " << frame++ << " took " << ms << "ms");
+	}, Log::Flush);
+	// A shader info log sized line, spread over five slots
+	std::string longText(1000, 'x');
+	Harness::RunFixed("log/1000 char line, async", 1, burst / 5, [&]()
+	{
+		LOG_INFO("Error Compiling Fragment Shader:\n" << longText);
+	}, Log::Flush);
+	uint64_t dropped = Log::Dropped();
+
+	// Lines dropped on a full ring still pay for formatting, but not for the copy
+	Harness::Run("log/formatted line, ring full", 1, [&]()
+	{
+		LOG_INFO("Frame " << frame++ << " took " << ms << "ms");
+	});
+	Log::Shutdown();
+
+	std::ofstream stream(streamFile);
+	Harness::Run("log/formatted line, ofstream endl", 1, [&]()
+	{
+		stream << "Frame " << frame++ << " took " << ms << "ms" << std::endl;
+	});
+	stream.close();
+
+	std::cout << "async: " << dropped << " lines dropped outside the ring full case" << std::endl;
+	std::remove(logFile);
+	std::remove(streamFile);
+}
@@ -0,0 +1,96 @@
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Benchmarks.h"
+#include "Harness.h"
+#include "JobSystem.h"
+#include "Model.h"
+#include "OcclusionCulling.h"
+
+// Closed box as an occluder, 12 triangles
+static void AddBoxOccluder(OcclusionCuller& culler, const glm::vec3& min, const glm::vec3& max)
+{
+	std::vector<glm::vec3> positions(8);
+	for (uint32_t corner = 0; corner < 8; corner++)
+		positions[corner] = glm::vec3((corner & 1) ? max.x : min.x, (corner & 2) ? max.y : min.y, (corner & 4) ? max.z : min.z);
+
+	static const std::vector<uint32_t> indices =
+	{
+		0, 2, 1, 1, 2, 3,	4, 5, 6, 5, 7, 6,
+		0, 1, 4, 1, 5, 4,	2, 6, 3, 3, 6, 7,
+		0, 4, 2, 2, 4, 6,	1, 3, 5, 3, 7, 5,
+	};
+	culler.AddOccluder(positions, indices);
+}
+
+// City block street view: rows of buildings as occluders hiding a field of small boxes
+void OcclusionBenchmark()
+{
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.0f, 2.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+	glm::mat4 viewProjection = projection * view;
+
+	std::mt19937 rng(36);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	Harness::PrintHeader();
+	for (uint32_t buildings : { 64u, 256u, 1024u })
+	{
+		OcclusionCuller culler;
+		for (uint32_t i = 0; i < buildings; i++)
+		{
+			glm::vec3 base(unit(rng) * 300.0f - 150.0f, 0.0f, -10.0f - unit(rng) * 300.0f);
+			glm::vec3 size(4.0f + unit(rng) * 16.0f, 5.0f + unit(rng) * 30.0f, 4.0f + unit(rng) * 16.0f);
+			AddBoxOccluder(culler, base, base + size);
+		}
+
+		// Items are occluder triangles
+		for (uint32_t threads : { 1u, JobSystem::DefaultWorkerCount() + 1 })
+		{
+			JobSystem jobs;
+			jobs.Init(threads - 1);
+
+			std::string name = "occlusion/raster " + std::to_string(culler.OccluderTriangles()) + " tris " + std::to_string(threads) + "t";
+			Harness::Run(name.c_str(), culler.OccluderTriangles(), [&]()
+			{
+				culler.Rasterize(viewProjection, 0.1f, jobs);
+			});
+
+			if (threads == 1 && JobSystem::DefaultWorkerCount() == 0)
+				break;
+		}
+
+		// Boxes against the last buffer
+		Model model;
+		for (uint32_t i = 0; i < 100000; i++)
+		{
+			MeshInstance instance = { 0, glm::mat4(1.0f) };
+			instance.boundsMin = glm::vec3(unit(rng) * 300.0f - 150.0f, unit(rng) * 10.0f, -5.0f - unit(rng) * 300.0f);
+			instance.boundsMax = instance.boundsMin + glm::vec3(0.5f + unit(rng) * 2.0f);
+			model.instances.push_back(instance);
+		}
+
+		JobSystem jobs;
+		jobs.Init(0);
+		// Culling shrinks the list, every sample starts from all of the boxes
+		std::vector<uint32_t> visible;
+		auto refill = [&]()
+		{
+			visible.resize(model.instances.size());
+			for (uint32_t i = 0; i < (uint32_t)visible.size(); i++)
+				visible[i] = i;
+		};
+		refill();
+		std::string name = "occlusion/test 100k vs " + std::to_string(culler.OccluderTriangles()) + " tris";
+		Harness::RunFixed(name.c_str(), model.instances.size(), 1, [&]()
+		{
+			culler.CullInstances(model, jobs, visible);
+		}, refill);
+		std::cout << "  " << culler.Stats().culled << " of " << model.instances.size() << " boxes culled" << std::endl;
+	}
+}
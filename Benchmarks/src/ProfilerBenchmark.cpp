@@ -0,0 +1,41 @@
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+
+#include "Benchmarks.h"
+#include "Harness.h"
+#include "Profiler.h"
+
+static volatile uint32_t s_sink = 0;
+
+static void Work(uint32_t i)
+{
+	s_sink = s_sink + i;
+}
+
+// Cost of one PROFILE_ZONE on top of an empty loop body; the target is under 50 ns
+void ProfilerBenchmark()
+{
+	Profiler::SetThreadName("Benchmark");
+
+	uint32_t i = 0;
+	Harness::PrintHeader();
+	double empty = Harness::Run("profiler/loop body", 1, [&]()
+	{
+		Work(i++);
+	}).medianNs;
+	double zone = Harness::Run("profiler/loop body + zone", 1, [&]()
+	{
+		PROFILE_ZONE("Zone");
+		Work(i++);
+	}).medianNs;
+	// A zone reads the clock twice, which is most of its cost
+	Harness::Run("profiler/clock read", 1, [&]()
+	{
+		DoNotOptimize(Profiler::Ticks());
+	});
+
+	double perZone = zone - empty;
+	std::cout << "  " << std::fixed << std::setprecision(1) << perZone << " ns per zone" << std::defaultfloat << std::setprecision(6) << std::endl;
+	Harness::Check(perZone < 50.0, "a profiler zone costs under 50 ns");
+}
@@ -0,0 +1,101 @@
+#include <cstdint>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Benchmarks.h"
+#include "BakedScene.h"
+#include "FrustumCulling.h"
+#include "Harness.h"
+#include "JobSystem.h"
+#include "Model.h"
+#include "SceneGenerator.h"
+
+// Grows one generator setting at a time from a mid sized scene and times generating,
+// baking, loading the baked file, building the model and culling it; items are instances.
+// Frame times with GL come from running the game with --generate and --bench-scene over
+// the same steps.
+void SceneGeneratorBenchmark()
+{
+	struct Sweep
+	{
+		const char* name;
+		uint32_t SceneGeneratorSettings::*setting;
+		uint32_t values[4];
+	};
+	const Sweep sweeps[] =
+	{
+		{ "instances", &SceneGeneratorSettings::instances, { 1000, 4000, 16000, 64000 } },
+		{ "meshes", &SceneGeneratorSettings::meshes, { 8, 32, 128, 512 } },
+		{ "textures", &SceneGeneratorSettings::textures, { 2, 8, 32, 128 } },
+		{ "lights", &SceneGeneratorSettings::lights, { 64, 256, 1024, 4096 } },
+		{ "depth", &SceneGeneratorSettings::depth, { 0, 2, 4, 8 } },
+		{ "detail", &SceneGeneratorSettings::detail, { 8, 16, 32, 64 } },
+	};
+	const char* file = "scenegen_benchmark.scene";
+
+	JobSystem jobs;
+	jobs.Init(JobSystem::DefaultWorkerCount());
+
+	Harness::PrintHeader();
+	for (const Sweep& sweep : sweeps)
+	{
+		for (uint32_t value : sweep.values)
+		{
+			SceneGeneratorSettings settings;
+			settings.meshes = 16;
+			settings.instances = 4000;
+			settings.textures = 4;
+			settings.textureSize = 128;
+			settings.*sweep.setting = value;
+
+			std::string prefix = "scenegen/" + std::string(sweep.name) + "=" + std::to_string(value) + " ";
+			BakedScene generated;
+			Harness::RunSlow((prefix + "generate").c_str(), settings.instances, [&]()
+			{
+				GenerateScene(settings, generated);
+			});
+			Harness::RunSlow((prefix + "write").c_str(), settings.instances, [&]()
+			{
+				generated.Write(file);
+			});
+
+			BakedScene loaded;
+			Harness::RunSlow((prefix + "read").c_str(), settings.instances, [&]()
+			{
+				loaded.Read(file);
+			});
+
+			Model model;
+			Harness::RunSlow((prefix + "build").c_str(), settings.instances, [&]()
+			{
+				model = Model();
+			}, [&]()
+			{
+				model.Build(loaded, ".", false);
+			});
+
+			// From above one corner of the grid, looking across it
+			glm::vec3 extent = model.boundsMax - model.boundsMin;
+			glm::mat4 view = glm::lookAt(model.boundsMin + glm::vec3(0.0f, glm::max(extent.x, extent.z) * 0.2f, 0.0f),
+				(model.boundsMin + model.boundsMax) * 0.5f, glm::vec3(0.0f, 1.0f, 0.0f));
+			FrustumCuller culler;
+			culler.SetFrustum(glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 10000.0f) * view);
+			std::vector<uint32_t> visible;
+			Harness::Run((prefix + "cull").c_str(), settings.instances, [&]()
+			{
+				culler.Cull(model.instanceBounds, jobs, visible);
+				DoNotOptimize(visible.data());
+			});
+
+			std::cout << "  " << loaded.TriangleCount() << " triangles, " << std::fixed << std::setprecision(1)
+				<< loaded.Bytes() / (1024.0 * 1024.0) << " MB" << std::defaultfloat << std::setprecision(6) << std::endl;
+		}
+	}
+
+	std::remove(file);
+}
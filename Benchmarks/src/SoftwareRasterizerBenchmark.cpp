@@ -0,0 +1,127 @@
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Benchmarks.h"
+#include "Harness.h"
+#include "JobSystem.h"
+#include "Model.h"
+#include "RenderSnapshot.h"
+#include "SoftwareRasterizer.h"
+
+// UV sphere of about 2 * segments * rings triangles, counter clockwise from outside
+static Mesh BuildSphere(uint32_t segments, uint32_t rings)
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	for (uint32_t ring = 0; ring <= rings; ring++)
+	{
+		float theta = 3.14159265f * ring / rings;
+		for (uint32_t segment = 0; segment <= segments; segment++)
+		{
+			float phi = 6.2831853f * segment / segments;
+			Vertex vertex;
+			vertex.Normal = glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), -std::sin(theta) * std::sin(phi));
+			vertex.Position = vertex.Normal;
+			vertex.TexCoords = glm::vec3((float)segment / segments * 4.0f, (float)ring / rings * 2.0f, 0.0f);
+			vertices.push_back(vertex);
+		}
+	}
+	for (uint32_t ring = 0; ring < rings; ring++)
+	{
+		for (uint32_t segment = 0; segment < segments; segment++)
+		{
+			uint32_t i = ring * (segments + 1) + segment;
+			indices.insert(indices.end(), { i, i + segments + 1, i + 1, i + 1, i + segments + 1, i + segments + 2 });
+		}
+	}
+	return Mesh(vertices, indices, {}, false);
+}
+
+// Grid of spheres over a ground quad, seen from above and in front
+void SoftwareRasterizerBenchmark()
+{
+	const int32_t width = 1280;
+	const int32_t height = 720;
+
+	std::vector<uint32_t> checker(256 * 256);
+	for (uint32_t y = 0; y < 256; y++)
+	{
+		for (uint32_t x = 0; x < 256; x++)
+			checker[y * 256 + x] = ((x / 32 + y / 32) & 1) ? 0xFFE0E0E0u : 0xFF3050A0u;
+	}
+
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 30.0f, 60.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), (float)width / height, 0.5f, 500.0f);
+	glm::mat4 viewProjection = projection * view;
+	glm::vec3 sun = glm::normalize(glm::vec3(-0.4f, -1.0f, -0.3f));
+	glm::vec4 clear(0.39f, 0.58f, 0.93f, 1.0f);
+
+	Harness::PrintHeader();
+	for (uint32_t side : { 10u, 32u })
+	{
+		Model model;
+		model.meshes.push_back(BuildSphere(48, 24));
+		std::vector<Vertex> ground =
+		{
+			{ glm::vec3(-60.0f, -1.0f, 60.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.0f) },
+			{ glm::vec3(60.0f, -1.0f, 60.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(16.0f, 0.0f, 0.0f) },
+			{ glm::vec3(60.0f, -1.0f, -60.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(16.0f, 16.0f, 0.0f) },
+			{ glm::vec3(-60.0f, -1.0f, -60.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 16.0f, 0.0f) },
+		};
+		model.meshes.push_back(Mesh(ground, { 0, 1, 2, 0, 2, 3 }, {}, false));
+
+		std::vector<RenderItem> items;
+		items.push_back({ 1, glm::mat4(1.0f) });
+		float spacing = 100.0f / side;
+		for (uint32_t z = 0; z < side; z++)
+		{
+			for (uint32_t x = 0; x < side; x++)
+			{
+				glm::vec3 position(x * spacing - 50.0f, 0.0f, z * spacing - 50.0f);
+				items.push_back({ 0, glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(spacing * 0.4f)) });
+			}
+		}
+
+		// Items are submitted triangles
+		uint32_t triangles = 0;
+		std::vector<uint32_t> visible(items.size());
+		for (uint32_t i = 0; i < (uint32_t)visible.size(); i++)
+		{
+			visible[i] = i;
+			triangles += model.meshes[items[i].mesh].IndexCount() / 3;
+		}
+
+		for (uint32_t threads : { 1u, JobSystem::DefaultWorkerCount() + 1 })
+		{
+			JobSystem jobs;
+			jobs.Init(threads - 1);
+
+			SoftwareRasterizer rasterizer;
+			rasterizer.Resize(width, height);
+			uint32_t texture = rasterizer.AddTexture(256, 256, checker.data());
+			rasterizer.SetMeshTexture(0, texture);
+			rasterizer.SetMeshTexture(1, texture);
+
+			std::string name = "raster/" + std::to_string(side * side) + " spheres " + std::to_string(threads) + "t";
+			Harness::RunSlow(name.c_str(), triangles, [&]()
+			{
+				rasterizer.Render(model, items.data(), visible, viewProjection, sun, clear, jobs);
+			});
+
+			// Stage times of the last frame
+			const SoftwareRasterStats& stats = rasterizer.Stats();
+			std::cout << "  vertex " << std::fixed << std::setprecision(2) << stats.vertexMs << " ms, bin " << stats.binMs
+				<< " ms, raster " << stats.rasterMs << " ms, " << std::setprecision(1) << stats.pixels / (stats.rasterMs * 1e3) << " Mpix/s"
+				<< std::defaultfloat << std::setprecision(6) << std::endl;
+
+			if (threads == 1 && JobSystem::DefaultWorkerCount() == 0)
+				break;
+		}
+	}
+}
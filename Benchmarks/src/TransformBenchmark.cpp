@@ -0,0 +1,81 @@
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Benchmarks.h"
+#include "Harness.h"
+#include "JobSystem.h"
+#include "TransformHierarchy.h"
+
+// Depth first tree of fanout 10 and depth 6, 1,111,111 nodes
+static void AddSubtree(TransformHierarchy& hierarchy, uint32_t parent, uint32_t depth, std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	glm::mat4 local = glm::translate(glm::mat4(1.0f), glm::vec3(unit(rng), unit(rng), unit(rng)));
+	local = glm::rotate(local, unit(rng), glm::vec3(0.0f, 1.0f, 0.0f));
+	uint32_t node = hierarchy.AddNode(parent, local);
+	if (depth == 0)
+		return;
+
+	for (uint32_t i = 0; i < 10; i++)
+		AddSubtree(hierarchy, node, depth - 1, rng);
+}
+
+// Moves 1% of the nodes at random, then every node through the root
+void TransformBenchmark()
+{
+	std::mt19937 rng(39);
+	TransformHierarchy hierarchy;
+	hierarchy.Reserve(1111111);
+	AddSubtree(hierarchy, TransformHierarchy::NoParent, 6, rng);
+	hierarchy.Update();
+	uint32_t count = hierarchy.Count();
+
+	std::uniform_int_distribution<uint32_t> pick(0, count - 1);
+	std::vector<uint32_t> moved(count / 100);
+	for (uint32_t& node : moved)
+		node = pick(rng);
+
+	std::cout << "  " << count << " nodes" << std::endl;
+	Harness::PrintHeader();
+	for (uint32_t percent : { 1u, 100u })
+	{
+		auto markDirty = [&]()
+		{
+			if (percent == 100)
+				hierarchy.MarkDirty(0);
+			else
+			{
+				for (uint32_t node : moved)
+					hierarchy.SetLocal(node, hierarchy.Local(node));
+			}
+		};
+
+		// Items are the nodes one update recomputes, moved nodes and their subtrees
+		markDirty();
+		hierarchy.Update();
+		uint32_t updated = hierarchy.Stats().updated;
+
+		for (uint32_t threads : { 1u, JobSystem::DefaultWorkerCount() + 1 })
+		{
+			JobSystem jobs;
+			jobs.Init(threads - 1);
+
+			std::string name = "transforms/" + std::to_string(percent) + "% dirty " + std::to_string(threads) + "t";
+			Harness::RunSlow(name.c_str(), updated, markDirty, [&]()
+			{
+				hierarchy.Update(jobs);
+			});
+
+			const TransformStats& stats = hierarchy.Stats();
+			std::cout << "  " << stats.updated << " updated, " << stats.subtrees << " subtrees, " << stats.jobs << " jobs" << std::endl;
+
+			if (threads == 1 && JobSystem::DefaultWorkerCount() == 0)
+				break;
+		}
+	}
+}
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "Harness.h"
+
+struct BenchmarkEntry
+{
+	const char* name;
+	void (*run)();
+};
+
+static const BenchmarkEntry s_benchmarks[] =
+{
+	{ "commands", CommandListBenchmark },
+	{ "profiler", ProfilerBenchmark },
+	{ "lights", LightCullingBenchmark },
+	{ "occlusion", OcclusionBenchmark },
+	{ "frustum", FrustumBenchmark },
+	{ "bvh", BvhBenchmark },
+	{ "transforms", TransformBenchmark },
+	{ "entities", EntityBenchmark },
+	{ "raster", SoftwareRasterizerBenchmark },
+	{ "scenegen", SceneGeneratorBenchmark },
+	{ "vertex", VertexBenchmark },
+	{ "cull", CullBenchmark },
+	{ "sort", SortBenchmark },
+	{ "uniforms", UniformBenchmark },
+	{ "decode", TextureDecodeBenchmark },
+	{ "json", JsonBenchmark },
+	{ "alloc", AllocationBenchmark },
+	{ "log", LogBenchmark },
+};
+
+// Benchmarks [--json file] [--warmup n] [--reps n] [--slow-reps n] [--min-ms ms] [name...]
+// Runs everything when no names are given. --json writes the harness results. Fails when
+// a benchmark's correctness check did.
+int main(int argc, char* argv[])
+{
+	HarnessOptions options;
+	std::string jsonFile;
+	std::vector<const char*> names;
+	for (int32_t i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--json" && hasValue)
+			jsonFile = argv[++i];
+		else if (arg == "--warmup" && hasValue)
+			options.warmup = (uint32_t)std::atoi(argv[++i]);
+		else if (arg == "--reps" && hasValue)
+			options.repetitions = (uint32_t)std::max(std::atoi(argv[++i]), 1);
+		else if (arg == "--slow-reps" && hasValue)
+			options.slowRepetitions = (uint32_t)std::max(std::atoi(argv[++i]), 1);
+		else if (arg == "--min-ms" && hasValue)
+			options.minSampleMs = std::atof(argv[++i]);
+		else
+			names.push_back(argv[i]);
+	}
+	Harness::SetOptions(options);
+
+	for (const BenchmarkEntry& entry : s_benchmarks)
+	{
+		bool selected = names.empty();
+		for (const char* name : names)
+			selected |= std::strcmp(name, entry.name) == 0;
+
+		if (!selected)
+			continue;
+
+		std::cout << "== " << entry.name << " ==" << std::endl;
+		entry.run();
+	}
+
+	if (!jsonFile.empty() && !Harness::WriteJson(jsonFile))
+		return 1;
+
+	if (Harness::Failures() > 0)
+	{
+		std::cout << Harness::Failures() << " checks failed" << std::endl;
+		return 1;
+	}
+	return 0;
+}
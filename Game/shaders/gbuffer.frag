@@ -0,0 +1,40 @@
+#version 450 core
+layout (location = 0) out vec4 gAlbedo;
+layout (location = 1) out vec4 gNormal;		// RGB10_A2
+
+in VS_OUT
+{
+	vec3 worldPos;
+	vec3 normal;
+	vec2 texCoords;
+} fs_in;
+
+struct Material
+{
+	sampler2D texture_diffuse1;
+};
+
+uniform Material material;
+
+// Imported materials carry no PBR parameters yet
+const float roughness = 0.6;
+const float metalness = 0.0;
+
+vec2 SignNotZero(vec2 v)
+{
+	return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Unit vector to [0, 1]^2 via the octahedron mapping
+vec2 OctEncode(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * SignNotZero(n.xy);
+	return e * 0.5 + 0.5;
+}
+
+void main()
+{
+	gAlbedo = vec4(texture(material.texture_diffuse1, fs_in.texCoords).rgb, 1.0);
+	gNormal = vec4(OctEncode(normalize(fs_in.normal)), roughness, metalness);
+}
@@ -0,0 +1,117 @@
+#version 450 core
+out vec4 FragColor;
+
+in VS_OUT
+{
+	vec3 worldPos;
+	vec3 normal;
+	vec2 texCoords;
+} fs_in;
+
+layout (std140, binding = 0) uniform Frame
+{
+	mat4 view;
+	mat4 projection;
+	vec4 viewPos;
+	uvec4 clusterDims;		// x, y, z, light count
+	vec4 clusterParams;		// slice scale, slice bias, tile width, tile height
+} frame;
+
+struct Light
+{
+	vec4 positionRange;
+	vec4 colorType;			// w: 0 point, 1 spot
+	vec4 directionOuterCos;
+	vec4 innerCos;
+};
+
+layout (std430, binding = 1) readonly buffer Lights
+{
+	Light lights[];
+};
+
+// offset, count per cluster
+layout (std430, binding = 2) readonly buffer Clusters
+{
+	uvec2 clusters[];
+};
+
+layout (std430, binding = 3) readonly buffer LightIndices
+{
+	uint lightIndices[];
+};
+
+// Cascaded shadow maps of the sun
+layout (std140, binding = 1) uniform Shadows
+{
+	mat4 cascades[4];
+	vec4 texelSizes;		// world size of a shadow texel per cascade
+	vec4 lightDirection;	// w: cascade count, 0 when shadows are off
+} shadows;
+
+layout (binding = 8) uniform sampler2DArrayShadow shadowMap;
+
+struct Material
+{
+	sampler2D texture_diffuse1;
+};
+
+uniform Material material;
+
+
+uint ClusterIndex()
+{
+	float viewDepth = -(frame.view * vec4(fs_in.worldPos, 1.0)).z;
+	uint z = uint(clamp(log(viewDepth) * frame.clusterParams.x + frame.clusterParams.y, 0.0, float(frame.clusterDims.z - 1)));
+	uint x = min(uint(gl_FragCoord.x / frame.clusterParams.z), frame.clusterDims.x - 1);
+	uint y = min(uint(gl_FragCoord.y / frame.clusterParams.w), frame.clusterDims.y - 1);
+	return (z * frame.clusterDims.y + y) * frame.clusterDims.x + x;
+}
+
+// First cascade that contains the point; offset along the normal by a texel against acne
+float Shadow(vec3 worldPos, vec3 n)
+{
+	uint count = uint(shadows.lightDirection.w);
+	for (uint i = 0u; i < count; i++)
+	{
+		vec4 p = shadows.cascades[i] * vec4(worldPos + n * shadows.texelSizes[i] * 1.5, 1.0);
+		vec3 uvw = p.xyz * 0.5 + 0.5;
+		if (all(greaterThan(uvw.xy, vec2(0.001))) && all(lessThan(uvw.xy, vec2(0.999))) && uvw.z < 1.0)
+			return texture(shadowMap, vec4(uvw.xy, float(i), uvw.z));
+	}
+	return 1.0;
+}
+
+vec3 PunctualLight(Light light, vec3 n)
+{
+	vec3 toLight = light.positionRange.xyz - fs_in.worldPos;
+	float distance = length(toLight);
+	vec3 l = toLight / max(distance, 1e-4);
+
+	// Smooth window so the light reaches exactly zero at its range
+	float ratio = distance / light.positionRange.w;
+	float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+	float attenuation = window * window / (distance * distance + 1.0);
+
+	if (light.colorType.w > 0.5)
+		attenuation *= smoothstep(light.directionOuterCos.w, light.innerCos.x, dot(-l, light.directionOuterCos.xyz));
+
+	return light.colorType.rgb * attenuation * max(dot(n, l), 0.0);
+}
+
+void main()
+{
+	vec3 albedo = texture(material.texture_diffuse1, fs_in.texCoords).rgb;
+	vec3 n = normalize(fs_in.normal);
+	float diffuse = max(dot(n, -shadows.lightDirection.xyz), 0.0) * Shadow(fs_in.worldPos, n);
+	vec3 lighting = vec3(0.25 + 0.75 * diffuse);
+
+	if (frame.clusterDims.w > 0)
+	{
+		uvec2 cluster = clusters[ClusterIndex()];
+		for (uint i = 0; i < cluster.y; i++)
+			lighting += PunctualLight(lights[lightIndices[cluster.x + i]], n);
+	}
+
+	FragColor = vec4(albedo * lighting, 1.0);
+}
@@ -0,0 +1,37 @@
+#version 450 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+
+layout (std140, binding = 0) uniform Frame
+{
+	mat4 view;
+	mat4 projection;
+	vec4 viewPos;
+	uvec4 clusterDims;
+	vec4 clusterParams;
+} frame;
+
+layout (std430, binding = 0) readonly buffer Transforms
+{
+	mat4 transforms[];
+};
+
+uniform uint drawIndex;
+
+out VS_OUT
+{
+	vec3 worldPos;
+	vec3 normal;
+	vec2 texCoords;
+} vs_out;
+
+void main()
+{
+	mat4 model = transforms[drawIndex];
+	vec4 worldPos = model * vec4(aPos, 1.0);
+	vs_out.worldPos = worldPos.xyz;
+	vs_out.normal = mat3(transpose(inverse(model))) * aNormal;
+	vs_out.texCoords = aTexCoords;
+	gl_Position = frame.projection * frame.view * worldPos;
+}
@@ -0,0 +1,6 @@
+#version 450 core
+
+// Depth only
+void main()
+{
+}
@@ -0,0 +1,15 @@
+#version 450 core
+layout (location = 0) in vec3 aPos;
+
+layout (std430, binding = 0) readonly buffer Transforms
+{
+	mat4 transforms[];
+};
+
+uniform uint drawIndex;
+uniform mat4 lightViewProjection;
+
+void main()
+{
+	gl_Position = lightViewProjection * transforms[drawIndex] * vec4(aPos, 1.0);
+}
@@ -0,0 +1,287 @@
+#include "BakedScene.h"
+
+#include <fstream>
+
+#include "Log.h"
+#include "Profiler.h"
+
+namespace
+{
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t textures;
+		uint32_t materials;
+		uint32_t meshes;
+		uint32_t nodes;
+		uint32_t instances;
+		uint32_t lights;
+		uint32_t lightmaps;
+	};
+
+	template <typename T>
+	void WritePod(std::ofstream& stream, const T& value)
+	{
+		stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template <typename T>
+	void WriteArray(std::ofstream& stream, const std::vector<T>& values)
+	{
+		WritePod(stream, (uint32_t)values.size());
+		if (!values.empty())
+			stream.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+	}
+
+	void WriteString(std::ofstream& stream, const std::string& value)
+	{
+		WritePod(stream, (uint32_t)value.size());
+		stream.write(value.data(), value.size());
+	}
+
+	// Tracks what is left of the file, so a bad count can't make a huge allocation
+	class Reader
+	{
+	public:
+		Reader(std::ifstream& stream, uint64_t size) : m_stream(stream), m_remaining(size) {}
+
+		bool Bytes(void* out, uint64_t size)
+		{
+			if (size > m_remaining)
+				return false;
+			m_remaining -= size;
+			return size == 0 || (bool)m_stream.read(reinterpret_cast<char*>(out), size);
+		}
+
+		template <typename T>
+		bool Pod(T& value)
+		{
+			return Bytes(&value, sizeof(T));
+		}
+
+		template <typename T>
+		bool Array(std::vector<T>& values)
+		{
+			uint32_t count = 0;
+			if (!Pod(count) || (uint64_t)count * sizeof(T) > m_remaining)
+				return false;
+			values.resize(count);
+			return Bytes(values.data(), (uint64_t)count * sizeof(T));
+		}
+
+		bool String(std::string& value)
+		{
+			uint32_t length = 0;
+			if (!Pod(length) || length > m_remaining)
+				return false;
+			value.resize(length);
+			return Bytes(&value[0], length);
+		}
+
+	private:
+		std::ifstream& m_stream;
+		uint64_t m_remaining;
+	};
+}
+
+void BakedScene::Clear()
+{
+	textures.clear();
+	materials.clear();
+	meshes.clear();
+	nodes.clear();
+	instances.clear();
+	lights.clear();
+	lightmaps.clear();
+}
+
+bool BakedScene::Write(const std::string& file) const
+{
+	PROFILE_ZONE("Write baked scene");
+	std::ofstream stream(file, std::ios::binary);
+	if (!stream)
+	{
+		LOG_ERROR("Failed to write baked scene: " << file);
+		return false;
+	}
+
+	Header header = { Magic, Version, (uint32_t)textures.size(), (uint32_t)materials.size(), (uint32_t)meshes.size(),
+		(uint32_t)nodes.size(), (uint32_t)instances.size(), (uint32_t)lights.size(), (uint32_t)lightmaps.size() };
+	WritePod(stream, header);
+
+	for (const BakedTexture& texture : textures)
+	{
+		WriteString(stream, texture.name);
+		WritePod(stream, texture.width);
+		WritePod(stream, texture.height);
+		WriteArray(stream, texture.texels);
+	}
+
+	for (const BakedMaterial& material : materials)
+	{
+		WriteString(stream, material.name);
+		WritePod(stream, material.diffuse);
+		WritePod(stream, material.specular);
+		WritePod(stream, material.normal);
+	}
+
+	for (const BakedMesh& mesh : meshes)
+	{
+		WritePod(stream, mesh.material);
+		WriteArray(stream, mesh.vertices);
+		WriteArray(stream, mesh.indices);
+		WriteArray(stream, mesh.lightmapUvs);
+	}
+
+	for (const BakedNode& node : nodes)
+	{
+		WritePod(stream, node.parent);
+		WritePod(stream, node.local);
+		WriteString(stream, node.name);
+	}
+
+	WriteArray(stream, instances);
+	WriteArray(stream, lights);
+
+	for (const BakedLightmap& lightmap : lightmaps)
+	{
+		WritePod(stream, lightmap.width);
+		WritePod(stream, lightmap.height);
+		WriteArray(stream, lightmap.texels);
+	}
+
+	if (!stream)
+	{
+		LOG_ERROR("Failed to write baked scene: " << file);
+		return false;
+	}
+	return true;
+}
+
+bool BakedScene::Read(const std::string& file)
+{
+	PROFILE_ZONE("Read baked scene");
+	Clear();
+
+	std::ifstream stream(file, std::ios::binary | std::ios::ate);
+	if (!stream)
+	{
+		LOG_ERROR("Failed to open baked scene: " << file);
+		return false;
+	}
+	uint64_t size = (uint64_t)stream.tellg();
+	stream.seekg(0);
+	Reader reader(stream, size);
+
+	Header header = {};
+	if (!reader.Pod(header) || header.magic != Magic)
+	{
+		LOG_ERROR("Not a baked scene: " << file);
+		return false;
+	}
+	if (header.version != Version)
+	{
+		LOG_ERROR("Baked scene " << file << " is version " << header.version << ", expected " << Version << "; bake it again");
+		return false;
+	}
+
+	bool ok = true;
+	// Every entry takes at least four bytes, which bounds the counts by the file size
+	uint64_t entries = (uint64_t)header.textures + header.materials + header.meshes + header.nodes + header.lightmaps;
+	ok = entries * 4 <= size;
+
+	if (ok)
+		textures.resize(header.textures);
+	for (uint32_t i = 0; ok && i < header.textures; i++)
+	{
+		BakedTexture& texture = textures[i];
+		ok = reader.String(texture.name) && reader.Pod(texture.width) && reader.Pod(texture.height) && reader.Array(texture.texels)
+			&& texture.width > 0 && texture.height > 0 && texture.texels.size() == (size_t)texture.width * texture.height;
+	}
+
+	if (ok)
+		materials.resize(header.materials);
+	for (uint32_t i = 0; ok && i < header.materials; i++)
+	{
+		BakedMaterial& material = materials[i];
+		ok = reader.String(material.name) && reader.Pod(material.diffuse) && reader.Pod(material.specular) && reader.Pod(material.normal);
+		for (int32_t texture : { material.diffuse, material.specular, material.normal })
+			ok = ok && texture >= -1 && texture < (int32_t)header.textures;
+	}
+
+	if (ok)
+		meshes.resize(header.meshes);
+	for (uint32_t i = 0; ok && i < header.meshes; i++)
+	{
+		BakedMesh& mesh = meshes[i];
+		ok = reader.Pod(mesh.material) && reader.Array(mesh.vertices) && reader.Array(mesh.indices) && reader.Array(mesh.lightmapUvs)
+			&& (mesh.material < header.materials || header.materials == 0) && mesh.indices.size() % 3 == 0
+			&& (mesh.lightmapUvs.empty() || mesh.lightmapUvs.size() == mesh.vertices.size());
+		for (size_t j = 0; ok && j < mesh.indices.size(); j++)
+			ok = mesh.indices[j] < mesh.vertices.size();
+	}
+
+	if (ok)
+		nodes.resize(header.nodes);
+	for (uint32_t i = 0; ok && i < header.nodes; i++)
+	{
+		BakedNode& node = nodes[i];
+		ok = reader.Pod(node.parent) && reader.Pod(node.local) && reader.String(node.name)
+			&& (node.parent < i || node.parent == UINT32_MAX);
+	}
+
+	ok = ok && reader.Array(instances) && instances.size() == header.instances;
+	for (size_t i = 0; ok && i < instances.size(); i++)
+		ok = instances[i].mesh < header.meshes && instances[i].node < header.nodes
+			&& instances[i].lightmap >= -1 && instances[i].lightmap < (int32_t)header.lightmaps
+			&& (instances[i].lightmap < 0 || !meshes[instances[i].mesh].lightmapUvs.empty());
+
+	ok = ok && reader.Array(lights) && lights.size() == header.lights;
+
+	if (ok)
+		lightmaps.resize(header.lightmaps);
+	for (uint32_t i = 0; ok && i < header.lightmaps; i++)
+	{
+		BakedLightmap& lightmap = lightmaps[i];
+		ok = reader.Pod(lightmap.width) && reader.Pod(lightmap.height) && reader.Array(lightmap.texels)
+			&& lightmap.width > 0 && lightmap.height > 0 && lightmap.texels.size() == (size_t)lightmap.width * lightmap.height;
+	}
+
+	if (!ok)
+	{
+		LOG_ERROR("Baked scene is damaged: " << file);
+		Clear();
+	}
+	return ok;
+}
+
+size_t BakedScene::Bytes() const
+{
+	size_t bytes = sizeof(Header) + instances.size() * sizeof(BakedInstance) + lights.size() * sizeof(Light);
+	for (const BakedTexture& texture : textures)
+		bytes += texture.texels.size() * sizeof(uint32_t) + texture.name.size() + 16;
+	for (const BakedMaterial& material : materials)
+		bytes += material.name.size() + 16;
+	for (const BakedMesh& mesh : meshes)
+		bytes += mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(uint32_t) + mesh.lightmapUvs.size() * sizeof(glm::vec2) + 16;
+	for (const BakedNode& node : nodes)
+		bytes += sizeof(glm::mat4) + node.name.size() + 8;
+	for (const BakedLightmap& lightmap : lightmaps)
+		bytes += lightmap.texels.size() * sizeof(uint32_t) + 12;
+	return bytes;
+}
+
+uint64_t BakedScene::TriangleCount() const
+{
+	uint64_t triangles = 0;
+	for (const BakedInstance& instance : instances)
+		triangles += meshes[instance.mesh].indices.size() / 3;
+	return triangles;
+}
+
+bool BakedScene::IsBakedFile(const std::string& file)
+{
+	size_t length = std::char_traits<char>::length(Extension);
+	return file.size() >= length && file.compare(file.size() - length, length, Extension) == 0;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Light.h"
+#include "Mesh.h"
+
+struct BakedTexture
+{
+	std::string name;
+	int32_t width = 0;
+	int32_t height = 0;
+	std::vector<uint32_t> texels;	// RGBA8, rows top down like stb_image
+};
+
+// Texture indices, -1 for none
+struct BakedMaterial
+{
+	std::string name;
+	int32_t diffuse = -1;
+	int32_t specular = -1;
+	int32_t normal = -1;
+};
+
+struct BakedMesh
+{
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	uint32_t material = 0;
+	std::vector<glm::vec2> lightmapUvs;	// one per vertex in [0, 1], empty until lightmaps are baked
+};
+
+// Nodes are stored depth first, the order TransformHierarchy needs
+struct BakedNode
+{
+	uint32_t parent;
+	glm::mat4 local;
+	std::string name;
+};
+
+// The instance's lightmap texels are its mesh's lightmap UVs times xy of the scale and
+// offset plus zw, in its lightmap page
+struct BakedInstance
+{
+	uint32_t mesh;
+	uint32_t node;
+	int32_t lightmap = -1;	// page, -1 for none
+	glm::vec4 lightmapScaleOffset = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+};
+
+// A page of baked lighting: sun, sky, punctual lights and bounces together, meant to be
+// multiplied with albedo. Stored for offline use; Model and the renderers ignore it.
+struct BakedLightmap
+{
+	int32_t width = 0;
+	int32_t height = 0;
+	std::vector<uint32_t> texels;	// RGB9_E5, row y covers v from y / height
+};
+
+// The scene the way Model uses it, with textures decoded, so loading is a few large
+// reads instead of an import. Written and read as one binary file: a header with the
+// counts, then each section in turn. Vertices and lights are stored as their in memory
+// structs, so files are only portable between builds with the same layout; the version
+// changes whenever that does.
+class BakedScene
+{
+public:
+	static constexpr uint32_t Magic = 0x42435353;	// "SSCB"
+	static constexpr uint32_t Version = 2;
+	static constexpr const char* Extension = ".scene";
+
+	std::vector<BakedTexture> textures;
+	std::vector<BakedMaterial> materials;
+	std::vector<BakedMesh> meshes;
+	std::vector<BakedNode> nodes;
+	std::vector<BakedInstance> instances;
+	std::vector<Light> lights;
+	std::vector<BakedLightmap> lightmaps;
+
+	void Clear();
+	bool Empty() const { return meshes.empty(); }
+
+	bool Write(const std::string& file) const;
+	// Checks every index, a damaged file fails instead of loading garbage
+	bool Read(const std::string& file);
+
+	// Roughly what Write produces
+	size_t Bytes() const;
+	// Over all instances, what a frame draws without culling
+	uint64_t TriangleCount() const;
+
+	static bool IsBakedFile(const std::string& file);
+};
@@ -0,0 +1,711 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#else
+#include <emmintrin.h>
+#endif
+
+#include "FramePacer.h"
+#include "Log.h"
+#include "Model.h"
+#include "Profiler.h"
+
+// Node of the binary tree the wide nodes are collapsed from; leaves have a count
+struct Bvh::BuildNode
+{
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+	uint32_t left = 0;
+	uint32_t right = 0;
+	uint32_t first = 0;
+	uint32_t count = 0;
+};
+
+struct Bvh::TraversalRay
+{
+	uint32_t nearX, nearY, nearZ;	// rows of Node::bounds the ray enters through
+#ifdef __AVX2__
+	__m256 originX, originY, originZ;
+	__m256 inverseX, inverseY, inverseZ;
+#else
+	__m128 originX, originY, originZ;
+	__m128 inverseX, inverseY, inverseZ;
+#endif
+
+	TraversalRay(const Ray& ray)
+	{
+		// Tiny instead of zero components keep 0 * inf out of the slab test
+		glm::vec3 inverse;
+		for (int32_t i = 0; i < 3; i++)
+		{
+			float d = ray.direction[i];
+			inverse[i] = 1.0f / (std::abs(d) > 1e-30f ? d : std::copysign(1e-30f, d));
+		}
+		nearX = ray.direction.x >= 0.0f ? 0 : 1;
+		nearY = ray.direction.y >= 0.0f ? 2 : 3;
+		nearZ = ray.direction.z >= 0.0f ? 4 : 5;
+#ifdef __AVX2__
+		originX = _mm256_set1_ps(ray.origin.x);
+		originY = _mm256_set1_ps(ray.origin.y);
+		originZ = _mm256_set1_ps(ray.origin.z);
+		inverseX = _mm256_set1_ps(inverse.x);
+		inverseY = _mm256_set1_ps(inverse.y);
+		inverseZ = _mm256_set1_ps(inverse.z);
+#else
+		originX = _mm_set1_ps(ray.origin.x);
+		originY = _mm_set1_ps(ray.origin.y);
+		originZ = _mm_set1_ps(ray.origin.z);
+		inverseX = _mm_set1_ps(inverse.x);
+		inverseY = _mm_set1_ps(inverse.y);
+		inverseZ = _mm_set1_ps(inverse.z);
+#endif
+	}
+};
+
+static float HalfArea(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	glm::vec3 d = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+	return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+void Bvh::Clear()
+{
+	m_nodes.clear();
+	m_triangles.clear();
+	m_sources.clear();
+	m_stats = BvhStats();
+}
+
+void Bvh::Build(const Model& model)
+{
+	PROFILE_ZONE("Build BVH");
+	std::vector<glm::vec3> corners;
+	std::vector<Source> sources;
+	for (uint32_t i = 0; i < (uint32_t)model.instances.size(); i++)
+	{
+		const MeshInstance& instance = model.instances[i];
+		const Mesh& mesh = model.meshes[instance.mesh];
+		for (uint32_t t = 0; t + 2 < (uint32_t)mesh.indices.size(); t += 3)
+		{
+			for (uint32_t c = 0; c < 3; c++)
+				corners.push_back(glm::vec3(instance.transform * glm::vec4(mesh.vertices[mesh.indices[t + c]].Position, 1.0f)));
+			sources.push_back({ i, t / 3 });
+		}
+	}
+	BuildTree(corners, sources);
+}
+
+void Bvh::Build(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices)
+{
+	PROFILE_ZONE("Build BVH");
+	std::vector<glm::vec3> corners;
+	std::vector<Source> sources;
+	corners.reserve(indices.size());
+	sources.reserve(indices.size() / 3);
+	for (uint32_t t = 0; t + 2 < (uint32_t)indices.size(); t += 3)
+	{
+		for (uint32_t c = 0; c < 3; c++)
+			corners.push_back(positions[indices[t + c]]);
+		sources.push_back({ 0, t / 3 });
+	}
+	BuildTree(corners, sources);
+}
+
+void Bvh::BuildTree(const std::vector<glm::vec3>& corners, std::vector<Source>& sources)
+{
+	uint64_t start = FramePacer::Now();
+	Clear();
+
+	// Leaf encoding leaves 28 bits for the first triangle
+	uint32_t count = (uint32_t)glm::min(sources.size(), (size_t)(1u << 28) - 1);
+	if (count < sources.size())
+		LOG_INFO("BVH: keeping " << count << " of " << sources.size() << " triangles");
+	if (count == 0)
+		return;
+
+	std::vector<glm::vec3> primMin(count), primMax(count), centroids(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const glm::vec3* v = &corners[i * 3];
+		primMin[i] = glm::min(v[0], glm::min(v[1], v[2]));
+		primMax[i] = glm::max(v[0], glm::max(v[1], v[2]));
+		centroids[i] = (primMin[i] + primMax[i]) * 0.5f;
+	}
+
+	std::vector<uint32_t> order(count);
+	for (uint32_t i = 0; i < count; i++)
+		order[i] = i;
+
+	std::vector<BuildNode> binary;
+	binary.reserve(count / MaxLeafTriangles * 2 + 1);
+	binary.push_back(BuildNode());
+	binary[0].count = count;
+
+	struct Task
+	{
+		uint32_t node;
+		uint32_t depth;
+	};
+	std::vector<Task> tasks = { { 0, 0 } };
+	while (!tasks.empty())
+	{
+		Task task = tasks.back();
+		tasks.pop_back();
+		uint32_t first = binary[task.node].first;
+		uint32_t nodeCount = binary[task.node].count;
+
+		glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+		glm::vec3 centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+		for (uint32_t i = first; i < first + nodeCount; i++)
+		{
+			uint32_t p = order[i];
+			boundsMin = glm::min(boundsMin, primMin[p]);
+			boundsMax = glm::max(boundsMax, primMax[p]);
+			centroidMin = glm::min(centroidMin, centroids[p]);
+			centroidMax = glm::max(centroidMax, centroids[p]);
+		}
+		binary[task.node].boundsMin = boundsMin;
+		binary[task.node].boundsMax = boundsMax;
+		if (nodeCount <= MaxLeafTriangles)
+			continue;
+
+		// Binned SAH: cost of a split is left area * left count + right area * right count
+		int32_t bestAxis = -1;
+		uint32_t bestBin = 0;
+		float bestCost = FLT_MAX;
+		for (int32_t axis = 0; axis < 3 && task.depth < MaxBuildDepth; axis++)
+		{
+			float extent = centroidMax[axis] - centroidMin[axis];
+			if (extent <= 0.0f)
+				continue;
+
+			struct Bin
+			{
+				glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+				glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+				uint32_t count = 0;
+			};
+			Bin bins[SahBins];
+			float scale = (float)SahBins / extent;
+			for (uint32_t i = first; i < first + nodeCount; i++)
+			{
+				uint32_t p = order[i];
+				uint32_t b = glm::min((uint32_t)((centroids[p][axis] - centroidMin[axis]) * scale), SahBins - 1);
+				bins[b].boundsMin = glm::min(bins[b].boundsMin, primMin[p]);
+				bins[b].boundsMax = glm::max(bins[b].boundsMax, primMax[p]);
+				bins[b].count++;
+			}
+
+			float rightArea[SahBins];
+			uint32_t rightCount[SahBins];
+			glm::vec3 sweepMin(FLT_MAX), sweepMax(-FLT_MAX);
+			uint32_t sweepCount = 0;
+			for (uint32_t b = SahBins - 1; b > 0; b--)
+			{
+				sweepMin = glm::min(sweepMin, bins[b].boundsMin);
+				sweepMax = glm::max(sweepMax, bins[b].boundsMax);
+				sweepCount += bins[b].count;
+				rightArea[b] = HalfArea(sweepMin, sweepMax);
+				rightCount[b] = sweepCount;
+			}
+
+			sweepMin = glm::vec3(FLT_MAX);
+			sweepMax = glm::vec3(-FLT_MAX);
+			sweepCount = 0;
+			for (uint32_t b = 0; b + 1 < SahBins; b++)
+			{
+				sweepMin = glm::min(sweepMin, bins[b].boundsMin);
+				sweepMax = glm::max(sweepMax, bins[b].boundsMax);
+				sweepCount += bins[b].count;
+				if (sweepCount == 0 || rightCount[b + 1] == 0)
+					continue;
+
+				float cost = HalfArea(sweepMin, sweepMax) * sweepCount + rightArea[b + 1] * rightCount[b + 1];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = b;
+				}
+			}
+		}
+
+		uint32_t middle;
+		if (bestAxis >= 0)
+		{
+			float scale = (float)SahBins / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+			float offset = centroidMin[bestAxis];
+			uint32_t* split = std::partition(order.data() + first, order.data() + first + nodeCount, [&](uint32_t p)
+			{
+				return glm::min((uint32_t)((centroids[p][bestAxis] - offset) * scale), SahBins - 1) <= bestBin;
+			});
+			middle = (uint32_t)(split - order.data());
+		}
+		else
+		{
+			// Coincident centroids or too deep: halve along the widest axis
+			glm::vec3 extent = centroidMax - centroidMin;
+			int32_t axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+			middle = first + nodeCount / 2;
+			std::nth_element(order.data() + first, order.data() + middle, order.data() + first + nodeCount,
+				[&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+		}
+
+		uint32_t left = (uint32_t)binary.size();
+		binary.push_back(BuildNode());
+		binary.push_back(BuildNode());
+		binary[left].first = first;
+		binary[left].count = middle - first;
+		binary[left + 1].first = middle;
+		binary[left + 1].count = first + nodeCount - middle;
+		binary[task.node].left = left;
+		binary[task.node].right = left + 1;
+		binary[task.node].count = 0;
+		tasks.push_back({ left, task.depth + 1 });
+		tasks.push_back({ left + 1, task.depth + 1 });
+	}
+
+	// Triangles in leaf order, so a leaf is a contiguous range
+	m_triangles.resize(count);
+	m_sources.resize(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const glm::vec3* v = &corners[order[i] * 3];
+		m_triangles[i] = { v[0], v[1] - v[0], v[2] - v[0] };
+		m_sources[i] = sources[order[i]];
+	}
+
+	m_nodes.reserve(binary.size() / 4 + 1);
+	Collapse(binary, 0, 1);
+
+	m_stats.triangles = count;
+	m_stats.nodes = (uint32_t)m_nodes.size();
+	m_stats.bytes = m_nodes.size() * sizeof(Node) + m_triangles.size() * (sizeof(TriangleData) + sizeof(Source));
+	m_stats.buildMs = FramePacer::ToMilliseconds(FramePacer::Now() - start);
+}
+
+uint32_t Bvh::Collapse(const std::vector<BuildNode>& binary, uint32_t index, uint32_t depth)
+{
+	// Open the largest inner child until the node is full
+	uint32_t children[Width];
+	uint32_t childCount = 0;
+	if (binary[index].count > 0)
+		children[childCount++] = index;
+	else
+	{
+		children[childCount++] = binary[index].left;
+		children[childCount++] = binary[index].right;
+	}
+
+	while (childCount < Width)
+	{
+		int32_t open = -1;
+		float openArea = -1.0f;
+		for (uint32_t i = 0; i < childCount; i++)
+		{
+			const BuildNode& child = binary[children[i]];
+			float area = HalfArea(child.boundsMin, child.boundsMax);
+			if (child.count == 0 && area > openArea)
+			{
+				open = (int32_t)i;
+				openArea = area;
+			}
+		}
+		if (open < 0)
+			break;
+
+		uint32_t opened = children[open];
+		children[open] = binary[opened].left;
+		children[childCount++] = binary[opened].right;
+	}
+
+	uint32_t nodeIndex = (uint32_t)m_nodes.size();
+	m_nodes.emplace_back();
+	for (uint32_t i = 0; i < Width; i++)
+	{
+		Node& node = m_nodes[nodeIndex];
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			node.bounds[axis * 2][i] = FLT_MAX;
+			node.bounds[axis * 2 + 1][i] = -FLT_MAX;
+		}
+		node.child[i] = EmptyChild;
+	}
+
+	m_stats.depth = glm::max(m_stats.depth, depth);
+	for (uint32_t i = 0; i < childCount; i++)
+	{
+		const BuildNode& child = binary[children[i]];
+		uint32_t encoded;
+		if (child.count > 0)
+		{
+			encoded = LeafBit | child.first << 3 | (child.count - 1);
+			m_stats.leaves++;
+		}
+		else
+			encoded = Collapse(binary, children[i], depth + 1);
+
+		// Children are appended behind, so the node is looked up again
+		Node& node = m_nodes[nodeIndex];
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			node.bounds[axis * 2][i] = child.boundsMin[axis];
+			node.bounds[axis * 2 + 1][i] = child.boundsMax[axis];
+		}
+		node.child[i] = encoded;
+	}
+	return nodeIndex;
+}
+
+// Slab test of the ray against all children; returns the hit mask and each child's entry t
+uint32_t Bvh::IntersectChildren(const Node& node, const TraversalRay& ray, float tMax, float* tNear)
+{
+#ifdef __AVX2__
+	__m256 enterX = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.bounds[ray.nearX]), ray.originX), ray.inverseX);
+	__m256 enterY = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.bounds[ray.nearY]), ray.originY), ray.inverseY);
+	__m256 enterZ = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.bounds[ray.nearZ]), ray.originZ), ray.inverseZ);
+	__m256 exitX = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.bounds[ray.nearX ^ 1]), ray.originX), ray.inverseX);
+	__m256 exitY = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.bounds[ray.nearY ^ 1]), ray.originY), ray.inverseY);
+	__m256 exitZ = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.bounds[ray.nearZ ^ 1]), ray.originZ), ray.inverseZ);
+
+	__m256 enter = _mm256_max_ps(_mm256_max_ps(enterX, enterY), _mm256_max_ps(enterZ, _mm256_setzero_ps()));
+	__m256 exit = _mm256_min_ps(_mm256_min_ps(exitX, exitY), _mm256_min_ps(exitZ, _mm256_set1_ps(tMax)));
+	_mm256_storeu_ps(tNear, enter);
+	return (uint32_t)_mm256_movemask_ps(_mm256_cmp_ps(enter, exit, _CMP_LE_OQ));
+#else
+	uint32_t mask = 0;
+	for (uint32_t half = 0; half < Width; half += 4)
+	{
+		__m128 enterX = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[ray.nearX] + half), ray.originX), ray.inverseX);
+		__m128 enterY = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[ray.nearY] + half), ray.originY), ray.inverseY);
+		__m128 enterZ = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[ray.nearZ] + half), ray.originZ), ray.inverseZ);
+		__m128 exitX = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[ray.nearX ^ 1] + half), ray.originX), ray.inverseX);
+		__m128 exitY = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[ray.nearY ^ 1] + half), ray.originY), ray.inverseY);
+		__m128 exitZ = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[ray.nearZ ^ 1] + half), ray.originZ), ray.inverseZ);
+
+		__m128 enter = _mm_max_ps(_mm_max_ps(enterX, enterY), _mm_max_ps(enterZ, _mm_setzero_ps()));
+		__m128 exit = _mm_min_ps(_mm_min_ps(exitX, exitY), _mm_min_ps(exitZ, _mm_set1_ps(tMax)));
+		_mm_storeu_ps(tNear + half, enter);
+		mask |= (uint32_t)_mm_movemask_ps(_mm_cmple_ps(enter, exit)) << half;
+	}
+	return mask;
+#endif
+}
+
+// Tests the leaf's triangles; records the closest hit, or stops at the first one without a hit record
+bool Bvh::IntersectLeaf(uint32_t leaf, const Ray& ray, float& tMax, RayHit* hit) const
+{
+	uint32_t first = (leaf & ~LeafBit) >> 3;
+	uint32_t count = (leaf & 7) + 1;
+	bool found = false;
+	for (uint32_t i = first; i < first + count; i++)
+	{
+		const TriangleData& triangle = m_triangles[i];
+		glm::vec3 p = glm::cross(ray.direction, triangle.e2);
+		float det = glm::dot(triangle.e1, p);
+		if (det == 0.0f)
+			continue;
+
+		float inverseDet = 1.0f / det;
+		glm::vec3 s = ray.origin - triangle.v0;
+		float u = glm::dot(s, p) * inverseDet;
+		if (u < 0.0f || u > 1.0f)
+			continue;
+
+		glm::vec3 q = glm::cross(s, triangle.e1);
+		float v = glm::dot(ray.direction, q) * inverseDet;
+		if (v < 0.0f || u + v > 1.0f)
+			continue;
+
+		float t = glm::dot(triangle.e2, q) * inverseDet;
+		if (t < 0.0f || t > tMax)
+			continue;
+
+		if (!hit)
+			return true;
+		tMax = t;
+		hit->t = t;
+		hit->u = u;
+		hit->v = v;
+		hit->triangle = i;
+		found = true;
+	}
+	return found;
+}
+
+bool Bvh::Intersect(const Ray& ray, RayHit& hit) const
+{
+	hit = RayHit();
+	if (m_nodes.empty())
+		return false;
+
+	struct Entry
+	{
+		uint32_t child;
+		float tNear;
+	};
+	Entry stack[StackSize];
+	uint32_t size = 0;
+	stack[size++] = { 0, 0.0f };
+
+	TraversalRay traversal(ray);
+	float tMax = ray.tMax;
+	while (size > 0)
+	{
+		Entry entry = stack[--size];
+		if (entry.tNear > tMax)
+			continue;
+
+		if (entry.child & LeafBit)
+		{
+			IntersectLeaf(entry.child, ray, tMax, &hit);
+			continue;
+		}
+
+		const Node& node = m_nodes[entry.child];
+		float tNear[Width];
+		uint32_t mask = IntersectChildren(node, traversal, tMax, tNear);
+
+		// Far to near, so the nearest child is popped first
+		uint32_t pushed = size;
+		for (uint32_t lane = 0; mask; lane++, mask >>= 1)
+		{
+			if (!(mask & 1))
+				continue;
+
+			uint32_t slot = size++;
+			while (slot > pushed && stack[slot - 1].tNear < tNear[lane])
+			{
+				stack[slot] = stack[slot - 1];
+				slot--;
+			}
+			stack[slot] = { node.child[lane], tNear[lane] };
+		}
+	}
+	return hit.Hit();
+}
+
+bool Bvh::Occluded(const Ray& ray) const
+{
+	if (m_nodes.empty())
+		return false;
+
+	uint32_t stack[StackSize];
+	uint32_t size = 0;
+	stack[size++] = 0;
+
+	TraversalRay traversal(ray);
+	float tMax = ray.tMax;
+	while (size > 0)
+	{
+		uint32_t child = stack[--size];
+		if (child & LeafBit)
+		{
+			if (IntersectLeaf(child, ray, tMax, nullptr))
+				return true;
+			continue;
+		}
+
+		const Node& node = m_nodes[child];
+		float tNear[Width];
+		uint32_t mask = IntersectChildren(node, traversal, tMax, tNear);
+		for (uint32_t lane = 0; mask; lane++, mask >>= 1)
+		{
+			if (mask & 1)
+				stack[size++] = node.child[lane];
+		}
+	}
+	return false;
+}
+
+bool Bvh::SegmentBlocked(const glm::vec3& from, const glm::vec3& to) const
+{
+	Ray ray;
+	ray.origin = from;
+	ray.direction = to - from;
+	ray.tMax = 1.0f;
+	return Occluded(ray);
+}
+
+void Bvh::IntersectBatch(const Ray* rays, RayHit* hits, uint32_t count, JobSystem& jobs) const
+{
+	PROFILE_ZONE("BVH intersect batch");
+	jobs.ParallelFor(count, BatchChunk, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+			Intersect(rays[i], hits[i]);
+	});
+}
+
+void Bvh::OccludedBatch(const Ray* rays, uint8_t* occluded, uint32_t count, JobSystem& jobs) const
+{
+	PROFILE_ZONE("BVH occluded batch");
+	jobs.ParallelFor(count, BatchChunk, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+			occluded[i] = Occluded(rays[i]) ? 1 : 0;
+	});
+}
+
+void Bvh::TriangleVertices(uint32_t triangle, glm::vec3& a, glm::vec3& b, glm::vec3& c) const
+{
+	const TriangleData& data = m_triangles[triangle];
+	a = data.v0;
+	b = data.v0 + data.e1;
+	c = data.v0 + data.e2;
+}
+
+// Closest point on the triangle (Ericson, Real-Time Collision Detection 5.1.5)
+static glm::vec3 ClosestPointOnTriangle(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+{
+	glm::vec3 ab = b - a;
+	glm::vec3 ac = c - a;
+	glm::vec3 ap = p - a;
+	float d1 = glm::dot(ab, ap);
+	float d2 = glm::dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f)
+		return a;
+
+	glm::vec3 bp = p - b;
+	float d3 = glm::dot(ab, bp);
+	float d4 = glm::dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3)
+		return b;
+
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+		return a + ab * (d1 / (d1 - d3));
+
+	glm::vec3 cp = p - c;
+	float d5 = glm::dot(ab, cp);
+	float d6 = glm::dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6)
+		return c;
+
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+		return a + ac * (d2 / (d2 - d6));
+
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+		return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+	float denominator = 1.0f / (va + vb + vc);
+	return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+// Separating axis test of the triangle against a box (Akenine-Moller): the box's axes,
+// the triangle's normal and the nine edge cross products
+static bool TriangleOverlapsBox(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& center, const glm::vec3& extent)
+{
+	glm::vec3 v[3] = { a - center, b - center, c - center };
+	if (glm::any(glm::greaterThan(glm::min(v[0], glm::min(v[1], v[2])), extent)) ||
+		glm::any(glm::lessThan(glm::max(v[0], glm::max(v[1], v[2])), -extent)))
+		return false;
+
+	glm::vec3 edges[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+	glm::vec3 normal = glm::cross(edges[0], edges[1]);
+	if (std::abs(glm::dot(normal, v[0])) > glm::dot(extent, glm::abs(normal)))
+		return false;
+
+	for (const glm::vec3& edge : edges)
+	{
+		for (int32_t i = 0; i < 3; i++)
+		{
+			glm::vec3 unit(0.0f);
+			unit[i] = 1.0f;
+			glm::vec3 axis = glm::cross(unit, edge);
+			float p0 = glm::dot(v[0], axis);
+			float p1 = glm::dot(v[1], axis);
+			float p2 = glm::dot(v[2], axis);
+			float radius = glm::dot(extent, glm::abs(axis));
+			if (glm::min(p0, glm::min(p1, p2)) > radius || glm::max(p0, glm::max(p1, p2)) < -radius)
+				return false;
+		}
+	}
+	return true;
+}
+
+void Bvh::OverlapSphere(const glm::vec3& center, float radius, std::vector<uint32_t>& triangles) const
+{
+	if (m_nodes.empty())
+		return;
+
+	uint32_t stack[StackSize];
+	uint32_t size = 0;
+	stack[size++] = 0;
+	float radiusSquared = radius * radius;
+	while (size > 0)
+	{
+		uint32_t child = stack[--size];
+		if (child & LeafBit)
+		{
+			uint32_t first = (child & ~LeafBit) >> 3;
+			for (uint32_t i = first; i <= first + (child & 7); i++)
+			{
+				glm::vec3 a, b, c;
+				TriangleVertices(i, a, b, c);
+				glm::vec3 d = ClosestPointOnTriangle(center, a, b, c) - center;
+				if (glm::dot(d, d) <= radiusSquared)
+					triangles.push_back(i);
+			}
+			continue;
+		}
+
+		// Squared distance from the center to each child box
+		const Node& node = m_nodes[child];
+		for (uint32_t lane = 0; lane < Width; lane++)
+		{
+			float distance = 0.0f;
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				float d = glm::max(glm::max(node.bounds[axis * 2][lane] - center[axis], center[axis] - node.bounds[axis * 2 + 1][lane]), 0.0f);
+				distance += d * d;
+			}
+			if (distance <= radiusSquared && node.child[lane] != EmptyChild)
+				stack[size++] = node.child[lane];
+		}
+	}
+}
+
+void Bvh::OverlapBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<uint32_t>& triangles) const
+{
+	if (m_nodes.empty())
+		return;
+
+	uint32_t stack[StackSize];
+	uint32_t size = 0;
+	stack[size++] = 0;
+	glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+	while (size > 0)
+	{
+		uint32_t child = stack[--size];
+		if (child & LeafBit)
+		{
+			uint32_t first = (child & ~LeafBit) >> 3;
+			for (uint32_t i = first; i <= first + (child & 7); i++)
+			{
+				glm::vec3 a, b, c;
+				TriangleVertices(i, a, b, c);
+				if (TriangleOverlapsBox(a, b, c, center, extent))
+					triangles.push_back(i);
+			}
+			continue;
+		}
+
+		const Node& node = m_nodes[child];
+		for (uint32_t lane = 0; lane < Width; lane++)
+		{
+			bool overlaps = node.bounds[0][lane] <= boundsMax.x && node.bounds[1][lane] >= boundsMin.x &&
+				node.bounds[2][lane] <= boundsMax.y && node.bounds[3][lane] >= boundsMin.y &&
+				node.bounds[4][lane] <= boundsMax.z && node.bounds[5][lane] >= boundsMin.z;
+			if (overlaps && node.child[lane] != EmptyChild)
+				stack[size++] = node.child[lane];
+		}
+	}
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "JobSystem.h"
+
+class Model;
+
+struct Ray
+{
+	glm::vec3 origin = glm::vec3(0.0f);
+	glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);	// not necessarily normalized, t is in its units
+	float tMax = FLT_MAX;
+};
+
+struct RayHit
+{
+	float t = FLT_MAX;
+	float u = 0.0f;		// barycentrics of the triangle's second and third vertex
+	float v = 0.0f;
+	uint32_t triangle = UINT32_MAX;	// UINT32_MAX when nothing was hit
+
+	bool Hit() const { return triangle != UINT32_MAX; }
+};
+
+struct BvhStats
+{
+	uint32_t triangles = 0;
+	uint32_t nodes = 0;
+	uint32_t leaves = 0;
+	uint32_t depth = 0;
+	size_t bytes = 0;
+	double buildMs = 0.0;
+};
+
+// Static bounding volume hierarchy over world space triangles for ray and overlap queries.
+// Built top down into a binary tree with binned SAH splits, then collapsed into nodes of up
+// to eight children whose boxes are stored one array per bound, so a node is tested with
+// one 8-wide AVX2 slab test (two 4-wide SSE tests otherwise). Nodes are stored depth first
+// in one array and leaf triangles in another, as a vertex and two edges for Moller-Trumbore.
+// The scene never moves, so the tree is built once after import.
+class Bvh
+{
+public:
+	static constexpr uint32_t Width = 8;				// children per node
+	static constexpr uint32_t MaxLeafTriangles = 4;
+	static constexpr uint32_t SahBins = 16;
+	static constexpr uint32_t MaxBuildDepth = 64;		// median splits below, keeps the stacks bounded
+
+	// Where a triangle of the tree came from
+	struct Source
+	{
+		uint32_t instance;
+		uint32_t primitive;		// triangle of the instance's mesh
+	};
+
+	void Build(const Model& model);
+	// From a triangle list; sources are instance 0 and the triangle's number in the list
+	void Build(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices);
+	void Clear();
+
+	// Closest hit in [0, tMax]; triangles are hit from both sides
+	bool Intersect(const Ray& ray, RayHit& hit) const;
+	// Any hit in [0, tMax], for shadow and visibility rays
+	bool Occluded(const Ray& ray) const;
+	// True when a triangle lies between the points
+	bool SegmentBlocked(const glm::vec3& from, const glm::vec3& to) const;
+
+	// Append the triangles touching the volume
+	void OverlapSphere(const glm::vec3& center, float radius, std::vector<uint32_t>& triangles) const;
+	void OverlapBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax, std::vector<uint32_t>& triangles) const;
+
+	// Independent rays split over the job system in chunks of BatchChunk
+	static constexpr uint32_t BatchChunk = 256;
+	void IntersectBatch(const Ray* rays, RayHit* hits, uint32_t count, JobSystem& jobs) const;
+	void OccludedBatch(const Ray* rays, uint8_t* occluded, uint32_t count, JobSystem& jobs) const;
+
+	const Source& TriangleSource(uint32_t triangle) const { return m_sources[triangle]; }
+	void TriangleVertices(uint32_t triangle, glm::vec3& a, glm::vec3& b, glm::vec3& c) const;
+	uint32_t TriangleCount() const { return (uint32_t)m_triangles.size(); }
+	bool Empty() const { return m_nodes.empty(); }
+	const BvhStats& Stats() const { return m_stats; }
+
+private:
+	struct alignas(32) Node
+	{
+		float bounds[6][Width];		// min x, max x, min y, max y, min z, max z; empty children are inverted
+		uint32_t child[Width];		// node index, or LeafBit | first triangle << 3 | count - 1
+	};
+
+	struct TriangleData
+	{
+		glm::vec3 v0;
+		glm::vec3 e1;	// v1 - v0
+		glm::vec3 e2;	// v2 - v0
+	};
+
+	struct BuildNode;
+	struct TraversalRay;
+
+	static constexpr uint32_t LeafBit = 0x80000000u;
+	static constexpr uint32_t EmptyChild = 0xFFFFFFFFu;
+	static constexpr uint32_t StackSize = Width * (MaxBuildDepth + 32);
+
+	void BuildTree(const std::vector<glm::vec3>& corners, std::vector<Source>& sources);
+	uint32_t Collapse(const std::vector<BuildNode>& binary, uint32_t index, uint32_t depth);
+	static uint32_t IntersectChildren(const Node& node, const TraversalRay& ray, float tMax, float* tNear);
+	bool IntersectLeaf(uint32_t leaf, const Ray& ray, float& tMax, RayHit* hit) const;
+
+	std::vector<Node> m_nodes;
+	std::vector<TriangleData> m_triangles;
+	std::vector<Source> m_sources;
+	BvhStats m_stats;
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cmath>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+// Free fly camera; yaw and pitch in degrees
+struct Camera
+{
+	glm::vec3 position = glm::vec3(0.0f, 0.0f, 3.0f);
+	float yaw = -90.0f;
+	float pitch = 0.0f;
+	float fov = 60.0f;
+	float nearPlane = 0.1f;
+	float farPlane = 1000.0f;
+
+	glm::vec3 Forward() const
+	{
+		return glm::normalize(glm::vec3(
+			std::cos(glm::radians(yaw)) * std::cos(glm::radians(pitch)),
+			std::sin(glm::radians(pitch)),
+			std::sin(glm::radians(yaw)) * std::cos(glm::radians(pitch))
+		));
+	}
+
+	glm::vec3 Right() const
+	{
+		return glm::normalize(glm::cross(Forward(), glm::vec3(0.0f, 1.0f, 0.0f)));
+	}
+
+	glm::mat4 View() const
+	{
+		return glm::lookAt(position, position + Forward(), glm::vec3(0.0f, 1.0f, 0.0f));
+	}
+
+	glm::mat4 Projection(float aspect) const
+	{
+		return glm::perspective(glm::radians(fov), aspect, nearPlane, farPlane);
+	}
+
+	static Camera Lerp(const Camera& a, const Camera& b, float t)
+	{
+		Camera result = b;
+		result.position = glm::mix(a.position, b.position, t);
+		result.yaw = glm::mix(a.yaw, b.yaw, t);
+		result.pitch = glm::mix(a.pitch, b.pitch, t);
+		return result;
+	}
+};
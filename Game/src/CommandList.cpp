@@ -0,0 +1,221 @@
+#include "CommandList.h"
+
+#include <cstring>
+
+#include <GL/glew.h>
+
+#include "RenderSnapshot.h"
+
+void CommandList::Reset()
+{
+	m_words.clear();
+	m_commands = 0;
+	m_program = 0;
+	m_vao = 0;
+	std::memset(m_textures, 0, sizeof(m_textures));
+}
+
+void CommandList::Emit(Command command)
+{
+	m_words.push_back((uint32_t)command);
+	m_commands++;
+}
+
+void CommandList::Write(float value)
+{
+	uint32_t word;
+	std::memcpy(&word, &value, sizeof(word));
+	m_words.push_back(word);
+}
+
+void CommandList::UseProgram(uint32_t program)
+{
+	if (program == m_program)
+		return;
+
+	m_program = program;
+	Emit(Command::UseProgram);
+	Write(program);
+}
+
+void CommandList::BindVertexArray(uint32_t vao)
+{
+	if (vao == m_vao)
+		return;
+
+	m_vao = vao;
+	Emit(Command::BindVertexArray);
+	Write(vao);
+}
+
+void CommandList::BindTexture(uint32_t unit, uint32_t texture)
+{
+	if (unit < MaxTextureUnits)
+	{
+		if (m_textures[unit] == texture)
+			return;
+		m_textures[unit] = texture;
+	}
+
+	Emit(Command::BindTexture);
+	Write(unit);
+	Write(texture);
+}
+
+void CommandList::SetUniformInt(int32_t location, int32_t value)
+{
+	if (location < 0)
+		return;
+
+	Emit(Command::SetUniformInt);
+	Write((uint32_t)location);
+	Write((uint32_t)value);
+}
+
+void CommandList::SetUniformUint(int32_t location, uint32_t value)
+{
+	if (location < 0)
+		return;
+
+	Emit(Command::SetUniformUint);
+	Write((uint32_t)location);
+	Write(value);
+}
+
+void CommandList::SetUniformVec3(int32_t location, const glm::vec3& value)
+{
+	if (location < 0)
+		return;
+
+	Emit(Command::SetUniformVec3);
+	Write((uint32_t)location);
+	for (int32_t i = 0; i < 3; i++)
+		Write(value[i]);
+}
+
+void CommandList::SetUniformMat4(int32_t location, const glm::mat4& value)
+{
+	if (location < 0)
+		return;
+
+	Emit(Command::SetUniformMat4);
+	Write((uint32_t)location);
+	size_t at = m_words.size();
+	m_words.resize(at + 16);
+	std::memcpy(&m_words[at], &value[0][0], 16 * sizeof(float));
+}
+
+void CommandList::DrawElements(uint32_t indexCount, uint32_t firstIndex)
+{
+	Emit(Command::DrawElements);
+	Write(indexCount);
+	Write(firstIndex);
+}
+
+void CommandList::DispatchCompute(uint32_t x, uint32_t y, uint32_t z)
+{
+	Emit(Command::DispatchCompute);
+	Write(x);
+	Write(y);
+	Write(z);
+}
+
+void CommandList::Barrier(uint32_t barriers)
+{
+	Emit(Command::Barrier);
+	Write(barriers);
+}
+
+void CommandList::Replay(CommandStats& stats) const
+{
+	const uint32_t* word = m_words.data();
+	const uint32_t* end = word + m_words.size();
+	float values[16];
+
+	while (word < end)
+	{
+		Command command = (Command)*word++;
+		switch (command)
+		{
+		case Command::UseProgram:
+			glUseProgram(word[0]);
+			word += 1;
+			stats.stateChanges++;
+			break;
+		case Command::BindVertexArray:
+			glBindVertexArray(word[0]);
+			word += 1;
+			stats.stateChanges++;
+			break;
+		case Command::BindTexture:
+			glBindTextureUnit(word[0], word[1]);
+			word += 2;
+			stats.stateChanges++;
+			break;
+		case Command::SetUniformInt:
+			glUniform1i((GLint)word[0], (GLint)word[1]);
+			word += 2;
+			stats.uniforms++;
+			break;
+		case Command::SetUniformUint:
+			glUniform1ui((GLint)word[0], word[1]);
+			word += 2;
+			stats.uniforms++;
+			break;
+		case Command::SetUniformVec3:
+			std::memcpy(values, word + 1, 3 * sizeof(float));
+			glUniform3fv((GLint)word[0], 1, values);
+			word += 4;
+			stats.uniforms++;
+			break;
+		case Command::SetUniformMat4:
+			std::memcpy(values, word + 1, 16 * sizeof(float));
+			glUniformMatrix4fv((GLint)word[0], 1, GL_FALSE, values);
+			word += 17;
+			stats.uniforms++;
+			break;
+		case Command::DrawElements:
+			glDrawElements(GL_TRIANGLES, word[0], GL_UNSIGNED_INT, (void*)(uintptr_t)(word[1] * sizeof(uint32_t)));
+			stats.drawCalls++;
+			stats.triangles += word[0] / 3;
+			word += 2;
+			break;
+		case Command::DispatchCompute:
+			glDispatchCompute(word[0], word[1], word[2]);
+			stats.dispatches++;
+			word += 3;
+			break;
+		case Command::Barrier:
+			glMemoryBarrier(word[0]);
+			word += 1;
+			break;
+		}
+		stats.commands++;
+	}
+}
+
+void RecordFrameSetup(CommandList& list, const SceneUniforms& uniforms)
+{
+	list.Reset();
+	list.UseProgram(uniforms.program);
+}
+
+void RecordMeshDraws(CommandList& list, const std::vector<DrawBinding>& bindings, const SceneUniforms& uniforms,
+	const RenderItem* items, const uint32_t* visible, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t index = visible[i];
+		const RenderItem& item = items[index];
+		const DrawBinding& binding = bindings[item.mesh];
+
+		list.BindVertexArray(binding.vao);
+		for (uint32_t t = 0; t < binding.textureCount; t++)
+		{
+			list.BindTexture(binding.textures[t].unit, binding.textures[t].texture);
+			list.SetUniformInt(binding.textures[t].location, (int32_t)binding.textures[t].unit);
+		}
+		list.SetUniformUint(uniforms.drawIndex, index);
+		list.DrawElements(binding.indexCount);
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+struct RenderItem;
+
+// Counters gathered while replaying, reset by the owner once per frame
+struct CommandStats
+{
+	uint32_t commands = 0;
+	uint32_t drawCalls = 0;
+	uint32_t dispatches = 0;
+	uint64_t triangles = 0;
+	uint32_t stateChanges = 0;	// program, vertex array and texture binds
+	uint32_t uniforms = 0;
+};
+
+enum class Command : uint32_t
+{
+	UseProgram,
+	BindVertexArray,
+	BindTexture,
+	SetUniformInt,
+	SetUniformUint,
+	SetUniformVec3,
+	SetUniformMat4,
+	DrawElements,
+	DispatchCompute,
+	Barrier
+};
+
+// Flat stream of GL commands. Recording touches no GL state, so any thread can build
+// a list; only the thread owning the context may Replay it. Every command is one
+// opcode word followed by a fixed number of 32 bit payload words.
+class CommandList
+{
+public:
+	void Reset();
+
+	void UseProgram(uint32_t program);
+	void BindVertexArray(uint32_t vao);
+	void BindTexture(uint32_t unit, uint32_t texture);
+	void SetUniformInt(int32_t location, int32_t value);
+	void SetUniformUint(int32_t location, uint32_t value);
+	void SetUniformVec3(int32_t location, const glm::vec3& value);
+	void SetUniformMat4(int32_t location, const glm::mat4& value);
+	void DrawElements(uint32_t indexCount, uint32_t firstIndex = 0);
+	void DispatchCompute(uint32_t x, uint32_t y, uint32_t z);
+	void Barrier(uint32_t barriers);
+
+	void Replay(CommandStats& stats) const;
+
+	uint32_t CommandCount() const { return m_commands; }
+	size_t SizeBytes() const { return m_words.size() * sizeof(uint32_t); }
+
+private:
+	static constexpr uint32_t MaxTextureUnits = 16;
+
+	void Emit(Command command);
+	void Write(uint32_t word) { m_words.push_back(word); }
+	void Write(float value);
+
+	std::vector<uint32_t> m_words;
+	uint32_t m_commands = 0;
+
+	// Redundant binds are dropped while recording
+	uint32_t m_program = 0;
+	uint32_t m_vao = 0;
+	uint32_t m_textures[MaxTextureUnits] = {};
+};
+
+// What a mesh needs bound to draw, resolved once at load so recording is pure data
+struct TextureBinding
+{
+	int32_t location;	// sampler uniform
+	uint32_t unit;
+	uint32_t texture;
+};
+
+struct DrawBinding
+{
+	static constexpr uint32_t MaxTextures = 4;
+
+	uint32_t vao = 0;
+	uint32_t indexCount = 0;
+	uint32_t textureCount = 0;
+	TextureBinding textures[MaxTextures] = {};
+};
+
+// Camera and transforms come from per frame buffers bound by the renderer;
+// each draw only selects its transform
+struct SceneUniforms
+{
+	uint32_t program = 0;
+	int32_t drawIndex = -1;
+};
+
+// Per frame state ahead of the draws
+void RecordFrameSetup(CommandList& list, const SceneUniforms& uniforms);
+
+// Draws for visible[0..count) of the snapshot's items. drawIndex is the item index,
+// which is where the renderer uploads that item's transform.
+void RecordMeshDraws(CommandList& list, const std::vector<DrawBinding>& bindings, const SceneUniforms& uniforms,
+	const RenderItem* items, const uint32_t* visible, size_t count);
@@ -0,0 +1,123 @@
+#include "DeferredPath.h"
+
+#include "Log.h"
+#include "MemoryTracker.h"
+
+// Texture units and image unit used by the lighting pass
+static constexpr uint32_t AlbedoUnit = 0;
+static constexpr uint32_t NormalUnit = 1;
+static constexpr uint32_t DepthUnit = 2;
+static constexpr uint32_t LitImageUnit = 0;
+
+void DeferredPath::Init(int32_t width, int32_t height)
+{
+	m_lighting = std::make_unique<Shader>("shaders/deferred_lighting.comp");
+	m_clearColorLocation = glGetUniformLocation(m_lighting->ID, "clearColor");
+
+	m_width = width;
+	m_height = height;
+	CreateTargets();
+
+	LOG_INFO("Deferred: G-buffer " << BytesPerPixel() << " bytes/pixel, "
+		<< Bytes() / (1024.0 * 1024.0) << " MB at " << width << "x" << height);
+}
+
+void DeferredPath::Shutdown()
+{
+	DestroyTargets();
+	if (m_lighting)
+		glDeleteProgram(m_lighting->ID);
+	m_lighting.reset();
+}
+
+static uint32_t CreateTarget(GLenum format, uint32_t bytesPerTexel, int32_t width, int32_t height, const char* label)
+{
+	uint32_t texture = 0;
+	glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+	glTextureStorage2D(texture, 1, format, width, height);
+	glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	MemoryTracker::TrackGpu(GpuResource::Texture, texture, MemoryTracker::TextureBytes(width, height, 1, bytesPerTexel, false), MemoryTag::Render, label);
+	return texture;
+}
+
+void DeferredPath::CreateTargets()
+{
+	m_albedo = CreateTarget(GL_RGBA8, 4, m_width, m_height, "g-buffer albedo");
+	m_normal = CreateTarget(GL_RGB10_A2, 4, m_width, m_height, "g-buffer normal");
+	m_depth = CreateTarget(GL_DEPTH_COMPONENT32F, 4, m_width, m_height, "g-buffer depth");
+	m_lit = CreateTarget(GL_RGBA8, 4, m_width, m_height, "lit target");
+
+	glCreateFramebuffers(1, &m_gbuffer);
+	glNamedFramebufferTexture(m_gbuffer, GL_COLOR_ATTACHMENT0, m_albedo, 0);
+	glNamedFramebufferTexture(m_gbuffer, GL_COLOR_ATTACHMENT1, m_normal, 0);
+	glNamedFramebufferTexture(m_gbuffer, GL_DEPTH_ATTACHMENT, m_depth, 0);
+	const GLenum attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glNamedFramebufferDrawBuffers(m_gbuffer, 2, attachments);
+	if (glCheckNamedFramebufferStatus(m_gbuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		LOG_ERROR("G-buffer framebuffer is incomplete");
+
+	glCreateFramebuffers(1, &m_litFramebuffer);
+	glNamedFramebufferTexture(m_litFramebuffer, GL_COLOR_ATTACHMENT0, m_lit, 0);
+}
+
+void DeferredPath::DestroyTargets()
+{
+	if (!m_gbuffer)
+		return;
+
+	glDeleteFramebuffers(1, &m_gbuffer);
+	glDeleteFramebuffers(1, &m_litFramebuffer);
+	const uint32_t textures[4] = { m_albedo, m_normal, m_depth, m_lit };
+	for (uint32_t texture : textures)
+		MemoryTracker::UntrackGpu(GpuResource::Texture, texture);
+	glDeleteTextures(4, textures);
+	m_gbuffer = m_litFramebuffer = 0;
+	m_albedo = m_normal = m_depth = m_lit = 0;
+}
+
+void DeferredPath::BeginGeometry(int32_t width, int32_t height)
+{
+	if (width != m_width || height != m_height)
+	{
+		DestroyTargets();
+		m_width = width;
+		m_height = height;
+		CreateTargets();
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_gbuffer);
+	glViewport(0, 0, m_width, m_height);
+
+	// Blending would mix packed normals; the geometry pass is opaque.
+	// The vendored glew declares the clear values non-const
+	glDisable(GL_BLEND);
+	float zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	float farDepth = 1.0f;
+	glClearNamedFramebufferfv(m_gbuffer, GL_COLOR, 0, zero);
+	glClearNamedFramebufferfv(m_gbuffer, GL_COLOR, 1, zero);
+	glClearNamedFramebufferfv(m_gbuffer, GL_DEPTH, 0, &farDepth);
+}
+
+void DeferredPath::Light(const glm::vec4& clearColor, uint32_t target)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, target);
+	glEnable(GL_BLEND);
+
+	glUseProgram(m_lighting->ID);
+	glUniform4f(m_clearColorLocation, clearColor.r, clearColor.g, clearColor.b, clearColor.a);
+	glBindTextureUnit(AlbedoUnit, m_albedo);
+	glBindTextureUnit(NormalUnit, m_normal);
+	glBindTextureUnit(DepthUnit, m_depth);
+	glBindImageTexture(LitImageUnit, m_lit, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+	glDispatchCompute((m_width + TileSize - 1) / TileSize, (m_height + TileSize - 1) / TileSize, 1);
+	glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT);
+}
+
+void DeferredPath::Resolve(uint32_t target)
+{
+	glBlitNamedFramebuffer(m_litFramebuffer, target, 0, 0, m_width, m_height, 0, 0, m_width, m_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <glm/glm.hpp>
+
+#include "Shader.h"
+
+enum class RenderPath
+{
+	Forward,
+	Deferred
+};
+
+// Deferred shading. The geometry pass fills a packed G-buffer, then a compute pass culls
+// lights per 16x16 tile against the tile's depth range and shades every pixel.
+//   albedo   RGBA8     rgb albedo, a unused
+//   normal   RGB10_A2  octahedral world normal (rg), roughness (b), metalness (a, 2 bits)
+//   depth    D32F      view position is reconstructed from depth, no position target
+// Shading goes to an RGBA8 target that is blitted to the back buffer.
+class DeferredPath
+{
+public:
+	static constexpr uint32_t TileSize = 16;
+	static constexpr uint32_t MaxLightsPerTile = 256;	// must match deferred_lighting.comp
+
+	void Init(int32_t width, int32_t height);
+	void Shutdown();
+
+	// Binds and clears the G-buffer, resizing it first if needed
+	void BeginGeometry(int32_t width, int32_t height);
+	// Expects the Frame block and the Lights buffer to be bound; leaves the target bound
+	void Light(const glm::vec4& clearColor, uint32_t target);
+	// Copies the shaded image to the target, 0 for the back buffer
+	void Resolve(uint32_t target);
+
+	// G-buffer only; the lit target adds another 4
+	static uint32_t BytesPerPixel() { return 4 + 4 + 4; }
+	size_t Bytes() const { return (size_t)BytesPerPixel() * m_width * m_height; }
+	static const char* Name(RenderPath path) { return path == RenderPath::Deferred ? "deferred" : "forward"; }
+
+private:
+	void CreateTargets();
+	void DestroyTargets();
+
+	std::unique_ptr<Shader> m_lighting;
+	int32_t m_clearColorLocation = -1;
+
+	int32_t m_width = 0;
+	int32_t m_height = 0;
+	uint32_t m_gbuffer = 0;
+	uint32_t m_albedo = 0;
+	uint32_t m_normal = 0;
+	uint32_t m_depth = 0;
+	uint32_t m_litFramebuffer = 0;
+	uint32_t m_lit = 0;
+};
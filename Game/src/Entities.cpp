@@ -0,0 +1,52 @@
+#include "Entities.h"
+
+Entity Registry::Create()
+{
+	Entity entity;
+	if (!m_free.empty())
+	{
+		entity.index = m_free.back();
+		m_free.pop_back();
+	}
+	else
+	{
+		entity.index = (uint32_t)m_generations.size();
+		m_generations.push_back(0);
+	}
+	entity.generation = m_generations[entity.index];
+	m_alive++;
+	return entity;
+}
+
+void Registry::Destroy(Entity entity)
+{
+	if (!Alive(entity))
+		return;
+
+	for (const std::unique_ptr<ComponentPoolBase>& pool : m_pools)
+	{
+		if (pool)
+			pool->Remove(entity.index);
+	}
+	m_generations[entity.index]++;
+	m_free.push_back(entity.index);
+	m_alive--;
+}
+
+void Registry::Clear()
+{
+	// Generations survive so handles from before the clear stay dead
+	m_free.clear();
+	for (uint32_t index = (uint32_t)m_generations.size(); index > 0; index--)
+	{
+		m_generations[index - 1]++;
+		m_free.push_back(index - 1);
+	}
+
+	for (const std::unique_ptr<ComponentPoolBase>& pool : m_pools)
+	{
+		if (pool)
+			pool->Clear();
+	}
+	m_alive = 0;
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Generational handle. Indices are reused after Destroy; the generation tells the
+// old and the new entity apart, so stale handles fail Alive instead of aliasing.
+struct Entity
+{
+	uint32_t index = UINT32_MAX;
+	uint32_t generation = 0;
+
+	bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const Entity& other) const { return !(*this == other); }
+	bool IsNull() const { return index == UINT32_MAX; }
+};
+
+class ComponentPoolBase
+{
+public:
+	static constexpr uint32_t Missing = UINT32_MAX;
+
+	virtual ~ComponentPoolBase() = default;
+	virtual void Remove(uint32_t entityIndex) = 0;
+	virtual void Clear() = 0;
+
+	uint32_t Size() const { return (uint32_t)m_entities.size(); }
+	uint32_t DenseIndex(uint32_t entityIndex) const { return entityIndex < m_sparse.size() ? m_sparse[entityIndex] : Missing; }
+	bool Contains(uint32_t entityIndex) const { return DenseIndex(entityIndex) != Missing; }
+	// Owners of the components, in the same order
+	const std::vector<Entity>& Entities() const { return m_entities; }
+
+protected:
+	std::vector<uint32_t> m_sparse;		// entity index to dense index
+	std::vector<Entity> m_entities;
+};
+
+// Sparse set: the components are packed in one array with their owners in a parallel
+// array, and an entity indexed array points into both. Removal moves the last
+// component into the hole, so iteration never sees gaps but order is not kept.
+template<typename T>
+class ComponentPool : public ComponentPoolBase
+{
+public:
+	T& Add(Entity entity, T component)
+	{
+		if (entity.index >= m_sparse.size())
+			m_sparse.resize(entity.index + 1, Missing);
+
+		uint32_t dense = m_sparse[entity.index];
+		if (dense != Missing)
+		{
+			m_components[dense] = std::move(component);
+			return m_components[dense];
+		}
+
+		m_sparse[entity.index] = (uint32_t)m_entities.size();
+		m_entities.push_back(entity);
+		m_components.push_back(std::move(component));
+		return m_components.back();
+	}
+
+	void Remove(uint32_t entityIndex) override
+	{
+		uint32_t dense = DenseIndex(entityIndex);
+		if (dense == Missing)
+			return;
+
+		uint32_t last = (uint32_t)m_entities.size() - 1;
+		if (dense != last)
+		{
+			m_components[dense] = std::move(m_components[last]);
+			m_entities[dense] = m_entities[last];
+			m_sparse[m_entities[dense].index] = dense;
+		}
+		m_components.pop_back();
+		m_entities.pop_back();
+		m_sparse[entityIndex] = Missing;
+	}
+
+	void Clear() override
+	{
+		m_sparse.clear();
+		m_entities.clear();
+		m_components.clear();
+	}
+
+	T* Get(uint32_t entityIndex)
+	{
+		uint32_t dense = DenseIndex(entityIndex);
+		return dense != Missing ? &m_components[dense] : nullptr;
+	}
+
+	std::vector<T>& Components() { return m_components; }
+	const std::vector<T>& Components() const { return m_components; }
+
+private:
+	std::vector<T> m_components;
+};
+
+// Entity store with one sparse set pool per component type, created on first use.
+// Not thread safe; pools may be read from several threads while nothing is added or removed.
+class Registry
+{
+public:
+	Entity Create();
+	// Removes every component of the entity and retires its handle
+	void Destroy(Entity entity);
+	bool Alive(Entity entity) const { return entity.index < m_generations.size() && m_generations[entity.index] == entity.generation; }
+	uint32_t AliveCount() const { return m_alive; }
+	void Clear();
+
+	// Null for a destroyed entity, so a stale handle can't attach to whoever reuses its index
+	template<typename T>
+	T* Add(Entity entity, T component = T())
+	{
+		if (!Alive(entity))
+			return nullptr;
+		return &Pool<T>().Add(entity, std::move(component));
+	}
+
+	template<typename T>
+	void Remove(Entity entity)
+	{
+		if (Alive(entity))
+			Pool<T>().Remove(entity.index);
+	}
+
+	template<typename T>
+	T* Get(Entity entity)
+	{
+		return Alive(entity) ? Pool<T>().Get(entity.index) : nullptr;
+	}
+
+	template<typename T>
+	bool Has(Entity entity)
+	{
+		return Alive(entity) && Pool<T>().Contains(entity.index);
+	}
+
+	template<typename T>
+	ComponentPool<T>& Pool()
+	{
+		uint32_t id = TypeId<T>();
+		if (id >= m_pools.size())
+			m_pools.resize(id + 1);
+		if (!m_pools[id])
+			m_pools[id] = std::make_unique<ComponentPool<T>>();
+		return *static_cast<ComponentPool<T>*>(m_pools[id].get());
+	}
+
+	// Calls fn(entity, T&...) for every entity that has all of the components. A single
+	// component walks its pool's arrays directly; combinations walk the smallest pool and
+	// look the rest up. Components of these types must not be added or removed inside fn.
+	template<typename... T, typename F>
+	void Each(F&& fn)
+	{
+		if constexpr (sizeof...(T) == 1)
+		{
+			auto& pool = Pool<T...>();
+			auto& components = pool.Components();
+			const std::vector<Entity>& entities = pool.Entities();
+			for (size_t i = 0; i < components.size(); i++)
+				fn(entities[i], components[i]);
+		}
+		else
+		{
+			std::tuple<ComponentPool<T>*...> pools(&Pool<T>()...);
+			const ComponentPoolBase* smallest = nullptr;
+			for (const ComponentPoolBase* pool : { static_cast<const ComponentPoolBase*>(&Pool<T>())... })
+			{
+				if (!smallest || pool->Size() < smallest->Size())
+					smallest = pool;
+			}
+
+			const std::vector<Entity>& entities = smallest->Entities();
+			for (size_t i = 0; i < entities.size(); i++)
+			{
+				Entity entity = entities[i];
+				if ((std::get<ComponentPool<T>*>(pools)->Contains(entity.index) && ...))
+					fn(entity, *std::get<ComponentPool<T>*>(pools)->Get(entity.index)...);
+			}
+		}
+	}
+
+private:
+	static uint32_t NextTypeId()
+	{
+		static std::atomic<uint32_t> next{ 0 };
+		return next++;
+	}
+
+	template<typename T>
+	static uint32_t TypeId()
+	{
+		static const uint32_t id = NextTypeId();
+		return id;
+	}
+
+	std::vector<uint32_t> m_generations;
+	std::vector<uint32_t> m_free;
+	std::vector<std::unique_ptr<ComponentPoolBase>> m_pools;
+	uint32_t m_alive = 0;
+};
@@ -0,0 +1,200 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#include "Log.h"
+#include "MemoryTracker.h"
+
+static constexpr size_t BlockAlignment = 64;
+
+#if ARENA_DEBUG
+static constexpr uint8_t NewByte = 0xCD;
+static constexpr uint8_t FreedByte = 0xDD;
+static constexpr uint8_t GuardByte = 0xFD;
+static constexpr size_t GuardSize = 8;
+
+// In front of every allocation, linking back to the previous one so guards can be walked
+struct ArenaHeader
+{
+	uint64_t size;
+	uint64_t previous;
+};
+static constexpr size_t HeaderSize = sizeof(ArenaHeader);
+#else
+static constexpr size_t GuardSize = 0;
+static constexpr size_t HeaderSize = 0;
+#endif
+
+FrameArena::~FrameArena()
+{
+	FreeOverflow(0);
+	if (m_memory)
+		::operator delete(m_memory, std::align_val_t(BlockAlignment));
+}
+
+void FrameArena::Init(size_t capacity)
+{
+	// Arena blocks belong to their thread, not to whoever allocated first
+	MemoryScope scope(MemoryTag::Untagged);
+
+	FreeOverflow(0);
+	if (m_memory)
+		::operator delete(m_memory, std::align_val_t(BlockAlignment));
+
+	m_memory = static_cast<uint8_t*>(::operator new(capacity, std::align_val_t(BlockAlignment)));
+	m_capacity = capacity;
+	m_used = 0;
+	m_overflow.reserve(64);
+	m_stats.capacity = capacity;
+	m_stats.used = 0;
+#if ARENA_DEBUG
+	std::memset(m_memory, FreedByte, capacity);
+	m_lastHeader = SIZE_MAX;
+#endif
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+	if (!m_memory)
+		Init(DefaultCapacity);
+
+	m_stats.allocations++;
+	uintptr_t base = reinterpret_cast<uintptr_t>(m_memory);
+	size_t offset = (size_t)(((base + m_used + HeaderSize + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base);
+	size_t end = offset + size + GuardSize;
+
+	if (end > m_capacity)
+	{
+		MemoryScope scope(MemoryTag::Untagged);
+		void* memory = ::operator new(size, std::align_val_t(alignment));
+		m_overflow.push_back({ memory, size, alignment });
+		m_overflowBytes += size;
+		m_stats.overflows++;
+		m_stats.highWater = std::max(m_stats.highWater, m_used + m_overflowBytes);
+#if ARENA_DEBUG
+		if (!m_reportedOverflow)
+			LOG_WARN("Frame arena overflow: " << size << " bytes with " << m_used << " of " << m_capacity << " used, growing at the next reset");
+		m_reportedOverflow = true;
+#endif
+		return memory;
+	}
+
+#if ARENA_DEBUG
+	ArenaHeader header = { size, m_lastHeader };
+	m_lastHeader = offset - HeaderSize;
+	std::memcpy(m_memory + m_lastHeader, &header, HeaderSize);
+	std::memset(m_memory + offset, NewByte, size);
+	std::memset(m_memory + offset + size, GuardByte, GuardSize);
+#endif
+
+	m_used = end;
+	m_stats.used = m_used;
+	m_stats.highWater = std::max(m_stats.highWater, m_used + m_overflowBytes);
+	return m_memory + offset;
+}
+
+void FrameArena::Free(void* memory, size_t size)
+{
+	uint8_t* bytes = static_cast<uint8_t*>(memory);
+	if (bytes < m_memory || bytes >= m_memory + m_capacity)
+		return;
+
+	// Anything but the latest allocation stays until the next Reset
+	size_t offset = (size_t)(bytes - m_memory);
+	if (offset + size + GuardSize != m_used)
+		return;
+
+	size_t start = offset - HeaderSize;
+#if ARENA_DEBUG
+	CheckGuards(start);
+	ArenaHeader header;
+	std::memcpy(&header, m_memory + start, HeaderSize);
+	m_lastHeader = header.previous;
+	std::memset(m_memory + start, FreedByte, m_used - start);
+#endif
+	m_used = start;
+	m_stats.used = m_used;
+}
+
+void FrameArena::Reset()
+{
+	Rewind({ 0, 0 });
+	m_stats.allocations = 0;
+}
+
+void FrameArena::Rewind(ArenaMark mark)
+{
+	FreeOverflow(mark.overflow);
+
+	if (mark.used < m_used)
+	{
+#if ARENA_DEBUG
+		CheckGuards(mark.used);
+		while (m_lastHeader != SIZE_MAX && m_lastHeader >= mark.used)
+		{
+			ArenaHeader header;
+			std::memcpy(&header, m_memory + m_lastHeader, HeaderSize);
+			m_lastHeader = header.previous;
+		}
+		std::memset(m_memory + mark.used, FreedByte, m_used - mark.used);
+#endif
+		m_used = mark.used;
+		m_stats.used = m_used;
+	}
+
+#if ARENA_DEBUG
+	if (m_overflow.empty())
+		m_reportedOverflow = false;
+#endif
+	if (m_used == 0 && m_overflow.empty())
+		Grow();
+}
+
+#if ARENA_DEBUG
+void FrameArena::CheckGuards(size_t from)
+{
+	for (size_t at = m_lastHeader; at != SIZE_MAX && at >= from; )
+	{
+		ArenaHeader header;
+		std::memcpy(&header, m_memory + at, HeaderSize);
+		const uint8_t* guard = m_memory + at + HeaderSize + header.size;
+		for (size_t i = 0; i < GuardSize; i++)
+		{
+			if (guard[i] != GuardByte)
+			{
+				LOG_ERROR("Frame arena: write past the end of a " << header.size << " byte allocation at offset " << at + HeaderSize);
+				break;
+			}
+		}
+		at = header.previous;
+	}
+}
+#endif
+
+void FrameArena::FreeOverflow(size_t from)
+{
+	for (size_t i = from; i < m_overflow.size(); i++)
+	{
+		::operator delete(m_overflow[i].memory, std::align_val_t(m_overflow[i].alignment));
+		m_overflowBytes -= m_overflow[i].size;
+	}
+	if (from < m_overflow.size())
+		m_overflow.resize(from);
+}
+
+void FrameArena::Grow()
+{
+	if (m_stats.highWater <= m_capacity)
+		return;
+
+	// Headroom so a frame slightly bigger than the worst so far still fits
+	Init(std::max(m_capacity * 2, m_stats.highWater + m_stats.highWater / 4));
+}
+
+FrameArena& FrameArena::Local()
+{
+	static thread_local FrameArena arena;
+	return arena;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Debug builds poison arena memory and check guard bytes after every allocation
+#ifndef ARENA_DEBUG
+#ifdef _DEBUG
+#define ARENA_DEBUG 1
+#else
+#define ARENA_DEBUG 0
+#endif
+#endif
+
+struct ArenaStats
+{
+	size_t capacity = 0;
+	size_t used = 0;			// in the block, this frame
+	size_t highWater = 0;		// most used in one frame, overflow included
+	uint64_t allocations = 0;	// this frame
+	uint64_t overflows = 0;		// allocations that went to the heap, ever
+};
+
+// Where to rewind an arena to, from Mark
+struct ArenaMark
+{
+	size_t used;
+	size_t overflow;
+};
+
+// Bump allocator for data that lives until its thread's next frame. Allocating moves
+// an offset; only the latest allocation can be freed on its own, everything else goes
+// at once on Reset. What does not fit is taken from the heap until the next Reset,
+// which grows the block so the following frames fit. Not thread safe: every thread
+// uses its own, see Local. Job system workers reset theirs after every job, so memory a
+// job takes from Local() must not outlive the job.
+//
+// With ARENA_DEBUG new memory is filled with 0xCD and released memory with 0xDD, and
+// the guard bytes behind each allocation are checked whenever memory is released.
+class FrameArena
+{
+public:
+	static constexpr size_t DefaultCapacity = 256 * 1024;
+
+	FrameArena() = default;
+	explicit FrameArena(size_t capacity) { Init(capacity); }
+	~FrameArena();
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	void Init(size_t capacity);
+
+	void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+	void Free(void* memory, size_t size);
+	// Start of a frame: everything allocated before is gone
+	void Reset();
+
+	ArenaMark Mark() const { return { m_used, m_overflow.size() }; }
+	// Releases everything allocated after the mark
+	void Rewind(ArenaMark mark);
+
+	const ArenaStats& Stats() const { return m_stats; }
+
+	// The calling thread's arena, made on first use
+	static FrameArena& Local();
+
+private:
+	struct Overflow
+	{
+		void* memory;
+		size_t size;
+		size_t alignment;
+	};
+
+	uint8_t* m_memory = nullptr;
+	size_t m_capacity = 0;
+	size_t m_used = 0;
+	std::vector<Overflow> m_overflow;
+	size_t m_overflowBytes = 0;
+	ArenaStats m_stats;
+#if ARENA_DEBUG
+	size_t m_lastHeader = SIZE_MAX;	// offset of the latest allocation's header
+	bool m_reportedOverflow = false;
+
+	void CheckGuards(size_t from);
+#endif
+
+	void FreeOverflow(size_t from);
+	// Grows the block to what the last frame needed, once nothing is allocated
+	void Grow();
+};
+
+// Allocator for standard containers on a frame arena; the calling thread's by default.
+// Containers must not outlive the frame, or the scope they were made in.
+template <typename T>
+class ArenaAllocator
+{
+public:
+	using value_type = T;
+
+	ArenaAllocator() : m_arena(&FrameArena::Local()) {}
+	explicit ArenaAllocator(FrameArena& arena) : m_arena(&arena) {}
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.Arena()) {}
+
+	T* allocate(size_t count) { return static_cast<T*>(m_arena->Allocate(count * sizeof(T), alignof(T))); }
+	void deallocate(T* memory, size_t count) { m_arena->Free(memory, count * sizeof(T)); }
+
+	FrameArena* Arena() const { return m_arena; }
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U>& other) const { return m_arena == other.Arena(); }
+	template <typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const { return m_arena != other.Arena(); }
+
+private:
+	FrameArena* m_arena;
+};
+
+template <typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
+using FrameString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+// Rewinds the arena when the scope ends, for temporaries outside the frame loop or
+// inside a long frame
+class ArenaScope
+{
+public:
+	explicit ArenaScope(FrameArena& arena = FrameArena::Local()) : m_arena(arena), m_mark(arena.Mark()) {}
+	~ArenaScope() { m_arena.Rewind(m_mark); }
+
+	ArenaScope(const ArenaScope&) = delete;
+	ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+	FrameArena& m_arena;
+	ArenaMark m_mark;
+};
@@ -0,0 +1,226 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <SDL.h>
+
+#include "FrameArena.h"
+
+SampleWindow::SampleWindow(size_t capacity)
+	: m_samples(capacity, 0.0)
+{
+}
+
+void SampleWindow::Push(double value)
+{
+	m_samples[m_head] = value;
+	m_head = (m_head + 1) % m_samples.size();
+	m_count = std::min(m_count + 1, m_samples.size());
+}
+
+void SampleWindow::Clear()
+{
+	m_head = 0;
+	m_count = 0;
+}
+
+double SampleWindow::Last() const
+{
+	if (m_count == 0)
+		return 0.0;
+
+	return m_samples[(m_head + m_samples.size() - 1) % m_samples.size()];
+}
+
+double SampleWindow::Min() const
+{
+	if (m_count == 0)
+		return 0.0;
+
+	return *std::min_element(m_samples.begin(), m_samples.begin() + m_count);
+}
+
+double SampleWindow::Max() const
+{
+	if (m_count == 0)
+		return 0.0;
+
+	return *std::max_element(m_samples.begin(), m_samples.begin() + m_count);
+}
+
+double SampleWindow::Average() const
+{
+	if (m_count == 0)
+		return 0.0;
+
+	double sum = 0.0;
+	for (size_t i = 0; i < m_count; i++)
+		sum += m_samples[i];
+
+	return sum / m_count;
+}
+
+double SampleWindow::StdDev() const
+{
+	if (m_count < 2)
+		return 0.0;
+
+	double mean = Average(),
+		   sum = 0.0;
+	for (size_t i = 0; i < m_count; i++)
+		sum += (m_samples[i] - mean) * (m_samples[i] - mean);
+
+	return std::sqrt(sum / (m_count - 1));
+}
+
+double SampleWindow::Percentile(double p) const
+{
+	if (m_count == 0)
+		return 0.0;
+
+	// Called every frame for the overlay, so the copy comes from the frame arena
+	ArenaScope scope;
+	FrameVector<double> sorted(m_samples.begin(), m_samples.begin() + m_count);
+	size_t rank = std::min(sorted.size() - 1, (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5));
+	std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+
+	return sorted[rank];
+}
+
+void SampleWindow::CopyOrdered(std::vector<float>& out) const
+{
+	out.resize(m_count);
+	size_t start = (m_head + m_samples.size() - m_count) % m_samples.size();
+	for (size_t i = 0; i < m_count; i++)
+		out[i] = (float)m_samples[(start + i) % m_samples.size()];
+}
+
+void FramePacer::Init(double updateHz, int32_t frameCap)
+{
+	m_fixedDelta = 1.0 / (updateHz > 0.0 ? updateHz : 60.0);
+	SetFrameCap(frameCap);
+	Resync();
+
+	m_frames = 0;
+	m_frameTimes.Clear();
+	m_frameDeltas.Clear();
+	m_latency.Clear();
+}
+
+void FramePacer::SetFrameCap(int32_t frameCap)
+{
+	m_targetTicks = frameCap > 0 ? SDL_GetPerformanceFrequency() / frameCap : 0;
+}
+
+void FramePacer::Resync()
+{
+	m_lastFrame = Now();
+	m_accumulator = 0.0;
+}
+
+uint32_t FramePacer::BeginFrame()
+{
+	m_frameStart = Now();
+
+	double frameTime = ToSeconds(m_frameStart - m_lastFrame);
+	m_lastFrame = m_frameStart;
+	m_deltaTime = frameTime;
+
+	double frameMs = frameTime * 1000.0;
+	if (m_frames > 0)
+	{
+		m_frameTimes.Push(frameMs);
+		m_frameDeltas.Push(std::abs(frameMs - m_lastFrameMs));
+	}
+	m_lastFrameMs = frameMs;
+	m_frames++;
+
+	// Avoid the spiral of death after a hitch (debugger, window drag)
+	m_accumulator += std::min(frameTime, MaxFrameTime);
+
+	uint32_t updates = 0;
+	while (m_accumulator >= m_fixedDelta && updates < MaxUpdatesPerFrame)
+	{
+		m_accumulator -= m_fixedDelta;
+		updates++;
+	}
+	if (updates == MaxUpdatesPerFrame)
+		m_accumulator = std::fmod(m_accumulator, m_fixedDelta);
+
+	m_updatesLastFrame = updates;
+	return updates;
+}
+
+void FramePacer::MarkInput()
+{
+	if (m_inputTime == 0)
+		m_inputTime = Now();
+}
+
+void FramePacer::RecordLatency(uint64_t inputTime, uint64_t presentTime)
+{
+	if (inputTime != 0 && presentTime > inputTime)
+		m_latency.Push(ToMilliseconds(presentTime - inputTime));
+}
+
+void FramePacer::EndFrame()
+{
+	// The snapshot took the input time, input from here on belongs to the next frame
+	m_inputTime = 0;
+	if (m_targetTicks == 0)
+		return;
+
+	// Sleep for the bulk of the remaining time, then spin the last couple of milliseconds
+	// since SDL_Delay is only accurate to the scheduler tick.
+	uint64_t deadline = m_frameStart + m_targetTicks;
+	uint64_t spinTicks = SDL_GetPerformanceFrequency() / 500;
+	uint64_t now = Now();
+	while (now + spinTicks < deadline)
+	{
+		SDL_Delay(1);
+		now = Now();
+	}
+	while (now < deadline)
+		now = Now();
+}
+
+FrameStats FramePacer::Stats() const
+{
+	FrameStats stats;
+	stats.frames = m_frames;
+	stats.frameMsAvg = m_frameTimes.Average();
+	stats.frameMsMin = m_frameTimes.Min();
+	stats.frameMsMax = m_frameTimes.Max();
+	stats.frameMsP99 = m_frameTimes.Percentile(99.0);
+	stats.fps = stats.frameMsAvg > 0.0 ? 1000.0 / stats.frameMsAvg : 0.0;
+	stats.jitterMs = m_frameDeltas.Average();
+	stats.latencyMsAvg = m_latency.Average();
+	stats.latencyMsMax = m_latency.Max();
+	stats.updatesLastFrame = m_updatesLastFrame;
+
+	return stats;
+}
+
+uint64_t FramePacer::Now()
+{
+	return SDL_GetPerformanceCounter();
+}
+
+double FramePacer::ToSeconds(uint64_t ticks)
+{
+	return (double)ticks / (double)SDL_GetPerformanceFrequency();
+}
+
+double FramePacer::ToMilliseconds(uint64_t ticks)
+{
+	return ToSeconds(ticks) * 1000.0;
+}
+
+void FramePacer::SpinFor(double milliseconds)
+{
+	uint64_t deadline = Now() + (uint64_t)(milliseconds / 1000.0 * SDL_GetPerformanceFrequency());
+	while (Now() < deadline)
+	{
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Fixed size ring of timing samples (milliseconds) with simple statistics.
+class SampleWindow
+{
+public:
+	SampleWindow() : SampleWindow(240) {}
+	explicit SampleWindow(size_t capacity);
+
+	void Push(double value);
+	void Clear();
+
+	size_t Count() const { return m_count; }
+	double Last() const;
+	double Min() const;
+	double Max() const;
+	double Average() const;
+	double StdDev() const;
+	double Percentile(double p) const;
+
+	// Copies the samples oldest first, for graphs
+	void CopyOrdered(std::vector<float>& out) const;
+
+private:
+	std::vector<double> m_samples;
+	size_t m_head = 0;
+	size_t m_count = 0;
+};
+
+struct FrameStats
+{
+	uint64_t frames = 0;
+	double fps = 0.0;
+	double frameMsAvg = 0.0;
+	double frameMsMin = 0.0;
+	double frameMsMax = 0.0;
+	double frameMsP99 = 0.0;
+	double jitterMs = 0.0;		// mean absolute change in frame time between frames
+	double latencyMsAvg = 0.0;	// input polled -> swap returned
+	double latencyMsMax = 0.0;
+	uint32_t updatesLastFrame = 0;
+};
+
+// Drives the main loop timing: high resolution clock, fixed timestep accumulator,
+// optional frame cap and frame time / latency statistics.
+class FramePacer
+{
+public:
+	void Init(double updateHz, int32_t frameCap);
+
+	// Samples the clock and returns how many fixed updates should run this frame
+	uint32_t BeginFrame();
+
+	// Records that input was seen; the first call until EndFrame wins, so polling before
+	// BeginFrame counts for the frame about to be built
+	void MarkInput();
+
+	// Call at the end of the frame, after the snapshot took InputTime; sleeps to honour the frame cap
+	void EndFrame();
+
+	// Forget accumulated time, eg. after waking from idle
+	void Resync();
+
+	double FixedDelta() const { return m_fixedDelta; }
+	double DeltaTime() const { return m_deltaTime; }
+	// Fraction of a fixed step left in the accumulator, for render interpolation
+	double Alpha() const { return m_accumulator / m_fixedDelta; }
+	uint64_t FrameStart() const { return m_frameStart; }
+	uint64_t InputTime() const { return m_inputTime; }
+	uint64_t Frames() const { return m_frames; }
+
+	void SetFrameCap(int32_t frameCap);
+	void RecordLatency(uint64_t inputTime, uint64_t presentTime);
+
+	FrameStats Stats() const;
+	const SampleWindow& FrameTimes() const { return m_frameTimes; }
+
+	static uint64_t Now();
+	static double ToSeconds(uint64_t ticks);
+	static double ToMilliseconds(uint64_t ticks);
+	// Busy waits, used to fake CPU load in benchmarks
+	static void SpinFor(double milliseconds);
+
+private:
+	static constexpr double MaxFrameTime = 0.25;
+	static constexpr uint32_t MaxUpdatesPerFrame = 8;
+
+	double m_fixedDelta = 1.0 / 60.0;
+	double m_accumulator = 0.0;
+	double m_deltaTime = 0.0;
+	uint64_t m_targetTicks = 0;
+
+	uint64_t m_lastFrame = 0;
+	uint64_t m_frameStart = 0;
+	uint64_t m_inputTime = 0;
+	uint64_t m_frames = 0;
+	uint32_t m_updatesLastFrame = 0;
+
+	double m_lastFrameMs = 0.0;
+	SampleWindow m_frameTimes;
+	SampleWindow m_frameDeltas;
+	SampleWindow m_latency;
+};
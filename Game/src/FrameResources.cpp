@@ -0,0 +1,124 @@
+#include "FrameResources.h"
+
+#include <algorithm>
+
+#include "FramePacer.h"
+#include "Log.h"
+#include "MemoryTracker.h"
+
+static size_t AlignUp(size_t value, size_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+void FrameResources::Init(uint32_t framesInFlight, size_t bytesPerFrame)
+{
+	m_framesInFlight = std::clamp(framesInFlight, 1u, MaxFramesInFlight);
+
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	m_uniformAlignment = std::max<size_t>(alignment, 16);
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	m_storageAlignment = std::max<size_t>(alignment, 16);
+
+	m_bytesPerFrame = AlignUp(bytesPerFrame, std::max(m_uniformAlignment, m_storageAlignment));
+	CreateBuffer();
+
+	// Start on the last slice so the first BeginFrame lands on slice 0
+	m_current = m_framesInFlight - 1;
+}
+
+void FrameResources::Shutdown()
+{
+	for (uint32_t i = 0; i < m_framesInFlight; i++)
+		WaitFor(m_fences[i]);
+
+	DestroyBuffer();
+}
+
+void FrameResources::CreateBuffer()
+{
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	size_t total = m_bytesPerFrame * m_framesInFlight;
+
+	glCreateBuffers(1, &m_buffer);
+	glNamedBufferStorage(m_buffer, total, nullptr, flags);
+	m_mapped = (uint8_t*)glMapNamedBufferRange(m_buffer, 0, total, flags);
+	MemoryTracker::TrackGpu(GpuResource::Buffer, m_buffer, total, MemoryTag::Render, "frame resources");
+	if (!m_mapped)
+		LOG_ERROR("Could not map frame resource buffer (" << total << " bytes)");
+}
+
+void FrameResources::DestroyBuffer()
+{
+	if (!m_buffer)
+		return;
+
+	glUnmapNamedBuffer(m_buffer);
+	MemoryTracker::UntrackGpu(GpuResource::Buffer, m_buffer);
+	glDeleteBuffers(1, &m_buffer);
+	m_buffer = 0;
+	m_mapped = nullptr;
+}
+
+void FrameResources::Reserve(size_t bytesPerFrame)
+{
+	if (bytesPerFrame <= m_bytesPerFrame)
+		return;
+
+	// Every slice may still be read by the GPU
+	for (uint32_t i = 0; i < m_framesInFlight; i++)
+		WaitFor(m_fences[i]);
+
+	DestroyBuffer();
+	m_bytesPerFrame = AlignUp(std::max(bytesPerFrame, m_bytesPerFrame * 2), std::max(m_uniformAlignment, m_storageAlignment));
+	CreateBuffer();
+}
+
+double FrameResources::WaitFor(GLsync& fence)
+{
+	if (!fence)
+		return 0.0;
+
+	uint64_t start = FramePacer::Now();
+	while (true)
+	{
+		GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		if (result != GL_TIMEOUT_EXPIRED)
+			break;
+	}
+	glDeleteSync(fence);
+	fence = nullptr;
+
+	return FramePacer::ToMilliseconds(FramePacer::Now() - start);
+}
+
+double FrameResources::BeginFrame()
+{
+	m_current = (m_current + 1) % m_framesInFlight;
+	m_offset = 0;
+	m_lastWaitMs = WaitFor(m_fences[m_current]);
+	return m_lastWaitMs;
+}
+
+void FrameResources::EndFrame()
+{
+	m_fences[m_current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+FrameAllocation FrameResources::Allocate(size_t size, size_t alignment)
+{
+	FrameAllocation allocation;
+
+	size_t offset = AlignUp(m_offset, alignment);
+	if (!m_mapped || offset + size > m_bytesPerFrame)
+		return allocation;
+
+	m_offset = offset + size;
+
+	allocation.buffer = m_buffer;
+	allocation.offset = m_bytesPerFrame * m_current + offset;
+	allocation.data = m_mapped + allocation.offset;
+	allocation.size = size;
+	return allocation;
+}
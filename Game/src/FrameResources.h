@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <GL/glew.h>
+
+struct FrameAllocation
+{
+	void* data = nullptr;
+	uint32_t buffer = 0;
+	size_t offset = 0;
+	size_t size = 0;
+};
+
+// Keeps several frames in flight on the GPU. Each frame owns a slice of one persistently
+// mapped buffer that is handed out linearly for uniforms, per draw data and staging;
+// a slice is only reused once the fence placed at the end of its frame has signalled.
+class FrameResources
+{
+public:
+	static constexpr uint32_t MaxFramesInFlight = 3;
+
+	void Init(uint32_t framesInFlight, size_t bytesPerFrame);
+	void Shutdown();
+
+	// Grows every slice to at least bytesPerFrame. Drains the GPU when it has to reallocate.
+	void Reserve(size_t bytesPerFrame);
+
+	// Moves to the next slice, blocking until the GPU is done with it.
+	// Returns the milliseconds spent waiting.
+	double BeginFrame();
+	// Fences everything submitted since BeginFrame
+	void EndFrame();
+
+	// Returns an empty allocation when the slice is exhausted; Reserve up front
+	FrameAllocation Allocate(size_t size, size_t alignment);
+
+	uint32_t FramesInFlight() const { return m_framesInFlight; }
+	uint32_t FrameIndex() const { return m_current; }
+	size_t BytesPerFrame() const { return m_bytesPerFrame; }
+	size_t BytesUsed() const { return m_offset; }
+	double LastWaitMs() const { return m_lastWaitMs; }
+
+	size_t UniformAlignment() const { return m_uniformAlignment; }
+	size_t StorageAlignment() const { return m_storageAlignment; }
+
+private:
+	void CreateBuffer();
+	void DestroyBuffer();
+	static double WaitFor(GLsync& fence);
+
+	uint32_t m_framesInFlight = 2;
+	uint32_t m_current = 0;
+	GLsync m_fences[MaxFramesInFlight] = {};
+
+	uint32_t m_buffer = 0;
+	uint8_t* m_mapped = nullptr;
+	size_t m_bytesPerFrame = 0;
+	size_t m_offset = 0;
+
+	size_t m_uniformAlignment = 256;
+	size_t m_storageAlignment = 256;
+	double m_lastWaitMs = 0.0;
+};
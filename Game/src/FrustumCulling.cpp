@@ -0,0 +1,155 @@
+#include "FrustumCulling.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "FrameArena.h"
+#include "FramePacer.h"
+#include "Profiler.h"
+
+// Padding boxes sit here so they fail every plane
+static constexpr float FarAway = 1e18f;
+
+void BoundsSoA::Resize(uint32_t boxes)
+{
+	count = boxes;
+	uint32_t padded = (boxes + 7) & ~7u;
+	for (std::vector<float>* component : { &centerX, &centerY, &centerZ })
+		component->assign(padded, FarAway);
+	for (std::vector<float>* component : { &extentX, &extentY, &extentZ })
+		component->assign(padded, 0.0f);
+}
+
+void BoundsSoA::Set(uint32_t index, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	// Meshes without vertices keep the far away padding
+	if (boundsMin.x > boundsMax.x)
+		return;
+
+	glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+	centerX[index] = center.x;
+	centerY[index] = center.y;
+	centerZ[index] = center.z;
+	extentX[index] = extent.x;
+	extentY[index] = extent.y;
+	extentZ[index] = extent.z;
+}
+
+void FrustumCuller::SetFrustum(const glm::mat4& viewProjection)
+{
+	// Gribb/Hartmann: rows of the matrix added to and subtracted from the w row
+	glm::mat4 m = glm::transpose(viewProjection);
+	m_planes[0] = m[3] + m[0];
+	m_planes[1] = m[3] - m[0];
+	m_planes[2] = m[3] + m[1];
+	m_planes[3] = m[3] - m[1];
+	m_planes[4] = m[3] + m[2];
+	m_planes[5] = m[3] - m[2];
+	for (glm::vec4& plane : m_planes)
+		plane /= glm::length(glm::vec3(plane));
+}
+
+#ifdef __AVX2__
+
+uint32_t FrustumCuller::CullRange(const BoundsSoA& bounds, uint32_t begin, uint32_t end, uint32_t* out) const
+{
+	__m256 planeX[6], planeY[6], planeZ[6], planeW[6], absX[6], absY[6], absZ[6];
+	for (uint32_t p = 0; p < 6; p++)
+	{
+		planeX[p] = _mm256_set1_ps(m_planes[p].x);
+		planeY[p] = _mm256_set1_ps(m_planes[p].y);
+		planeZ[p] = _mm256_set1_ps(m_planes[p].z);
+		planeW[p] = _mm256_set1_ps(m_planes[p].w);
+		absX[p] = _mm256_set1_ps(std::abs(m_planes[p].x));
+		absY[p] = _mm256_set1_ps(std::abs(m_planes[p].y));
+		absZ[p] = _mm256_set1_ps(std::abs(m_planes[p].z));
+	}
+
+	// Padding lanes past the end are far away and never written
+	uint32_t written = 0;
+	for (uint32_t i = begin; i < end; i += 8)
+	{
+		__m256 cx = _mm256_loadu_ps(&bounds.centerX[i]);
+		__m256 cy = _mm256_loadu_ps(&bounds.centerY[i]);
+		__m256 cz = _mm256_loadu_ps(&bounds.centerZ[i]);
+		__m256 ex = _mm256_loadu_ps(&bounds.extentX[i]);
+		__m256 ey = _mm256_loadu_ps(&bounds.extentY[i]);
+		__m256 ez = _mm256_loadu_ps(&bounds.extentZ[i]);
+
+		// Outside a plane when even the corner nearest to it is behind: distance + projected extent < 0
+		__m256 outside = _mm256_setzero_ps();
+		for (uint32_t p = 0; p < 6; p++)
+		{
+			__m256 distance = _mm256_fmadd_ps(cx, planeX[p], _mm256_fmadd_ps(cy, planeY[p], _mm256_fmadd_ps(cz, planeZ[p], planeW[p])));
+			__m256 radius = _mm256_fmadd_ps(ex, absX[p], _mm256_fmadd_ps(ey, absY[p], _mm256_mul_ps(ez, absZ[p])));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+		}
+
+		uint32_t mask = ~(uint32_t)_mm256_movemask_ps(outside) & 0xFF;
+		for (uint32_t lane = i; mask; lane++, mask >>= 1)
+		{
+			if ((mask & 1) && lane < end)
+				out[written++] = lane;
+		}
+	}
+	return written;
+}
+
+#else
+
+uint32_t FrustumCuller::CullRange(const BoundsSoA& bounds, uint32_t begin, uint32_t end, uint32_t* out) const
+{
+	uint32_t written = 0;
+	for (uint32_t i = begin; i < end; i++)
+	{
+		bool inside = true;
+		for (uint32_t p = 0; p < 6 && inside; p++)
+		{
+			const glm::vec4& plane = m_planes[p];
+			float distance = bounds.centerX[i] * plane.x + bounds.centerY[i] * plane.y + bounds.centerZ[i] * plane.z + plane.w;
+			float radius = bounds.extentX[i] * std::abs(plane.x) + bounds.extentY[i] * std::abs(plane.y) + bounds.extentZ[i] * std::abs(plane.z);
+			inside = distance + radius >= 0.0f;
+		}
+		if (inside)
+			out[written++] = i;
+	}
+	return written;
+}
+
+#endif
+
+void FrustumCuller::Cull(const BoundsSoA& bounds, JobSystem& jobs, std::vector<uint32_t>& visible)
+{
+	PROFILE_ZONE("Frustum cull");
+	uint64_t start = FramePacer::Now();
+
+	// Per chunk results are compacted into visible below and gone when this returns
+	FrameArena& arena = FrameArena::Local();
+	ArenaScope scope(arena);
+	uint32_t chunks = (bounds.count + ChunkSize - 1) / ChunkSize;
+	uint32_t* scratch = static_cast<uint32_t*>(arena.Allocate(bounds.count * sizeof(uint32_t)));
+	uint32_t* chunkCounts = static_cast<uint32_t*>(arena.Allocate(chunks * sizeof(uint32_t)));
+	jobs.ParallelFor(bounds.count, ChunkSize, [&](uint32_t begin, uint32_t end)
+	{
+		chunkCounts[begin / ChunkSize] = CullRange(bounds, begin, end, scratch + begin);
+	});
+
+	visible.resize(bounds.count);
+	uint32_t written = 0;
+	for (uint32_t chunk = 0; chunk < chunks; chunk++)
+	{
+		std::memcpy(visible.data() + written, scratch + chunk * ChunkSize, chunkCounts[chunk] * sizeof(uint32_t));
+		written += chunkCounts[chunk];
+	}
+	visible.resize(written);
+
+	m_stats.tested = bounds.count;
+	m_stats.visible = written;
+	m_stats.ms = FramePacer::ToMilliseconds(FramePacer::Now() - start);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "JobSystem.h"
+
+// World space boxes as center and half extent, one array per component.
+// Arrays are padded to a multiple of eight with empty boxes far away.
+struct BoundsSoA
+{
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+	uint32_t count = 0;
+
+	void Resize(uint32_t boxes);
+	void Set(uint32_t index, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+};
+
+struct FrustumStats
+{
+	uint32_t tested = 0;
+	uint32_t visible = 0;
+	double ms = 0.0;
+};
+
+// Box versus the six frustum planes, eight boxes per AVX2 iteration. Large inputs are
+// split into chunks on the job system; every chunk compacts its hits into its own range
+// of a scratch list, and the ranges are joined in order.
+class FrustumCuller
+{
+public:
+	static constexpr uint32_t ChunkSize = 8192;	// boxes per job, a multiple of 8
+
+	// Planes from a projection * view matrix, normalized, facing inward
+	void SetFrustum(const glm::mat4& viewProjection);
+
+	// Indices of the boxes touching the frustum, in ascending order
+	void Cull(const BoundsSoA& bounds, JobSystem& jobs, std::vector<uint32_t>& visible);
+
+	const FrustumStats& Stats() const { return m_stats; }
+
+	// Writes the visible indices of boxes [begin, end) and returns how many; begin is a multiple of 8
+	uint32_t CullRange(const BoundsSoA& bounds, uint32_t begin, uint32_t end, uint32_t* out) const;
+
+private:
+	glm::vec4 m_planes[6] = {};
+	FrustumStats m_stats;
+};
@@ -0,0 +1,214 @@
+#include "GpuProfiler.h"
+
+#include <cstring>
+
+#include "Log.h"
+#include "Profiler.h"
+
+uint64_t GpuProfiler::CpuNowNs()
+{
+	return Profiler::NowNs();
+}
+
+void GpuProfiler::Init(bool enabled)
+{
+	m_enabled = enabled && GLEW_ARB_timer_query;
+	if (enabled && !m_enabled)
+		LOG_WARN("GPU profiler disabled: timer queries not supported");
+
+	if (m_enabled)
+	{
+		GLint bits = 0;
+		glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+		if (bits == 0)
+		{
+			LOG_WARN("GPU profiler disabled: GL_TIMESTAMP has no counter bits");
+			m_enabled = false;
+		}
+	}
+
+	if (!m_enabled)
+		return;
+
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	m_cpuMeasured = renderer && (std::strstr(renderer, "llvmpipe") || std::strstr(renderer, "softpipe") || std::strstr(renderer, "SWR"));
+	if (m_cpuMeasured)
+		LOG_INFO("GPU profiler: " << renderer << " timestamps are CPU measured");
+
+	for (Frame& frame : m_ring)
+		glGenQueries(MaxScopesPerFrame * 2, frame.queries);
+
+	m_averages.reserve(MaxScopesPerFrame);
+	m_window.reserve(MaxScopesPerFrame);
+	m_lastFrameEvents.reserve(MaxScopesPerFrame);
+	Calibrate();
+}
+
+void GpuProfiler::Shutdown()
+{
+	if (!m_enabled)
+		return;
+
+	for (Frame& frame : m_ring)
+		glDeleteQueries(MaxScopesPerFrame * 2, frame.queries);
+	m_enabled = false;
+}
+
+void GpuProfiler::Calibrate()
+{
+	// Sample both clocks back to back; the error is the driver round trip, well under a scope
+	GLint64 gpuNow = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+	m_gpuOffset = (int64_t)gpuNow - (int64_t)CpuNowNs();
+}
+
+uint32_t GpuProfiler::Timestamp()
+{
+	Frame& frame = m_ring[m_current];
+	uint32_t index = frame.queryCount++;
+	glQueryCounter(frame.queries[index], GL_TIMESTAMP);
+	return index;
+}
+
+bool GpuProfiler::BeginFrame()
+{
+	if (!m_enabled)
+		return false;
+
+	m_current = (uint32_t)(m_frames % FrameLatency);
+	m_frames++;
+
+	Frame& frame = m_ring[m_current];
+	bool resolved = false;
+	if (frame.pending)
+	{
+		// Queries finish in order, so the last one being ready means all are
+		GLint available = 0;
+		glGetQueryObjectiv(frame.queries[frame.queryCount - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+		{
+			Resolve(frame);
+			resolved = true;
+		}
+		else
+		{
+			m_droppedFrames++;
+		}
+	}
+
+	if (m_frames % 300 == 0)
+		Calibrate();
+
+	frame.scopeCount = 0;
+	frame.queryCount = 0;
+	frame.pending = false;
+	m_stackDepth = 0;
+
+	return resolved;
+}
+
+void GpuProfiler::EndFrame()
+{
+	if (!m_enabled)
+		return;
+
+	while (m_stackDepth > 0)
+		End();
+
+	Frame& frame = m_ring[m_current];
+	frame.pending = frame.queryCount > 0;
+}
+
+double GpuProfiler::LastFrameMs() const
+{
+	uint64_t totalNs = 0;
+	for (const GpuEvent& event : m_lastFrameEvents)
+	{
+		if (event.depth == 0)
+			totalNs += event.endNs - event.startNs;
+	}
+	return totalNs / 1e6;
+}
+
+void GpuProfiler::Begin(const char* name)
+{
+	if (!m_enabled)
+		return;
+
+	Frame& frame = m_ring[m_current];
+	if (frame.scopeCount == MaxScopesPerFrame)
+	{
+		// Keep Begin/End balanced even when out of queries
+		m_stack[m_stackDepth++] = NoScope;
+		return;
+	}
+
+	uint32_t index = frame.scopeCount++;
+	Scope& scope = frame.scopes[index];
+	scope.name = name;
+	scope.depth = m_stackDepth;
+	scope.beginQuery = Timestamp();
+	scope.endQuery = scope.beginQuery;
+	m_stack[m_stackDepth++] = index;
+}
+
+void GpuProfiler::End()
+{
+	if (!m_enabled || m_stackDepth == 0)
+		return;
+
+	uint32_t index = m_stack[--m_stackDepth];
+	if (index != NoScope)
+		m_ring[m_current].scopes[index].endQuery = Timestamp();
+}
+
+void GpuProfiler::Resolve(Frame& frame)
+{
+	m_lastFrameEvents.clear();
+	for (uint32_t i = 0; i < frame.scopeCount; i++)
+	{
+		const Scope& scope = frame.scopes[i];
+		GLuint64 begin = 0,
+				 end = 0;
+		glGetQueryObjectui64v(frame.queries[scope.beginQuery], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(frame.queries[scope.endQuery], GL_QUERY_RESULT, &end);
+		if (end < begin)
+			end = begin;
+
+		GpuEvent event;
+		event.name = scope.name;
+		event.depth = scope.depth;
+		event.startNs = (uint64_t)((int64_t)begin - m_gpuOffset);
+		event.endNs = (uint64_t)((int64_t)end - m_gpuOffset);
+		m_lastFrameEvents.push_back(event);
+
+		Accumulator* accumulator = nullptr;
+		for (Accumulator& entry : m_window)
+		{
+			if (entry.name == scope.name && entry.depth == scope.depth)
+			{
+				accumulator = &entry;
+				break;
+			}
+		}
+		if (!accumulator)
+		{
+			if (m_window.size() == MaxScopesPerFrame)
+				continue;
+			m_window.push_back({ scope.name, scope.depth, 0 });
+			accumulator = &m_window.back();
+		}
+		accumulator->totalNs += end - begin;
+	}
+
+	if (++m_windowFrames < WindowFrames)
+		return;
+
+	m_averages.clear();
+	for (Accumulator& entry : m_window)
+	{
+		m_averages.push_back({ entry.name, entry.depth, entry.totalNs / 1e6 / m_windowFrames });
+		entry.totalNs = 0;
+	}
+	m_windowFrames = 0;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <GL/glew.h>
+
+// One resolved scope on the CPU timeline (nanoseconds since the profiler's epoch)
+struct GpuEvent
+{
+	const char* name;
+	uint32_t depth;
+	uint64_t startNs;
+	uint64_t endNs;
+};
+
+// Scope duration averaged over the last window of resolved frames
+struct GpuScopeAverage
+{
+	const char* name;
+	uint32_t depth;
+	double ms;
+};
+
+// Nested GPU timing with GL_TIMESTAMP queries. Queries go into a ring several frames
+// deep and are only read once available, so reading back never stalls the pipeline.
+// Scope names must be string literals; they are compared by pointer.
+// Must be used from the thread that owns the GL context.
+class GpuProfiler
+{
+public:
+	static constexpr uint32_t FrameLatency = 5;
+	static constexpr uint32_t MaxScopesPerFrame = 128;
+	static constexpr uint32_t WindowFrames = 30;
+
+	void Init(bool enabled);
+	void Shutdown();
+
+	// Resolves the oldest frame in the ring (if its queries are ready) and starts a new one.
+	// Returns true when LastFrameEvents() changed.
+	bool BeginFrame();
+	void EndFrame();
+
+	void Begin(const char* name);
+	void End();
+
+	bool Enabled() const { return m_enabled; }
+	// Software rasterizers (llvmpipe) timestamp on the CPU when commands execute,
+	// so results are a coarse estimate of where the CPU spent rasterizing
+	bool CpuMeasured() const { return m_cpuMeasured; }
+	uint32_t DroppedFrames() const { return m_droppedFrames; }
+
+	const std::vector<GpuScopeAverage>& Averages() const { return m_averages; }
+	// Events of the most recently resolved frame, mapped onto the CPU clock
+	const std::vector<GpuEvent>& LastFrameEvents() const { return m_lastFrameEvents; }
+	// Sum of the top level scopes of that frame
+	double LastFrameMs() const;
+
+	// The CPU clock the events are expressed in, shared with the CPU profiler
+	static uint64_t CpuNowNs();
+
+private:
+	struct Scope
+	{
+		const char* name;
+		uint32_t depth;
+		uint32_t beginQuery;
+		uint32_t endQuery;
+	};
+
+	struct Frame
+	{
+		uint32_t queries[MaxScopesPerFrame * 2] = {};
+		Scope scopes[MaxScopesPerFrame];
+		uint32_t scopeCount = 0;
+		uint32_t queryCount = 0;
+		bool pending = false;
+	};
+
+	struct Accumulator
+	{
+		const char* name;
+		uint32_t depth;
+		uint64_t totalNs;
+	};
+
+	static constexpr uint32_t NoScope = ~0u;
+
+	void Calibrate();
+	void Resolve(Frame& frame);
+	uint32_t Timestamp();
+
+	bool m_enabled = false;
+	bool m_cpuMeasured = false;
+	uint32_t m_current = 0;
+	uint32_t m_droppedFrames = 0;
+	uint64_t m_frames = 0;
+	Frame m_ring[FrameLatency];
+
+	uint32_t m_stack[MaxScopesPerFrame] = {};
+	uint32_t m_stackDepth = 0;
+
+	// gpuTime - m_gpuOffset lands on the CPU clock
+	int64_t m_gpuOffset = 0;
+
+	std::vector<Accumulator> m_window;
+	uint32_t m_windowFrames = 0;
+	std::vector<GpuScopeAverage> m_averages;
+	std::vector<GpuEvent> m_lastFrameEvents;
+};
+
+class GpuScope
+{
+public:
+	GpuScope(GpuProfiler& profiler, const char* name) : m_profiler(profiler) { m_profiler.Begin(name); }
+	~GpuScope() { m_profiler.End(); }
+
+private:
+	GpuProfiler& m_profiler;
+};
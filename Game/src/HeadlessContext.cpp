@@ -0,0 +1,259 @@
+#include "HeadlessContext.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include <GL/glew.h>
+
+#if defined(HEADLESS_EGL)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#elif defined(HEADLESS_OSMESA)
+// glew.h undefines GLAPI on its way out, osmesa.h still declares with it
+#define GLAPI extern
+#include <GL/osmesa.h>
+#endif
+
+#include "Log.h"
+#include "MemoryTracker.h"
+#include "Profiler.h"
+
+const char* HeadlessContext::Backend()
+{
+#if defined(HEADLESS_EGL)
+	return "EGL surfaceless";
+#elif defined(HEADLESS_OSMESA)
+	return "OSMesa";
+#else
+	return nullptr;
+#endif
+}
+
+#if defined(HEADLESS_EGL)
+
+bool HeadlessContext::Create(int32_t width, int32_t height)
+{
+	m_width = width;
+	m_height = height;
+
+	// The surfaceless platform needs no display server; plain eglGetDisplay is the fallback
+	EGLDisplay display = EGL_NO_DISPLAY;
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay)
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major = 0, minor = 0;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+	{
+		LOG_ERROR("Headless: no EGL display");
+		return false;
+	}
+	m_display = display;
+
+	const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+	if (!extensions || !std::strstr(extensions, "EGL_KHR_surfaceless_context"))
+	{
+		LOG_ERROR("Headless: EGL " << major << "." << minor << " without EGL_KHR_surfaceless_context");
+		return false;
+	}
+
+	if (!eglBindAPI(EGL_OPENGL_API))
+	{
+		LOG_ERROR("Headless: EGL has no desktop GL");
+		return false;
+	}
+
+	// No surface is ever made, so any surface type will do
+	const EGLint configAttributes[] = { EGL_SURFACE_TYPE, 0, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig config = nullptr;
+	EGLint configCount = 0;
+	if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0)
+	{
+		LOG_ERROR("Headless: no EGL config for desktop GL");
+		return false;
+	}
+
+	const EGLint contextAttributes[] =
+	{
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 5,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT)
+	{
+		LOG_ERROR("Headless: could not create a GL 4.5 core context (0x" << std::hex << eglGetError() << std::dec << ")");
+		return false;
+	}
+	m_context = context;
+
+	return MakeCurrent();
+}
+
+void HeadlessContext::Destroy()
+{
+	DestroyTarget();
+	if (m_display)
+	{
+		eglMakeCurrent((EGLDisplay)m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (m_context)
+			eglDestroyContext((EGLDisplay)m_display, (EGLContext)m_context);
+		eglTerminate((EGLDisplay)m_display);
+	}
+	m_display = nullptr;
+	m_context = nullptr;
+}
+
+bool HeadlessContext::MakeCurrent()
+{
+	return eglMakeCurrent((EGLDisplay)m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, (EGLContext)m_context) == EGL_TRUE;
+}
+
+void HeadlessContext::Release()
+{
+	eglMakeCurrent((EGLDisplay)m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+}
+
+#elif defined(HEADLESS_OSMESA)
+
+bool HeadlessContext::Create(int32_t width, int32_t height)
+{
+	m_width = width;
+	m_height = height;
+
+	const int attributes[] =
+	{
+		OSMESA_FORMAT, OSMESA_RGBA,
+		OSMESA_DEPTH_BITS, 24,
+		OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+		OSMESA_CONTEXT_MAJOR_VERSION, 4,
+		OSMESA_CONTEXT_MINOR_VERSION, 5,
+		0
+	};
+	OSMesaContext context = OSMesaCreateContextAttribs(attributes, nullptr);
+	if (!context)
+	{
+		LOG_ERROR("Headless: could not create a GL 4.5 core OSMesa context");
+		return false;
+	}
+	m_context = context;
+	m_osmesaBuffer.resize((size_t)width * height * 4);
+
+	return MakeCurrent();
+}
+
+void HeadlessContext::Destroy()
+{
+	DestroyTarget();
+	if (m_context)
+		OSMesaDestroyContext((OSMesaContext)m_context);
+	m_context = nullptr;
+	m_osmesaBuffer.clear();
+}
+
+bool HeadlessContext::MakeCurrent()
+{
+	return OSMesaMakeCurrent((OSMesaContext)m_context, m_osmesaBuffer.data(), GL_UNSIGNED_BYTE, m_width, m_height) == GL_TRUE;
+}
+
+void HeadlessContext::Release()
+{
+	OSMesaMakeCurrent(nullptr, nullptr, 0, 0, 0);
+}
+
+#else
+
+bool HeadlessContext::Create(int32_t, int32_t)
+{
+	LOG_ERROR("Headless: built without HEADLESS_EGL or HEADLESS_OSMESA");
+	return false;
+}
+
+void HeadlessContext::Destroy() {}
+bool HeadlessContext::MakeCurrent() { return false; }
+void HeadlessContext::Release() {}
+
+#endif
+
+bool HeadlessContext::CreateTarget()
+{
+	glCreateRenderbuffers(1, &m_color);
+	glNamedRenderbufferStorage(m_color, GL_RGBA8, m_width, m_height);
+	glCreateRenderbuffers(1, &m_depth);
+	glNamedRenderbufferStorage(m_depth, GL_DEPTH24_STENCIL8, m_width, m_height);
+	MemoryTracker::TrackGpu(GpuResource::Renderbuffer, m_color, (size_t)m_width * m_height * 4, MemoryTag::Render, "headless color");
+	MemoryTracker::TrackGpu(GpuResource::Renderbuffer, m_depth, (size_t)m_width * m_height * 4, MemoryTag::Render, "headless depth");
+
+	glCreateFramebuffers(1, &m_framebuffer);
+	glNamedFramebufferRenderbuffer(m_framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_color);
+	glNamedFramebufferRenderbuffer(m_framebuffer, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_depth);
+	if (glCheckNamedFramebufferStatus(m_framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		LOG_ERROR("Headless: target framebuffer is incomplete");
+		return false;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	return true;
+}
+
+void HeadlessContext::DestroyTarget()
+{
+	if (m_framebuffer)
+		glDeleteFramebuffers(1, &m_framebuffer);
+	if (m_color)
+	{
+		MemoryTracker::UntrackGpu(GpuResource::Renderbuffer, m_color);
+		glDeleteRenderbuffers(1, &m_color);
+	}
+	if (m_depth)
+	{
+		MemoryTracker::UntrackGpu(GpuResource::Renderbuffer, m_depth);
+		glDeleteRenderbuffers(1, &m_depth);
+	}
+	m_framebuffer = 0;
+	m_color = 0;
+	m_depth = 0;
+}
+
+bool HeadlessContext::WriteFrame(uint64_t frame)
+{
+	PROFILE_ZONE("Write frame");
+	if (m_captureDirectory.empty() || !m_framebuffer)
+		return false;
+
+	size_t rowBytes = (size_t)m_width * 3;
+	m_pixels.resize(rowBytes * m_height);
+	m_row.resize(rowBytes);
+	glNamedFramebufferReadBuffer(m_framebuffer, GL_COLOR_ATTACHMENT0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, m_width, m_height, GL_RGB, GL_UNSIGNED_BYTE, m_pixels.data());
+
+	// GL rows go bottom up, PPM rows top down
+	for (int32_t y = 0; y < m_height / 2; y++)
+	{
+		uint8_t* top = m_pixels.data() + rowBytes * y;
+		uint8_t* bottom = m_pixels.data() + rowBytes * (m_height - 1 - y);
+		std::memcpy(m_row.data(), top, rowBytes);
+		std::memcpy(top, bottom, rowBytes);
+		std::memcpy(bottom, m_row.data(), rowBytes);
+	}
+
+	char name[64];
+	std::snprintf(name, sizeof(name), "/frame_%05llu.ppm", (unsigned long long)frame);
+	std::string path = m_captureDirectory + name;
+	FILE* file = std::fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		LOG_ERROR("Headless: could not write " << path);
+		return false;
+	}
+	std::fprintf(file, "P6\n%d %d\n255\n", m_width, m_height);
+	std::fwrite(m_pixels.data(), 1, m_pixels.size(), file);
+	std::fclose(file);
+	return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// GL 4.5 core context without a window or display, for build and test machines without
+// a GPU or X server. Built with HEADLESS_EGL it uses EGL's surfaceless platform (Mesa's
+// llvmpipe, or a GPU driver when there is one); with HEADLESS_OSMESA it uses OSMesa.
+// There is no default framebuffer, so frames are drawn into an FBO the size of the screen.
+class HeadlessContext
+{
+public:
+	// Name of the compiled in backend, or null when headless mode is not available
+	static const char* Backend();
+
+	// Creates the context and makes it current on the calling thread
+	bool Create(int32_t width, int32_t height);
+	void Destroy();
+
+	// The context moves to the render thread like a window's context does
+	bool MakeCurrent();
+	void Release();
+
+	// Needs the context current and GL loaded
+	bool CreateTarget();
+	uint32_t Framebuffer() const { return m_framebuffer; }
+
+	// Frames are written as <directory>/frame_<number>.ppm
+	void SetCaptureDirectory(const std::string& directory) { m_captureDirectory = directory; }
+	// Reads the target back and writes it; render thread only
+	bool WriteFrame(uint64_t frame);
+
+private:
+	void DestroyTarget();
+
+	int32_t m_width = 0;
+	int32_t m_height = 0;
+
+	void* m_display = nullptr;
+	void* m_context = nullptr;
+	std::vector<uint8_t> m_osmesaBuffer;	// OSMesa's own color buffer, unused by the frame loop
+
+	uint32_t m_framebuffer = 0;
+	uint32_t m_color = 0;
+	uint32_t m_depth = 0;
+
+	std::string m_captureDirectory;
+	std::vector<uint8_t> m_pixels;
+	std::vector<uint8_t> m_row;
+};
@@ -0,0 +1,136 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <string>
+
+#include "FrameArena.h"
+#include "Profiler.h"
+
+JobSystem::~JobSystem()
+{
+	Shutdown();
+}
+
+uint32_t JobSystem::DefaultWorkerCount()
+{
+	return std::max(1u, std::thread::hardware_concurrency()) - 1;
+}
+
+void JobSystem::Init(uint32_t workerCount)
+{
+	Shutdown();
+
+	m_stop = false;
+	m_workers.reserve(workerCount);
+	for (uint32_t i = 0; i < workerCount; i++)
+		m_workers.emplace_back(&JobSystem::WorkerMain, this, i);
+}
+
+void JobSystem::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+
+	for (std::thread& worker : m_workers)
+		worker.join();
+	m_workers.clear();
+}
+
+uint32_t JobSystem::PendingJobs()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_queued;
+}
+
+void JobSystem::Execute(Job& job)
+{
+	while (true)
+	{
+		uint32_t begin = job.next.fetch_add(job.chunkSize, std::memory_order_relaxed);
+		if (begin >= job.count)
+			return;
+
+		PROFILE_ZONE("Job chunk");
+		uint32_t end = std::min(begin + job.chunkSize, job.count);
+		job.invoke(job.context, begin, end);
+		job.done.fetch_add(end - begin, std::memory_order_release);
+	}
+}
+
+void JobSystem::Remove(Job& job)
+{
+	for (uint32_t i = 0; i < m_queued; i++)
+	{
+		if (m_queue[i] == &job)
+		{
+			std::copy(m_queue + i + 1, m_queue + m_queued, m_queue + i);
+			m_queued--;
+			return;
+		}
+	}
+}
+
+void JobSystem::Run(Job& job)
+{
+	// Only worth waking anyone if there is more than one chunk
+	bool shared = !m_workers.empty() && job.count > job.chunkSize;
+	if (shared)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_queued < MaxQueuedJobs)
+		{
+			m_queue[m_queued++] = &job;
+			lock.unlock();
+			m_wake.notify_all();
+		}
+		else
+		{
+			shared = false;
+		}
+	}
+
+	Execute(job);
+
+	if (!shared)
+		return;
+
+	// Every chunk is claimed; take the job off the queue so no new worker picks it up,
+	// then wait for the ones still running a chunk.
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		Remove(job);
+	}
+	while (job.done.load(std::memory_order_acquire) < job.count || job.active.load(std::memory_order_acquire) != 0)
+		std::this_thread::yield();
+}
+
+void JobSystem::WorkerMain(uint32_t index)
+{
+	Profiler::SetThreadName(("Worker " + std::to_string(index)).c_str());
+
+	while (true)
+	{
+		Job* job = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this] { return m_stop || m_queued > 0; });
+			if (m_stop)
+				return;
+
+			job = m_queue[0];
+			job->active.fetch_add(1, std::memory_order_relaxed);
+			// Exhausted jobs are removed by their owner; drop it from the front so idle
+			// workers don't keep picking it up in the meantime
+			if (job->next.load(std::memory_order_relaxed) >= job->count)
+				Remove(*job);
+		}
+
+		Execute(*job);
+		job->active.fetch_sub(1, std::memory_order_release);
+		// Workers have no frames; what a job took from their arena ends with the job
+		FrameArena::Local().Reset();
+	}
+}
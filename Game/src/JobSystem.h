@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small worker pool for data parallel loops. The calling thread always helps, so a
+// pool with zero workers degrades to a plain loop.
+class JobSystem
+{
+public:
+	~JobSystem();
+
+	// One worker per hardware thread besides the caller
+	static uint32_t DefaultWorkerCount();
+
+	void Init(uint32_t workerCount);
+	void Shutdown();
+
+	uint32_t WorkerCount() const { return (uint32_t)m_workers.size(); }
+	// Jobs queued but not yet picked up by any worker
+	uint32_t PendingJobs();
+
+	// Calls fn(begin, end) over [0, count) in chunks of chunkSize and returns once all
+	// chunks ran. Several threads may issue loops at the same time. Never allocates.
+	template<typename F>
+	void ParallelFor(uint32_t count, uint32_t chunkSize, F&& fn)
+	{
+		if (count == 0)
+			return;
+
+		Job job;
+		job.context = &fn;
+		job.invoke = [](void* context, uint32_t begin, uint32_t end) { (*static_cast<F*>(context))(begin, end); };
+		job.count = count;
+		job.chunkSize = chunkSize > 0 ? chunkSize : 1;
+		Run(job);
+	}
+
+private:
+	struct Job
+	{
+		void* context = nullptr;
+		void (*invoke)(void*, uint32_t, uint32_t) = nullptr;
+		uint32_t count = 0;
+		uint32_t chunkSize = 1;
+		std::atomic<uint32_t> next{ 0 };
+		std::atomic<uint32_t> done{ 0 };
+		std::atomic<uint32_t> active{ 0 };	// workers currently holding a pointer to the job
+	};
+
+	static constexpr uint32_t MaxQueuedJobs = 64;
+
+	void Run(Job& job);
+	static void Execute(Job& job);
+	void Remove(Job& job);
+	void WorkerMain(uint32_t index);
+
+	std::vector<std::thread> m_workers;
+	Job* m_queue[MaxQueuedJobs] = {};
+	uint32_t m_queued = 0;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	bool m_stop = false;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+enum class LightType : uint32_t
+{
+	Point,
+	Spot
+};
+
+// A punctual light in world space. Range is where the light stops contributing.
+struct Light
+{
+	LightType type = LightType::Point;
+	glm::vec3 position = glm::vec3(0.0f);
+	float range = 1.0f;
+	glm::vec3 color = glm::vec3(1.0f);
+	float intensity = 1.0f;
+	glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+	float innerCos = 1.0f;	// spot only, cosines of the cone half angles
+	float outerCos = 0.0f;
+};
+
+// Light layout in the Lights storage buffer (std430), see scene.frag
+struct GpuLight
+{
+	glm::vec4 positionRange;
+	glm::vec4 colorType;		// rgb premultiplied by intensity, w = LightType
+	glm::vec4 directionOuterCos;
+	glm::vec4 innerCos;			// x, rest unused
+};
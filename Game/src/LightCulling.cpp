@@ -0,0 +1,361 @@
+#include "LightCulling.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "Profiler.h"
+
+// Far enough away that the padding lanes never touch anything
+static constexpr float FarAway = 1e18f;
+
+void LightCuller::LightSoA::Resize(uint32_t lights)
+{
+	count = lights;
+	size_t padded = (lights + 7) & ~7u;
+	for (std::vector<float>* component : { &x, &y, &z, &radius, &dirX, &dirY, &dirZ, &cosAngle, &sinAngle })
+		component->resize(padded);
+
+	for (size_t i = lights; i < padded; i++)
+	{
+		x[i] = y[i] = z[i] = FarAway;
+		radius[i] = 0.0f;
+		dirX[i] = dirY[i] = dirZ[i] = 0.0f;
+		cosAngle[i] = -1.0f;
+		sinAngle[i] = 0.0f;
+	}
+}
+
+static LightCuller::Bounds MergeBounds(const LightCuller::Bounds& a, const LightCuller::Bounds& b)
+{
+	LightCuller::Bounds merged;
+	merged.min = glm::min(a.min, b.min);
+	merged.max = glm::max(a.max, b.max);
+	merged.center = (merged.min + merged.max) * 0.5f;
+	merged.radius = glm::length(merged.max - merged.min) * 0.5f;
+	return merged;
+}
+
+static GpuLight PackLight(const Light& light)
+{
+	GpuLight gpu;
+	gpu.positionRange = glm::vec4(light.position, light.range);
+	gpu.colorType = glm::vec4(light.color * light.intensity, (float)light.type);
+	gpu.directionOuterCos = glm::vec4(light.direction, light.outerCos);
+	gpu.innerCos = glm::vec4(light.innerCos, 0.0f, 0.0f, 0.0f);
+	return gpu;
+}
+
+void LightCuller::Pack(const std::vector<Light>& lights, ClusterLightLists& out)
+{
+	out.lights.resize(lights.size());
+	for (size_t i = 0; i < lights.size(); i++)
+		out.lights[i] = PackLight(lights[i]);
+
+	out.clusters.clear();
+	out.indices.clear();
+	out.sliceScale = 0.0f;
+	out.sliceBias = 0.0f;
+}
+
+void LightCuller::SetProjection(const glm::mat4& projection, float nearPlane, float farPlane)
+{
+	if (!m_clusters.empty() && projection == m_projection && nearPlane == m_near && farPlane == m_far)
+		return;
+
+	m_projection = projection;
+	m_near = nearPlane;
+	m_far = farPlane;
+	m_clusters.resize(ClusterCount);
+
+	// Tile corners on the near plane; scaling by depth / near moves them along their view ray
+	glm::mat4 inverse = glm::inverse(projection);
+	auto nearCorner = [&](uint32_t x, uint32_t y)
+	{
+		glm::vec4 ndc(-1.0f + 2.0f * x / ClusterX, -1.0f + 2.0f * y / ClusterY, -1.0f, 1.0f);
+		glm::vec4 view = inverse * ndc;
+		return glm::vec3(view) / view.w;
+	};
+
+	for (uint32_t z = 0; z < ClusterZ; z++)
+	{
+		float depthNear = nearPlane * std::pow(farPlane / nearPlane, (float)z / ClusterZ);
+		float depthFar = nearPlane * std::pow(farPlane / nearPlane, (float)(z + 1) / ClusterZ);
+
+		for (uint32_t y = 0; y < ClusterY; y++)
+		{
+			for (uint32_t x = 0; x < ClusterX; x++)
+			{
+				Bounds& bounds = m_clusters[(z * ClusterY + y) * ClusterX + x];
+				bounds.min = glm::vec3(FLT_MAX);
+				bounds.max = glm::vec3(-FLT_MAX);
+
+				for (uint32_t corner = 0; corner < 4; corner++)
+				{
+					glm::vec3 point = nearCorner(x + (corner & 1), y + (corner >> 1));
+					for (float depth : { depthNear, depthFar })
+					{
+						glm::vec3 scaled = point * (depth / nearPlane);
+						bounds.min = glm::min(bounds.min, scaled);
+						bounds.max = glm::max(bounds.max, scaled);
+					}
+				}
+
+				bounds.center = (bounds.min + bounds.max) * 0.5f;
+				bounds.radius = glm::length(bounds.max - bounds.min) * 0.5f;
+			}
+		}
+	}
+
+	for (uint32_t z = 0; z < ClusterZ; z++)
+	{
+		for (uint32_t y = 0; y < ClusterY; y++)
+		{
+			Bounds& row = m_rows[z * ClusterY + y];
+			row = m_clusters[(z * ClusterY + y) * ClusterX];
+			for (uint32_t x = 1; x < ClusterX; x++)
+				row = MergeBounds(row, m_clusters[(z * ClusterY + y) * ClusterX + x]);
+		}
+
+		m_slices[z] = m_rows[z * ClusterY];
+		for (uint32_t y = 1; y < ClusterY; y++)
+			m_slices[z] = MergeBounds(m_slices[z], m_rows[z * ClusterY + y]);
+	}
+}
+
+#ifdef __AVX2__
+
+// Eight sphere versus box tests, plus the cone versus bounding sphere test for spots:
+// a spot is rejected when the sphere is outside the cone's angle, past its range or behind it
+static inline __m256 TestLights(__m256 x, __m256 y, __m256 z, __m256 radius,
+	__m256 dirX, __m256 dirY, __m256 dirZ, __m256 cosAngle, __m256 sinAngle,
+	const LightCuller::Bounds& bounds, bool cone)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	__m256 dx = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_set1_ps(bounds.min.x), x), _mm256_sub_ps(x, _mm256_set1_ps(bounds.max.x))), zero);
+	__m256 dy = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_set1_ps(bounds.min.y), y), _mm256_sub_ps(y, _mm256_set1_ps(bounds.max.y))), zero);
+	__m256 dz = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_set1_ps(bounds.min.z), z), _mm256_sub_ps(z, _mm256_set1_ps(bounds.max.z))), zero);
+	__m256 distanceSq = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dz, dz)));
+	__m256 inside = _mm256_cmp_ps(distanceSq, _mm256_mul_ps(radius, radius), _CMP_LE_OQ);
+	if (!cone)
+		return inside;
+
+	__m256 sphereRadius = _mm256_set1_ps(bounds.radius);
+	__m256 vx = _mm256_sub_ps(_mm256_set1_ps(bounds.center.x), x);
+	__m256 vy = _mm256_sub_ps(_mm256_set1_ps(bounds.center.y), y);
+	__m256 vz = _mm256_sub_ps(_mm256_set1_ps(bounds.center.z), z);
+	__m256 lengthSq = _mm256_fmadd_ps(vx, vx, _mm256_fmadd_ps(vy, vy, _mm256_mul_ps(vz, vz)));
+	__m256 along = _mm256_fmadd_ps(vx, dirX, _mm256_fmadd_ps(vy, dirY, _mm256_mul_ps(vz, dirZ)));
+	__m256 across = _mm256_sqrt_ps(_mm256_max_ps(_mm256_fnmadd_ps(along, along, lengthSq), zero));
+	__m256 closest = _mm256_fmsub_ps(cosAngle, across, _mm256_mul_ps(along, sinAngle));
+
+	__m256 outside = _mm256_cmp_ps(closest, sphereRadius, _CMP_GT_OQ);
+	outside = _mm256_or_ps(outside, _mm256_cmp_ps(along, _mm256_add_ps(sphereRadius, radius), _CMP_GT_OQ));
+	outside = _mm256_or_ps(outside, _mm256_cmp_ps(along, _mm256_sub_ps(zero, sphereRadius), _CMP_LT_OQ));
+	return _mm256_andnot_ps(outside, inside);
+}
+
+// Writes the light index of every set lane and returns how many
+static inline uint32_t Compact(uint32_t mask, const uint32_t* lanes, uint32_t* out)
+{
+	uint32_t written = 0;
+	for (uint32_t lane = 0; mask; lane++, mask >>= 1)
+	{
+		if (mask & 1)
+			out[written++] = lanes[lane];
+	}
+	return written;
+}
+
+static uint32_t CullAll(const LightCuller::LightSoA& lights, const LightCuller::Bounds& bounds, uint32_t* out)
+{
+	uint32_t written = 0;
+	uint32_t lanes[8];
+	for (uint32_t i = 0; i < lights.count; i += 8)
+	{
+		__m256 hit = TestLights(_mm256_loadu_ps(&lights.x[i]), _mm256_loadu_ps(&lights.y[i]), _mm256_loadu_ps(&lights.z[i]), _mm256_loadu_ps(&lights.radius[i]),
+			_mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), bounds, false);
+
+		uint32_t mask = (uint32_t)_mm256_movemask_ps(hit);
+		if (!mask)
+			continue;
+		for (uint32_t lane = 0; lane < 8; lane++)
+			lanes[lane] = i + lane;
+		written += Compact(mask, lanes, out + written);
+	}
+	return written;
+}
+
+static uint32_t CullCandidates(const LightCuller::LightSoA& lights, const uint32_t* candidates, uint32_t count, const LightCuller::Bounds& bounds, bool cone, uint32_t* out)
+{
+	uint32_t written = 0;
+	for (uint32_t i = 0; i < count; i += 8)
+	{
+		// Tail lanes repeat the last candidate and are masked off below
+		uint32_t lanes[8];
+		for (uint32_t lane = 0; lane < 8; lane++)
+			lanes[lane] = candidates[std::min(i + lane, count - 1)];
+		__m256i index = _mm256_loadu_si256((const __m256i*)lanes);
+
+		__m256 hit = TestLights(
+			_mm256_i32gather_ps(lights.x.data(), index, 4), _mm256_i32gather_ps(lights.y.data(), index, 4),
+			_mm256_i32gather_ps(lights.z.data(), index, 4), _mm256_i32gather_ps(lights.radius.data(), index, 4),
+			cone ? _mm256_i32gather_ps(lights.dirX.data(), index, 4) : _mm256_setzero_ps(),
+			cone ? _mm256_i32gather_ps(lights.dirY.data(), index, 4) : _mm256_setzero_ps(),
+			cone ? _mm256_i32gather_ps(lights.dirZ.data(), index, 4) : _mm256_setzero_ps(),
+			cone ? _mm256_i32gather_ps(lights.cosAngle.data(), index, 4) : _mm256_setzero_ps(),
+			cone ? _mm256_i32gather_ps(lights.sinAngle.data(), index, 4) : _mm256_setzero_ps(),
+			bounds, cone);
+
+		uint32_t valid = count - i >= 8 ? 0xFFu : (1u << (count - i)) - 1;
+		written += Compact((uint32_t)_mm256_movemask_ps(hit) & valid, lanes, out + written);
+	}
+	return written;
+}
+
+#else
+
+static bool TestLight(const LightCuller::LightSoA& lights, uint32_t i, const LightCuller::Bounds& bounds, bool cone)
+{
+	glm::vec3 center(lights.x[i], lights.y[i], lights.z[i]);
+	glm::vec3 delta = glm::max(glm::max(bounds.min - center, center - bounds.max), glm::vec3(0.0f));
+	if (glm::dot(delta, delta) > lights.radius[i] * lights.radius[i])
+		return false;
+	if (!cone)
+		return true;
+
+	glm::vec3 v = bounds.center - center;
+	float along = glm::dot(v, glm::vec3(lights.dirX[i], lights.dirY[i], lights.dirZ[i]));
+	float across = std::sqrt(std::max(glm::dot(v, v) - along * along, 0.0f));
+	float closest = lights.cosAngle[i] * across - along * lights.sinAngle[i];
+	return !(closest > bounds.radius || along > bounds.radius + lights.radius[i] || along < -bounds.radius);
+}
+
+static uint32_t CullAll(const LightCuller::LightSoA& lights, const LightCuller::Bounds& bounds, uint32_t* out)
+{
+	uint32_t written = 0;
+	for (uint32_t i = 0; i < lights.count; i++)
+		if (TestLight(lights, i, bounds, false))
+			out[written++] = i;
+	return written;
+}
+
+static uint32_t CullCandidates(const LightCuller::LightSoA& lights, const uint32_t* candidates, uint32_t count, const LightCuller::Bounds& bounds, bool cone, uint32_t* out)
+{
+	uint32_t written = 0;
+	for (uint32_t i = 0; i < count; i++)
+		if (TestLight(lights, candidates[i], bounds, cone))
+			out[written++] = candidates[i];
+	return written;
+}
+
+#endif
+
+void LightCuller::CullSlice(uint32_t z)
+{
+	SliceScratch& scratch = m_scratch[z];
+	scratch.used = 0;
+
+	uint32_t sliceCount = CullAll(m_lights, m_slices[z], scratch.slice.data());
+	for (uint32_t y = 0; y < ClusterY; y++)
+	{
+		uint32_t rowCount = sliceCount ? CullCandidates(m_lights, scratch.slice.data(), sliceCount, m_rows[z * ClusterY + y], false, scratch.row.data()) : 0;
+		for (uint32_t x = 0; x < ClusterX; x++)
+		{
+			uint32_t count = 0;
+			if (rowCount)
+			{
+				if (scratch.indices.size() < scratch.used + rowCount)
+					scratch.indices.resize((scratch.used + rowCount) * 2);
+				count = CullCandidates(m_lights, scratch.row.data(), rowCount, m_clusters[(z * ClusterY + y) * ClusterX + x], true, scratch.indices.data() + scratch.used);
+			}
+			scratch.counts[y * ClusterX + x] = count;
+			scratch.used += count;
+		}
+	}
+}
+
+void LightCuller::Cull(const std::vector<Light>& lights, const glm::mat4& view, JobSystem& jobs, ClusterLightLists& out)
+{
+	PROFILE_ZONE("Light culling");
+
+	float logRatio = std::log(m_far / m_near);
+	out.sliceScale = (float)ClusterZ / logRatio;
+	out.sliceBias = -(float)ClusterZ * std::log(m_near) / logRatio;
+
+	uint32_t count = (uint32_t)lights.size();
+	m_lights.Resize(count);
+	out.lights.resize(count);
+
+	glm::mat3 rotation(view);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const Light& light = lights[i];
+		glm::vec3 position = glm::vec3(view * glm::vec4(light.position, 1.0f));
+		m_lights.x[i] = position.x;
+		m_lights.y[i] = position.y;
+		m_lights.z[i] = position.z;
+		m_lights.radius[i] = light.range;
+
+		if (light.type == LightType::Spot)
+		{
+			glm::vec3 direction = rotation * light.direction;
+			m_lights.dirX[i] = direction.x;
+			m_lights.dirY[i] = direction.y;
+			m_lights.dirZ[i] = direction.z;
+			m_lights.cosAngle[i] = light.outerCos;
+			m_lights.sinAngle[i] = std::sqrt(std::max(1.0f - light.outerCos * light.outerCos, 0.0f));
+		}
+		else
+		{
+			m_lights.dirX[i] = m_lights.dirY[i] = m_lights.dirZ[i] = 0.0f;
+			m_lights.cosAngle[i] = -1.0f;
+			m_lights.sinAngle[i] = 0.0f;
+		}
+
+		out.lights[i] = PackLight(light);
+	}
+
+	m_scratch.resize(ClusterZ);
+	for (SliceScratch& scratch : m_scratch)
+	{
+		if (scratch.slice.size() < m_lights.x.size())
+		{
+			scratch.slice.resize(m_lights.x.size());
+			scratch.row.resize(m_lights.x.size());
+		}
+	}
+
+	jobs.ParallelFor(ClusterZ, 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t z = begin; z < end; z++)
+			CullSlice(z);
+	});
+
+	// Stitch the per slice lists together
+	uint32_t total = 0;
+	for (const SliceScratch& scratch : m_scratch)
+		total += scratch.used;
+
+	out.clusters.resize(ClusterCount * 2);
+	out.indices.resize(total);
+	uint32_t offset = 0;
+	for (uint32_t z = 0; z < ClusterZ; z++)
+	{
+		const SliceScratch& scratch = m_scratch[z];
+		for (uint32_t i = 0; i < ClusterX * ClusterY; i++)
+		{
+			uint32_t cluster = z * ClusterX * ClusterY + i;
+			out.clusters[cluster * 2] = offset;
+			out.clusters[cluster * 2 + 1] = scratch.counts[i];
+			offset += scratch.counts[i];
+		}
+		if (scratch.used)
+			std::memcpy(out.indices.data() + offset - scratch.used, scratch.indices.data(), scratch.used * sizeof(uint32_t));
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "JobSystem.h"
+#include "Light.h"
+
+// Output of one culling pass, laid out the way the fragment shader reads it
+struct ClusterLightLists
+{
+	std::vector<GpuLight> lights;
+	std::vector<uint32_t> clusters;		// offset, count into indices per cluster, x fastest
+	std::vector<uint32_t> indices;		// light indices per cluster, back to back
+	float sliceScale = 0.0f;			// slice = log(viewDepth) * sliceScale + sliceBias
+	float sliceBias = 0.0f;
+};
+
+// Clustered forward+ light assignment on the CPU. The view frustum is cut into a froxel
+// grid with exponential depth slices; lights are tested against each depth slice, then
+// each row of tiles and finally each cluster, eight lights at a time with AVX2.
+// Depth slices run in parallel on the job system.
+class LightCuller
+{
+public:
+	static constexpr uint32_t ClusterX = 16;
+	static constexpr uint32_t ClusterY = 9;
+	static constexpr uint32_t ClusterZ = 24;
+	static constexpr uint32_t ClusterCount = ClusterX * ClusterY * ClusterZ;
+
+	// Rebuilds the cluster bounds when the projection changed
+	void SetProjection(const glm::mat4& projection, float nearPlane, float farPlane);
+
+	void Cull(const std::vector<Light>& lights, const glm::mat4& view, JobSystem& jobs, ClusterLightLists& out);
+	// Only fills out.lights and leaves the cluster lists empty
+	static void Pack(const std::vector<Light>& lights, ClusterLightLists& out);
+
+	struct Bounds
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+		glm::vec3 center;	// bounding sphere, for the spot cone test
+		float radius;
+	};
+
+	// View space lights, one array per component, padded to a multiple of eight.
+	// Point lights use a degenerate cone (zero direction, cos -1) so one test covers both.
+	struct LightSoA
+	{
+		std::vector<float> x, y, z, radius;
+		std::vector<float> dirX, dirY, dirZ, cosAngle, sinAngle;
+		uint32_t count = 0;
+
+		void Resize(uint32_t lights);
+	};
+
+private:
+	struct SliceScratch
+	{
+		std::vector<uint32_t> slice;	// lights touching the depth slice
+		std::vector<uint32_t> row;		// of those, lights touching the current row
+		std::vector<uint32_t> indices;	// per cluster results, back to back
+		uint32_t used = 0;
+		uint32_t counts[ClusterX * ClusterY] = {};
+	};
+
+	void CullSlice(uint32_t slice);
+
+	glm::mat4 m_projection = glm::mat4(0.0f);
+	float m_near = 0.0f;
+	float m_far = 0.0f;
+
+	std::vector<Bounds> m_clusters;
+	Bounds m_slices[ClusterZ];
+	Bounds m_rows[ClusterZ * ClusterY];
+
+	LightSoA m_lights;
+	std::vector<SliceScratch> m_scratch;
+};
@@ -0,0 +1,831 @@
+#include "LightmapBaker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+#include "FramePacer.h"
+#include "Log.h"
+#include "Profiler.h"
+
+// imgui_draw.cpp keeps its copy static too
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <imstb_rectpack.h>
+
+static constexpr uint32_t Gutter = 2;			// texels around every chart, at the smallest instance
+static constexpr uint32_t MaxPackAttempts = 32;
+// Lighting terms of scene.frag
+static constexpr float SunLight = 0.75f;
+static constexpr float SkyLight = 0.25f;
+static constexpr float UntexturedAlbedo = 0.8f;
+// A texel whose hemisphere sees this much back faces is inside geometry
+static constexpr float InsideFraction = 0.25f;
+
+bool LightmapSettings::Parse(const std::string& spec)
+{
+	std::istringstream stream(spec);
+	std::string pair;
+	while (std::getline(stream, pair, ','))
+	{
+		if (pair.empty())
+			continue;
+
+		size_t equals = pair.find('=');
+		std::string key = pair.substr(0, equals);
+		char* end = nullptr;
+		double value = equals != std::string::npos ? std::strtod(pair.c_str() + equals + 1, &end) : 0.0;
+		if (equals == std::string::npos || *end != '\0' || value < 0.0)
+		{
+			LOG_ERROR("Bad lightmap setting: " << pair);
+			return false;
+		}
+
+		if (key == "texels_per_unit") texelsPerUnit = (float)value;
+		else if (key == "page_size") pageSize = (uint32_t)value;
+		else if (key == "max_size") maxSize = (uint32_t)value;
+		else if (key == "samples") samples = (uint32_t)value;
+		else if (key == "bounces") bounces = (uint32_t)value;
+		else if (key == "denoise") denoise = (uint32_t)value;
+		else if (key == "dilate") dilate = (uint32_t)value;
+		else if (key == "seed") seed = (uint32_t)value;
+		else
+		{
+			LOG_ERROR("Unknown lightmap setting: " << key);
+			return false;
+		}
+	}
+	return true;
+}
+
+std::string LightmapSettings::Describe() const
+{
+	std::ostringstream stream;
+	stream << "texels_per_unit=" << texelsPerUnit << ",page_size=" << pageSize << ",max_size=" << maxSize
+		<< ",samples=" << samples << ",bounces=" << bounces << ",denoise=" << denoise << ",dilate=" << dilate
+		<< ",seed=" << seed;
+	return stream.str();
+}
+
+// splitmix64, one sequence per texel
+static uint64_t NextRandom(uint64_t& state)
+{
+	uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+static float Random(uint64_t& state)
+{
+	return (float)(NextRandom(state) >> 40) * (1.0f / 16777216.0f);
+}
+
+// Cosine weighted around n, tangents after Duff et al., "Building an Orthonormal Basis, Revisited"
+static glm::vec3 CosineSample(const glm::vec3& n, uint64_t& rng)
+{
+	float sign = std::copysign(1.0f, n.z);
+	float a = -1.0f / (sign + n.z);
+	float b = n.x * n.y * a;
+	glm::vec3 tangent(1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+	glm::vec3 bitangent(b, sign + n.y * n.y * a, -n.y);
+
+	float phi = 6.2831853f * Random(rng);
+	float r2 = Random(rng);
+	float r = std::sqrt(r2);
+	return tangent * (r * std::cos(phi)) + bitangent * (r * std::sin(phi)) + n * std::sqrt(1.0f - r2);
+}
+
+// GL_RGB9_E5, after the EXT_texture_shared_exponent reference
+static uint32_t PackRgb9e5(const glm::vec3& color)
+{
+	const float maxValue = 65408.0f;
+	glm::vec3 c = glm::clamp(color, glm::vec3(0.0f), glm::vec3(maxValue));
+	float maxChannel = std::max(c.r, std::max(c.g, c.b));
+	if (maxChannel <= 0.0f)
+		return 0;
+
+	int32_t exponent = 0;
+	std::frexp(maxChannel, &exponent);
+	int32_t shared = std::max(-16, exponent - 1) + 16;
+	if ((int32_t)std::floor(maxChannel / std::ldexp(1.0f, shared - 24) + 0.5f) == 512)
+		shared++;
+
+	float scale = std::ldexp(1.0f, 24 - shared);
+	uint32_t r = (uint32_t)std::min(std::floor(c.r * scale + 0.5f), 511.0f);
+	uint32_t g = (uint32_t)std::min(std::floor(c.g * scale + 0.5f), 511.0f);
+	uint32_t b = (uint32_t)std::min(std::floor(c.b * scale + 0.5f), 511.0f);
+	return r | g << 9 | b << 18 | (uint32_t)shared << 27;
+}
+
+static uint32_t FindRoot(std::vector<uint32_t>& parents, uint32_t i)
+{
+	while (parents[i] != i)
+	{
+		parents[i] = parents[parents[i]];
+		i = parents[i];
+	}
+	return i;
+}
+
+// Charts are connected triangles facing the same of the six axis directions, projected on
+// that axis' plane at density texels per unit. Packs them into the smallest square that
+// fits, lowering the density when that would be over maxSize, then splits vertices shared
+// between charts and writes the lightmap UVs. size is 0 when the charts don't fit at all.
+static void UnwrapMesh(BakedMesh& mesh, float density, uint32_t maxSize, uint32_t& size, uint32_t& chartCount)
+{
+	size = 0;
+	chartCount = 0;
+	uint32_t triangles = (uint32_t)(mesh.indices.size() / 3);
+	if (triangles == 0)
+		return;
+
+	std::vector<uint32_t> parents(triangles);
+	std::vector<uint32_t> axes(triangles);
+	std::vector<uint32_t> first(mesh.vertices.size() * 6, UINT32_MAX);
+	for (uint32_t t = 0; t < triangles; t++)
+	{
+		const glm::vec3& a = mesh.vertices[mesh.indices[t * 3]].Position;
+		glm::vec3 n = glm::cross(mesh.vertices[mesh.indices[t * 3 + 1]].Position - a, mesh.vertices[mesh.indices[t * 3 + 2]].Position - a);
+		glm::vec3 magnitude = glm::abs(n);
+		uint32_t axis = magnitude.x >= magnitude.y && magnitude.x >= magnitude.z ? 0 : (magnitude.y >= magnitude.z ? 1 : 2);
+		axes[t] = axis * 2 + (n[axis] < 0.0f ? 1 : 0);
+		parents[t] = t;
+
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			uint32_t& slot = first[mesh.indices[t * 3 + c] * 6 + axes[t]];
+			if (slot == UINT32_MAX)
+				slot = t;
+			else
+				parents[FindRoot(parents, t)] = FindRoot(parents, slot);
+		}
+	}
+
+	// Number the charts, then sort the triangles by chart
+	std::vector<uint32_t> chartOf(triangles);
+	std::vector<uint32_t> rootChart(triangles, UINT32_MAX);
+	for (uint32_t t = 0; t < triangles; t++)
+	{
+		uint32_t root = FindRoot(parents, t);
+		if (rootChart[root] == UINT32_MAX)
+			rootChart[root] = chartCount++;
+		chartOf[t] = rootChart[root];
+	}
+
+	std::vector<uint32_t> chartFirst(chartCount + 1, 0);
+	for (uint32_t t = 0; t < triangles; t++)
+		chartFirst[chartOf[t] + 1]++;
+	for (uint32_t c = 0; c < chartCount; c++)
+		chartFirst[c + 1] += chartFirst[c];
+	std::vector<uint32_t> sorted(triangles);
+	std::vector<uint32_t> cursor(chartFirst.begin(), chartFirst.end() - 1);
+	for (uint32_t t = 0; t < triangles; t++)
+		sorted[cursor[chartOf[t]]++] = t;
+
+	std::vector<glm::vec2> chartMin(chartCount, glm::vec2(FLT_MAX));
+	std::vector<glm::vec2> chartMax(chartCount, glm::vec2(-FLT_MAX));
+	std::vector<uint32_t> chartAxis(chartCount);
+	for (uint32_t t = 0; t < triangles; t++)
+	{
+		uint32_t chart = chartOf[t];
+		uint32_t axis = axes[t] / 2;
+		chartAxis[chart] = axis;
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			const glm::vec3& p = mesh.vertices[mesh.indices[t * 3 + c]].Position;
+			glm::vec2 projected(p[(axis + 1) % 3], p[(axis + 2) % 3]);
+			chartMin[chart] = glm::min(chartMin[chart], projected);
+			chartMax[chart] = glm::max(chartMax[chart], projected);
+		}
+	}
+
+	// Grow the square until everything fits, shrink the density when it gets too big
+	std::vector<stbrp_rect> rects(chartCount);
+	std::vector<stbrp_node> nodes(maxSize);
+	bool packed = false;
+	for (uint32_t attempt = 0; attempt < MaxPackAttempts && !packed; attempt++)
+	{
+		uint64_t area = 0;
+		for (uint32_t c = 0; c < chartCount; c++)
+		{
+			glm::vec2 extent = (chartMax[c] - chartMin[c]) * density;
+			rects[c].id = (int)c;
+			rects[c].w = (stbrp_coord)std::ceil(extent.x) + 1 + Gutter * 2;
+			rects[c].h = (stbrp_coord)std::ceil(extent.y) + 1 + Gutter * 2;
+			area += (uint64_t)rects[c].w * rects[c].h;
+		}
+
+		for (size = (uint32_t)std::ceil(std::sqrt((double)area)); size <= maxSize; size = size + size / 10 + 1)
+		{
+			stbrp_context context;
+			stbrp_init_target(&context, (int)size, (int)size, nodes.data(), (int)size);
+			if (stbrp_pack_rects(&context, rects.data(), (int)rects.size()))
+			{
+				packed = true;
+				break;
+			}
+		}
+		if (!packed)
+			density *= 0.8f * maxSize / std::max(size, 1u);
+	}
+	if (!packed)
+	{
+		size = 0;
+		return;
+	}
+
+	// Every chart gets its own copy of the vertices it uses, triangles stay in order
+	std::vector<Vertex> vertices;
+	std::vector<glm::vec2> uvs;
+	vertices.reserve(mesh.vertices.size() + mesh.vertices.size() / 4);
+	uvs.reserve(vertices.capacity());
+	std::vector<uint32_t> remap(mesh.vertices.size());
+	std::vector<uint32_t> remapChart(mesh.vertices.size(), UINT32_MAX);
+	for (uint32_t chart = 0; chart < chartCount; chart++)
+	{
+		uint32_t axis = chartAxis[chart];
+		glm::vec2 origin(rects[chart].x + Gutter + 0.5f, rects[chart].y + Gutter + 0.5f);
+		for (uint32_t i = chartFirst[chart]; i < chartFirst[chart + 1]; i++)
+		{
+			uint32_t t = sorted[i];
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				uint32_t& index = mesh.indices[t * 3 + c];
+				if (remapChart[index] != chart)
+				{
+					const Vertex& vertex = mesh.vertices[index];
+					glm::vec2 projected(vertex.Position[(axis + 1) % 3], vertex.Position[(axis + 2) % 3]);
+					remapChart[index] = chart;
+					remap[index] = (uint32_t)vertices.size();
+					vertices.push_back(vertex);
+					uvs.push_back((origin + (projected - chartMin[chart]) * density) / (float)size);
+				}
+				index = remap[index];
+			}
+		}
+	}
+	mesh.vertices = std::move(vertices);
+	mesh.lightmapUvs = std::move(uvs);
+}
+
+bool LightmapBaker::Bake(BakedScene& scene, const LightmapSettings& settings, JobSystem& jobs)
+{
+	PROFILE_ZONE("Bake lightmaps");
+	uint64_t start = FramePacer::Now();
+	m_settings = settings;
+	m_settings.pageSize = glm::clamp(m_settings.pageSize, 64u, 16384u);
+	m_settings.maxSize = glm::clamp(m_settings.maxSize, 8u, m_settings.pageSize);
+	m_settings.texelsPerUnit = std::max(m_settings.texelsPerUnit, 1e-3f);
+	m_settings.sunDirection = glm::normalize(m_settings.sunDirection);
+	m_stats = LightmapStats();
+	m_scene = &scene;
+	m_pages.clear();
+	scene.lightmaps.clear();
+
+	if (scene.instances.empty())
+	{
+		LOG_ERROR("Lightmaps: the scene has no instances");
+		return false;
+	}
+
+	std::vector<glm::mat4> nodeWorlds(scene.nodes.size());
+	for (size_t i = 0; i < scene.nodes.size(); i++)
+	{
+		const BakedNode& node = scene.nodes[i];
+		nodeWorlds[i] = node.parent == UINT32_MAX ? node.local : nodeWorlds[node.parent] * node.local;
+	}
+
+	// Layouts are made for the smallest instance of each mesh, bigger ones scale them up
+	uint32_t instanceCount = (uint32_t)scene.instances.size();
+	m_worlds.resize(instanceCount);
+	std::vector<float> scales(instanceCount);
+	std::vector<float> meshScales(scene.meshes.size(), FLT_MAX);
+	for (uint32_t i = 0; i < instanceCount; i++)
+	{
+		m_worlds[i] = nodeWorlds[scene.instances[i].node];
+		scales[i] = std::max(std::cbrt(std::abs(glm::determinant(glm::mat3(m_worlds[i])))), 1e-6f);
+		meshScales[scene.instances[i].mesh] = std::min(meshScales[scene.instances[i].mesh], scales[i]);
+	}
+
+	{
+		PROFILE_ZONE("Unwrap");
+		uint64_t unwrapStart = FramePacer::Now();
+		std::vector<uint32_t> layoutSizes(scene.meshes.size());
+		std::vector<uint32_t> charts(scene.meshes.size());
+		jobs.ParallelFor((uint32_t)scene.meshes.size(), 1, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t m = begin; m < end; m++)
+			{
+				float scale = meshScales[m] == FLT_MAX ? 1.0f : meshScales[m];
+				UnwrapMesh(scene.meshes[m], m_settings.texelsPerUnit * scale, m_settings.maxSize, layoutSizes[m], charts[m]);
+			}
+		});
+		for (size_t m = 0; m < scene.meshes.size(); m++)
+		{
+			m_stats.charts += charts[m];
+			if (layoutSizes[m] == 0 && !scene.meshes[m].indices.empty())
+				LOG_WARN("Lightmaps: the " << charts[m] << " charts of mesh " << m << " don't fit in " << m_settings.maxSize << " texels, it stays unlit");
+		}
+
+		std::vector<uint32_t> sizes(instanceCount);
+		for (uint32_t i = 0; i < instanceCount; i++)
+		{
+			uint32_t mesh = scene.instances[i].mesh;
+			uint32_t layout = layoutSizes[mesh];
+			uint32_t scaled = (uint32_t)std::lround(layout * scales[i] / meshScales[mesh]);
+			sizes[i] = layout > 0 ? glm::clamp(scaled, layout, m_settings.maxSize) : 0;
+		}
+		m_stats.unwrapMs = FramePacer::ToMilliseconds(FramePacer::Now() - unwrapStart);
+
+		uint64_t packStart = FramePacer::Now();
+		if (!PackInstances(scene, sizes))
+			return false;
+		m_stats.packMs = FramePacer::ToMilliseconds(FramePacer::Now() - packStart);
+	}
+
+	// The whole scene in world space, triangles numbered instance by instance
+	{
+		uint64_t bvhStart = FramePacer::Now();
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+		m_firstTriangle.resize(instanceCount);
+		m_triangleInstance.clear();
+		glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+		for (uint32_t i = 0; i < instanceCount; i++)
+		{
+			const BakedMesh& mesh = scene.meshes[scene.instances[i].mesh];
+			uint32_t base = (uint32_t)positions.size();
+			m_firstTriangle[i] = (uint32_t)m_triangleInstance.size();
+			for (const Vertex& vertex : mesh.vertices)
+			{
+				positions.push_back(glm::vec3(m_worlds[i] * glm::vec4(vertex.Position, 1.0f)));
+				boundsMin = glm::min(boundsMin, positions.back());
+				boundsMax = glm::max(boundsMax, positions.back());
+			}
+			for (uint32_t index : mesh.indices)
+				indices.push_back(base + index);
+			m_triangleInstance.insert(m_triangleInstance.end(), mesh.indices.size() / 3, i);
+		}
+		m_bvh.Build(positions, indices);
+		m_bias = positions.empty() ? 1e-4f : std::max(glm::length(boundsMax - boundsMin) * 1e-5f, 1e-4f);
+		m_stats.bvhMs = FramePacer::ToMilliseconds(FramePacer::Now() - bvhStart);
+	}
+
+	uint64_t traceStart = FramePacer::Now();
+	{
+		PROFILE_ZONE("Rasterize texels");
+		jobs.ParallelFor(instanceCount, 16, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t i = begin; i < end; i++)
+				Rasterize(scene, i);
+		});
+	}
+
+	{
+		PROFILE_ZONE("Trace texels");
+		uint32_t rows = 0;
+		for (const Page& page : m_pages)
+			rows += page.height;
+
+		std::atomic<uint64_t> rays(0);
+		std::atomic<uint32_t> rowsDone(0);
+		jobs.ParallelFor(rows, 1, [&](uint32_t begin, uint32_t end)
+		{
+			uint64_t chunkRays = 0;
+			for (uint32_t row = begin; row < end; row++)
+			{
+				uint32_t page = 0;
+				uint32_t y = row;
+				while (y >= m_pages[page].height)
+					y -= m_pages[page++].height;
+
+				Page& target = m_pages[page];
+				for (uint32_t x = 0; x < target.width; x++)
+				{
+					size_t texel = (size_t)y * target.width + x;
+					uint64_t seed = (uint64_t)m_settings.seed << 40 ^ (uint64_t)page << 32 ^ texel;
+					chunkRays += TraceTexel(target, texel, seed);
+				}
+			}
+			rays.fetch_add(chunkRays, std::memory_order_relaxed);
+
+			uint32_t done = rowsDone.fetch_add(end - begin, std::memory_order_relaxed) + (end - begin);
+			if (done * 10 / rows != (done - (end - begin)) * 10 / rows)
+				LOG_INFO("  Traced " << done * 100 / rows << "% of the lightmap texels");
+		});
+		m_stats.rays = rays.load();
+	}
+	m_stats.traceMs = FramePacer::ToMilliseconds(FramePacer::Now() - traceStart);
+
+	uint64_t filterStart = FramePacer::Now();
+	for (uint32_t p = 0; p < (uint32_t)m_pages.size(); p++)
+	{
+		PROFILE_ZONE("Filter lightmap");
+		Page& page = m_pages[p];
+		for (uint8_t valid : page.valid)
+			m_stats.texels += valid;
+
+		Denoise(page, jobs);
+		for (size_t i = 0; i < page.lighting.size(); i++)
+			page.lighting[i] += page.indirect[i];
+		Dilate(page, jobs);
+
+		BakedLightmap& lightmap = scene.lightmaps[p];
+		lightmap.texels.resize(page.lighting.size());
+		for (size_t i = 0; i < page.lighting.size(); i++)
+			lightmap.texels[i] = PackRgb9e5(page.lighting[i]);
+	}
+	m_stats.filterMs = FramePacer::ToMilliseconds(FramePacer::Now() - filterStart);
+
+	m_pages.clear();
+	m_pages.shrink_to_fit();
+	m_stats.pages = (uint32_t)scene.lightmaps.size();
+	m_stats.totalMs = FramePacer::ToMilliseconds(FramePacer::Now() - start);
+	return true;
+}
+
+// Square per instance, biggest first, into as many pages as it takes; the last page is
+// cut to the rows it uses
+bool LightmapBaker::PackInstances(BakedScene& scene, const std::vector<uint32_t>& sizes)
+{
+	PROFILE_ZONE("Pack lightmaps");
+	std::vector<stbrp_rect> remaining;
+	for (uint32_t i = 0; i < (uint32_t)scene.instances.size(); i++)
+	{
+		scene.instances[i].lightmap = -1;
+		scene.instances[i].lightmapScaleOffset = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+		if (sizes[i] > 0)
+			remaining.push_back({ (int)i, (stbrp_coord)sizes[i], (stbrp_coord)sizes[i], 0, 0, 0 });
+	}
+
+	uint32_t pageSize = m_settings.pageSize;
+	std::vector<stbrp_node> nodes(pageSize);
+	while (!remaining.empty())
+	{
+		stbrp_context context;
+		stbrp_init_target(&context, (int)pageSize, (int)pageSize, nodes.data(), (int)pageSize);
+		stbrp_pack_rects(&context, remaining.data(), (int)remaining.size());
+
+		int32_t page = (int32_t)scene.lightmaps.size();
+		uint32_t height = 0;
+		std::vector<stbrp_rect> next;
+		for (const stbrp_rect& rect : remaining)
+		{
+			if (rect.was_packed)
+				height = std::max(height, (uint32_t)(rect.y + rect.h));
+			else
+				next.push_back(rect);
+		}
+		if (height == 0)
+		{
+			LOG_ERROR("Lightmaps: could not pack " << remaining.size() << " instances into " << pageSize << " texel pages");
+			return false;
+		}
+		height = std::min((height + 3) & ~3u, pageSize);
+
+		for (const stbrp_rect& rect : remaining)
+		{
+			if (!rect.was_packed)
+				continue;
+			BakedInstance& instance = scene.instances[rect.id];
+			instance.lightmap = page;
+			instance.lightmapScaleOffset = glm::vec4((float)rect.w / pageSize, (float)rect.h / height, (float)rect.x / pageSize, (float)rect.y / height);
+		}
+
+		scene.lightmaps.emplace_back();
+		scene.lightmaps.back().width = (int32_t)pageSize;
+		scene.lightmaps.back().height = (int32_t)height;
+
+		m_pages.emplace_back();
+		Page& target = m_pages.back();
+		size_t texels = (size_t)pageSize * height;
+		target.width = pageSize;
+		target.height = height;
+		target.positions.assign(texels, glm::vec3(0.0f));
+		target.normals.assign(texels, glm::vec3(0.0f));
+		target.faces.assign(texels, glm::vec3(0.0f));
+		target.lighting.assign(texels, glm::vec3(0.0f));
+		target.indirect.assign(texels, glm::vec3(0.0f));
+		target.valid.assign(texels, 0);
+		remaining.swap(next);
+	}
+	return true;
+}
+
+// Texel centers inside a triangle take its world position and normals. Instances own
+// their squares, so instances can be rasterized in parallel.
+void LightmapBaker::Rasterize(const BakedScene& scene, uint32_t instance)
+{
+	const BakedInstance& baked = scene.instances[instance];
+	if (baked.lightmap < 0)
+		return;
+
+	const BakedMesh& mesh = scene.meshes[baked.mesh];
+	Page& page = m_pages[baked.lightmap];
+	const glm::mat4& world = m_worlds[instance];
+	glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(world)));
+	glm::vec2 scale = glm::vec2(baked.lightmapScaleOffset) * glm::vec2((float)page.width, (float)page.height);
+	glm::vec2 offset = glm::vec2(baked.lightmapScaleOffset.z, baked.lightmapScaleOffset.w) * glm::vec2((float)page.width, (float)page.height);
+
+	for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3)
+	{
+		const Vertex* v[3];
+		glm::vec2 p[3];
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			v[c] = &mesh.vertices[mesh.indices[t + c]];
+			p[c] = mesh.lightmapUvs[mesh.indices[t + c]] * scale + offset;
+		}
+
+		float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[1].y - p[0].y) * (p[2].x - p[0].x);
+		if (std::abs(area) < 1e-12f)
+			continue;
+
+		glm::vec3 a = glm::vec3(world * glm::vec4(v[0]->Position, 1.0f));
+		glm::vec3 b = glm::vec3(world * glm::vec4(v[1]->Position, 1.0f));
+		glm::vec3 c = glm::vec3(world * glm::vec4(v[2]->Position, 1.0f));
+		glm::vec3 face = glm::cross(b - a, c - a);
+		if (glm::dot(face, face) < 1e-20f)
+			continue;
+		face = glm::normalize(face);
+
+		glm::vec2 low = glm::min(p[0], glm::min(p[1], p[2]));
+		glm::vec2 high = glm::max(p[0], glm::max(p[1], p[2]));
+		int32_t x0 = std::max((int32_t)std::floor(low.x), 0);
+		int32_t y0 = std::max((int32_t)std::floor(low.y), 0);
+		int32_t x1 = std::min((int32_t)std::ceil(high.x), (int32_t)page.width - 1);
+		int32_t y1 = std::min((int32_t)std::ceil(high.y), (int32_t)page.height - 1);
+		for (int32_t y = y0; y <= y1; y++)
+		{
+			for (int32_t x = x0; x <= x1; x++)
+			{
+				glm::vec2 center(x + 0.5f, y + 0.5f);
+				float w1 = ((center.x - p[0].x) * (p[2].y - p[0].y) - (center.y - p[0].y) * (p[2].x - p[0].x)) / area;
+				float w2 = ((p[1].x - p[0].x) * (center.y - p[0].y) - (p[1].y - p[0].y) * (center.x - p[0].x)) / area;
+				float w0 = 1.0f - w1 - w2;
+				if (w0 < -1e-4f || w1 < -1e-4f || w2 < -1e-4f)
+					continue;
+
+				glm::vec3 normal = normalMatrix * (v[0]->Normal * w0 + v[1]->Normal * w1 + v[2]->Normal * w2);
+				normal = glm::dot(normal, normal) > 1e-12f ? glm::normalize(normal) : face;
+				size_t texel = (size_t)y * page.width + x;
+				page.positions[texel] = a * w0 + b * w1 + c * w2;
+				page.normals[texel] = normal;
+				// Paths leave on the side the shading normal is on
+				page.faces[texel] = glm::dot(face, normal) < 0.0f ? -face : face;
+			}
+		}
+	}
+}
+
+// Sun and punctual lights the way scene.frag lights a surface, with shadow rays. Path
+// vertices after the first take one light at random out of those in range.
+glm::vec3 LightmapBaker::Direct(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& face, uint64_t& rng, bool allLights, uint32_t& rays) const
+{
+	glm::vec3 light(0.0f);
+	glm::vec3 origin = position + face * m_bias;
+
+	float sun = glm::dot(normal, -m_settings.sunDirection);
+	if (sun > 0.0f)
+	{
+		rays++;
+		Ray ray;
+		ray.origin = origin;
+		ray.direction = -m_settings.sunDirection;
+		if (!m_bvh.Occluded(ray))
+			light += glm::vec3(SunLight * sun);
+	}
+
+	const std::vector<Light>& lights = m_scene->lights;
+	uint32_t inRange = 0;
+	uint32_t picked = 0;
+	for (uint32_t i = 0; i < (uint32_t)lights.size(); i++)
+	{
+		glm::vec3 toLight = lights[i].position - position;
+		if (glm::dot(toLight, toLight) >= lights[i].range * lights[i].range || glm::dot(toLight, normal) <= 0.0f)
+			continue;
+		inRange++;
+		if (!allLights)
+		{
+			// Reservoir of one, every light in range equally likely
+			if (Random(rng) * inRange < 1.0f)
+				picked = i;
+			continue;
+		}
+		light += Punctual(lights[i], position, normal, origin, rays);
+	}
+	if (!allLights && inRange > 0)
+		light += Punctual(lights[picked], position, normal, origin, rays) * (float)inRange;
+	return light;
+}
+
+glm::vec3 LightmapBaker::Punctual(const Light& light, const glm::vec3& position, const glm::vec3& normal, const glm::vec3& origin, uint32_t& rays) const
+{
+	glm::vec3 toLight = light.position - position;
+	float distance = glm::length(toLight);
+	glm::vec3 l = toLight / std::max(distance, 1e-4f);
+
+	float ratio = distance / light.range;
+	float window = glm::clamp(1.0f - ratio * ratio * ratio * ratio, 0.0f, 1.0f);
+	float attenuation = window * window / (distance * distance + 1.0f);
+	if (light.type == LightType::Spot)
+		attenuation *= glm::smoothstep(light.outerCos, light.innerCos, glm::dot(-l, light.direction));
+
+	float lit = attenuation * std::max(glm::dot(normal, l), 0.0f);
+	if (lit <= 0.0f)
+		return glm::vec3(0.0f);
+
+	rays++;
+	Ray ray;
+	ray.origin = origin;
+	ray.direction = light.position - origin;
+	ray.tMax = 1.0f - 1e-4f;
+	return m_bvh.Occluded(ray) ? glm::vec3(0.0f) : light.color * light.intensity * lit;
+}
+
+// Diffuse texture at the hit, nearest texel
+glm::vec3 LightmapBaker::Albedo(const RayHit& hit) const
+{
+	uint32_t triangle = m_bvh.TriangleSource(hit.triangle).primitive;
+	uint32_t instance = m_triangleInstance[triangle];
+	const BakedMesh& mesh = m_scene->meshes[m_scene->instances[instance].mesh];
+	int32_t diffuse = mesh.material < m_scene->materials.size() ? m_scene->materials[mesh.material].diffuse : -1;
+	if (diffuse < 0)
+		return glm::vec3(UntexturedAlbedo);
+
+	size_t first = (size_t)(triangle - m_firstTriangle[instance]) * 3;
+	glm::vec3 uv = mesh.vertices[mesh.indices[first]].TexCoords * (1.0f - hit.u - hit.v)
+		+ mesh.vertices[mesh.indices[first + 1]].TexCoords * hit.u + mesh.vertices[mesh.indices[first + 2]].TexCoords * hit.v;
+
+	const BakedTexture& texture = m_scene->textures[diffuse];
+	int32_t x = glm::clamp((int32_t)((uv.x - std::floor(uv.x)) * texture.width), 0, texture.width - 1);
+	int32_t y = glm::clamp((int32_t)((uv.y - std::floor(uv.y)) * texture.height), 0, texture.height - 1);
+	uint32_t texel = texture.texels[(size_t)y * texture.width + x];
+	return glm::vec3((float)(texel & 0xFF), (float)((texel >> 8) & 0xFF), (float)((texel >> 16) & 0xFF)) * (1.0f / 255.0f);
+}
+
+// Direct light without noise, then cosine weighted paths for the sky and bounces.
+// Returns the rays it took.
+uint32_t LightmapBaker::TraceTexel(Page& page, size_t texel, uint64_t seed) const
+{
+	const glm::vec3& normal = page.normals[texel];
+	if (normal == glm::vec3(0.0f))
+		return 0;
+
+	uint32_t rays = 0;
+	uint64_t rng = seed;
+	const glm::vec3& position = page.positions[texel];
+	const glm::vec3& face = page.faces[texel];
+	glm::vec3 direct = Direct(position, normal, face, rng, true, rays);
+
+	glm::vec3 indirect(0.0f);
+	uint32_t backFaces = 0;
+	uint32_t samples = std::max(m_settings.samples, 1u);
+	for (uint32_t s = 0; s < samples; s++)
+	{
+		glm::vec3 throughput(1.0f);
+		Ray ray;
+		ray.origin = position + face * m_bias;
+		ray.direction = CosineSample(face, rng);
+		for (uint32_t bounce = 0; ; bounce++)
+		{
+			rays++;
+			RayHit hit;
+			if (!m_bvh.Intersect(ray, hit))
+			{
+				indirect += throughput * SkyLight;
+				break;
+			}
+
+			glm::vec3 a, b, c;
+			m_bvh.TriangleVertices(hit.triangle, a, b, c);
+			glm::vec3 hitFace = glm::cross(b - a, c - a);
+			if (glm::dot(hitFace, ray.direction) > 0.0f)
+			{
+				backFaces += bounce == 0 ? 1 : 0;
+				break;
+			}
+			if (bounce == m_settings.bounces)
+				break;
+
+			hitFace = glm::normalize(hitFace);
+			glm::vec3 hitPosition = ray.origin + ray.direction * hit.t;
+			throughput *= Albedo(hit);
+			indirect += throughput * Direct(hitPosition, hitFace, hitFace, rng, false, rays);
+
+			ray.origin = hitPosition + hitFace * m_bias;
+			ray.direction = CosineSample(hitFace, rng);
+			ray.tMax = FLT_MAX;
+		}
+	}
+
+	page.lighting[texel] = direct;
+	page.indirect[texel] = indirect / (float)samples;
+	page.valid[texel] = backFaces <= samples * InsideFraction ? 1 : 0;
+	return rays;
+}
+
+// Edge avoiding a-trous wavelet filter (Dammertz et al. 2010) on the indirect light: a 5x5
+// B3 spline kernel whose taps spread twice as far each pass, weighted down across creases
+// and gaps in world space, so neighbouring charts and instances don't mix
+void LightmapBaker::Denoise(Page& page, JobSystem& jobs)
+{
+	static const float kernel[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+	std::vector<glm::vec3> filtered(page.indirect.size());
+	for (uint32_t pass = 0; pass < m_settings.denoise; pass++)
+	{
+		int32_t step = 1 << pass;
+		float spacing = 2.0f * step / m_settings.texelsPerUnit;
+		float positionWeight = 1.0f / (spacing * spacing);
+		jobs.ParallelFor(page.height, 8, [&](uint32_t begin, uint32_t end)
+		{
+			for (int32_t y = (int32_t)begin; y < (int32_t)end; y++)
+			{
+				for (int32_t x = 0; x < (int32_t)page.width; x++)
+				{
+					size_t center = (size_t)y * page.width + x;
+					filtered[center] = page.indirect[center];
+					if (!page.valid[center])
+						continue;
+
+					glm::vec3 sum(0.0f);
+					float weights = 0.0f;
+					for (int32_t dy = -2; dy <= 2; dy++)
+					{
+						int32_t ty = y + dy * step;
+						if (ty < 0 || ty >= (int32_t)page.height)
+							continue;
+						for (int32_t dx = -2; dx <= 2; dx++)
+						{
+							int32_t tx = x + dx * step;
+							size_t tap = (size_t)ty * page.width + tx;
+							if (tx < 0 || tx >= (int32_t)page.width || !page.valid[tap])
+								continue;
+
+							float facing = std::max(glm::dot(page.normals[center], page.normals[tap]), 0.0f);
+							facing *= facing;
+							facing *= facing;
+							glm::vec3 offset = page.positions[tap] - page.positions[center];
+							float weight = kernel[dx + 2] * kernel[dy + 2] * facing * facing * std::exp(-glm::dot(offset, offset) * positionWeight);
+							sum += page.indirect[tap] * weight;
+							weights += weight;
+						}
+					}
+					filtered[center] = sum / weights;
+				}
+			}
+		});
+		page.indirect.swap(filtered);
+	}
+}
+
+// Grows every chart into its gutter a texel per pass, so bilinear filtering at chart
+// edges never reads texels no surface wrote
+void LightmapBaker::Dilate(Page& page, JobSystem& jobs)
+{
+	std::vector<glm::vec3> grown(page.lighting.size());
+	std::vector<uint8_t> valid(page.valid.size());
+	for (uint32_t pass = 0; pass < m_settings.dilate; pass++)
+	{
+		jobs.ParallelFor(page.height, 16, [&](uint32_t begin, uint32_t end)
+		{
+			for (int32_t y = (int32_t)begin; y < (int32_t)end; y++)
+			{
+				for (int32_t x = 0; x < (int32_t)page.width; x++)
+				{
+					size_t center = (size_t)y * page.width + x;
+					grown[center] = page.lighting[center];
+					valid[center] = page.valid[center];
+					if (page.valid[center])
+						continue;
+
+					glm::vec3 sum(0.0f);
+					uint32_t count = 0;
+					for (int32_t ty = std::max(y - 1, 0); ty <= std::min(y + 1, (int32_t)page.height - 1); ty++)
+					{
+						for (int32_t tx = std::max(x - 1, 0); tx <= std::min(x + 1, (int32_t)page.width - 1); tx++)
+						{
+							size_t tap = (size_t)ty * page.width + tx;
+							if (page.valid[tap])
+							{
+								sum += page.lighting[tap];
+								count++;
+							}
+						}
+					}
+					if (count > 0)
+					{
+						grown[center] = sum / (float)count;
+						valid[center] = 1;
+					}
+				}
+			}
+		});
+		page.lighting.swap(grown);
+		page.valid.swap(valid);
+	}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BakedScene.h"
+#include "Bvh.h"
+#include "JobSystem.h"
+
+struct LightmapSettings
+{
+	float texelsPerUnit = 4.0f;		// world space density, before clamping to maxSize
+	uint32_t pageSize = 1024;
+	uint32_t maxSize = 256;			// texels on a side for one instance
+	uint32_t samples = 64;			// hemisphere paths per texel
+	uint32_t bounces = 2;
+	uint32_t denoise = 3;			// a-trous passes over the indirect light
+	uint32_t dilate = 4;			// texels grown out of every chart
+	uint32_t seed = 1;
+	glm::vec3 sunDirection = glm::normalize(glm::vec3(-0.4f, -1.0f, -0.3f));
+
+	// Comma separated key=value pairs: texels_per_unit, page_size, max_size, samples,
+	// bounces, denoise, dilate, seed. Keys not given keep their value; fails on unknown keys.
+	bool Parse(const std::string& spec);
+	std::string Describe() const;
+};
+
+struct LightmapStats
+{
+	uint32_t charts = 0;
+	uint32_t pages = 0;
+	uint64_t texels = 0;		// covered by a surface, before dilation
+	uint64_t rays = 0;
+	double unwrapMs = 0.0;
+	double packMs = 0.0;
+	double bvhMs = 0.0;
+	double traceMs = 0.0;
+	double filterMs = 0.0;		// denoise and dilate
+	double totalMs = 0.0;
+};
+
+// Bakes the lighting of a static scene into lightmap pages on the CPU.
+//  1. Every mesh is cut into charts of connected triangles facing the same axis, each
+//     projected onto that axis' plane, and the charts are packed into one square with
+//     imstb_rectpack. The layout is in texels of the mesh's smallest instance, with a
+//     gutter around each chart, so no instance bleeds between charts.
+//  2. Instances get a square scaled from their mesh's layout, packed into pages.
+//  3. Texels are rasterized into their triangles for a world position and normal, then
+//     path traced through a Bvh over the whole scene: the sun and punctual lights directly
+//     with shadow rays, the sky and bounces through cosine weighted paths. The direct
+//     terms use scene.frag's falloff, though nothing samples the pages at run time yet.
+//  4. Only the indirect part is noisy. It is smoothed with an edge aware a-trous filter
+//     guided by position and normal, then every chart is grown into its gutter.
+// Texels are traced in parallel on the job system with a random sequence of their own,
+// so the result does not depend on the number of threads.
+class LightmapBaker
+{
+public:
+	// Cuts the meshes at chart seams, adds lightmap UVs and pages to the scene
+	bool Bake(BakedScene& scene, const LightmapSettings& settings, JobSystem& jobs);
+	const LightmapStats& Stats() const { return m_stats; }
+
+private:
+	// One page while it is baked
+	struct Page
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;		// shading normals, zero where no surface is
+		std::vector<glm::vec3> faces;		// geometric normals, on the side of the shading normal
+		std::vector<glm::vec3> lighting;	// direct light, everything once filtered
+		std::vector<glm::vec3> indirect;
+		std::vector<uint8_t> valid;
+	};
+
+	bool PackInstances(BakedScene& scene, const std::vector<uint32_t>& sizes);
+	void Rasterize(const BakedScene& scene, uint32_t instance);
+	uint32_t TraceTexel(Page& page, size_t texel, uint64_t seed) const;
+	glm::vec3 Direct(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& face, uint64_t& rng, bool allLights, uint32_t& rays) const;
+	glm::vec3 Punctual(const Light& light, const glm::vec3& position, const glm::vec3& normal, const glm::vec3& origin, uint32_t& rays) const;
+	glm::vec3 Albedo(const RayHit& hit) const;
+	void Denoise(Page& page, JobSystem& jobs);
+	void Dilate(Page& page, JobSystem& jobs);
+
+	LightmapSettings m_settings;
+	LightmapStats m_stats;
+	const BakedScene* m_scene = nullptr;
+	std::vector<glm::mat4> m_worlds;			// per instance
+	std::vector<uint32_t> m_triangleInstance;	// per Bvh source primitive
+	std::vector<uint32_t> m_firstTriangle;		// per instance, into the Bvh source primitives
+	std::vector<Page> m_pages;
+	Bvh m_bvh;
+	float m_bias = 1e-4f;
+};
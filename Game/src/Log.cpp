@@ -0,0 +1,294 @@
+#include "Log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#include "MemoryTracker.h"
+#include "Profiler.h"
+
+static constexpr uint64_t SlotMask = Log::SlotCount - 1;
+static constexpr uint32_t WritePeriodMs = 5;
+static_assert((Log::SlotCount & SlotMask) == 0, "log slot count must be a power of two");
+
+struct alignas(64) LogSlot
+{
+	// Equals the position while free, position + 1 once written, and position + SlotCount
+	// once the writer is done with it, which frees it for the next lap
+	std::atomic<uint64_t> sequence;
+	uint16_t length;
+	bool more;		// the line goes on in the next slot
+	char text[Log::SlotText];
+};
+static_assert(sizeof(LogSlot) == 256, "log slots should fill four cache lines exactly");
+
+// Formatting state of one thread
+struct LogStream
+{
+	LogBuffer buffer;
+	std::ostream stream{ &buffer };
+	std::ios_base::fmtflags flags = stream.flags();
+};
+
+static LogSlot s_slots[Log::SlotCount];
+alignas(64) static std::atomic<uint64_t> s_enqueue;
+alignas(64) static uint64_t s_dequeue = 0;		// writer thread only
+static std::atomic<uint64_t> s_written;			// positions written out, for Flush
+static std::atomic<uint64_t> s_dropped;
+static std::atomic<uint32_t> s_level;
+
+static std::atomic<bool> s_running;
+static std::atomic<bool> s_stop;
+static std::atomic<bool> s_asleep;
+static std::mutex s_wakeMutex;
+static std::condition_variable s_wake;
+static std::thread s_writer;
+static FILE* s_output = nullptr;
+static std::mutex s_directMutex;
+
+static LogStream& LocalStream()
+{
+	static thread_local LogStream stream;
+	return stream;
+}
+
+static bool Published(uint64_t position)
+{
+	return s_slots[position & SlotMask].sequence.load(std::memory_order_acquire) == position + 1;
+}
+
+static void Wake()
+{
+	std::lock_guard<std::mutex> lock(s_wakeMutex);
+	s_asleep.store(false, std::memory_order_relaxed);
+	s_wake.notify_one();
+}
+
+static void WriteDirect(const char* text, size_t length)
+{
+	std::lock_guard<std::mutex> lock(s_directMutex);
+	std::fwrite(text, 1, length, stdout);
+	std::fputc('\n', stdout);
+	std::fflush(stdout);
+}
+
+static void WriterMain()
+{
+	Profiler::SetThreadName("Log");
+
+	static char batch[64 * 1024];
+	uint64_t reportedDrops = 0;
+	while (true)
+	{
+		size_t used = 0;
+		while (Published(s_dequeue))
+		{
+			if (used + Log::SlotText + 1 > sizeof(batch))
+			{
+				std::fwrite(batch, 1, used, s_output);
+				used = 0;
+			}
+
+			LogSlot& slot = s_slots[s_dequeue & SlotMask];
+			std::memcpy(batch + used, slot.text, slot.length);
+			used += slot.length;
+			if (!slot.more)
+				batch[used++] = '\n';
+			slot.sequence.store(s_dequeue + Log::SlotCount, std::memory_order_release);
+			s_dequeue++;
+		}
+
+		uint64_t dropped = s_dropped.load(std::memory_order_relaxed);
+		if (dropped != reportedDrops)
+		{
+			if (used + 128 > sizeof(batch))
+			{
+				std::fwrite(batch, 1, used, s_output);
+				used = 0;
+			}
+			used += (size_t)std::snprintf(batch + used, 128, "Log: %llu lines dropped, the queue was full\n", (unsigned long long)(dropped - reportedDrops));
+			reportedDrops = dropped;
+		}
+
+		if (used > 0)
+		{
+			PROFILE_ZONE("Write log");
+			std::fwrite(batch, 1, used, s_output);
+			std::fflush(s_output);
+		}
+		s_written.store(s_dequeue, std::memory_order_release);
+		if (used > 0)
+			continue;
+		if (s_stop.load(std::memory_order_acquire))
+			break;
+
+		// Polls while idle, so callers only pay for a wake when the ring starts to fill
+		std::unique_lock<std::mutex> lock(s_wakeMutex);
+		s_asleep.store(true, std::memory_order_relaxed);
+		s_wake.wait_for(lock, std::chrono::milliseconds(WritePeriodMs), []() { return !s_asleep.load(std::memory_order_relaxed); });
+		s_asleep.store(false, std::memory_order_relaxed);
+	}
+}
+
+bool Log::Init(const char* file)
+{
+	if (Running())
+		return true;
+
+	s_output = stdout;
+	if (file)
+	{
+		s_output = std::fopen(file, "wb");
+		if (!s_output)
+		{
+			s_output = stdout;
+			LOG_ERROR("Could not open log file: " << file);
+			return false;
+		}
+	}
+
+	// Nothing is queued while the writer is stopped, so the ring can start over
+	for (uint32_t i = 0; i < SlotCount; i++)
+		s_slots[i].sequence.store(i, std::memory_order_relaxed);
+	s_enqueue.store(0, std::memory_order_relaxed);
+	s_dequeue = 0;
+	s_written.store(0, std::memory_order_relaxed);
+	s_dropped.store(0, std::memory_order_relaxed);
+	s_stop.store(false, std::memory_order_relaxed);
+
+	{
+		// The writer lives as long as the program
+		MemoryScope scope(MemoryTag::Untagged);
+		s_writer = std::thread(WriterMain);
+	}
+	s_running.store(true, std::memory_order_release);
+
+	static bool registered = false;
+	if (!registered)
+		std::atexit(Shutdown);
+	registered = true;
+	return true;
+}
+
+void Log::Shutdown()
+{
+	if (!s_running.exchange(false, std::memory_order_acq_rel))
+		return;
+
+	s_stop.store(true, std::memory_order_release);
+	Wake();
+	s_writer.join();
+
+	if (s_output != stdout)
+		std::fclose(s_output);
+	s_output = nullptr;
+}
+
+void Log::Flush()
+{
+	if (!Running())
+		return;
+
+	uint64_t target = s_enqueue.load(std::memory_order_acquire);
+	Wake();
+	while (s_written.load(std::memory_order_acquire) < target && Running())
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+bool Log::Running()
+{
+	return s_running.load(std::memory_order_acquire);
+}
+
+void Log::SetLevel(LogLevel level)
+{
+	s_level.store((uint32_t)level, std::memory_order_relaxed);
+}
+
+bool Log::Enabled(LogLevel level)
+{
+	return (uint32_t)level >= s_level.load(std::memory_order_relaxed);
+}
+
+void Log::Write(const char* text, size_t length)
+{
+	if (!Running())
+	{
+		WriteDirect(text, length);
+		return;
+	}
+
+	// A line that would take over a quarter of the ring is cut to that
+	uint64_t count = std::max<uint64_t>((length + SlotText - 1) / SlotText, 1);
+	if (count > SlotCount / 4)
+	{
+		count = SlotCount / 4;
+		length = count * SlotText;
+	}
+
+	// Claim count slots in a row. The writer frees slots in order, so when the last one
+	// is free for this lap, all before it are too.
+	uint64_t position = s_enqueue.load(std::memory_order_relaxed);
+	while (true)
+	{
+		uint64_t last = position + count - 1;
+		int64_t difference = (int64_t)(s_slots[last & SlotMask].sequence.load(std::memory_order_acquire) - last);
+		if (difference == 0)
+		{
+			if (s_enqueue.compare_exchange_weak(position, position + count, std::memory_order_relaxed))
+				break;
+		}
+		else if (difference < 0)
+		{
+			s_dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		else
+			position = s_enqueue.load(std::memory_order_relaxed);
+	}
+
+	for (uint64_t i = 0; i < count; i++)
+	{
+		LogSlot& slot = s_slots[(position + i) & SlotMask];
+		size_t offset = (size_t)i * SlotText;
+		size_t chunk = std::min(length - offset, SlotText);
+		std::memcpy(slot.text, text + offset, chunk);
+		slot.more = i + 1 < count;
+		slot.length = (uint16_t)chunk;
+		slot.sequence.store(position + i + 1, std::memory_order_release);
+	}
+
+	uint64_t queued = position + count - s_written.load(std::memory_order_relaxed);
+	if (queued > SlotCount / 4 && s_asleep.load(std::memory_order_relaxed))
+		Wake();
+}
+
+uint64_t Log::Dropped()
+{
+	return s_dropped.load(std::memory_order_relaxed);
+}
+
+LogLine::LogLine()
+	: m_stream(LocalStream().stream)
+{
+	// Manipulators from the last line must not carry over
+	LogStream& local = LocalStream();
+	local.buffer.Reset();
+	local.stream.clear();
+	local.stream.flags(local.flags);
+	local.stream.precision(6);
+	local.stream.width(0);
+	local.stream.fill(' ');
+}
+
+LogLine::~LogLine()
+{
+	const LogBuffer& buffer = LocalStream().buffer;
+	Log::Write(buffer.Text(), buffer.Length());
+}
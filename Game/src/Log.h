@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <streambuf>
+
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_WARN 3
+#define LOG_LEVEL_ERROR 4
+#define LOG_LEVEL_OFF 5
+
+// Lowest level compiled in. Calls below it disappear, arguments and all.
+#ifndef LOG_LEVEL
+#ifdef _DEBUG
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#else
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+#endif
+
+enum class LogLevel : uint32_t
+{
+	Trace = LOG_LEVEL_TRACE,
+	Debug = LOG_LEVEL_DEBUG,
+	Info = LOG_LEVEL_INFO,
+	Warn = LOG_LEVEL_WARN,
+	Error = LOG_LEVEL_ERROR,
+	Off = LOG_LEVEL_OFF
+};
+
+// Asynchronous line logger. Callers format on their own thread into a thread local
+// buffer and copy the line into a fixed ring of slots without locking; a writer thread
+// drains the ring to the output every few milliseconds, or sooner once it fills up.
+// When the ring is full the line is dropped and counted, the caller never waits. Lines
+// longer than a slot take several slots in a row. Before Init and after Shutdown lines
+// are written directly, so tools that never start the writer still see everything in
+// order.
+class Log
+{
+public:
+	static constexpr size_t SlotText = 244;
+	static constexpr uint32_t SlotCount = 4096;
+	static constexpr size_t MaxLine = 4096;	// longer lines are cut off
+
+	// Starts the writer thread, writing to the file or to stdout without one
+	static bool Init(const char* file = nullptr);
+	// Writes everything queued and stops the writer. Also runs at exit.
+	static void Shutdown();
+	// Blocks until every line queued before the call is written
+	static void Flush();
+	static bool Running();
+
+	// Lines below this are dropped at run time, on top of LOG_LEVEL
+	static void SetLevel(LogLevel level);
+	static bool Enabled(LogLevel level);
+
+	static void Write(const char* text, size_t length);
+	// Lines lost to a full ring since Init
+	static uint64_t Dropped();
+};
+
+// Fixed buffer the thread's log stream formats into; nothing allocates
+class LogBuffer : public std::streambuf
+{
+public:
+	LogBuffer() { Reset(); }
+
+	void Reset() { setp(m_text, m_text + sizeof(m_text)); }
+	const char* Text() const { return pbase(); }
+	size_t Length() const { return (size_t)(pptr() - pbase()); }
+
+private:
+	char m_text[Log::MaxLine];
+};
+
+// One line: takes the calling thread's stream, hands the text to Log when it ends
+class LogLine
+{
+public:
+	LogLine();
+	~LogLine();
+
+	LogLine(const LogLine&) = delete;
+	LogLine& operator=(const LogLine&) = delete;
+
+	std::ostream& Stream() { return m_stream; }
+
+private:
+	std::ostream& m_stream;
+};
+
+// LOG_INFO("Loaded " << count << " meshes"): the argument is a chain of stream inserts,
+// without the trailing std::endl
+#define LOG_WRITE(level, message) do { if (Log::Enabled(level)) { LogLine _logLine; _logLine.Stream() << message; } } while (0)
+
+#if LOG_LEVEL <= LOG_LEVEL_TRACE
+#define LOG_TRACE(message) LOG_WRITE(LogLevel::Trace, message)
+#else
+#define LOG_TRACE(message) do {} while (0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(message) LOG_WRITE(LogLevel::Debug, message)
+#else
+#define LOG_DEBUG(message) do {} while (0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(message) LOG_WRITE(LogLevel::Info, message)
+#else
+#define LOG_INFO(message) do {} while (0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(message) LOG_WRITE(LogLevel::Warn, message)
+#else
+#define LOG_WARN(message) do {} while (0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(message) LOG_WRITE(LogLevel::Error, message)
+#else
+#define LOG_ERROR(message) do {} while (0)
+#endif
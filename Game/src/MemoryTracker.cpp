@@ -0,0 +1,524 @@
+#include "MemoryTracker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <dbghelp.h>
+#elif defined(__GLIBC__) || defined(__APPLE__)
+#include <cxxabi.h>
+#include <execinfo.h>
+#define HAS_BACKTRACE 1
+#endif
+
+#include "Log.h"
+
+// Sits right in front of every tracked block
+struct AllocationHeader
+{
+	uint64_t size;
+	uint32_t offset;	// from the start of the malloc block to the user pointer
+	uint32_t tag;
+};
+static_assert(sizeof(AllocationHeader) == 16, "header must keep 16 byte alignment");
+
+struct CpuCounters
+{
+	std::atomic<int64_t> bytes;
+	std::atomic<int64_t> peak;
+	std::atomic<int64_t> live;
+	std::atomic<int64_t> total;
+};
+
+struct GpuObject
+{
+	size_t bytes;
+	MemoryTag tag;
+	const char* label;
+};
+
+struct GpuTable
+{
+	std::mutex mutex;
+	std::unordered_map<uint64_t, GpuObject> objects;
+	int64_t bytes[(size_t)MemoryTag::Count] = {};
+	int64_t peak[(size_t)MemoryTag::Count] = {};
+	uint32_t count[(size_t)MemoryTag::Count] = {};
+};
+
+static constexpr uint32_t TraceDepth = 24;
+static constexpr uint32_t MaxTraces = 64;
+
+// One distinct call stack seen while tracing
+struct AllocationTrace
+{
+	void* frames[TraceDepth];
+	uint32_t depth;
+	uint32_t count;
+	uint64_t bytes;
+	uint64_t hash;
+};
+
+// Zero initialized before any constructor runs, so allocations during static init are fine
+static CpuCounters s_cpu[(size_t)MemoryTag::Count];
+static thread_local MemoryTag t_tag = MemoryTag::Untagged;
+
+// Fixed storage, so recording a stack never allocates itself
+static std::atomic<bool> s_tracing;
+static std::atomic<uint64_t> s_traced;
+static std::mutex s_traceMutex;
+static AllocationTrace s_traces[MaxTraces];
+static uint32_t s_traceCount = 0;
+static thread_local bool t_inTrace = false;
+
+static GpuTable& Gpu()
+{
+	static GpuTable table;
+	return table;
+}
+
+static uint64_t GpuKey(GpuResource kind, uint32_t id)
+{
+	return (uint64_t)kind << 32 | id;
+}
+
+static const char* GpuKindName(GpuResource kind)
+{
+	switch (kind)
+	{
+	case GpuResource::Buffer: return "buffer";
+	case GpuResource::Texture: return "texture";
+	case GpuResource::Renderbuffer: return "renderbuffer";
+	}
+	return "object";
+}
+
+static void RaisePeak(std::atomic<int64_t>& peak, int64_t value)
+{
+	int64_t current = peak.load(std::memory_order_relaxed);
+	while (value > current && !peak.compare_exchange_weak(current, value, std::memory_order_relaxed))
+	{
+	}
+}
+
+static double ToMB(int64_t bytes)
+{
+	return bytes / (1024.0 * 1024.0);
+}
+
+static uint32_t CaptureStack(void** frames, uint32_t count)
+{
+#ifdef _WIN32
+	return CaptureStackBackTrace(0, count, frames, nullptr);
+#elif HAS_BACKTRACE
+	return (uint32_t)backtrace(frames, (int32_t)count);
+#else
+	return 0;
+#endif
+}
+
+static void TraceAllocation(size_t size)
+{
+	// The unwinder may allocate on first use
+	if (t_inTrace)
+		return;
+	t_inTrace = true;
+	s_traced.fetch_add(1, std::memory_order_relaxed);
+
+	AllocationTrace trace;
+	trace.depth = CaptureStack(trace.frames, TraceDepth);
+	trace.hash = 14695981039346656037ull;
+	for (uint32_t i = 0; i < trace.depth; i++)
+		trace.hash = (trace.hash ^ reinterpret_cast<uintptr_t>(trace.frames[i])) * 1099511628211ull;
+
+	std::lock_guard<std::mutex> lock(s_traceMutex);
+	AllocationTrace* found = nullptr;
+	for (uint32_t i = 0; i < s_traceCount && !found; i++)
+	{
+		if (s_traces[i].hash == trace.hash && s_traces[i].depth == trace.depth && std::memcmp(s_traces[i].frames, trace.frames, trace.depth * sizeof(void*)) == 0)
+			found = &s_traces[i];
+	}
+	if (!found && s_traceCount < MaxTraces)
+	{
+		found = &s_traces[s_traceCount++];
+		*found = trace;
+		found->count = 0;
+		found->bytes = 0;
+	}
+	if (found)
+	{
+		found->count++;
+		found->bytes += size;
+	}
+	t_inTrace = false;
+}
+
+// Function name for a return address, with file and line where the platform has them
+static std::string FrameName(void* address)
+{
+#ifdef _WIN32
+	static bool initialized = SymInitialize(GetCurrentProcess(), nullptr, TRUE);
+	if (!initialized)
+		return std::to_string(reinterpret_cast<uintptr_t>(address));
+
+	alignas(SYMBOL_INFO) char buffer[sizeof(SYMBOL_INFO) + 256];
+	SYMBOL_INFO* symbol = reinterpret_cast<SYMBOL_INFO*>(buffer);
+	symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+	symbol->MaxNameLen = 255;
+	DWORD64 displacement = 0;
+	if (!SymFromAddr(GetCurrentProcess(), (DWORD64)address, &displacement, symbol))
+		return std::to_string(reinterpret_cast<uintptr_t>(address));
+
+	std::string name = symbol->Name;
+	IMAGEHLP_LINE64 line = {};
+	line.SizeOfStruct = sizeof(line);
+	DWORD lineDisplacement = 0;
+	if (SymGetLineFromAddr64(GetCurrentProcess(), (DWORD64)address, &lineDisplacement, &line))
+		name += std::string(" (") + line.FileName + ":" + std::to_string(line.LineNumber) + ")";
+	return name;
+#elif HAS_BACKTRACE
+	// module(mangled+offset) [address]
+	char** symbols = backtrace_symbols(&address, 1);
+	if (!symbols)
+		return "?";
+	std::string text = symbols[0];
+	std::free(symbols);
+
+	size_t open = text.find('('),
+		   plus = text.find('+', open);
+	if (open == std::string::npos || plus == std::string::npos || plus == open + 1)
+		return text;
+
+	std::string mangled = text.substr(open + 1, plus - open - 1);
+	int32_t status = 0;
+	char* demangled = abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+	if (status != 0 || !demangled)
+		return mangled;
+	std::string name = demangled;
+	std::free(demangled);
+	return name;
+#else
+	return std::to_string(reinterpret_cast<uintptr_t>(address));
+#endif
+}
+
+// The tracker's own frames and operator new say nothing about the caller
+static bool IsAllocatorFrame(const std::string& name)
+{
+	return name.find("MemoryTracker") != std::string::npos || name.find("TraceAllocation") != std::string::npos
+		|| name.find("CaptureStack") != std::string::npos || name.find("NewOrThrow") != std::string::npos
+		|| name.find("operator new") != std::string::npos;
+}
+
+MemoryTag MemoryTracker::CurrentTag()
+{
+	return t_tag;
+}
+
+void MemoryTracker::SetCurrentTag(MemoryTag tag)
+{
+	t_tag = tag;
+}
+
+void* MemoryTracker::Allocate(size_t size, size_t alignment)
+{
+	size_t padding = sizeof(AllocationHeader);
+	if (alignment > padding)
+		padding = alignment + sizeof(AllocationHeader);
+
+	uint8_t* block = static_cast<uint8_t*>(std::malloc(size + padding));
+	if (!block)
+		return nullptr;
+
+	uintptr_t user = reinterpret_cast<uintptr_t>(block) + sizeof(AllocationHeader);
+	if (alignment > sizeof(AllocationHeader))
+		user = (user + alignment - 1) & ~(uintptr_t)(alignment - 1);
+
+	AllocationHeader* header = reinterpret_cast<AllocationHeader*>(user) - 1;
+	header->size = size;
+	header->offset = (uint32_t)(user - reinterpret_cast<uintptr_t>(block));
+	header->tag = (uint32_t)t_tag;
+
+	CpuCounters& counters = s_cpu[header->tag];
+	int64_t bytes = counters.bytes.fetch_add((int64_t)size, std::memory_order_relaxed) + (int64_t)size;
+	RaisePeak(counters.peak, bytes);
+	counters.live.fetch_add(1, std::memory_order_relaxed);
+	counters.total.fetch_add(1, std::memory_order_relaxed);
+
+	if (s_tracing.load(std::memory_order_relaxed))
+		TraceAllocation(size);
+	return reinterpret_cast<void*>(user);
+}
+
+void* MemoryTracker::Reallocate(void* memory, size_t size)
+{
+	if (!memory)
+		return Allocate(size);
+
+	const AllocationHeader* header = static_cast<const AllocationHeader*>(memory) - 1;
+	void* moved = Allocate(size);
+	if (moved)
+	{
+		std::memcpy(moved, memory, (size_t)std::min<uint64_t>(header->size, size));
+		Free(memory);
+	}
+	return moved;
+}
+
+void MemoryTracker::Free(void* memory)
+{
+	if (!memory)
+		return;
+
+	const AllocationHeader* header = static_cast<const AllocationHeader*>(memory) - 1;
+	CpuCounters& counters = s_cpu[header->tag];
+	counters.bytes.fetch_sub((int64_t)header->size, std::memory_order_relaxed);
+	counters.live.fetch_sub(1, std::memory_order_relaxed);
+	std::free(static_cast<uint8_t*>(memory) - header->offset);
+}
+
+void MemoryTracker::TrackGpu(GpuResource kind, uint32_t id, size_t bytes, MemoryTag tag, const char* label)
+{
+	if (id == 0)
+		return;
+
+	// The table's own nodes are bookkeeping, not the caller's memory
+	MemoryScope scope(MemoryTag::Untagged);
+	GpuTable& gpu = Gpu();
+	std::lock_guard<std::mutex> lock(gpu.mutex);
+	GpuObject& object = gpu.objects[GpuKey(kind, id)];
+	if (object.label)
+	{
+		// Storage respecified on a live name replaces the old size
+		gpu.bytes[(size_t)object.tag] -= (int64_t)object.bytes;
+		gpu.count[(size_t)object.tag]--;
+	}
+	object = { bytes, tag, label };
+	gpu.bytes[(size_t)tag] += (int64_t)bytes;
+	gpu.peak[(size_t)tag] = std::max(gpu.peak[(size_t)tag], gpu.bytes[(size_t)tag]);
+	gpu.count[(size_t)tag]++;
+}
+
+void MemoryTracker::UntrackGpu(GpuResource kind, uint32_t id)
+{
+	GpuTable& gpu = Gpu();
+	std::lock_guard<std::mutex> lock(gpu.mutex);
+	auto it = gpu.objects.find(GpuKey(kind, id));
+	if (it == gpu.objects.end())
+		return;
+
+	gpu.bytes[(size_t)it->second.tag] -= (int64_t)it->second.bytes;
+	gpu.count[(size_t)it->second.tag]--;
+	gpu.objects.erase(it);
+}
+
+size_t MemoryTracker::TextureBytes(int32_t width, int32_t height, int32_t layers, uint32_t bytesPerTexel, bool mips)
+{
+	size_t bytes = 0;
+	while (true)
+	{
+		bytes += (size_t)width * height * bytesPerTexel;
+		if (!mips || (width == 1 && height == 1))
+			break;
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+	}
+	return bytes * (size_t)std::max(layers, 1);
+}
+
+int64_t MemoryTracker::AllocationCount()
+{
+	int64_t count = 0;
+	for (const CpuCounters& counters : s_cpu)
+		count += counters.total.load(std::memory_order_relaxed);
+	return count;
+}
+
+void MemoryTracker::TraceAllocations(bool enabled)
+{
+	if (enabled)
+	{
+		// Lets the unwinder load whatever it needs before the frames being traced
+		void* frames[TraceDepth];
+		CaptureStack(frames, TraceDepth);
+	}
+	s_tracing.store(enabled, std::memory_order_relaxed);
+}
+
+uint64_t MemoryTracker::ReportTracedAllocations()
+{
+	s_tracing.store(false, std::memory_order_relaxed);
+
+	std::vector<AllocationTrace> traces;
+	{
+		std::lock_guard<std::mutex> lock(s_traceMutex);
+		traces.assign(s_traces, s_traces + s_traceCount);
+		s_traceCount = 0;
+	}
+	uint64_t traced = s_traced.exchange(0, std::memory_order_relaxed);
+	if (traced == 0)
+		return 0;
+
+	std::sort(traces.begin(), traces.end(), [](const AllocationTrace& a, const AllocationTrace& b) { return a.count > b.count; });
+
+	uint64_t kept = 0;
+	LOG_INFO("Traced " << traced << " allocations from " << traces.size() << " call stacks:");
+	for (const AllocationTrace& trace : traces)
+	{
+		kept += trace.count;
+		LOG_INFO("  " << trace.count << " allocations, " << trace.bytes << " bytes");
+
+		uint32_t printed = 0;
+		for (uint32_t i = 0; i < trace.depth && printed < 12; i++)
+		{
+			std::string name = FrameName(trace.frames[i]);
+			if (printed == 0 && IsAllocatorFrame(name))
+				continue;
+			LOG_INFO("    " << name);
+			printed++;
+		}
+		if (trace.depth == 0)
+			LOG_INFO("    no call stacks on this platform");
+	}
+	if (kept < traced)
+		LOG_INFO("  " << traced - kept << " more from call stacks past the first " << MaxTraces);
+	return traced;
+}
+
+MemoryTagStats MemoryTracker::Stats(MemoryTag tag)
+{
+	const CpuCounters& counters = s_cpu[(size_t)tag];
+	MemoryTagStats stats;
+	stats.cpuBytes = counters.bytes.load(std::memory_order_relaxed);
+	stats.cpuPeak = counters.peak.load(std::memory_order_relaxed);
+	stats.cpuLive = counters.live.load(std::memory_order_relaxed);
+	stats.cpuTotal = counters.total.load(std::memory_order_relaxed);
+
+	GpuTable& gpu = Gpu();
+	std::lock_guard<std::mutex> lock(gpu.mutex);
+	stats.gpuBytes = gpu.bytes[(size_t)tag];
+	stats.gpuPeak = gpu.peak[(size_t)tag];
+	stats.gpuObjects = gpu.count[(size_t)tag];
+	return stats;
+}
+
+const char* MemoryTracker::Name(MemoryTag tag)
+{
+	switch (tag)
+	{
+	case MemoryTag::Untagged: return "untagged";
+	case MemoryTag::Import: return "import";
+	case MemoryTag::Meshes: return "meshes";
+	case MemoryTag::Textures: return "textures";
+	case MemoryTag::Scene: return "scene";
+	case MemoryTag::Render: return "render";
+	case MemoryTag::Count: break;
+	}
+	return "unknown";
+}
+
+void MemoryTracker::Report(const char* title)
+{
+	LOG_INFO("Memory (" << title << ")" << (ENABLE_MEMORY_TRACKING ? "" : ", operator new not tracked") << ":");
+	LOG_INFO("  tag         cpu MB  peak MB      live allocs     total allocs  gpu MB  peak MB  objects");
+
+	MemoryTagStats total;
+	for (uint32_t i = 0; i < (uint32_t)MemoryTag::Count; i++)
+	{
+		MemoryTagStats stats = Stats((MemoryTag)i);
+		total.cpuBytes += stats.cpuBytes;
+		total.cpuPeak += stats.cpuPeak;
+		total.cpuLive += stats.cpuLive;
+		total.cpuTotal += stats.cpuTotal;
+		total.gpuBytes += stats.gpuBytes;
+		total.gpuPeak += stats.gpuPeak;
+		total.gpuObjects += stats.gpuObjects;
+
+		LOG_INFO("  " << std::left << std::setw(9) << Name((MemoryTag)i) << std::right << std::fixed << std::setprecision(2)
+			<< std::setw(9) << ToMB(stats.cpuBytes) << std::setw(9) << ToMB(stats.cpuPeak)
+			<< std::setw(17) << stats.cpuLive << std::setw(17) << stats.cpuTotal
+			<< std::setw(8) << ToMB(stats.gpuBytes) << std::setw(9) << ToMB(stats.gpuPeak) << std::setw(9) << stats.gpuObjects);
+	}
+	// Peaks of different tags need not coincide, so their sum is an upper bound
+	LOG_INFO("  " << std::left << std::setw(9) << "total" << std::right << std::fixed << std::setprecision(2)
+		<< std::setw(9) << ToMB(total.cpuBytes) << std::setw(9) << ToMB(total.cpuPeak)
+		<< std::setw(17) << total.cpuLive << std::setw(17) << total.cpuTotal
+		<< std::setw(8) << ToMB(total.gpuBytes) << std::setw(9) << ToMB(total.gpuPeak) << std::setw(9) << total.gpuObjects);
+}
+
+uint32_t MemoryTracker::ReportLeaks(std::initializer_list<MemoryTag> released)
+{
+	uint32_t leaks = 0;
+	{
+		GpuTable& gpu = Gpu();
+		std::lock_guard<std::mutex> lock(gpu.mutex);
+		for (const auto& entry : gpu.objects)
+		{
+			const GpuObject& object = entry.second;
+			LOG_ERROR("Leaked " << GpuKindName((GpuResource)(entry.first >> 32)) << " " << (uint32_t)entry.first
+				<< " (" << object.label << ", " << Name(object.tag) << "): " << object.bytes << " bytes");
+			leaks++;
+		}
+	}
+
+	for (MemoryTag tag : released)
+	{
+		const CpuCounters& counters = s_cpu[(size_t)tag];
+		int64_t live = counters.live.load(std::memory_order_relaxed);
+		if (live == 0)
+			continue;
+		LOG_ERROR("Leaked " << counters.bytes.load(std::memory_order_relaxed) << " bytes in " << live
+			<< " allocations tagged " << Name(tag));
+		leaks++;
+	}
+
+	if (leaks == 0)
+		LOG_INFO("No memory leaks");
+	return leaks;
+}
+
+#if ENABLE_MEMORY_TRACKING
+
+static void* NewOrThrow(size_t size, size_t alignment)
+{
+	void* memory = MemoryTracker::Allocate(size > 0 ? size : 1, alignment);
+	if (!memory)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new(size_t size) { return NewOrThrow(size, 16); }
+void* operator new[](size_t size) { return NewOrThrow(size, 16); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return MemoryTracker::Allocate(size > 0 ? size : 1); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return MemoryTracker::Allocate(size > 0 ? size : 1); }
+void* operator new(size_t size, std::align_val_t alignment) { return NewOrThrow(size, (size_t)alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return NewOrThrow(size, (size_t)alignment); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return MemoryTracker::Allocate(size > 0 ? size : 1, (size_t)alignment); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return MemoryTracker::Allocate(size > 0 ? size : 1, (size_t)alignment); }
+
+void operator delete(void* memory) noexcept { MemoryTracker::Free(memory); }
+void operator delete[](void* memory) noexcept { MemoryTracker::Free(memory); }
+void operator delete(void* memory, size_t) noexcept { MemoryTracker::Free(memory); }
+void operator delete[](void* memory, size_t) noexcept { MemoryTracker::Free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { MemoryTracker::Free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { MemoryTracker::Free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { MemoryTracker::Free(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { MemoryTracker::Free(memory); }
+void operator delete(void* memory, size_t, std::align_val_t) noexcept { MemoryTracker::Free(memory); }
+void operator delete[](void* memory, size_t, std::align_val_t) noexcept { MemoryTracker::Free(memory); }
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept { MemoryTracker::Free(memory); }
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept { MemoryTracker::Free(memory); }
+
+#endif
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+// Dist builds define ENABLE_MEMORY_TRACKING=0, which leaves the global operator new
+// alone; explicit tags, the stb hooks and GL accounting keep working either way
+#ifndef ENABLE_MEMORY_TRACKING
+#define ENABLE_MEMORY_TRACKING 1
+#endif
+
+// Who an allocation is charged to. Set per thread with MemoryScope.
+enum class MemoryTag : uint32_t
+{
+	Untagged,
+	Import,		// assimp and file parsing while loading
+	Meshes,		// vertex and index data
+	Textures,	// decoded texels
+	Scene,		// hierarchy, acceleration structures, entities
+	Render,		// renderer state and render targets
+	Count
+};
+
+enum class GpuResource : uint32_t
+{
+	Buffer,
+	Texture,
+	Renderbuffer
+};
+
+struct MemoryTagStats
+{
+	int64_t cpuBytes = 0;
+	int64_t cpuPeak = 0;
+	int64_t cpuLive = 0;		// allocations not yet freed
+	int64_t cpuTotal = 0;		// allocations ever made
+	int64_t gpuBytes = 0;
+	int64_t gpuPeak = 0;
+	uint32_t gpuObjects = 0;
+};
+
+// Byte counts per tag for the heap and for GL objects. Every allocation through the
+// global operator new carries a small header with its size and tag, so freeing charges
+// the tag it was made under no matter which thread frees it. GL sizes are what we asked
+// the driver for, not what it actually reserves.
+class MemoryTracker
+{
+public:
+	static MemoryTag CurrentTag();
+	static void SetCurrentTag(MemoryTag tag);
+
+	// Tracked heap memory, tagged with the calling thread's current tag
+	static void* Allocate(size_t size, size_t alignment = 16);
+	static void* Reallocate(void* memory, size_t size);
+	static void Free(void* memory);
+
+	static void TrackGpu(GpuResource kind, uint32_t id, size_t bytes, MemoryTag tag, const char* label);
+	static void UntrackGpu(GpuResource kind, uint32_t id);
+	// Layers times the mip chain, if any
+	static size_t TextureBytes(int32_t width, int32_t height, int32_t layers, uint32_t bytesPerTexel, bool mips);
+
+	// Heap allocations ever made, over all tags and threads
+	static int64_t AllocationCount();
+	// While on, every tracked allocation on any thread records its call stack, to find
+	// who allocates where nothing should. Only distinct stacks are kept.
+	static void TraceAllocations(bool enabled);
+	// Turns tracing off, prints the distinct call stacks most frequent first and forgets
+	// them. Returns how many allocations were traced.
+	static uint64_t ReportTracedAllocations();
+	static MemoryTagStats Stats(MemoryTag tag);
+	static const char* Name(MemoryTag tag);
+
+	// Current and high-water bytes per tag
+	static void Report(const char* title);
+	// GL objects still alive, and heap memory left under tags whose owners were all
+	// released. Returns how many leaks were found.
+	static uint32_t ReportLeaks(std::initializer_list<MemoryTag> released);
+};
+
+// Charges allocations on this thread to a tag until the scope ends
+class MemoryScope
+{
+public:
+	explicit MemoryScope(MemoryTag tag) : m_previous(MemoryTracker::CurrentTag()) { MemoryTracker::SetCurrentTag(tag); }
+	~MemoryScope() { MemoryTracker::SetCurrentTag(m_previous); }
+
+	MemoryScope(const MemoryScope&) = delete;
+	MemoryScope& operator=(const MemoryScope&) = delete;
+
+private:
+	MemoryTag m_previous;
+};
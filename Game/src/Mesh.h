@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "MemoryTracker.h"
+#include "Shader.h"
+
+struct Vertex
+{
+	glm::vec3 Position;
+	glm::vec3 Normal;
+	glm::vec3 TexCoords;
+};
+
+struct Texture 
+{
+	uint32_t id;
+	std::string type;
+	std::string path;
+};
+
+class Mesh {
+public:
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<Texture> textures;
+	glm::vec3 boundsMin = glm::vec3(0.0f);	// local space
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+
+	// Without upload only the CPU copies exist, for the software rasterizer and tools
+	Mesh(std::vector<Vertex> vertices, std::vector<uint32_t> indices, std::vector<Texture> textures, bool upload = true)
+	{
+		this->vertices = std::move(vertices);
+		this->indices = std::move(indices);
+		this->textures = std::move(textures);
+		indexCount = (uint32_t)this->indices.size();
+
+		if (!this->vertices.empty())
+		{
+			boundsMin = boundsMax = this->vertices[0].Position;
+			for (const Vertex& vertex : this->vertices)
+			{
+				boundsMin = glm::min(boundsMin, vertex.Position);
+				boundsMax = glm::max(boundsMax, vertex.Position);
+			}
+		}
+
+		NameSamplers();
+		if (upload)
+			SetupMesh();
+	};
+
+	void Draw(Shader &shader)
+	{
+		for (uint32_t i = 0; i < (uint32_t)textures.size(); i++)
+		{
+			glActiveTexture(GL_TEXTURE0 + i);
+			shader.SetUniformInt(samplerNames[i], i);
+			glBindTexture(GL_TEXTURE_2D, textures[i].id);
+		}
+
+		glActiveTexture(GL_TEXTURE0);
+
+		// draw mesh 
+		glBindVertexArray(VAO);
+		glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+		glBindVertexArray(0);
+	};
+
+	uint32_t GetVAO() const { return VAO; }
+	// Stays valid after ReleaseCpuData
+	uint32_t IndexCount() const { return indexCount; }
+
+	// Once uploaded, the GPU has its own copy; the vectors are only kept for CPU
+	// consumers like the BVH, occluders and the software rasterizer
+	void ReleaseCpuData()
+	{
+		if (!VAO)
+			return;
+		std::vector<Vertex>().swap(vertices);
+		std::vector<uint32_t>().swap(indices);
+	}
+
+	void Destroy()
+	{
+		if (!VAO)
+			return;
+		MemoryTracker::UntrackGpu(GpuResource::Buffer, VBO);
+		MemoryTracker::UntrackGpu(GpuResource::Buffer, EBO);
+		glDeleteBuffers(1, &VBO);
+		glDeleteBuffers(1, &EBO);
+		glDeleteVertexArrays(1, &VAO);
+		VAO = VBO = EBO = 0;
+	}
+private:
+	uint32_t VAO = 0, VBO = 0, EBO = 0;
+	uint32_t indexCount = 0;
+	std::vector<std::string> samplerNames;	// material.texture_diffuse1 and so on, one per texture
+
+	// Draw used to build these strings for every texture of every draw
+	void NameSamplers()
+	{
+		int32_t diffuseNr = 1, 
+				specularNr = 1;
+		samplerNames.reserve(textures.size());
+		for (const Texture& texture : textures)
+		{
+			std::string number;
+			if (texture.type == "texture_diffuse")
+				number = std::to_string(diffuseNr++);
+			else if (texture.type == "texture_specular")
+				number = std::to_string(specularNr++);
+			samplerNames.push_back("material." + texture.type + number);
+		}
+	}
+
+	void SetupMesh()
+	{
+		glGenVertexArrays(1, &VAO);
+		glGenBuffers(1, &VBO);
+		glGenBuffers(1, &EBO);
+
+
+		glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(int32_t), &indices[0], GL_STATIC_DRAW);
+		MemoryTracker::TrackGpu(GpuResource::Buffer, VBO, vertices.size() * sizeof(Vertex), MemoryTag::Meshes, "mesh vertices");
+		MemoryTracker::TrackGpu(GpuResource::Buffer, EBO, indices.size() * sizeof(int32_t), MemoryTag::Meshes, "mesh indices");
+
+		// vert pos
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+		// vert norm
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+		// vert tex coords
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+
+		glBindVertexArray(0);
+	};
+};
@@ -0,0 +1,358 @@
+#include "Model.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "Log.h"
+#include "MemoryTracker.h"
+#include "Profiler.h"
+
+// Decoded images are charged to whatever tag the caller runs under
+#define STBI_MALLOC(size) MemoryTracker::Allocate(size)
+#define STBI_REALLOC(memory, size) MemoryTracker::Reallocate(memory, size)
+#define STBI_FREE(memory) MemoryTracker::Free(memory)
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+static glm::mat4 ToGlm(const aiMatrix4x4& m)
+{
+	// Assimp matrices are row major
+	return glm::mat4(
+		m.a1, m.b1, m.c1, m.d1,
+		m.a2, m.b2, m.c2, m.d2,
+		m.a3, m.b3, m.c3, m.d3,
+		m.a4, m.b4, m.c4, m.d4
+	);
+}
+
+uint32_t TextureFromFile(const std::string& file)
+{
+	PROFILE_ZONE("Load texture");
+	MemoryScope scope(MemoryTag::Textures);
+
+	int32_t width, height, components;
+	uint8_t* data = nullptr;
+	{
+		PROFILE_ZONE("Decode texture");
+		data = stbi_load(file.c_str(), &width, &height, &components, 0);
+	}
+	if (!data)
+	{
+		LOG_ERROR("Failed to load texture: " << file);
+		return 0;
+	}
+
+	uint32_t id = TextureFromPixels(width, height, components, data);
+	stbi_image_free(data);
+
+	return id;
+}
+
+uint32_t TextureFromPixels(int32_t width, int32_t height, int32_t components, const uint8_t* data)
+{
+	GLenum format = GL_RGBA;
+	if (components == 1)
+		format = GL_RED;
+	else if (components == 3)
+		format = GL_RGB;
+
+	PROFILE_ZONE("Upload texture");
+	uint32_t id;
+	glGenTextures(1, &id);
+	glBindTexture(GL_TEXTURE_2D, id);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	MemoryTracker::TrackGpu(GpuResource::Texture, id, MemoryTracker::TextureBytes(width, height, 1, components == 3 ? 4 : components, true),
+		MemoryTag::Textures, "model texture");
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	return id;
+}
+
+void Model::Build(const aiScene* scene, const std::string& directory, bool upload)
+{
+	PROFILE_ZONE("Build model");
+	this->directory = directory;
+	this->upload = upload;
+
+	{
+		MemoryScope scope(MemoryTag::Meshes);
+		meshes.reserve(scene->mNumMeshes);
+		for (uint32_t i = 0; i < scene->mNumMeshes; i++)
+			meshes.push_back(ProcessMesh(scene->mMeshes[i], scene));
+	}
+
+	PROFILE_ZONE("Process nodes");
+	ProcessNode(scene->mRootNode, TransformHierarchy::NoParent);
+	UpdateBounds();
+	ProcessLights(scene);
+}
+
+void Model::Build(const BakedScene& scene, const std::string& directory, bool upload)
+{
+	PROFILE_ZONE("Build model");
+	this->directory = directory;
+	this->upload = upload;
+
+	// Materials share textures, upload each once
+	textures_loaded.resize(scene.textures.size());
+	for (uint32_t i = 0; i < (uint32_t)scene.textures.size(); i++)
+	{
+		const BakedTexture& baked = scene.textures[i];
+		textures_loaded[i].id = upload ? TextureFromPixels(baked.width, baked.height, 4, reinterpret_cast<const uint8_t*>(baked.texels.data())) : 0;
+		textures_loaded[i].path = baked.name;
+	}
+
+	{
+		MemoryScope scope(MemoryTag::Meshes);
+		meshes.reserve(scene.meshes.size());
+		for (const BakedMesh& baked : scene.meshes)
+		{
+			std::vector<Texture> textures;
+			if (baked.material < scene.materials.size())
+			{
+				const BakedMaterial& material = scene.materials[baked.material];
+				const std::pair<int32_t, const char*> slots[] = { { material.diffuse, "texture_diffuse" }, { material.specular, "texture_specular" }, { material.normal, "texture_normal" } };
+				for (const auto& slot : slots)
+				{
+					if (slot.first < 0)
+						continue;
+					Texture texture = textures_loaded[slot.first];
+					texture.type = slot.second;
+					textures.push_back(texture);
+				}
+			}
+			meshes.push_back(Mesh(baked.vertices, baked.indices, std::move(textures), upload));
+		}
+	}
+
+	PROFILE_ZONE("Process nodes");
+	nodes.Reserve((uint32_t)scene.nodes.size());
+	for (const BakedNode& node : scene.nodes)
+		nodes.AddNode(node.parent, node.local, node.name);
+
+	instances.reserve(scene.instances.size());
+	for (const BakedInstance& baked : scene.instances)
+	{
+		MeshInstance instance = { baked.mesh, glm::mat4(1.0f) };
+		instance.node = baked.node;
+		instances.push_back(instance);
+	}
+
+	UpdateBounds();
+	lights = scene.lights;
+}
+
+void Model::ReleaseCpuMeshes()
+{
+	for (Mesh& mesh : meshes)
+		mesh.ReleaseCpuData();
+}
+
+void Model::Release()
+{
+	for (Mesh& mesh : meshes)
+		mesh.Destroy();
+	for (const Texture& texture : textures_loaded)
+	{
+		if (!texture.id)
+			continue;
+		MemoryTracker::UntrackGpu(GpuResource::Texture, texture.id);
+		glDeleteTextures(1, &texture.id);
+	}
+
+	meshes = std::vector<Mesh>();
+	instances = std::vector<MeshInstance>();
+	textures_loaded = std::vector<Texture>();
+	lights = std::vector<Light>();
+	nodes = TransformHierarchy();
+	instanceBounds = BoundsSoA();
+}
+
+// World matrices and bounds of every instance, then the whole model's
+void Model::UpdateBounds()
+{
+	nodes.Update();
+
+	boundsMin = glm::vec3(FLT_MAX);
+	boundsMax = glm::vec3(-FLT_MAX);
+	for (MeshInstance& instance : instances)
+	{
+		instance.transform = nodes.World(instance.node);
+		ExpandBounds(meshes[instance.mesh], instance);
+	}
+
+	instanceBounds.Resize((uint32_t)instances.size());
+	for (uint32_t i = 0; i < (uint32_t)instances.size(); i++)
+		instanceBounds.Set(i, instances[i].boundsMin, instances[i].boundsMax);
+
+	if (instances.empty())
+	{
+		boundsMin = glm::vec3(0.0f);
+		boundsMax = glm::vec3(0.0f);
+	}
+}
+
+void Model::ProcessLights(const aiScene* scene)
+{
+	float sceneRadius = glm::max(glm::length(boundsMax - boundsMin) * 0.5f, 1.0f);
+
+	for (uint32_t i = 0; i < scene->mNumLights; i++)
+	{
+		const aiLight* source = scene->mLights[i];
+		// Directional lights stay with the constant sun in the shader; area and ambient are not supported
+		if (source->mType != aiLightSource_POINT && source->mType != aiLightSource_SPOT)
+			continue;
+
+		uint32_t node = nodes.Find(source->mName.C_Str());
+		glm::mat4 transform = node != TransformHierarchy::NoParent ? nodes.World(node) : glm::mat4(1.0f);
+
+		Light light;
+		light.type = source->mType == aiLightSource_SPOT ? LightType::Spot : LightType::Point;
+		light.position = glm::vec3(transform * glm::vec4(source->mPosition.x, source->mPosition.y, source->mPosition.z, 1.0f));
+		light.direction = glm::normalize(glm::mat3(transform) * glm::vec3(source->mDirection.x, source->mDirection.y, source->mDirection.z));
+		if (!std::isfinite(light.direction.x))
+			light.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+
+		glm::vec3 color(source->mColorDiffuse.r, source->mColorDiffuse.g, source->mColorDiffuse.b);
+		light.intensity = glm::max(color.r, glm::max(color.g, color.b));
+		light.color = light.intensity > 0.0f ? color / light.intensity : glm::vec3(1.0f);
+
+		// Range where the attenuated light drops below 1/256 of its intensity
+		float c = source->mAttenuationConstant;
+		float l = source->mAttenuationLinear;
+		float q = source->mAttenuationQuadratic;
+		float target = 256.0f * light.intensity;
+		if (q > 0.0f)
+			light.range = (-l + std::sqrt(l * l - 4.0f * q * (c - target))) / (2.0f * q);
+		else if (l > 0.0f)
+			light.range = (target - c) / l;
+		else
+			light.range = sceneRadius * 0.25f;
+		light.range = glm::clamp(light.range, sceneRadius * 0.001f, sceneRadius * 4.0f);
+
+		if (light.type == LightType::Spot)
+		{
+			light.outerCos = std::cos(glm::max(source->mAngleOuterCone, 0.001f) * 0.5f);
+			light.innerCos = std::cos(glm::clamp(source->mAngleInnerCone, 0.0f, source->mAngleOuterCone) * 0.5f);
+		}
+
+		lights.push_back(light);
+	}
+}
+
+// Depth first, which is the order the hierarchy needs
+void Model::ProcessNode(const aiNode* node, uint32_t parent)
+{
+	uint32_t index = nodes.AddNode(parent, ToGlm(node->mTransformation), node->mName.C_Str());
+
+	for (uint32_t i = 0; i < node->mNumMeshes; i++)
+	{
+		MeshInstance instance = { node->mMeshes[i], glm::mat4(1.0f) };
+		instance.node = index;
+		instances.push_back(instance);
+	}
+
+	for (uint32_t i = 0; i < node->mNumChildren; i++)
+		ProcessNode(node->mChildren[i], index);
+}
+
+Mesh Model::ProcessMesh(const aiMesh* mesh, const aiScene* scene)
+{
+	PROFILE_ZONE("Process mesh");
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<Texture> textures;
+
+	vertices.reserve(mesh->mNumVertices);
+	for (uint32_t i = 0; i < mesh->mNumVertices; i++)
+	{
+		Vertex vertex;
+		vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+		vertex.Normal = mesh->HasNormals()
+			? glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z)
+			: glm::vec3(0.0f, 1.0f, 0.0f);
+		vertex.TexCoords = mesh->mTextureCoords[0]
+			? glm::vec3(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y, 0.0f)
+			: glm::vec3(0.0f);
+		vertices.push_back(vertex);
+	}
+
+	indices.reserve(mesh->mNumFaces * 3);
+	for (uint32_t i = 0; i < mesh->mNumFaces; i++)
+	{
+		const aiFace& face = mesh->mFaces[i];
+		for (uint32_t j = 0; j < face.mNumIndices; j++)
+			indices.push_back(face.mIndices[j]);
+	}
+
+	const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+	std::vector<Texture> diffuse = LoadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+	textures.insert(textures.end(), diffuse.begin(), diffuse.end());
+	std::vector<Texture> specular = LoadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+	textures.insert(textures.end(), specular.begin(), specular.end());
+	std::vector<Texture> normal = LoadMaterialTextures(material, aiTextureType_NORMALS, "texture_normal");
+	textures.insert(textures.end(), normal.begin(), normal.end());
+
+	return Mesh(std::move(vertices), std::move(indices), std::move(textures), upload);
+}
+
+std::vector<Texture> Model::LoadMaterialTextures(const aiMaterial* material, aiTextureType type, const std::string& typeName)
+{
+	std::vector<Texture> textures;
+	for (uint32_t i = 0; i < material->GetTextureCount(type); i++)
+	{
+		aiString str;
+		material->GetTexture(type, i, &str);
+
+		// Exporters like to write absolute paths from the artist's machine, look next to the scene instead
+		std::string path = str.C_Str();
+		size_t slash = path.find_last_of("/\\");
+		if (slash != std::string::npos)
+			path = path.substr(slash + 1);
+
+		bool skip = false;
+		for (const Texture& loaded : textures_loaded)
+		{
+			if (loaded.path == path)
+			{
+				textures.push_back(loaded);
+				skip = true;
+				break;
+			}
+		}
+		if (skip)
+			continue;
+
+		Texture texture;
+		texture.id = upload ? TextureFromFile(directory + "/" + path) : 0;
+		texture.type = typeName;
+		texture.path = path;
+		textures.push_back(texture);
+		textures_loaded.push_back(texture);
+	}
+
+	return textures;
+}
+
+void Model::ExpandBounds(const Mesh& mesh, MeshInstance& instance)
+{
+	// Transforming every vertex is tighter than transforming the mesh's box
+	instance.boundsMin = glm::vec3(FLT_MAX);
+	instance.boundsMax = glm::vec3(-FLT_MAX);
+	for (const Vertex& vertex : mesh.vertices)
+	{
+		glm::vec3 p = glm::vec3(instance.transform * glm::vec4(vertex.Position, 1.0f));
+		instance.boundsMin = glm::min(instance.boundsMin, p);
+		instance.boundsMax = glm::max(instance.boundsMax, p);
+	}
+
+	boundsMin = glm::min(boundsMin, instance.boundsMin);
+	boundsMax = glm::max(boundsMax, instance.boundsMax);
+}
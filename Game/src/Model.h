@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <assimp/scene.h>
+
+#include "BakedScene.h"
+#include "FrustumCulling.h"
+#include "Light.h"
+#include "Mesh.h"
+#include "TransformHierarchy.h"
+
+// One placement of a mesh in the world
+struct MeshInstance
+{
+	uint32_t mesh;
+	glm::mat4 transform;	// world matrix of the node
+	glm::vec3 boundsMin = glm::vec3(0.0f);	// world space
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+	uint32_t node = TransformHierarchy::NoParent;
+};
+
+class Model
+{
+public:
+	std::vector<Mesh> meshes;
+	std::vector<MeshInstance> instances;
+	TransformHierarchy nodes;	// the imported node tree
+	BoundsSoA instanceBounds;	// the instances' world bounds again, for the SIMD culler
+	std::vector<Light> lights;	// point and spot lights, world space
+	std::string directory;
+
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+
+	// Builds GPU meshes and textures from an imported scene. Needs a current GL context
+	// unless upload is false, which keeps only the CPU side for the software rasterizer.
+	void Build(const aiScene* scene, const std::string& directory, bool upload = true);
+	// Same from a baked or generated scene, whose textures are already decoded
+	void Build(const BakedScene& scene, const std::string& directory, bool upload = true);
+
+	// Frees the CPU vertex and index copies of meshes the GPU already has
+	void ReleaseCpuMeshes();
+	// Deletes the GL meshes and textures and empties the model. Needs the GL context.
+	void Release();
+
+private:
+	std::vector<Texture> textures_loaded;
+	bool upload = true;
+
+	void ProcessNode(const aiNode* node, uint32_t parent);
+	Mesh ProcessMesh(const aiMesh* mesh, const aiScene* scene);
+	std::vector<Texture> LoadMaterialTextures(const aiMaterial* material, aiTextureType type, const std::string& typeName);
+	void ExpandBounds(const Mesh& mesh, MeshInstance& instance);
+	void UpdateBounds();
+	void ProcessLights(const aiScene* scene);
+};
+
+uint32_t TextureFromFile(const std::string& file);
+// 8 bit texels with 1, 3 or 4 components, rows top down
+uint32_t TextureFromPixels(int32_t width, int32_t height, int32_t components, const uint8_t* data);
@@ -0,0 +1,509 @@
+#include "OcclusionCulling.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "FramePacer.h"
+#include "Profiler.h"
+
+static constexpr uint32_t FullMask = 0xFFFFFFFFu;
+static constexpr float EmptyLayer = FLT_MAX;
+
+// Subtile origins inside a tile: four across, two down
+static const float SubtileX[8] = { 0.0f, 8.0f, 16.0f, 24.0f, 0.0f, 8.0f, 16.0f, 24.0f };
+static const float SubtileY[8] = { 0.0f, 0.0f, 0.0f, 0.0f, 4.0f, 4.0f, 4.0f, 4.0f };
+
+void OcclusionCuller::AddOccluder(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices)
+{
+	Occluder occluder;
+	occluder.firstVertex = (uint32_t)m_positions.size();
+	occluder.vertexCount = (uint32_t)positions.size();
+	occluder.firstTriangle = (uint32_t)m_triangles.size();
+	occluder.triangleCount = (uint32_t)(indices.size() / 3);
+	occluder.boundsMin = glm::vec3(FLT_MAX);
+	occluder.boundsMax = glm::vec3(-FLT_MAX);
+
+	for (const glm::vec3& position : positions)
+	{
+		m_positions.push_back(position);
+		occluder.boundsMin = glm::min(occluder.boundsMin, position);
+		occluder.boundsMax = glm::max(occluder.boundsMax, position);
+	}
+	for (uint32_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		m_triangles.push_back(glm::uvec3(indices[i], indices[i + 1], indices[i + 2]) + occluder.firstVertex);
+		m_triangleOccluder.push_back((uint32_t)m_occluders.size());
+	}
+
+	m_occluders.push_back(occluder);
+}
+
+void OcclusionCuller::SelectOccluders(const Model& model, uint32_t maxTriangles)
+{
+	PROFILE_ZONE("Select occluders");
+	float sceneSize = glm::max(glm::length(model.boundsMax - model.boundsMin), 1e-3f);
+
+	// Big in the world relative to how many triangles it costs
+	struct Candidate
+	{
+		uint32_t instance;
+		float size;
+	};
+	std::vector<Candidate> candidates;
+	for (uint32_t i = 0; i < (uint32_t)model.instances.size(); i++)
+	{
+		const MeshInstance& instance = model.instances[i];
+		const Mesh& mesh = model.meshes[instance.mesh];
+		uint32_t triangles = (uint32_t)(mesh.indices.size() / 3);
+		if (triangles == 0 || triangles > maxTriangles / 4 || instance.boundsMin.x > instance.boundsMax.x)
+			continue;
+
+		float size = glm::length(instance.boundsMax - instance.boundsMin);
+		if (size >= sceneSize * 0.05f)
+			candidates.push_back({ i, size / std::sqrt((float)triangles) });
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.size > b.size; });
+
+	std::vector<glm::vec3> positions;
+	for (const Candidate& candidate : candidates)
+	{
+		const MeshInstance& instance = model.instances[candidate.instance];
+		const Mesh& mesh = model.meshes[instance.mesh];
+		if (m_triangles.size() + mesh.indices.size() / 3 > maxTriangles)
+			continue;
+
+		positions.resize(mesh.vertices.size());
+		for (size_t v = 0; v < mesh.vertices.size(); v++)
+			positions[v] = glm::vec3(instance.transform * glm::vec4(mesh.vertices[v].Position, 1.0f));
+		AddOccluder(positions, mesh.indices);
+	}
+}
+
+void OcclusionCuller::TransformVertices(uint32_t begin, uint32_t end, const glm::mat4& viewProjection, float nearPlane)
+{
+	for (uint32_t i = begin; i < end; i++)
+	{
+		glm::vec4 clip = viewProjection * glm::vec4(m_positions[i], 1.0f);
+		ScreenVertex& vertex = m_screen[i];
+		vertex.valid = clip.w > nearPlane;
+		float invW = vertex.valid ? 1.0f / clip.w : 0.0f;
+		vertex.x = (clip.x * invW * 0.5f + 0.5f) * (float)Width;
+		vertex.y = (clip.y * invW * 0.5f + 0.5f) * (float)Height;
+		vertex.z = invW;
+	}
+}
+
+void OcclusionCuller::SetupTriangles(uint32_t begin, uint32_t end)
+{
+	for (uint32_t t = begin; t < end; t++)
+	{
+		Setup& setup = m_setup[t];
+		setup.valid = false;
+		if (!m_occluderActive[m_triangleOccluder[t]])
+			continue;
+
+		const glm::uvec3& triangle = m_triangles[t];
+		ScreenVertex v[3] = { m_screen[triangle.x], m_screen[triangle.y], m_screen[triangle.z] };
+		if (!v[0].valid || !v[1].valid || !v[2].valid)
+			continue;
+
+		// Both windings occlude; make it counter clockwise so the inside is on the left of every edge
+		float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[2].x - v[0].x) * (v[1].y - v[0].y);
+		if (std::abs(area) < 1e-6f)
+			continue;
+		if (area < 0.0f)
+		{
+			std::swap(v[1], v[2]);
+			area = -area;
+		}
+
+		float xMin = std::min(v[0].x, std::min(v[1].x, v[2].x));
+		float xMax = std::max(v[0].x, std::max(v[1].x, v[2].x));
+		setup.yMin = std::min(v[0].y, std::min(v[1].y, v[2].y));
+		setup.yMax = std::max(v[0].y, std::max(v[1].y, v[2].y));
+		if (xMax < 0.0f || xMin >= (float)Width || setup.yMax < 0.0f || setup.yMin >= (float)Height)
+			continue;
+
+		setup.tileMinX = (uint16_t)std::max(0.0f, xMin / TileWidth);
+		setup.tileMaxX = (uint16_t)std::min((float)(TilesX - 1), xMax / TileWidth);
+		setup.tileMinY = (uint16_t)std::max(0.0f, setup.yMin / TileHeight);
+		setup.tileMaxY = (uint16_t)std::min((float)(TilesY - 1), setup.yMax / TileHeight);
+
+		// E(p) = a x + b y + c >= 0 inside. Horizontal edges lie on the bounding rows, which yMin/yMax cover.
+		for (uint32_t e = 0; e < 3; e++)
+		{
+			const ScreenVertex& p0 = v[e];
+			const ScreenVertex& p1 = v[(e + 1) % 3];
+			float a = p0.y - p1.y;
+			float b = p1.x - p0.x;
+			float c = -(a * p0.x + b * p0.y);
+			if (a == 0.0f)
+			{
+				setup.kind[e] = EdgeKind::None;
+				setup.slope[e] = 0.0f;
+				setup.offset[e] = 0.0f;
+				continue;
+			}
+			setup.kind[e] = a > 0.0f ? EdgeKind::Left : EdgeKind::Right;
+			setup.slope[e] = -b / a;
+			setup.offset[e] = -c / a;
+		}
+
+		// z = z0 + zx x + zy y through the three vertices
+		float dx1 = v[1].x - v[0].x, dy1 = v[1].y - v[0].y, dz1 = v[1].z - v[0].z;
+		float dx2 = v[2].x - v[0].x, dy2 = v[2].y - v[0].y, dz2 = v[2].z - v[0].z;
+		setup.zx = (dz1 * dy2 - dz2 * dy1) / area;
+		setup.zy = (dz2 * dx1 - dz1 * dx2) / area;
+		setup.z0 = v[0].z - setup.zx * v[0].x - setup.zy * v[0].y;
+		setup.zMin = std::min(v[0].z, std::min(v[1].z, v[2].z));
+		setup.valid = true;
+	}
+}
+
+#ifdef __AVX2__
+
+void OcclusionCuller::RasterizeTile(const Setup& setup, Tile& tile, uint32_t tileX, uint32_t tileY)
+{
+	__m256 laneX = _mm256_add_ps(_mm256_loadu_ps(SubtileX), _mm256_set1_ps((float)(tileX * TileWidth)));
+	__m256 laneY = _mm256_add_ps(_mm256_loadu_ps(SubtileY), _mm256_set1_ps((float)(tileY * TileHeight)));
+	__m256 yMin = _mm256_set1_ps(setup.yMin);
+	__m256 yMax = _mm256_set1_ps(setup.yMax);
+	__m256 zero = _mm256_setzero_ps();
+	__m256 eight = _mm256_set1_ps(8.0f);
+	__m256 half = _mm256_set1_ps(0.5f);
+	__m256i rowBits = _mm256_set1_epi32(0xFF);
+
+	// Each row of a subtile is the span between the rightmost left edge and the leftmost right edge
+	__m256i coverage = _mm256_setzero_si256();
+	for (uint32_t row = 0; row < 4; row++)
+	{
+		__m256 y = _mm256_add_ps(laneY, _mm256_set1_ps(row + 0.5f));
+		__m256 start = zero;
+		__m256 end = eight;
+		for (uint32_t e = 0; e < 3; e++)
+		{
+			if (setup.kind[e] == EdgeKind::None)
+				continue;
+
+			__m256 x = _mm256_sub_ps(_mm256_fmadd_ps(_mm256_set1_ps(setup.slope[e]), y, _mm256_set1_ps(setup.offset[e])), laneX);
+			x = _mm256_sub_ps(x, half);
+			if (setup.kind[e] == EdgeKind::Left)
+				start = _mm256_max_ps(start, _mm256_ceil_ps(x));
+			else
+				end = _mm256_min_ps(end, _mm256_add_ps(_mm256_floor_ps(x), _mm256_set1_ps(1.0f)));
+		}
+		start = _mm256_min_ps(start, eight);
+		end = _mm256_max_ps(end, zero);
+
+		__m256i first = _mm256_sllv_epi32(rowBits, _mm256_cvttps_epi32(start));
+		__m256i past = _mm256_sllv_epi32(rowBits, _mm256_cvttps_epi32(end));
+		__m256i bits = _mm256_and_si256(_mm256_andnot_si256(past, first), rowBits);
+
+		__m256 inside = _mm256_and_ps(_mm256_cmp_ps(y, yMin, _CMP_GE_OQ), _mm256_cmp_ps(y, yMax, _CMP_LE_OQ));
+		bits = _mm256_and_si256(bits, _mm256_castps_si256(inside));
+		coverage = _mm256_or_si256(coverage, _mm256_sllv_epi32(bits, _mm256_set1_epi32(row * 8)));
+	}
+
+	if (_mm256_testz_si256(coverage, coverage))
+		return;
+
+	// Farthest point of the triangle's plane over each subtile, but never past its farthest vertex
+	__m256 zx = _mm256_set1_ps(setup.zx);
+	__m256 zy = _mm256_set1_ps(setup.zy);
+	__m256 zTri = _mm256_add_ps(_mm256_set1_ps(setup.z0),
+		_mm256_add_ps(_mm256_min_ps(_mm256_mul_ps(zx, laneX), _mm256_mul_ps(zx, _mm256_add_ps(laneX, eight))),
+			_mm256_min_ps(_mm256_mul_ps(zy, laneY), _mm256_mul_ps(zy, _mm256_add_ps(laneY, _mm256_set1_ps(4.0f))))));
+	zTri = _mm256_max_ps(zTri, _mm256_set1_ps(setup.zMin));
+
+	__m256 zMin0 = _mm256_load_ps(tile.zMin0);
+	__m256 zMin1 = _mm256_load_ps(tile.zMin1);
+	__m256i mask = _mm256_load_si256((const __m256i*)tile.mask);
+	__m256i full = _mm256_set1_epi32((int32_t)FullMask);
+
+	// Lanes where the triangle is entirely behind the conservative layer add nothing
+	__m256i alive = _mm256_andnot_si256(_mm256_cmpeq_epi32(coverage, _mm256_setzero_si256()),
+		_mm256_castps_si256(_mm256_cmp_ps(zTri, zMin0, _CMP_GT_OQ)));
+
+	// Covering a whole subtile alone goes straight into the conservative layer
+	__m256i alone = _mm256_and_si256(alive, _mm256_cmpeq_epi32(coverage, full));
+	zMin0 = _mm256_blendv_ps(zMin0, _mm256_max_ps(zMin0, zTri), _mm256_castsi256_ps(alone));
+	__m256i merge = _mm256_andnot_si256(alone, alive);
+
+	// A much nearer triangle throws away the working layer rather than being dragged back by it
+	__m256 gap = _mm256_sub_ps(zMin1, zMin0);
+	__m256i discard = _mm256_andnot_si256(_mm256_cmpeq_epi32(mask, _mm256_setzero_si256()),
+		_mm256_castps_si256(_mm256_cmp_ps(_mm256_sub_ps(zTri, zMin1), gap, _CMP_GT_OQ)));
+	discard = _mm256_and_si256(discard, merge);
+	mask = _mm256_andnot_si256(discard, mask);
+	zMin1 = _mm256_blendv_ps(zMin1, _mm256_set1_ps(EmptyLayer), _mm256_castsi256_ps(discard));
+
+	zMin1 = _mm256_blendv_ps(zMin1, _mm256_min_ps(zMin1, zTri), _mm256_castsi256_ps(merge));
+	mask = _mm256_or_si256(mask, _mm256_and_si256(coverage, merge));
+
+	// A full working layer becomes the conservative one
+	__m256i filled = _mm256_cmpeq_epi32(mask, full);
+	zMin0 = _mm256_blendv_ps(zMin0, _mm256_max_ps(zMin0, zMin1), _mm256_castsi256_ps(filled));
+	zMin1 = _mm256_blendv_ps(zMin1, _mm256_set1_ps(EmptyLayer), _mm256_castsi256_ps(filled));
+	mask = _mm256_andnot_si256(filled, mask);
+
+	_mm256_store_ps(tile.zMin0, zMin0);
+	_mm256_store_ps(tile.zMin1, zMin1);
+	_mm256_store_si256((__m256i*)tile.mask, mask);
+}
+
+#else
+
+void OcclusionCuller::RasterizeTile(const Setup& setup, Tile& tile, uint32_t tileX, uint32_t tileY)
+{
+	for (uint32_t lane = 0; lane < 8; lane++)
+	{
+		float laneX = SubtileX[lane] + (float)(tileX * TileWidth);
+		float laneY = SubtileY[lane] + (float)(tileY * TileHeight);
+
+		uint32_t coverage = 0;
+		for (uint32_t row = 0; row < 4; row++)
+		{
+			float y = laneY + row + 0.5f;
+			if (y < setup.yMin || y > setup.yMax)
+				continue;
+
+			float start = 0.0f, end = 8.0f;
+			for (uint32_t e = 0; e < 3; e++)
+			{
+				if (setup.kind[e] == EdgeKind::None)
+					continue;
+				float x = setup.slope[e] * y + setup.offset[e] - laneX - 0.5f;
+				if (setup.kind[e] == EdgeKind::Left)
+					start = std::max(start, std::ceil(x));
+				else
+					end = std::min(end, std::floor(x) + 1.0f);
+			}
+			start = std::min(start, 8.0f);
+			end = std::max(end, 0.0f);
+			uint32_t bits = (0xFFu << (uint32_t)start) & ~(0xFFu << (uint32_t)end) & 0xFFu;
+			coverage |= bits << (row * 8);
+		}
+		if (coverage == 0)
+			continue;
+
+		float zTri = setup.z0 + std::min(setup.zx * laneX, setup.zx * (laneX + 8.0f)) + std::min(setup.zy * laneY, setup.zy * (laneY + 4.0f));
+		zTri = std::max(zTri, setup.zMin);
+		if (zTri <= tile.zMin0[lane])
+			continue;
+
+		if (coverage == FullMask)
+		{
+			tile.zMin0[lane] = std::max(tile.zMin0[lane], zTri);
+			continue;
+		}
+
+		if (tile.mask[lane] != 0 && zTri - tile.zMin1[lane] > tile.zMin1[lane] - tile.zMin0[lane])
+		{
+			tile.mask[lane] = 0;
+			tile.zMin1[lane] = EmptyLayer;
+		}
+
+		tile.zMin1[lane] = std::min(tile.zMin1[lane], zTri);
+		tile.mask[lane] |= coverage;
+		if (tile.mask[lane] == FullMask)
+		{
+			tile.zMin0[lane] = std::max(tile.zMin0[lane], tile.zMin1[lane]);
+			tile.zMin1[lane] = EmptyLayer;
+			tile.mask[lane] = 0;
+		}
+	}
+}
+
+#endif
+
+void OcclusionCuller::RasterizeBand(uint32_t band)
+{
+	uint32_t rowBegin = band * BandRows;
+	uint32_t rowEnd = std::min(rowBegin + BandRows, TilesY);
+
+	for (const Setup& setup : m_setup)
+	{
+		if (!setup.valid || setup.tileMaxY < rowBegin || setup.tileMinY >= rowEnd)
+			continue;
+
+		uint32_t yBegin = std::max<uint32_t>(setup.tileMinY, rowBegin);
+		uint32_t yEnd = std::min<uint32_t>(setup.tileMaxY + 1, rowEnd);
+		for (uint32_t y = yBegin; y < yEnd; y++)
+			for (uint32_t x = setup.tileMinX; x <= setup.tileMaxX; x++)
+				RasterizeTile(setup, m_tiles[y * TilesX + x], x, y);
+	}
+}
+
+void OcclusionCuller::Rasterize(const glm::mat4& viewProjection, float nearPlane, JobSystem& jobs)
+{
+	PROFILE_ZONE("Occlusion rasterize");
+	uint64_t start = FramePacer::Now();
+	m_viewProjection = viewProjection;
+	m_near = nearPlane;
+
+	for (Tile& tile : m_tiles)
+	{
+		for (uint32_t lane = 0; lane < 8; lane++)
+		{
+			tile.zMin0[lane] = 0.0f;
+			tile.zMin1[lane] = EmptyLayer;
+			tile.mask[lane] = 0;
+		}
+	}
+
+	// Occluders whose box is behind the camera or beside the view are skipped whole
+	m_occluderActive.resize(m_occluders.size());
+	m_stats.occluders = 0;
+	for (size_t i = 0; i < m_occluders.size(); i++)
+	{
+		const Occluder& occluder = m_occluders[i];
+		uint32_t outside[5] = {};
+		for (uint32_t corner = 0; corner < 8; corner++)
+		{
+			glm::vec3 p((corner & 1) ? occluder.boundsMax.x : occluder.boundsMin.x,
+				(corner & 2) ? occluder.boundsMax.y : occluder.boundsMin.y,
+				(corner & 4) ? occluder.boundsMax.z : occluder.boundsMin.z);
+			glm::vec4 clip = viewProjection * glm::vec4(p, 1.0f);
+			outside[0] += clip.w <= nearPlane;
+			outside[1] += clip.x < -clip.w;
+			outside[2] += clip.x > clip.w;
+			outside[3] += clip.y < -clip.w;
+			outside[4] += clip.y > clip.w;
+		}
+		m_occluderActive[i] = std::none_of(outside, outside + 5, [](uint32_t count) { return count == 8; });
+		m_stats.occluders += m_occluderActive[i];
+	}
+
+	m_screen.resize(m_positions.size());
+	jobs.ParallelFor((uint32_t)m_occluders.size(), 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			if (m_occluderActive[i])
+				TransformVertices(m_occluders[i].firstVertex, m_occluders[i].firstVertex + m_occluders[i].vertexCount, viewProjection, nearPlane);
+		}
+	});
+
+	m_setup.resize(m_triangles.size());
+	jobs.ParallelFor((uint32_t)m_triangles.size(), 1024, [&](uint32_t begin, uint32_t end)
+	{
+		SetupTriangles(begin, end);
+	});
+
+	m_stats.triangles = 0;
+	for (const Setup& setup : m_setup)
+		m_stats.triangles += setup.valid;
+
+	// Bands own disjoint tiles, so no locking
+	jobs.ParallelFor((TilesY + BandRows - 1) / BandRows, 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t band = begin; band < end; band++)
+			RasterizeBand(band);
+	});
+
+	m_stats.rasterizeMs = FramePacer::ToMilliseconds(FramePacer::Now() - start);
+}
+
+bool OcclusionCuller::TestBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+{
+	// Corners from one transform and the clip space edge vectors
+	glm::vec3 size = boundsMax - boundsMin;
+	glm::vec4 origin = m_viewProjection * glm::vec4(boundsMin, 1.0f);
+	glm::vec4 edgeX = m_viewProjection[0] * size.x;
+	glm::vec4 edgeY = m_viewProjection[1] * size.y;
+	glm::vec4 edgeZ = m_viewProjection[2] * size.z;
+
+	float xMin = FLT_MAX, xMax = -FLT_MAX, yMin = FLT_MAX, yMax = -FLT_MAX, zNear = 0.0f;
+	for (uint32_t corner = 0; corner < 8; corner++)
+	{
+		glm::vec4 clip = origin;
+		if (corner & 1) clip += edgeX;
+		if (corner & 2) clip += edgeY;
+		if (corner & 4) clip += edgeZ;
+		// Crossing the near plane: too close to say anything
+		if (clip.w <= m_near)
+			return true;
+
+		float invW = 1.0f / clip.w;
+		float x = (clip.x * invW * 0.5f + 0.5f) * (float)Width;
+		float y = (clip.y * invW * 0.5f + 0.5f) * (float)Height;
+		xMin = std::min(xMin, x);
+		xMax = std::max(xMax, x);
+		yMin = std::min(yMin, y);
+		yMax = std::max(yMax, y);
+		zNear = std::max(zNear, invW);
+	}
+
+	if (xMax < 0.0f || xMin >= (float)Width || yMax < 0.0f || yMin >= (float)Height)
+		return false;
+
+	int32_t pxMin = std::max(0, (int32_t)std::floor(xMin));
+	int32_t pxMax = std::min((int32_t)Width - 1, (int32_t)std::floor(xMax));
+	int32_t pyMin = std::max(0, (int32_t)std::floor(yMin));
+	int32_t pyMax = std::min((int32_t)Height - 1, (int32_t)std::floor(yMax));
+
+	for (int32_t ty = pyMin / (int32_t)TileHeight; ty <= pyMax / (int32_t)TileHeight; ty++)
+	{
+		for (int32_t tx = pxMin / (int32_t)TileWidth; tx <= pxMax / (int32_t)TileWidth; tx++)
+		{
+			const Tile& tile = m_tiles[ty * TilesX + tx];
+#ifdef __AVX2__
+			// Subtiles the rectangle touches, then any of them not hidden
+			__m256 laneX = _mm256_add_ps(_mm256_loadu_ps(SubtileX), _mm256_set1_ps((float)(tx * TileWidth)));
+			__m256 laneY = _mm256_add_ps(_mm256_loadu_ps(SubtileY), _mm256_set1_ps((float)(ty * TileHeight)));
+			__m256 touched = _mm256_and_ps(
+				_mm256_and_ps(_mm256_cmp_ps(_mm256_add_ps(laneX, _mm256_set1_ps(7.0f)), _mm256_set1_ps((float)pxMin), _CMP_GE_OQ),
+					_mm256_cmp_ps(laneX, _mm256_set1_ps((float)pxMax), _CMP_LE_OQ)),
+				_mm256_and_ps(_mm256_cmp_ps(_mm256_add_ps(laneY, _mm256_set1_ps(3.0f)), _mm256_set1_ps((float)pyMin), _CMP_GE_OQ),
+					_mm256_cmp_ps(laneY, _mm256_set1_ps((float)pyMax), _CMP_LE_OQ)));
+			__m256 visible = _mm256_cmp_ps(_mm256_set1_ps(zNear), _mm256_load_ps(tile.zMin0), _CMP_GE_OQ);
+			if (_mm256_movemask_ps(_mm256_and_ps(touched, visible)))
+				return true;
+#else
+			for (uint32_t lane = 0; lane < 8; lane++)
+			{
+				int32_t x = (int32_t)(SubtileX[lane]) + tx * (int32_t)TileWidth;
+				int32_t y = (int32_t)(SubtileY[lane]) + ty * (int32_t)TileHeight;
+				bool touched = x + 7 >= pxMin && x <= pxMax && y + 3 >= pyMin && y <= pyMax;
+				if (touched && zNear >= tile.zMin0[lane])
+					return true;
+			}
+#endif
+		}
+	}
+	return false;
+}
+
+void OcclusionCuller::CullInstances(const Model& model, JobSystem& jobs, std::vector<uint32_t>& visible)
+{
+	PROFILE_ZONE("Occlusion test");
+	uint64_t start = FramePacer::Now();
+
+	uint32_t count = (uint32_t)visible.size();
+	m_visibleFlags.resize(count);
+	jobs.ParallelFor(count, 256, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const MeshInstance& instance = model.instances[visible[i]];
+			m_visibleFlags[i] = instance.boundsMin.x <= instance.boundsMax.x && TestBox(instance.boundsMin, instance.boundsMax);
+		}
+	});
+
+	uint32_t kept = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (m_visibleFlags[i])
+			visible[kept++] = visible[i];
+	}
+	visible.resize(kept);
+
+	m_stats.tested = count;
+	m_stats.culled = count - kept;
+	m_stats.testMs = FramePacer::ToMilliseconds(FramePacer::Now() - start);
+}
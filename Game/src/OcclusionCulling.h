@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "JobSystem.h"
+#include "Model.h"
+
+struct OcclusionStats
+{
+	uint32_t occluders = 0;		// in front of the camera this frame
+	uint32_t triangles = 0;		// rasterized after setup rejected the rest
+	uint32_t tested = 0;
+	uint32_t culled = 0;		// hidden or off screen
+	double rasterizeMs = 0.0;
+	double testMs = 0.0;
+};
+
+// Software occlusion culling in the style of masked occlusion culling (Hasselgren et al.).
+// A few large, simple meshes are rasterized into a small depth buffer of 32x8 pixel tiles,
+// each split into eight 8x4 subtiles, one per AVX2 lane. A subtile keeps a 32 bit coverage
+// mask and two depths instead of per pixel depth: the farthest depth of a layer that covers
+// it completely, and the farthest depth of the partially covered working layer. Depth is
+// 1/w, so larger is nearer. Rasterization runs in parallel over horizontal bands of tiles;
+// boxes are then tested against the conservative layer of the subtiles they touch.
+class OcclusionCuller
+{
+public:
+	static constexpr uint32_t Width = 320;
+	static constexpr uint32_t Height = 192;
+	static constexpr uint32_t TileWidth = 32;
+	static constexpr uint32_t TileHeight = 8;
+	static constexpr uint32_t TilesX = Width / TileWidth;
+	static constexpr uint32_t TilesY = Height / TileHeight;
+	static constexpr uint32_t BandRows = 2;		// tile rows per rasterization job
+
+	struct alignas(32) Tile
+	{
+		float zMin0[8];		// conservative layer
+		float zMin1[8];		// working layer
+		uint32_t mask[8];	// coverage of the working layer
+	};
+
+	// Picks the largest meshes with few triangles as occluders, up to the triangle budget.
+	// Their world space triangles are copied, since the scene does not move.
+	void SelectOccluders(const Model& model, uint32_t maxTriangles);
+	// Occluder from raw world space triangles
+	void AddOccluder(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices);
+	uint32_t OccluderCount() const { return (uint32_t)m_occluders.size(); }
+	uint32_t OccluderTriangles() const { return (uint32_t)m_triangles.size(); }
+
+	// Clears the buffer and rasterizes every occluder in front of the camera.
+	// Triangles crossing the near plane are dropped, which only loses occlusion.
+	void Rasterize(const glm::mat4& viewProjection, float nearPlane, JobSystem& jobs);
+
+	// False when the box is hidden behind the occluders or off screen
+	bool TestBox(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+	// Drops the instances in visible that are hidden, keeping the order
+	void CullInstances(const Model& model, JobSystem& jobs, std::vector<uint32_t>& visible);
+
+	const OcclusionStats& Stats() const { return m_stats; }
+	const Tile* Tiles() const { return m_tiles; }
+
+private:
+	struct Occluder
+	{
+		uint32_t firstVertex;
+		uint32_t vertexCount;
+		uint32_t firstTriangle;
+		uint32_t triangleCount;
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+
+	struct ScreenVertex
+	{
+		float x, y, z;	// pixels, 1/w
+		bool valid;		// in front of the near plane
+	};
+
+	enum class EdgeKind : uint8_t
+	{
+		None,
+		Left,	// inside to the right of the edge's x
+		Right
+	};
+
+	struct Setup
+	{
+		float slope[3];		// edge x at row center y: slope * y + offset
+		float offset[3];
+		EdgeKind kind[3];
+		float yMin, yMax;
+		float zx, zy, z0;	// 1/w plane
+		float zMin;			// farthest vertex
+		uint16_t tileMinX, tileMaxX, tileMinY, tileMaxY;
+		bool valid;
+	};
+
+	void TransformVertices(uint32_t begin, uint32_t end, const glm::mat4& viewProjection, float nearPlane);
+	void SetupTriangles(uint32_t begin, uint32_t end);
+	void RasterizeBand(uint32_t band);
+	void RasterizeTile(const Setup& setup, Tile& tile, uint32_t tileX, uint32_t tileY);
+
+	std::vector<Occluder> m_occluders;
+	std::vector<uint8_t> m_occluderActive;
+	std::vector<uint32_t> m_triangleOccluder;
+	std::vector<glm::vec3> m_positions;
+	std::vector<glm::uvec3> m_triangles;
+
+	std::vector<ScreenVertex> m_screen;
+	std::vector<Setup> m_setup;
+	std::vector<uint8_t> m_visibleFlags;
+
+	glm::mat4 m_viewProjection = glm::mat4(1.0f);
+	float m_near = 0.0f;
+
+	Tile m_tiles[TilesX * TilesY];
+	OcclusionStats m_stats;
+};
@@ -0,0 +1,277 @@
+#include "Overlay.h"
+
+#include "FrustumCulling.h"
+#include "LightCulling.h"
+#include "OcclusionCulling.h"
+#include "Shadows.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#if ENABLE_OVERLAY
+
+#include <imgui_impl_opengl3.h>
+#include <imgui_impl_sdl.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+// Resident set of the whole process
+static size_t ProcessMemoryBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters = {};
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.WorkingSetSize;
+	return 0;
+#else
+	FILE* file = fopen("/proc/self/statm", "r");
+	if (!file)
+		return 0;
+
+	unsigned long size = 0, resident = 0;
+	if (fscanf(file, "%lu %lu", &size, &resident) != 2)
+		resident = 0;
+	fclose(file);
+	return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+// Resizes without freeing, unlike ImVector::operator=
+template <typename T>
+static void CopyVector(ImVector<T>& dst, const ImVector<T>& src)
+{
+	dst.resize(src.Size);
+	if (src.Size > 0)
+		memcpy(dst.Data, src.Data, (size_t)src.Size * sizeof(T));
+}
+
+void Overlay::Init(SDL_Window* window, SDL_GLContext context, bool visible)
+{
+	m_window = window;
+	m_visible = visible;
+
+	IMGUI_CHECKVERSION();
+	ImGui::CreateContext();
+	ImGuiIO& io = ImGui::GetIO();
+	io.IniFilename = nullptr;
+	ImGui::StyleColorsDark();
+	ImGui::GetStyle().Alpha = 0.9f;
+
+	ImGui_ImplSDL2_InitForOpenGL(window, context);
+	ImGui_ImplOpenGL3_Init("#version 450");
+	// Created here rather than lazily in NewFrame, which would touch GL from the simulation thread
+	ImGui_ImplOpenGL3_CreateDeviceObjects();
+
+	m_initialized = true;
+}
+
+void Overlay::Shutdown()
+{
+	if (!m_initialized)
+		return;
+
+	ImGui_ImplOpenGL3_Shutdown();
+	ImGui_ImplSDL2_Shutdown();
+	ImGui::DestroyContext();
+	m_initialized = false;
+}
+
+bool Overlay::ProcessEvent(const SDL_Event& event)
+{
+	if (!m_initialized || !m_visible)
+		return false;
+
+	ImGui_ImplSDL2_ProcessEvent(&event);
+
+	ImGuiIO& io = ImGui::GetIO();
+	switch (event.type)
+	{
+	case SDL_MOUSEMOTION:
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+	case SDL_MOUSEWHEEL:
+		return io.WantCaptureMouse;
+	case SDL_KEYDOWN:
+	case SDL_KEYUP:
+	case SDL_TEXTINPUT:
+		return io.WantCaptureKeyboard;
+	}
+	return false;
+}
+
+void Overlay::RefreshSlowData()
+{
+	uint64_t now = Profiler::NowNs();
+	if (m_lastRefresh != 0 && now - m_lastRefresh < (uint64_t)(RefreshInterval * 1e9))
+		return;
+
+	Profiler::Summarize(m_lastRefresh, m_zones);
+	std::sort(m_zones.begin(), m_zones.end(), [](const ZoneSummary& a, const ZoneSummary& b) { return a.totalNs > b.totalNs; });
+	if (m_zones.size() > MaxZoneRows)
+		m_zones.resize(MaxZoneRows);
+
+	m_processBytes = ProcessMemoryBytes();
+	m_lastRefresh = now;
+}
+
+void Overlay::Build(const OverlayStats& stats, OverlayDrawData& out)
+{
+	out.valid = false;
+	if (!m_initialized || !m_visible)
+		return;
+
+	PROFILE_ZONE("Overlay");
+	uint64_t start = FramePacer::Now();
+
+	// Zone totals cover the frames since the last refresh
+	uint64_t refreshedAt = m_lastRefresh;
+	RefreshSlowData();
+	if (m_lastRefresh != refreshedAt)
+	{
+		m_zoneWindowFrames = (double)std::max<uint64_t>(stats.frame.frames - m_lastRefreshFrames, 1);
+		m_lastRefreshFrames = stats.frame.frames;
+	}
+
+	ImGui_ImplSDL2_NewFrame(m_window);
+	ImGui::NewFrame();
+	DrawWindow(stats);
+	ImGui::Render();
+
+	ImDrawData* src = ImGui::GetDrawData();
+	while ((int32_t)out.lists.size() < src->CmdListsCount)
+		out.lists.push_back(std::make_unique<ImDrawList>(nullptr));
+
+	out.pointers.resize(src->CmdListsCount);
+	for (int32_t i = 0; i < src->CmdListsCount; i++)
+	{
+		ImDrawList* dst = out.lists[i].get();
+		CopyVector(dst->CmdBuffer, src->CmdLists[i]->CmdBuffer);
+		CopyVector(dst->IdxBuffer, src->CmdLists[i]->IdxBuffer);
+		CopyVector(dst->VtxBuffer, src->CmdLists[i]->VtxBuffer);
+		dst->Flags = src->CmdLists[i]->Flags;
+		out.pointers[i] = dst;
+	}
+
+	out.drawData = *src;
+	out.drawData.CmdLists = out.pointers.data();
+	out.valid = true;
+
+	m_buildMs = FramePacer::ToMilliseconds(FramePacer::Now() - start);
+}
+
+void Overlay::DrawWindow(const OverlayStats& stats)
+{
+	ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f), ImGuiCond_FirstUseEver);
+	ImGui::SetNextWindowSize(ImVec2(380.0f, 0.0f), ImGuiCond_FirstUseEver);
+	ImGui::Begin("Performance (F1)");
+
+	ImGui::Text("%.2f ms  %.1f fps", stats.frame.frameMsAvg, stats.frame.fps);
+	if (stats.frameTimes)
+	{
+		const SampleWindow& times = *stats.frameTimes;
+		times.CopyOrdered(m_frameTimes);
+		float scale = (float)std::max(times.Max(), 1.0);
+		ImGui::PlotLines("##frametimes", m_frameTimes.data(), (int32_t)m_frameTimes.size(), 0, nullptr, 0.0f, scale, ImVec2(-1.0f, 60.0f));
+		ImGui::Text("p50 %.2f  p95 %.2f  p99 %.2f  max %.2f ms", times.Percentile(50.0), times.Percentile(95.0), times.Percentile(99.0), times.Max());
+	}
+	ImGui::Text("jitter %.2f ms  latency %.2f ms (max %.2f)", stats.frame.jitterMs, stats.frame.latencyMsAvg, stats.frame.latencyMsMax);
+	ImGui::Text("fence wait %.2f ms", stats.fenceWaitMs);
+
+	if (ImGui::CollapsingHeader("Draws", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		if (stats.gbufferBytesPerPixel)
+			ImGui::Text("path %s  G-buffer %u B/px", stats.renderPath, stats.gbufferBytesPerPixel);
+		else
+			ImGui::Text("path %s", stats.renderPath);
+		ImGui::Text("draw calls %u  dispatches %u", stats.commands.drawCalls, stats.commands.dispatches);
+		ImGui::Text("triangles %llu", (unsigned long long)stats.commands.triangles);
+		ImGui::Text("state changes %u  uniforms %u", stats.commands.stateChanges, stats.commands.uniforms);
+		ImGui::Text("commands %u", stats.commands.commands);
+		ImGui::Text("lights %u  avg %.2f per cluster", stats.lights, (double)stats.lightIndices / LightCuller::ClusterCount);
+		if (stats.frustum)
+			ImGui::Text("frustum visible %u of %u  %.3f ms", stats.frustum->visible, stats.frustum->tested, stats.frustum->ms);
+		if (stats.occlusion)
+		{
+			ImGui::Text("occlusion culled %u of %u  (%u occluders, %u tris)", stats.occlusion->culled, stats.occlusion->tested,
+				stats.occlusion->occluders, stats.occlusion->triangles);
+			ImGui::Text("occlusion rasterize %.3f ms  test %.3f ms", stats.occlusion->rasterizeMs, stats.occlusion->testMs);
+		}
+	}
+
+	if (stats.shadows && stats.shadows->enabled && ImGui::CollapsingHeader("Shadows", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		for (uint32_t i = 0; i < stats.shadows->cascadeCount; i++)
+		{
+			const ShadowCascade& cascade = stats.shadows->cascades[i];
+			ImGui::Text("cascade %u  to %.1f  casters %u  %s  cull %.3f ms", i, cascade.splitFar, cascade.casterCount,
+				cascade.render ? "drawn" : "cached", cascade.cullMs);
+		}
+	}
+
+	if (ImGui::CollapsingHeader("CPU zones (ms per frame)", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		ImGui::Columns(3, "cpuzones", false);
+		for (const ZoneSummary& zone : m_zones)
+		{
+			ImGui::TextUnformatted(zone.thread);
+			ImGui::NextColumn();
+			ImGui::TextUnformatted(zone.name);
+			ImGui::NextColumn();
+			ImGui::Text("%.3f", zone.totalNs / 1e6 / m_zoneWindowFrames);
+			ImGui::NextColumn();
+		}
+		ImGui::Columns(1);
+	}
+
+	if (stats.gpuScopes && ImGui::CollapsingHeader(stats.gpuTimesCpuMeasured ? "GPU zones (CPU measured)" : "GPU zones", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		for (const GpuScopeAverage& scope : *stats.gpuScopes)
+			ImGui::Text("%*s%s: %.3f ms", (int32_t)scope.depth * 2, "", scope.name, scope.ms);
+	}
+
+	if (ImGui::CollapsingHeader("Queues", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		ImGui::Text("jobs pending %u  (%u workers)", stats.pendingJobs, stats.workerThreads);
+		ImGui::Text("snapshots queued for render %u", stats.queuedSnapshots);
+	}
+
+	if (ImGui::CollapsingHeader("Memory", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		ImGui::Text("process %.1f MB", m_processBytes / (1024.0 * 1024.0));
+		ImGui::Text("frame resources %.1f MB", stats.frameResourceBytes / (1024.0 * 1024.0));
+	}
+
+	ImGui::Separator();
+	ImGui::Text("overlay: build %.3f ms  render %.3f ms", m_buildMs, stats.overlayRenderMs);
+
+	ImGui::End();
+}
+
+void Overlay::Render(OverlayDrawData& data)
+{
+	if (!data.valid)
+		return;
+
+	ImGui_ImplOpenGL3_RenderDrawData(&data.drawData);
+}
+
+#else
+
+void Overlay::Init(SDL_Window* window, SDL_GLContext context, bool visible) {}
+void Overlay::Shutdown() {}
+bool Overlay::ProcessEvent(const SDL_Event& event) { return false; }
+void Overlay::Build(const OverlayStats& stats, OverlayDrawData& out) { out.valid = false; }
+void Overlay::Render(OverlayDrawData& data) {}
+void Overlay::RefreshSlowData() {}
+void Overlay::DrawWindow(const OverlayStats& stats) {}
+
+#endif
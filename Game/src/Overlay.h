@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <SDL.h>
+
+#include "CommandList.h"
+#include "FramePacer.h"
+#include "GpuProfiler.h"
+#include "Profiler.h"
+
+struct ShadowFrame;
+struct OcclusionStats;
+struct FrustumStats;
+
+// Dist builds define ENABLE_OVERLAY=0, which leaves empty stubs and no ImGui
+#ifndef ENABLE_OVERLAY
+#define ENABLE_OVERLAY 1
+#endif
+
+#if ENABLE_OVERLAY
+#include <imgui.h>
+#endif
+
+// ImGui output copied out of the ImGui context, so the GL thread can draw it while
+// the simulation thread already builds the next frame's UI. Buffers are reused.
+struct OverlayDrawData
+{
+	bool valid = false;
+#if ENABLE_OVERLAY
+	std::vector<std::unique_ptr<ImDrawList>> lists;
+	std::vector<ImDrawList*> pointers;
+	ImDrawData drawData;
+#endif
+};
+
+// Everything the overlay shows, gathered by the frame loop
+struct OverlayStats
+{
+	const SampleWindow* frameTimes = nullptr;
+	FrameStats frame;
+	CommandStats commands;
+	uint32_t lights = 0;
+	uint32_t lightIndices = 0;		// summed over all clusters
+	const char* renderPath = "";
+	uint32_t gbufferBytesPerPixel = 0;
+	const ShadowFrame* shadows = nullptr;
+	const FrustumStats* frustum = nullptr;		// null when frustum culling is off
+	const OcclusionStats* occlusion = nullptr;	// null when occlusion culling is off
+	const std::vector<GpuScopeAverage>* gpuScopes = nullptr;
+	bool gpuTimesCpuMeasured = false;
+	double fenceWaitMs = 0.0;
+	double overlayRenderMs = 0.0;	// GL thread CPU time spent drawing the overlay
+	uint32_t pendingJobs = 0;
+	uint32_t workerThreads = 0;
+	uint32_t queuedSnapshots = 0;
+	size_t frameResourceBytes = 0;
+};
+
+// Live performance overlay drawn with Dear ImGui. The UI is built on the simulation
+// thread; only the copied draw data crosses to the GL thread. Heavier data (zone
+// summaries, process memory) is refreshed a few times a second so the cost per frame
+// stays flat, and the time spent is shown in the overlay itself.
+class Overlay
+{
+public:
+	static constexpr double RefreshInterval = 0.25;	// seconds between zone/memory refreshes
+	static constexpr uint32_t MaxZoneRows = 24;
+
+	// Needs the GL context current; creates the font texture and backend objects
+	void Init(SDL_Window* window, SDL_GLContext context, bool visible);
+	void Shutdown();
+
+	// Returns true when the overlay wants this event for itself
+	bool ProcessEvent(const SDL_Event& event);
+	void Toggle() { m_visible = !m_visible; }
+	bool Visible() const { return m_visible; }
+
+	// Builds this frame's UI and copies it into out; out is left invalid when hidden
+	void Build(const OverlayStats& stats, OverlayDrawData& out);
+	double BuildMs() const { return m_buildMs; }
+
+	// GL thread
+	static void Render(OverlayDrawData& data);
+
+private:
+	void RefreshSlowData();
+	void DrawWindow(const OverlayStats& stats);
+
+	SDL_Window* m_window = nullptr;
+	bool m_initialized = false;
+	bool m_visible = true;
+	double m_buildMs = 0.0;
+
+	uint64_t m_lastRefresh = 0;
+	std::vector<ZoneSummary> m_zones;
+	double m_zoneWindowFrames = 1.0;
+	uint64_t m_lastRefreshFrames = 0;
+	size_t m_processBytes = 0;
+	std::vector<float> m_frameTimes;
+};
@@ -0,0 +1,214 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+
+#include "GpuProfiler.h"
+#include "Log.h"
+#include "MemoryTracker.h"
+
+static std::mutex s_registryMutex;
+static std::vector<void*> s_registry;
+static thread_local void* t_buffer = nullptr;
+
+// Where both clocks stood at startup; the tick rate is measured from here
+static const uint64_t s_startTicks = Profiler::Ticks();
+static const uint64_t s_startNs = Profiler::NowNs();
+
+// Read once per summary or dump. The longer the process ran, the closer the rate; only
+// a call within the first millisecond has to wait for enough of a span.
+static double NsPerTick()
+{
+#if PROFILER_TSC
+	uint64_t ns = Profiler::NowNs() - s_startNs;
+	while (ns < 1000000)
+		ns = Profiler::NowNs() - s_startNs;
+	return (double)ns / (double)(Profiler::Ticks() - s_startTicks);
+#else
+	return 1.0;
+#endif
+}
+
+static uint64_t TicksToNs(uint64_t ticks, double nsPerTick)
+{
+	return s_startNs + (uint64_t)(int64_t)((double)(int64_t)(ticks - s_startTicks) * nsPerTick);
+}
+
+Profiler::ThreadBuffer* Profiler::CreateBuffer(const char* name)
+{
+	// Buffers live until exit so a dump never races a thread shutting down. They are
+	// made lazily by the first zone, which should not be charged for them.
+	MemoryScope scope(MemoryTag::Untagged);
+	ThreadBuffer* buffer = new ThreadBuffer();
+	std::strncpy(buffer->name, name, sizeof(buffer->name) - 1);
+
+	std::lock_guard<std::mutex> lock(s_registryMutex);
+	buffer->id = (uint32_t)s_registry.size() + 1;
+	s_registry.push_back(buffer);
+	return buffer;
+}
+
+Profiler::ThreadBuffer* Profiler::LocalBuffer()
+{
+	if (!t_buffer)
+		t_buffer = CreateBuffer("Thread");
+	return (ThreadBuffer*)t_buffer;
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	ThreadBuffer* buffer = LocalBuffer();
+	std::lock_guard<std::mutex> lock(s_registryMutex);
+	std::strncpy(buffer->name, name, sizeof(buffer->name) - 1);
+}
+
+void Profiler::Push(ThreadBuffer* buffer, const char* name, uint64_t start, uint64_t end)
+{
+	uint64_t index = buffer->written.load(std::memory_order_relaxed);
+	ProfileEvent& event = buffer->events[index & (EventsPerThread - 1)];
+	event.name = name;
+	event.start = start;
+	event.end = end;
+	buffer->written.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::Record(const char* name, uint64_t startTicks, uint64_t endTicks)
+{
+	Push(LocalBuffer(), name, startTicks, endTicks);
+}
+
+void Profiler::RecordGpuEvents(const std::vector<GpuEvent>& events)
+{
+	static ThreadBuffer* s_gpuBuffer = CreateBuffer("GPU");
+	s_gpuBuffer->gpu = true;
+
+	for (const GpuEvent& event : events)
+		Push(s_gpuBuffer, event.name, event.startNs, event.endNs);
+}
+
+void Profiler::Summarize(uint64_t sinceNs, std::vector<ZoneSummary>& out)
+{
+	out.clear();
+	double nsPerTick = NsPerTick();
+
+	std::lock_guard<std::mutex> lock(s_registryMutex);
+	for (void* entry : s_registry)
+	{
+		ThreadBuffer* buffer = (ThreadBuffer*)entry;
+		if (buffer->gpu)
+			continue;
+
+		// Zones are pushed as they end, so end times only grow within a ring. The oldest
+		// quarter is skipped as the owner may be overwriting it while we read.
+		uint64_t end = buffer->written.load(std::memory_order_acquire);
+		uint64_t begin = end > EventsPerThread * 3 / 4 ? end - EventsPerThread * 3 / 4 : 0;
+		for (uint64_t e = end; e > begin; e--)
+		{
+			const ProfileEvent& event = buffer->events[(e - 1) & (EventsPerThread - 1)];
+			uint64_t endNs = TicksToNs(event.end, nsPerTick);
+			if (endNs < sinceNs)
+				break;
+
+			uint64_t durationNs = (uint64_t)((double)(event.end - event.start) * nsPerTick);
+			auto it = std::find_if(out.begin(), out.end(), [&](const ZoneSummary& zone) { return zone.name == event.name && zone.thread == buffer->name; });
+			if (it == out.end())
+			{
+				out.push_back({ event.name, buffer->name, durationNs, 1 });
+			}
+			else
+			{
+				it->totalNs += durationNs;
+				it->count++;
+			}
+		}
+	}
+}
+
+static void WriteJsonString(std::ostream& out, const char* text)
+{
+	out << '"';
+	for (const char* c = text; *c; c++)
+	{
+		if (*c == '"' || *c == '\\')
+			out << '\\';
+		out << *c;
+	}
+	out << '"';
+}
+
+bool Profiler::WriteChromeTrace(const std::string& file)
+{
+	std::vector<ThreadBuffer*> buffers;
+	{
+		std::lock_guard<std::mutex> lock(s_registryMutex);
+		for (void* buffer : s_registry)
+			buffers.push_back((ThreadBuffer*)buffer);
+	}
+
+	std::ofstream out(file);
+	if (!out)
+	{
+		LOG_ERROR("Could not write trace: " << file);
+		return false;
+	}
+
+	// Copy each ring first; entries the owner overwrote while copying are dropped. CPU
+	// zones are converted to nanoseconds on the way, GPU events already are.
+	std::vector<std::vector<ProfileEvent>> copies(buffers.size());
+	double nsPerTick = NsPerTick();
+	uint64_t epoch = UINT64_MAX;
+	for (size_t i = 0; i < buffers.size(); i++)
+	{
+		ThreadBuffer* buffer = buffers[i];
+		uint64_t end = buffer->written.load(std::memory_order_acquire);
+		uint64_t begin = end > EventsPerThread ? end - EventsPerThread : 0;
+
+		std::vector<ProfileEvent>& copy = copies[i];
+		copy.reserve((size_t)(end - begin));
+		for (uint64_t e = begin; e < end; e++)
+			copy.push_back(buffer->events[e & (EventsPerThread - 1)]);
+
+		// The owner may also be halfway through writing slot 'after'
+		uint64_t after = buffer->written.load(std::memory_order_acquire) + 1;
+		uint64_t overwritten = after > EventsPerThread ? after - EventsPerThread : 0;
+		if (overwritten > begin)
+			copy.erase(copy.begin(), copy.begin() + (size_t)std::min<uint64_t>(overwritten - begin, copy.size()));
+
+		for (ProfileEvent& event : copy)
+		{
+			if (!buffer->gpu)
+			{
+				event.start = TicksToNs(event.start, nsPerTick);
+				event.end = TicksToNs(event.end, nsPerTick);
+			}
+			epoch = std::min(epoch, event.start);
+		}
+	}
+
+	out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	bool first = true;
+	for (size_t i = 0; i < buffers.size(); i++)
+	{
+		out << (first ? "" : ",") << "\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffers[i]->id << ",\"args\":{\"name\":";
+		WriteJsonString(out, buffers[i]->name);
+		out << "}}";
+		first = false;
+
+		for (const ProfileEvent& event : copies[i])
+		{
+			out << ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":" << buffers[i]->id << ",\"name\":";
+			WriteJsonString(out, event.name);
+			out << std::fixed << std::setprecision(3)
+				<< ",\"ts\":" << (event.start - epoch) / 1000.0
+				<< ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+		}
+	}
+	out << "\n]}\n";
+
+	LOG_INFO("Wrote trace: " << file);
+	return true;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define PROFILER_TSC 1
+#else
+#define PROFILER_TSC 0
+#endif
+
+#ifndef ENABLE_PROFILER
+#define ENABLE_PROFILER 1
+#endif
+
+struct GpuEvent;
+
+struct ProfileEvent
+{
+	const char* name;
+	uint64_t start;		// Profiler::Ticks for CPU zones, nanoseconds for GPU events
+	uint64_t end;
+};
+
+struct ZoneSummary
+{
+	const char* name;
+	const char* thread;
+	uint64_t totalNs;
+	uint32_t count;
+};
+
+// Low overhead CPU zone profiler. Every thread writes finished zones into its own ring
+// buffer without locking; dumping copies whatever the rings currently hold into a
+// Chrome trace / Perfetto JSON file. Zone names must be string literals.
+class Profiler
+{
+public:
+	static constexpr uint32_t EventsPerThread = 1 << 15;
+
+	// Nanoseconds on the clock that traces, summaries and mapped GPU events use
+	static uint64_t NowNs()
+	{
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// What zones time themselves with: the TSC where there is one, which costs about half
+	// a steady_clock read. Only summaries and dumps convert it to NowNs time.
+	static uint64_t Ticks()
+	{
+#if PROFILER_TSC
+		return __rdtsc();
+#else
+		return NowNs();
+#endif
+	}
+
+	static void SetThreadName(const char* name);
+
+	static void Record(const char* name, uint64_t startTicks, uint64_t endTicks);
+	// Puts resolved GPU scopes on their own track
+	static void RecordGpuEvents(const std::vector<GpuEvent>& events);
+
+	static bool WriteChromeTrace(const std::string& file);
+
+	// Per thread totals of the CPU zones that ended after sinceNs. Only walks the
+	// events inside that window, so the cost follows the window and not the ring size.
+	static void Summarize(uint64_t sinceNs, std::vector<ZoneSummary>& out);
+
+private:
+	struct ThreadBuffer
+	{
+		ProfileEvent events[EventsPerThread];
+		std::atomic<uint64_t> written{ 0 };
+		uint32_t id = 0;
+		bool gpu = false;
+		char name[32] = {};
+	};
+
+	static ThreadBuffer* CreateBuffer(const char* name);
+	static ThreadBuffer* LocalBuffer();
+	static void Push(ThreadBuffer* buffer, const char* name, uint64_t start, uint64_t end);
+};
+
+class ProfileZone
+{
+public:
+	explicit ProfileZone(const char* name) : m_name(name), m_start(Profiler::Ticks()) {}
+	~ProfileZone() { Profiler::Record(m_name, m_start, Profiler::Ticks()); }
+
+private:
+	const char* m_name;
+	uint64_t m_start;
+};
+
+#if ENABLE_PROFILER
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(_profileZone, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#endif
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "CommandList.h"
+#include "GpuProfiler.h"
+#include "LightCulling.h"
+#include "Overlay.h"
+#include "Shadows.h"
+
+struct RenderItem
+{
+	uint32_t mesh;
+	glm::mat4 world;
+};
+
+// Everything the render thread needs to draw one frame. Written by the simulation
+// thread, then read-only once submitted until the render thread hands it back.
+struct RenderSnapshot
+{
+	uint64_t frame = 0;
+	uint64_t inputTime = 0;		// performance counter of the first input in this frame, 0 if none
+	uint64_t presentTime = 0;	// set by the render thread after the swap
+	CommandStats stats;			// set by the render thread while replaying
+	double fenceWaitMs = 0.0;	// set by the render thread, time blocked on the GPU
+	std::vector<GpuScopeAverage> gpuScopes;	// set by the render thread, latest GPU profiler window
+	bool gpuTimesCpuMeasured = false;
+	double gpuFrameMs = -1.0;	// set by the render thread when a GPU frame resolved, from a few frames back
+	double overlayRenderMs = 0.0;	// set by the render thread
+	size_t frameResourceBytes = 0;	// set by the render thread
+
+	int32_t width = 0;
+	int32_t height = 0;
+	glm::vec4 clearColor = glm::vec4(0.39f, 0.58f, 0.93f, 1.0f);
+
+	glm::mat4 view = glm::mat4(1.0f);
+	glm::mat4 projection = glm::mat4(1.0f);
+	glm::vec3 cameraPosition = glm::vec3(0.0f);
+
+	std::vector<RenderItem> items;
+	std::vector<uint32_t> visible;	// indices into items
+	ClusterLightLists lights;		// clustered light assignment for this view
+	ShadowFrame shadows;			// cascade matrices and casters
+
+	// Recorded in parallel by the simulation side, replayed in order on the GL thread.
+	// The first list holds per frame state, the rest one chunk of the visible set each.
+	std::vector<CommandList> commandLists;
+	std::vector<CommandList> shadowLists;	// one per cascade, empty when the cascade is cached
+
+	OverlayDrawData overlay;		// built by the simulation thread, drawn last
+
+	double renderLoadMs = 0.0;		// synthetic GL thread load for benchmarking
+	int64_t captureFrame = -1;		// headless: frame number to write to disk, -1 for none
+};
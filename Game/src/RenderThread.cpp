@@ -0,0 +1,104 @@
+#include "RenderThread.h"
+
+#include "FrameArena.h"
+#include "FramePacer.h"
+#include "Log.h"
+#include "Profiler.h"
+
+bool RenderThread::TakeContext()
+{
+	return m_headless ? m_headless->MakeCurrent() : SDL_GL_MakeCurrent(m_window, m_context) == 0;
+}
+
+void RenderThread::ReleaseContext()
+{
+	if (m_headless)
+		m_headless->Release();
+	else
+		SDL_GL_MakeCurrent(m_window, nullptr);
+}
+
+void RenderThread::Start(SDL_Window* window, SDL_GLContext context, Renderer* renderer, HeadlessContext* headless)
+{
+	m_window = window;
+	m_context = context;
+	m_renderer = renderer;
+	m_headless = headless;
+
+	m_freeCount = SDL_CreateSemaphore(0);
+	m_readyCount = SDL_CreateSemaphore(0);
+	for (uint32_t i = 0; i < SnapshotCount; i++)
+	{
+		m_free.Push(&m_snapshots[i]);
+		SDL_SemPost(m_freeCount);
+	}
+
+	// The context can only be current on one thread at a time
+	ReleaseContext();
+	m_thread = std::thread(&RenderThread::ThreadMain, this);
+}
+
+void RenderThread::Stop()
+{
+	if (!m_thread.joinable())
+		return;
+
+	// A null snapshot tells the render thread to exit
+	m_ready.Push(nullptr);
+	SDL_SemPost(m_readyCount);
+	m_thread.join();
+
+	SDL_DestroySemaphore(m_freeCount);
+	SDL_DestroySemaphore(m_readyCount);
+
+	if (!TakeContext())
+		LOG_ERROR("Could not take the GL context back from the render thread: " << (m_headless ? "headless" : SDL_GetError()));
+}
+
+RenderSnapshot* RenderThread::Acquire()
+{
+	PROFILE_ZONE("Acquire snapshot");
+	SDL_SemWait(m_freeCount);
+
+	RenderSnapshot* snapshot = nullptr;
+	m_free.Pop(snapshot);
+	return snapshot;
+}
+
+void RenderThread::Submit(RenderSnapshot* snapshot)
+{
+	m_ready.Push(snapshot);
+	SDL_SemPost(m_readyCount);
+}
+
+void RenderThread::ThreadMain()
+{
+	Profiler::SetThreadName("Render");
+
+	if (!TakeContext())
+		LOG_ERROR("Render thread could not take the GL context: " << (m_headless ? "headless" : SDL_GetError()));
+
+	while (true)
+	{
+		{
+			PROFILE_ZONE("Wait for snapshot");
+			SDL_SemWait(m_readyCount);
+		}
+
+		RenderSnapshot* snapshot = nullptr;
+		m_ready.Pop(snapshot);
+		if (!snapshot)
+			break;
+
+		FrameArena::Local().Reset();
+		uint64_t start = FramePacer::Now();
+		m_renderer->RenderFrame(*snapshot, m_window);
+		snapshot->presentTime = FramePacer::Now();
+		m_lastRenderMs.store(FramePacer::ToMilliseconds(snapshot->presentTime - start), std::memory_order_relaxed);
+
+		m_free.Push(snapshot);
+		SDL_SemPost(m_freeCount);
+	}
+
+	ReleaseContext();
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include <SDL.h>
+
+#include "RenderSnapshot.h"
+#include "HeadlessContext.h"
+#include "Renderer.h"
+#include "SpscQueue.h"
+
+// Runs the Renderer on its own thread with the GL context current there.
+// The simulation thread fills one snapshot while the render thread draws the other;
+// ownership moves between them through two lock-free queues.
+class RenderThread
+{
+public:
+	static constexpr uint32_t SnapshotCount = 2;
+
+	// Headless runs pass the headless context instead of a window and its context
+	void Start(SDL_Window* window, SDL_GLContext context, Renderer* renderer, HeadlessContext* headless = nullptr);
+	void Stop();
+	bool Running() const { return m_thread.joinable(); }
+
+	// Blocks until the render thread has released a snapshot. The returned snapshot
+	// still carries the timings of the frame it was last used for.
+	RenderSnapshot* Acquire();
+	void Submit(RenderSnapshot* snapshot);
+
+	// Milliseconds the render thread spent on its last frame, including the swap
+	double LastRenderMs() const { return m_lastRenderMs.load(std::memory_order_relaxed); }
+	// Snapshots submitted but not yet picked up by the render thread
+	uint32_t QueuedSnapshots() const { return m_readyCount ? SDL_SemValue(m_readyCount) : 0; }
+
+private:
+	void ThreadMain();
+	bool TakeContext();
+	void ReleaseContext();
+
+	SDL_Window* m_window = nullptr;
+	SDL_GLContext m_context = nullptr;
+	Renderer* m_renderer = nullptr;
+	HeadlessContext* m_headless = nullptr;
+	std::thread m_thread;
+
+	RenderSnapshot m_snapshots[SnapshotCount];
+	SpscQueue<RenderSnapshot*, 4> m_free;
+	SpscQueue<RenderSnapshot*, 4> m_ready;
+	// Only used to sleep when a queue is empty; the queues themselves never lock
+	SDL_sem* m_freeCount = nullptr;
+	SDL_sem* m_readyCount = nullptr;
+
+	std::atomic<double> m_lastRenderMs{ 0.0 };
+};
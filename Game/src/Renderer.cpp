@@ -0,0 +1,347 @@
+#include "Renderer.h"
+
+#include <cstring>
+
+#include "FramePacer.h"
+#include "MemoryTracker.h"
+#include "Profiler.h"
+
+// Matches the Frame uniform block in the scene shaders (std140)
+struct FrameBlock
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::vec4 viewPos;
+	glm::uvec4 clusterDims;		// x, y, z, light count
+	glm::vec4 clusterParams;	// slice scale, slice bias, tile width, tile height in pixels
+};
+
+// Matches the Shadows uniform block (std140). Always bound, it also carries the sun direction.
+struct ShadowBlock
+{
+	glm::mat4 cascades[ShadowFrame::MaxCascades];
+	glm::vec4 texelSizes;
+	glm::vec4 lightDirection;	// w: cascade count, 0 when shadows are off
+};
+
+// Binding points shared with the shaders
+static constexpr uint32_t FrameBlockBinding = 0;
+static constexpr uint32_t ShadowBlockBinding = 1;
+static constexpr uint32_t TransformBufferBinding = 0;
+static constexpr uint32_t LightBufferBinding = 1;
+static constexpr uint32_t ClusterBufferBinding = 2;
+static constexpr uint32_t LightIndexBufferBinding = 3;
+
+// Binds an SSBO range with per frame data, skipping empty arrays
+template <typename T>
+static void UploadStorage(FrameResources& resources, uint32_t binding, const std::vector<T>& data)
+{
+	if (data.empty())
+		return;
+
+	FrameAllocation allocation = resources.Allocate(data.size() * sizeof(T), resources.StorageAlignment());
+	if (!allocation.data)
+		return;
+
+	std::memcpy(allocation.data, data.data(), allocation.size);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, allocation.buffer, allocation.offset, allocation.size);
+}
+
+void Renderer::Init(Model* model, uint32_t framesInFlight, bool gpuProfiling, RenderPath path, int32_t width, int32_t height)
+{
+	m_model = model;
+	m_path = path;
+	if (path == RenderPath::Deferred)
+	{
+		m_shader = std::make_unique<Shader>("shaders/scene.vert", "shaders/gbuffer.frag");
+		m_deferred.Init(width, height);
+	}
+	else
+	{
+		m_shader = std::make_unique<Shader>("shaders/scene.vert", "shaders/scene.frag");
+	}
+
+	// Stands in for the diffuse map of meshes that have none
+	const uint8_t white[4] = { 255, 255, 255, 255 };
+	glGenTextures(1, &m_whiteTexture);
+	glBindTexture(GL_TEXTURE_2D, m_whiteTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	MemoryTracker::TrackGpu(GpuResource::Texture, m_whiteTexture, 4, MemoryTag::Render, "white texture");
+
+	m_uniforms.program = m_shader->ID;
+	m_uniforms.drawIndex = glGetUniformLocation(m_shader->ID, "drawIndex");
+
+	m_frameResources.Init(framesInFlight, 1024 * 1024);
+	m_gpuProfiler.Init(gpuProfiling);
+
+	// Resolve what each mesh binds up front, following the material naming of Mesh::Draw
+	m_bindings.reserve(model->meshes.size());
+	for (const Mesh& mesh : model->meshes)
+	{
+		DrawBinding binding;
+		binding.vao = mesh.GetVAO();
+		binding.indexCount = mesh.IndexCount();
+
+		int32_t diffuseNr = 1,
+				specularNr = 1;
+		for (const Texture& texture : mesh.textures)
+		{
+			if (binding.textureCount == DrawBinding::MaxTextures)
+				break;
+
+			std::string number;
+			if (texture.type == "texture_diffuse")
+				number = std::to_string(diffuseNr++);
+			else if (texture.type == "texture_specular")
+				number = std::to_string(specularNr++);
+
+			TextureBinding& slot = binding.textures[binding.textureCount];
+			slot.location = glGetUniformLocation(m_shader->ID, ("material." + texture.type + number).c_str());
+			slot.unit = binding.textureCount;
+			slot.texture = texture.id;
+			binding.textureCount++;
+		}
+
+		if (diffuseNr == 1 && binding.textureCount < DrawBinding::MaxTextures)
+		{
+			TextureBinding& slot = binding.textures[binding.textureCount];
+			slot.location = glGetUniformLocation(m_shader->ID, "material.texture_diffuse1");
+			slot.unit = binding.textureCount;
+			slot.texture = m_whiteTexture;
+			binding.textureCount++;
+		}
+
+		m_bindings.push_back(binding);
+	}
+
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_CULL_FACE);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void Renderer::InitShadows(uint32_t resolution, uint32_t cascades)
+{
+	m_shadowMaps.Init(resolution, cascades);
+	if (!m_shadowMaps.Enabled())
+		return;
+
+	m_shadowUniforms.program = m_shadowMaps.Program();
+	m_shadowUniforms.drawIndex = m_shadowMaps.DrawIndexLocation();
+	m_shadowBindings.resize(m_bindings.size());
+	for (size_t i = 0; i < m_bindings.size(); i++)
+	{
+		m_shadowBindings[i].vao = m_bindings[i].vao;
+		m_shadowBindings[i].indexCount = m_bindings[i].indexCount;
+	}
+}
+
+void Renderer::Shutdown()
+{
+	m_shadowMaps.Shutdown();
+	m_deferred.Shutdown();
+	m_gpuProfiler.Shutdown();
+	m_frameResources.Shutdown();
+
+	if (m_whiteTexture)
+	{
+		MemoryTracker::UntrackGpu(GpuResource::Texture, m_whiteTexture);
+		glDeleteTextures(1, &m_whiteTexture);
+		m_whiteTexture = 0;
+	}
+}
+
+void Renderer::Clear(const RenderSnapshot& snapshot)
+{
+	PROFILE_ZONE("Clear");
+	GpuScope scope(m_gpuProfiler, "Clear");
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_target);
+	glViewport(0, 0, snapshot.width, snapshot.height);
+	glClearColor(snapshot.clearColor.r, snapshot.clearColor.g, snapshot.clearColor.b, snapshot.clearColor.a);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void Renderer::Draw(RenderSnapshot& snapshot)
+{
+	PROFILE_ZONE("Draw");
+	GpuScope scope(m_gpuProfiler, "Draw");
+	snapshot.stats = CommandStats();
+
+	FrameAllocation frame = m_frameResources.Allocate(sizeof(FrameBlock), m_frameResources.UniformAlignment());
+	if (frame.data)
+	{
+		FrameBlock* block = (FrameBlock*)frame.data;
+		block->view = snapshot.view;
+		block->projection = snapshot.projection;
+		block->viewPos = glm::vec4(snapshot.cameraPosition, 1.0f);
+		block->clusterDims = glm::uvec4(LightCuller::ClusterX, LightCuller::ClusterY, LightCuller::ClusterZ, (uint32_t)snapshot.lights.lights.size());
+		block->clusterParams = glm::vec4(snapshot.lights.sliceScale, snapshot.lights.sliceBias,
+			(float)snapshot.width / LightCuller::ClusterX, (float)snapshot.height / LightCuller::ClusterY);
+		glBindBufferRange(GL_UNIFORM_BUFFER, FrameBlockBinding, frame.buffer, frame.offset, frame.size);
+	}
+
+	// Draws index their transform by item index
+	if (!snapshot.items.empty())
+	{
+		FrameAllocation transforms = m_frameResources.Allocate(snapshot.items.size() * sizeof(glm::mat4), m_frameResources.StorageAlignment());
+		if (transforms.data)
+		{
+			glm::mat4* world = (glm::mat4*)transforms.data;
+			for (size_t i = 0; i < snapshot.items.size(); i++)
+				std::memcpy(&world[i], &snapshot.items[i].world, sizeof(glm::mat4));
+			glBindBufferRange(GL_SHADER_STORAGE_BUFFER, TransformBufferBinding, transforms.buffer, transforms.offset, transforms.size);
+		}
+	}
+
+	UploadStorage(m_frameResources, LightBufferBinding, snapshot.lights.lights);
+	UploadStorage(m_frameResources, ClusterBufferBinding, snapshot.lights.clusters);
+	UploadStorage(m_frameResources, LightIndexBufferBinding, snapshot.lights.indices);
+
+	FrameAllocation shadowBlock = m_frameResources.Allocate(sizeof(ShadowBlock), m_frameResources.UniformAlignment());
+	if (shadowBlock.data)
+	{
+		const ShadowFrame& shadows = snapshot.shadows;
+		bool enabled = shadows.enabled && m_shadowMaps.Enabled();
+		ShadowBlock* block = (ShadowBlock*)shadowBlock.data;
+		for (uint32_t i = 0; i < ShadowFrame::MaxCascades; i++)
+		{
+			block->cascades[i] = shadows.cascades[i].viewProjection;
+			block->texelSizes[i] = shadows.cascades[i].texelSize;
+		}
+		block->lightDirection = glm::vec4(shadows.lightDirection, enabled ? (float)shadows.cascadeCount : 0.0f);
+		glBindBufferRange(GL_UNIFORM_BUFFER, ShadowBlockBinding, shadowBlock.buffer, shadowBlock.offset, shadowBlock.size);
+	}
+
+	// Casters read the transforms uploaded above
+	if (snapshot.shadows.enabled && m_shadowMaps.Enabled())
+		DrawShadows(snapshot);
+
+	if (m_path == RenderPath::Deferred)
+	{
+		{
+			PROFILE_ZONE("G-buffer");
+			GpuScope gbufferScope(m_gpuProfiler, "G-buffer");
+			m_deferred.BeginGeometry(snapshot.width, snapshot.height);
+			for (const CommandList& list : snapshot.commandLists)
+				list.Replay(snapshot.stats);
+			glBindVertexArray(0);
+		}
+		{
+			PROFILE_ZONE("Lighting");
+			GpuScope lightingScope(m_gpuProfiler, "Lighting");
+			m_deferred.Light(snapshot.clearColor, m_target);
+		}
+		{
+			GpuScope resolveScope(m_gpuProfiler, "Resolve");
+			m_deferred.Resolve(m_target);
+		}
+		return;
+	}
+
+	for (const CommandList& list : snapshot.commandLists)
+		list.Replay(snapshot.stats);
+
+	glBindVertexArray(0);
+}
+
+void Renderer::DrawShadows(RenderSnapshot& snapshot)
+{
+	PROFILE_ZONE("Shadows");
+	GpuScope scope(m_gpuProfiler, "Shadows");
+
+	// Scope names are compared by pointer, so one literal per cascade
+	static const char* const CascadeNames[ShadowFrame::MaxCascades] = { "Cascade 0", "Cascade 1", "Cascade 2", "Cascade 3" };
+
+	m_shadowMaps.BeginPass();
+	for (uint32_t i = 0; i < snapshot.shadows.cascadeCount && i < snapshot.shadowLists.size(); i++)
+	{
+		// Cached layers keep what an earlier frame drew
+		if (!snapshot.shadows.cascades[i].render)
+			continue;
+
+		PROFILE_ZONE(CascadeNames[i]);
+		GpuScope cascadeScope(m_gpuProfiler, CascadeNames[i]);
+		m_shadowMaps.BeginCascade(i);
+		snapshot.shadowLists[i].Replay(snapshot.stats);
+	}
+	glBindVertexArray(0);
+	m_shadowMaps.EndPass(snapshot.width, snapshot.height, m_target);
+}
+
+void Renderer::DrawOverlay(RenderSnapshot& snapshot)
+{
+	snapshot.overlayRenderMs = 0.0;
+	if (!snapshot.overlay.valid)
+		return;
+
+	PROFILE_ZONE("Overlay");
+	GpuScope scope(m_gpuProfiler, "Overlay");
+
+	uint64_t start = FramePacer::Now();
+	Overlay::Render(snapshot.overlay);
+	snapshot.overlayRenderMs = FramePacer::ToMilliseconds(FramePacer::Now() - start);
+}
+
+void Renderer::LateUpdate()
+{
+	PROFILE_ZONE("LateUpdate");
+	// Fencing flushes as part of the wait, no explicit glFlush needed
+	m_frameResources.EndFrame();
+}
+
+void Renderer::Present(SDL_Window* window)
+{
+	PROFILE_ZONE("Present");
+	SDL_GL_SwapWindow(window);
+}
+
+void Renderer::RenderFrame(RenderSnapshot& snapshot, SDL_Window* window)
+{
+	PROFILE_ZONE("Render frame");
+
+	if (snapshot.renderLoadMs > 0.0)
+		FramePacer::SpinFor(snapshot.renderLoadMs);
+
+	// Room for the frame block, every transform and the light lists, plus alignment padding
+	size_t needed = sizeof(FrameBlock) + snapshot.items.size() * sizeof(glm::mat4)
+		+ snapshot.lights.lights.size() * sizeof(GpuLight)
+		+ (snapshot.lights.clusters.size() + snapshot.lights.indices.size()) * sizeof(uint32_t)
+		+ sizeof(ShadowBlock) + m_frameResources.UniformAlignment() * 2 + m_frameResources.StorageAlignment() * 4;
+	m_frameResources.Reserve(needed);
+	{
+		PROFILE_ZONE("Fence wait");
+		snapshot.fenceWaitMs = m_frameResources.BeginFrame();
+	}
+
+	snapshot.gpuFrameMs = -1.0;
+	if (m_gpuProfiler.BeginFrame())
+	{
+		Profiler::RecordGpuEvents(m_gpuProfiler.LastFrameEvents());
+		snapshot.gpuFrameMs = m_gpuProfiler.LastFrameMs();
+	}
+	m_gpuProfiler.Begin("Frame");
+	Clear(snapshot);
+	Draw(snapshot);
+	DrawOverlay(snapshot);
+	m_gpuProfiler.End();
+	m_gpuProfiler.EndFrame();
+
+	snapshot.gpuScopes.assign(m_gpuProfiler.Averages().begin(), m_gpuProfiler.Averages().end());
+	snapshot.gpuTimesCpuMeasured = m_gpuProfiler.CpuMeasured();
+	snapshot.frameResourceBytes = m_frameResources.BytesPerFrame() * m_frameResources.FramesInFlight();
+
+	LateUpdate();
+	if (!m_headless)
+		Present(window);
+	else if (snapshot.captureFrame >= 0)
+		m_headless->WriteFrame((uint64_t)snapshot.captureFrame);
+}
+
+void Renderer::SetHeadless(HeadlessContext* headless)
+{
+	m_headless = headless;
+	m_target = headless ? headless->Framebuffer() : 0;
+}
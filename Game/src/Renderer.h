@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <SDL.h>
+
+#include "CommandList.h"
+#include "DeferredPath.h"
+#include "FrameResources.h"
+#include "GpuProfiler.h"
+#include "HeadlessContext.h"
+#include "Model.h"
+#include "RenderSnapshot.h"
+#include "Shader.h"
+#include "Shadows.h"
+
+// Owns GL side state and turns a RenderSnapshot into GL calls.
+// Every method must be called from the thread that has the GL context current.
+class Renderer
+{
+public:
+	void Init(Model* model, uint32_t framesInFlight, bool gpuProfiling, RenderPath path, int32_t width, int32_t height);
+	// No cascades leaves shadows off
+	void InitShadows(uint32_t resolution, uint32_t cascades);
+	void Shutdown();
+
+	void Clear(const RenderSnapshot& snapshot);
+	void Draw(RenderSnapshot& snapshot);
+	void DrawShadows(RenderSnapshot& snapshot);
+	void DrawOverlay(RenderSnapshot& snapshot);
+	void LateUpdate();
+	void Present(SDL_Window* window);
+
+	void RenderFrame(RenderSnapshot& snapshot, SDL_Window* window);
+	// Draw into the headless context's framebuffer and capture frames instead of presenting
+	void SetHeadless(HeadlessContext* headless);
+
+	// Immutable after Init, so any thread may record against them
+	const std::vector<DrawBinding>& Bindings() const { return m_bindings; }
+	const SceneUniforms& Uniforms() const { return m_uniforms; }
+	const std::vector<DrawBinding>& ShadowBindings() const { return m_shadowBindings; }
+	const SceneUniforms& ShadowUniforms() const { return m_shadowUniforms; }
+	int32_t ShadowMatrixLocation() const { return m_shadowMaps.MatrixLocation(); }
+	RenderPath Path() const { return m_path; }
+	uint32_t GBufferBytesPerPixel() const { return m_path == RenderPath::Deferred ? DeferredPath::BytesPerPixel() : 0; }
+
+private:
+	Model* m_model = nullptr;
+	RenderPath m_path = RenderPath::Forward;
+	std::unique_ptr<Shader> m_shader;	// forward shading or G-buffer fill, depending on the path
+	DeferredPath m_deferred;
+	uint32_t m_whiteTexture = 0;
+
+	std::vector<DrawBinding> m_bindings;
+	SceneUniforms m_uniforms;
+
+	ShadowMaps m_shadowMaps;
+	std::vector<DrawBinding> m_shadowBindings;	// geometry only
+	SceneUniforms m_shadowUniforms;
+
+	FrameResources m_frameResources;
+	GpuProfiler m_gpuProfiler;
+
+	HeadlessContext* m_headless = nullptr;
+	uint32_t m_target = 0;	// framebuffer frames end up in
+};
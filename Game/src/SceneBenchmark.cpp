@@ -0,0 +1,397 @@
+#include "SceneBenchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <json.hpp>
+
+#include "FramePacer.h"
+#include "Log.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+void CameraPath::Orbit(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+	const uint32_t keys = 64;
+	glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	float radius = glm::max(glm::length(boundsMax - boundsMin) * 0.5f, 1.0f);
+
+	m_keys.clear();
+	for (uint32_t i = 0; i <= keys; i++)
+	{
+		float angle = 6.2831853f * i / keys;
+		Key key;
+		key.time = i * 0.5;
+		key.position = center + glm::vec3(std::cos(angle) * radius * 1.2f, radius * (0.35f + 0.15f * std::sin(angle * 2.0f)), std::sin(angle) * radius * 1.2f);
+
+		// Yaw keeps counting past 180 so interpolation never swings the long way round
+		glm::vec3 toCenter = glm::normalize(center - key.position);
+		key.yaw = glm::degrees(angle) + 180.0f;
+		key.pitch = glm::degrees(std::asin(glm::clamp(toCenter.y, -1.0f, 1.0f)));
+		m_keys.push_back(key);
+	}
+}
+
+void CameraPath::Add(double time, const Camera& camera)
+{
+	m_keys.push_back({ time, camera.position, camera.yaw, camera.pitch });
+}
+
+bool CameraPath::Load(const std::string& file)
+{
+	std::ifstream stream(file);
+	if (!stream)
+	{
+		LOG_ERROR("Failed to open camera path: " << file);
+		return false;
+	}
+
+	m_keys.clear();
+	std::string line;
+	uint32_t lineNumber = 0;
+	while (std::getline(stream, line))
+	{
+		lineNumber++;
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		Key key;
+		std::istringstream fields(line);
+		if (!(fields >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.yaw >> key.pitch)
+			|| (!m_keys.empty() && key.time < m_keys.back().time))
+		{
+			LOG_ERROR("Bad camera path key at " << file << ":" << lineNumber);
+			m_keys.clear();
+			return false;
+		}
+		m_keys.push_back(key);
+	}
+
+	if (m_keys.empty())
+		LOG_ERROR("Camera path has no keys: " << file);
+	return !m_keys.empty();
+}
+
+bool CameraPath::Save(const std::string& file) const
+{
+	std::ofstream stream(file);
+	if (!stream)
+	{
+		LOG_ERROR("Failed to write camera path: " << file);
+		return false;
+	}
+
+	stream << "# time x y z yaw pitch" << std::endl;
+	stream << std::setprecision(9);
+	for (const Key& key : m_keys)
+		stream << key.time << " " << key.position.x << " " << key.position.y << " " << key.position.z << " " << key.yaw << " " << key.pitch << std::endl;
+	return (bool)stream;
+}
+
+void CameraPath::Sample(double progress, Camera& camera) const
+{
+	if (m_keys.empty())
+		return;
+
+	double time = m_keys.front().time + glm::clamp(progress, 0.0, 1.0) * (m_keys.back().time - m_keys.front().time);
+	auto next = std::upper_bound(m_keys.begin(), m_keys.end(), time, [](double t, const Key& key) { return t < key.time; });
+	if (next == m_keys.begin() || next == m_keys.end())
+	{
+		const Key& key = next == m_keys.end() ? m_keys.back() : m_keys.front();
+		camera.position = key.position;
+		camera.yaw = key.yaw;
+		camera.pitch = key.pitch;
+		return;
+	}
+
+	const Key& a = *(next - 1);
+	const Key& b = *next;
+	float t = b.time > a.time ? (float)((time - a.time) / (b.time - a.time)) : 1.0f;
+	camera.position = glm::mix(a.position, b.position, t);
+	camera.yaw = glm::mix(a.yaw, b.yaw, t);
+	camera.pitch = glm::mix(a.pitch, b.pitch, t);
+}
+
+void SceneBenchmark::Begin(const std::string& scene, uint32_t frames)
+{
+	m_scene = scene;
+	m_frames = frames;
+	m_seen = 0;
+	m_active = true;
+	m_peakBytes = 0;
+	m_info.clear();
+	m_frameMs.clear();
+	m_cpuMs.clear();
+	m_gpuMs.clear();
+	m_frameMs.reserve(frames);
+	m_cpuMs.reserve(frames);
+	m_gpuMs.reserve(frames);
+}
+
+void SceneBenchmark::End()
+{
+	m_active = false;
+	m_peakBytes = PeakMemoryBytes();
+}
+
+void SceneBenchmark::SetInfo(const std::string& key, const std::string& value)
+{
+	m_info.emplace_back(key, value);
+}
+
+double SceneBenchmark::Progress(uint64_t frame) const
+{
+	if (frame < WarmupFrames || m_frames <= 1)
+		return 0.0;
+	return glm::min((double)(frame - WarmupFrames) / (m_frames - 1), 1.0);
+}
+
+void SceneBenchmark::AddFrame(double frameMs, double cpuMs)
+{
+	if (!m_active || m_seen++ < WarmupFrames)
+		return;
+	m_frameMs.push_back(frameMs);
+	m_cpuMs.push_back(cpuMs);
+}
+
+void SceneBenchmark::AddGpuFrame(double gpuMs)
+{
+	if (!m_active || m_seen < WarmupFrames)
+		return;
+	m_gpuMs.push_back(gpuMs);
+}
+
+SeriesSummary SceneBenchmark::Summarize(const std::vector<double>& samples)
+{
+	SeriesSummary summary;
+	summary.count = samples.size();
+	if (samples.empty())
+		return summary;
+
+	// Same nearest rank percentiles as the live frame stats
+	SampleWindow window(samples.size());
+	for (double sample : samples)
+		window.Push(sample);
+	summary.min = window.Min();
+	summary.avg = window.Average();
+	summary.p50 = window.Percentile(50.0);
+	summary.p95 = window.Percentile(95.0);
+	summary.p99 = window.Percentile(99.0);
+	summary.max = window.Max();
+	return summary;
+}
+
+size_t SceneBenchmark::PeakMemoryBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters = {};
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.PeakWorkingSetSize;
+	return 0;
+#else
+	// Kilobytes on Linux
+	struct rusage usage = {};
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+	return (size_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+void SceneBenchmark::Print() const
+{
+	LOG_INFO("Scene benchmark: " << m_frameMs.size() << " frames, load " << m_loadMs << "ms, peak memory "
+		<< m_peakBytes / (1024.0 * 1024.0) << " MB");
+	LOG_INFO("  series     count      min      avg      p50      p95      p99      max");
+
+	const std::pair<const char*, const std::vector<double>*> series[] = { { "frame_ms", &m_frameMs }, { "cpu_ms", &m_cpuMs }, { "gpu_ms", &m_gpuMs } };
+	for (const auto& entry : series)
+	{
+		if (entry.second->empty())
+			continue;
+		SeriesSummary summary = Summarize(*entry.second);
+		LOG_INFO("  " << std::left << std::setw(8) << entry.first << std::right << std::setw(8) << summary.count
+			<< std::fixed << std::setprecision(3)
+			<< std::setw(9) << summary.min << std::setw(9) << summary.avg << std::setw(9) << summary.p50
+			<< std::setw(9) << summary.p95 << std::setw(9) << summary.p99 << std::setw(9) << summary.max);
+	}
+}
+
+static nlohmann::json SeriesJson(const std::vector<double>& samples)
+{
+	SeriesSummary summary = SceneBenchmark::Summarize(samples);
+	nlohmann::json series;
+	series["count"] = summary.count;
+	series["min"] = summary.min;
+	series["avg"] = summary.avg;
+	series["p50"] = summary.p50;
+	series["p95"] = summary.p95;
+	series["p99"] = summary.p99;
+	series["max"] = summary.max;
+	series["samples"] = samples;
+	return series;
+}
+
+bool SceneBenchmark::Write(const std::string& file) const
+{
+	nlohmann::json doc;
+	doc["scene"] = m_scene;
+	doc["frames"] = m_frames;
+	doc["warmup_frames"] = WarmupFrames;
+	doc["info"] = nlohmann::json::object();
+	for (const auto& entry : m_info)
+		doc["info"][entry.first] = entry.second;
+	doc["load_ms"] = m_loadMs;
+	doc["peak_memory_bytes"] = m_peakBytes;
+	doc["frame_ms"] = SeriesJson(m_frameMs);
+	doc["cpu_ms"] = SeriesJson(m_cpuMs);
+	doc["gpu_ms"] = SeriesJson(m_gpuMs);
+
+	std::ofstream stream(file);
+	if (!stream)
+	{
+		LOG_ERROR("Failed to write benchmark results: " << file);
+		return false;
+	}
+	stream << doc.dump(1, '\t') << std::endl;
+	LOG_INFO("Benchmark results written to " << file);
+	return (bool)stream;
+}
+
+static bool ReadResults(const std::string& file, nlohmann::json& doc)
+{
+	std::ifstream stream(file);
+	if (stream)
+		doc = nlohmann::json::parse(stream, nullptr, false);
+	if (!stream || doc.is_discarded() || !doc.is_object())
+	{
+		LOG_ERROR("Failed to read benchmark results: " << file);
+		return false;
+	}
+	return true;
+}
+
+static std::vector<double> ReadSamples(const nlohmann::json& doc, const char* series)
+{
+	std::vector<double> samples;
+	if (doc.contains(series) && doc[series].contains("samples") && doc[series]["samples"].is_array())
+	{
+		for (const nlohmann::json& value : doc[series]["samples"])
+		{
+			if (value.is_number())
+				samples.push_back(value.get<double>());
+		}
+	}
+	return samples;
+}
+
+// z > 0 when the candidate tends to be larger. Normal approximation with the tie
+// correction, which is accurate well below the few hundred samples a run has.
+static double MannWhitneyZ(const std::vector<double>& baseline, const std::vector<double>& candidate)
+{
+	std::vector<std::pair<double, bool>> all;
+	all.reserve(baseline.size() + candidate.size());
+	for (double value : baseline)
+		all.emplace_back(value, false);
+	for (double value : candidate)
+		all.emplace_back(value, true);
+	std::sort(all.begin(), all.end(), [](const std::pair<double, bool>& a, const std::pair<double, bool>& b) { return a.first < b.first; });
+
+	double candidateRanks = 0.0;
+	double ties = 0.0;
+	for (size_t i = 0; i < all.size();)
+	{
+		size_t j = i;
+		while (j < all.size() && all[j].first == all[i].first)
+			j++;
+
+		// Tied values share the average of the ranks i + 1 through j
+		double rank = (i + 1 + j) * 0.5;
+		for (size_t k = i; k < j; k++)
+		{
+			if (all[k].second)
+				candidateRanks += rank;
+		}
+		double count = (double)(j - i);
+		ties += count * count * count - count;
+		i = j;
+	}
+
+	double n1 = (double)candidate.size();
+	double n2 = (double)baseline.size();
+	double n = n1 + n2;
+	double u = candidateRanks - n1 * (n1 + 1.0) * 0.5;
+	double variance = n1 * n2 / 12.0 * ((n + 1.0) - ties / (n * (n - 1.0)));
+	return variance > 0.0 ? (u - n1 * n2 * 0.5) / std::sqrt(variance) : 0.0;
+}
+
+int32_t SceneBenchmark::Compare(const std::string& baselineFile, const std::string& candidateFile)
+{
+	nlohmann::json baseline, candidate;
+	if (!ReadResults(baselineFile, baseline) || !ReadResults(candidateFile, candidate))
+		return -1;
+
+	LOG_INFO("Comparing " << baselineFile << " (baseline) with " << candidateFile);
+
+	// Results from different setups still compare, but say so
+	if (baseline.value("scene", "") != candidate.value("scene", ""))
+		LOG_WARN("  Warning: different scenes");
+	if (baseline.contains("info") && candidate.contains("info") && baseline["info"] != candidate["info"])
+		LOG_WARN("  Warning: different settings: " << baseline["info"].dump() << " vs " << candidate["info"].dump());
+
+	LOG_INFO("  series    baseline p50  candidate p50    change          p");
+	int32_t regressions = 0;
+	for (const char* series : { "frame_ms", "cpu_ms", "gpu_ms" })
+	{
+		std::vector<double> a = ReadSamples(baseline, series);
+		std::vector<double> b = ReadSamples(candidate, series);
+		if (a.size() < 8 || b.size() < 8)
+			continue;
+
+		double p50a = Summarize(a).p50;
+		double p50b = Summarize(b).p50;
+		double change = p50a > 0.0 ? (p50b - p50a) / p50a * 100.0 : 0.0;
+		double z = MannWhitneyZ(a, b);
+		double p = std::erfc(std::abs(z) / std::sqrt(2.0));
+
+		const char* verdict = "";
+		if (p < Significance && change > MinChangePercent)
+		{
+			verdict = "REGRESSION";
+			regressions++;
+		}
+		else if (p < Significance && change < -MinChangePercent)
+		{
+			verdict = "improvement";
+		}
+
+		LOG_INFO("  " << std::left << std::setw(8) << series << std::right << std::fixed << std::setprecision(3)
+			<< std::setw(14) << p50a << std::setw(15) << p50b
+			<< std::setw(9) << std::showpos << std::setprecision(2) << change << "%" << std::noshowpos
+			<< std::scientific << std::setprecision(1) << std::setw(11) << p << "  " << verdict);
+	}
+
+	// Single values per run, shown for reference but not tested
+	double loadA = baseline.value("load_ms", 0.0);
+	double loadB = candidate.value("load_ms", 0.0);
+	double memoryA = baseline.value("peak_memory_bytes", 0.0) / (1024.0 * 1024.0);
+	double memoryB = candidate.value("peak_memory_bytes", 0.0) / (1024.0 * 1024.0);
+	LOG_INFO(std::fixed << std::setprecision(1)
+		<< "  Load: " << loadA << "ms -> " << loadB << "ms, peak memory: " << memoryA << " MB -> " << memoryB << " MB");
+
+	if (regressions > 0)
+		LOG_WARN(regressions << " significant regression(s)");
+	else
+		LOG_INFO("No significant regressions");
+	return regressions;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Camera.h"
+
+// Camera keys played back by progress along the path. Stored as text, one
+// "time x y z yaw pitch" line per key; lines starting with # are comments.
+class CameraPath
+{
+public:
+	struct Key
+	{
+		double time;	// seconds, only the spacing between keys matters for playback
+		glm::vec3 position;
+		float yaw;
+		float pitch;
+	};
+
+	// Scripted path: one lap around the bounds looking at the center, rising and falling
+	void Orbit(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+	void Clear() { m_keys.clear(); }
+	void Add(double time, const Camera& camera);
+	bool Load(const std::string& file);
+	bool Save(const std::string& file) const;
+
+	bool Empty() const { return m_keys.empty(); }
+	size_t Count() const { return m_keys.size(); }
+	double EndTime() const { return m_keys.empty() ? 0.0 : m_keys.back().time; }
+
+	// Sets position and angles from 0 (first key) to 1 (last key), linear between keys.
+	// Everything else on the camera is left alone.
+	void Sample(double progress, Camera& camera) const;
+
+private:
+	std::vector<Key> m_keys;
+};
+
+struct SeriesSummary
+{
+	size_t count = 0;
+	double min = 0.0;
+	double avg = 0.0;
+	double p50 = 0.0;
+	double p95 = 0.0;
+	double p99 = 0.0;
+	double max = 0.0;
+};
+
+// Timings of one fixed length run over a camera path. Results are written as JSON with
+// the raw per frame samples, so two runs can be compared with a significance test
+// instead of eyeballing averages.
+class SceneBenchmark
+{
+public:
+	// Frames run before measuring, for shader compiles, residency and caches to settle
+	static constexpr uint32_t WarmupFrames = 60;
+	// Smallest median change flagged, even when significant
+	static constexpr double MinChangePercent = 2.0;
+	// Two sided p value below which a change is significant
+	static constexpr double Significance = 0.01;
+
+	void Begin(const std::string& scene, uint32_t frames);
+	void End();
+	bool Active() const { return m_active; }
+	uint64_t TotalFrames() const { return WarmupFrames + (uint64_t)m_frames; }
+
+	// Free form description of the run, e.g. the render path and resolution
+	void SetInfo(const std::string& key, const std::string& value);
+	void SetLoadMs(double ms) { m_loadMs = ms; }
+
+	// Path progress for a frame: 0 through warmup, then evenly up to 1 on the last frame
+	double Progress(uint64_t frame) const;
+
+	// Whole frame interval and simulation thread work; dropped during warmup
+	void AddFrame(double frameMs, double cpuMs);
+	// GPU time of a resolved frame, which arrives a few frames late; dropped during warmup
+	void AddGpuFrame(double gpuMs);
+
+	void Print() const;
+	bool Write(const std::string& file) const;
+
+	// Mann-Whitney U test per series of the candidate against the baseline. Prints a table
+	// and returns the number of significant regressions, or -1 when a file can't be read.
+	static int32_t Compare(const std::string& baselineFile, const std::string& candidateFile);
+
+	static SeriesSummary Summarize(const std::vector<double>& samples);
+	// High water mark of the process' resident memory
+	static size_t PeakMemoryBytes();
+
+private:
+	std::string m_scene;
+	uint32_t m_frames = 0;
+	uint64_t m_seen = 0;
+	bool m_active = false;
+	double m_loadMs = 0.0;
+	size_t m_peakBytes = 0;
+	std::vector<std::pair<std::string, std::string>> m_info;
+
+	std::vector<double> m_frameMs;
+	std::vector<double> m_cpuMs;
+	std::vector<double> m_gpuMs;
+};
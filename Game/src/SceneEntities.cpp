@@ -0,0 +1,19 @@
+#include "SceneEntities.h"
+
+#include "Model.h"
+#include "Profiler.h"
+
+void CreateSceneEntities(const Model& model, Registry& registry)
+{
+	PROFILE_ZONE("Create scene entities");
+	for (uint32_t i = 0; i < (uint32_t)model.instances.size(); i++)
+	{
+		const MeshInstance& instance = model.instances[i];
+		Entity entity = registry.Create();
+		registry.Add(entity, WorldTransform{ instance.transform, instance.node });
+		registry.Add(entity, MeshRef{ instance.mesh, i });
+	}
+
+	for (const Light& light : model.lights)
+		registry.Add(registry.Create(), light);
+}
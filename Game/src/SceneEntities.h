@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Entities.h"
+#include "Light.h"
+
+class Model;
+
+// Components of the imported scene's entities. Lights use Light itself.
+struct WorldTransform
+{
+	glm::mat4 matrix = glm::mat4(1.0f);
+	uint32_t node = UINT32_MAX;		// in Model::nodes
+};
+
+struct MeshRef
+{
+	uint32_t mesh = 0;
+	uint32_t instance = 0;	// in Model::instances, whose bounds culling reads
+};
+
+// One entity per mesh instance (WorldTransform, MeshRef) and per light (Light). The render
+// snapshot's draws and the light culling read them from here.
+void CreateSceneEntities(const Model& model, Registry& registry);
@@ -0,0 +1,311 @@
+#include "SceneGenerator.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <sstream>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Log.h"
+#include "Profiler.h"
+
+bool SceneGeneratorSettings::Parse(const std::string& spec)
+{
+	std::istringstream stream(spec);
+	std::string pair;
+	while (std::getline(stream, pair, ','))
+	{
+		if (pair.empty())
+			continue;
+
+		size_t equals = pair.find('=');
+		std::string key = pair.substr(0, equals);
+		char* end = nullptr;
+		unsigned long value = equals != std::string::npos ? std::strtoul(pair.c_str() + equals + 1, &end, 10) : 0;
+		if (equals == std::string::npos || *end != '\0')
+		{
+			LOG_ERROR("Bad scene generator setting: " << pair);
+			return false;
+		}
+
+		if (key == "meshes") meshes = (uint32_t)value;
+		else if (key == "instances") instances = (uint32_t)value;
+		else if (key == "materials") materials = (uint32_t)value;
+		else if (key == "textures") textures = (uint32_t)value;
+		else if (key == "lights") lights = (uint32_t)value;
+		else if (key == "depth") depth = (uint32_t)value;
+		else if (key == "detail") detail = (uint32_t)value;
+		else if (key == "texture_size") textureSize = (uint32_t)value;
+		else if (key == "seed") seed = (uint32_t)value;
+		else
+		{
+			LOG_ERROR("Unknown scene generator setting: " << key);
+			return false;
+		}
+	}
+	return true;
+}
+
+std::string SceneGeneratorSettings::Describe() const
+{
+	return "meshes=" + std::to_string(meshes) + ",instances=" + std::to_string(instances)
+		+ ",materials=" + std::to_string(materials) + ",textures=" + std::to_string(textures)
+		+ ",lights=" + std::to_string(lights) + ",depth=" + std::to_string(depth)
+		+ ",detail=" + std::to_string(detail) + ",texture_size=" + std::to_string(textureSize)
+		+ ",seed=" + std::to_string(seed);
+}
+
+// Makes every triangle counter clockwise seen from the side its normals point to
+static void OrientTriangles(BakedMesh& mesh)
+{
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		const Vertex& a = mesh.vertices[mesh.indices[i]];
+		const Vertex& b = mesh.vertices[mesh.indices[i + 1]];
+		const Vertex& c = mesh.vertices[mesh.indices[i + 2]];
+		glm::vec3 face = glm::cross(b.Position - a.Position, c.Position - a.Position);
+		if (glm::dot(face, a.Normal + b.Normal + c.Normal) < 0.0f)
+			std::swap(mesh.indices[i + 1], mesh.indices[i + 2]);
+	}
+}
+
+// Quads of a (columns + 1) x (rows + 1) vertex grid starting at first
+static void AddGridIndices(BakedMesh& mesh, uint32_t first, uint32_t columns, uint32_t rows)
+{
+	for (uint32_t row = 0; row < rows; row++)
+	{
+		for (uint32_t column = 0; column < columns; column++)
+		{
+			uint32_t i = first + row * (columns + 1) + column;
+			mesh.indices.insert(mesh.indices.end(), { i, i + columns + 1, i + 1, i + 1, i + columns + 1, i + columns + 2 });
+		}
+	}
+}
+
+static void BuildSphere(BakedMesh& mesh, uint32_t segments)
+{
+	uint32_t rings = glm::max(segments / 2, 2u);
+	for (uint32_t ring = 0; ring <= rings; ring++)
+	{
+		float theta = 3.14159265f * ring / rings;
+		for (uint32_t segment = 0; segment <= segments; segment++)
+		{
+			float phi = 6.2831853f * segment / segments;
+			Vertex vertex;
+			vertex.Normal = glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+			vertex.Position = vertex.Normal;
+			vertex.TexCoords = glm::vec3((float)segment / segments * 2.0f, (float)ring / rings, 0.0f);
+			mesh.vertices.push_back(vertex);
+		}
+	}
+	AddGridIndices(mesh, 0, segments, rings);
+}
+
+static void BuildBox(BakedMesh& mesh, uint32_t segments)
+{
+	uint32_t cells = glm::max(segments / 4, 1u);
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		for (float side : { -1.0f, 1.0f })
+		{
+			glm::vec3 normal(0.0f);
+			normal[axis] = side;
+			glm::vec3 u(0.0f), v(0.0f);
+			u[(axis + 1) % 3] = 1.0f;
+			v[(axis + 2) % 3] = 1.0f;
+
+			uint32_t first = (uint32_t)mesh.vertices.size();
+			for (uint32_t y = 0; y <= cells; y++)
+			{
+				for (uint32_t x = 0; x <= cells; x++)
+				{
+					float s = (float)x / cells;
+					float t = (float)y / cells;
+					Vertex vertex;
+					vertex.Position = normal + u * (s * 2.0f - 1.0f) + v * (t * 2.0f - 1.0f);
+					vertex.Normal = normal;
+					vertex.TexCoords = glm::vec3(s, t, 0.0f);
+					mesh.vertices.push_back(vertex);
+				}
+			}
+			AddGridIndices(mesh, first, cells, cells);
+		}
+	}
+}
+
+static void BuildTorus(BakedMesh& mesh, uint32_t segments)
+{
+	const float major = 0.7f;
+	const float minor = 0.3f;
+	uint32_t sides = glm::max(segments / 2, 3u);
+	for (uint32_t side = 0; side <= sides; side++)
+	{
+		float v = 6.2831853f * side / sides;
+		for (uint32_t segment = 0; segment <= segments; segment++)
+		{
+			float u = 6.2831853f * segment / segments;
+			glm::vec3 around(std::cos(u), 0.0f, std::sin(u));
+			Vertex vertex;
+			vertex.Normal = around * std::cos(v) + glm::vec3(0.0f, std::sin(v), 0.0f);
+			vertex.Position = around * major + vertex.Normal * minor;
+			vertex.TexCoords = glm::vec3((float)segment / segments * 4.0f, (float)side / sides, 0.0f);
+			mesh.vertices.push_back(vertex);
+		}
+	}
+	AddGridIndices(mesh, 0, segments, sides);
+}
+
+// Checkers, stripes or dots in two random colors
+static void BuildTexture(BakedTexture& texture, uint32_t index, uint32_t size, std::mt19937& rng)
+{
+	std::uniform_int_distribution<uint32_t> channel(0, 255);
+	uint32_t colors[2];
+	for (uint32_t& color : colors)
+		color = 0xFF000000u | channel(rng) << 16 | channel(rng) << 8 | channel(rng);
+
+	texture.name = "generated_" + std::to_string(index);
+	texture.width = (int32_t)size;
+	texture.height = (int32_t)size;
+	texture.texels.resize((size_t)size * size);
+
+	uint32_t cell = glm::max(size / 8, 1u);
+	for (uint32_t y = 0; y < size; y++)
+	{
+		for (uint32_t x = 0; x < size; x++)
+		{
+			bool first;
+			if (index % 3 == 0)
+				first = ((x / cell + y / cell) & 1) != 0;
+			else if (index % 3 == 1)
+				first = ((x + y) / cell & 1) != 0;
+			else
+			{
+				int32_t dx = (int32_t)(x % cell) - (int32_t)cell / 2;
+				int32_t dy = (int32_t)(y % cell) - (int32_t)cell / 2;
+				first = dx * dx + dy * dy < (int32_t)(cell * cell / 9);
+			}
+			texture.texels[(size_t)y * size + x] = colors[first ? 0 : 1];
+		}
+	}
+}
+
+struct HierarchyBuilder
+{
+	BakedScene& scene;
+	const std::vector<glm::mat4>& placements;
+	const std::vector<uint32_t>& meshes;
+	uint32_t depth;
+	uint32_t branching;
+	std::mt19937& rng;
+
+	// Depth first, so nodes come out in the order the transform hierarchy needs
+	void Emit(uint32_t parent, const glm::mat4& parentWorld, uint32_t level, uint32_t begin, uint32_t end)
+	{
+		if (level == depth)
+		{
+			glm::mat4 toParent = glm::inverse(parentWorld);
+			for (uint32_t i = begin; i < end; i++)
+			{
+				scene.instances.push_back({ meshes[i], (uint32_t)scene.nodes.size() });
+				scene.nodes.push_back({ parent, toParent * placements[i], std::string() });
+			}
+			return;
+		}
+
+		// Groups get a transform of their own so world matrices really go through the tree
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		for (uint32_t child = 0; child < branching; child++)
+		{
+			uint32_t childBegin = begin + (uint32_t)((uint64_t)(end - begin) * child / branching);
+			uint32_t childEnd = begin + (uint32_t)((uint64_t)(end - begin) * (child + 1) / branching);
+			if (childBegin == childEnd)
+				continue;
+
+			glm::mat4 local = glm::translate(glm::mat4(1.0f), glm::vec3(unit(rng) - 0.5f, unit(rng) - 0.5f, unit(rng) - 0.5f));
+			local = glm::rotate(local, unit(rng) * 6.2831853f, glm::vec3(0.0f, 1.0f, 0.0f));
+			uint32_t node = (uint32_t)scene.nodes.size();
+			scene.nodes.push_back({ parent, local, std::string() });
+			Emit(node, parentWorld * local, level + 1, childBegin, childEnd);
+		}
+	}
+};
+
+void GenerateScene(const SceneGeneratorSettings& settings, BakedScene& scene)
+{
+	PROFILE_ZONE("Generate scene");
+	scene.Clear();
+	std::mt19937 rng(settings.seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	uint32_t textureSize = glm::max(settings.textureSize, 1u);
+	for (uint32_t i = 0; i < settings.textures; i++)
+	{
+		scene.textures.emplace_back();
+		BuildTexture(scene.textures.back(), i, textureSize, rng);
+	}
+
+	for (uint32_t i = 0; i < settings.materials; i++)
+	{
+		BakedMaterial material;
+		material.name = "generated_" + std::to_string(i);
+		material.diffuse = settings.textures > 0 ? (int32_t)(i % settings.textures) : -1;
+		scene.materials.push_back(material);
+	}
+
+	// Detail varies between half and one and a half times the setting
+	uint32_t meshCount = glm::max(settings.meshes, 1u);
+	uint32_t detail = glm::max(settings.detail, 4u);
+	for (uint32_t i = 0; i < meshCount; i++)
+	{
+		BakedMesh mesh;
+		uint32_t segments = glm::max(detail / 2 + (i * 7) % (detail + 1), 4u);
+		if (i % 3 == 0)
+			BuildSphere(mesh, segments);
+		else if (i % 3 == 1)
+			BuildBox(mesh, segments);
+		else
+			BuildTorus(mesh, segments);
+		OrientTriangles(mesh);
+		mesh.material = settings.materials > 0 ? i % settings.materials : 0;
+		scene.meshes.push_back(std::move(mesh));
+	}
+
+	// Row major over the grid, so every group is a strip of neighbours
+	const float spacing = 4.0f;
+	uint32_t side = (uint32_t)std::ceil(std::sqrt((double)settings.instances));
+	float half = side * spacing * 0.5f;
+	std::vector<glm::mat4> placements(settings.instances);
+	std::vector<uint32_t> meshes(settings.instances);
+	for (uint32_t i = 0; i < settings.instances; i++)
+	{
+		glm::vec3 position((i % side) * spacing - half + unit(rng), unit(rng) * 2.0f, (i / side) * spacing - half + unit(rng));
+		glm::mat4 world = glm::translate(glm::mat4(1.0f), position);
+		world = glm::rotate(world, unit(rng) * 6.2831853f, glm::vec3(0.0f, 1.0f, 0.0f));
+		placements[i] = glm::scale(world, glm::vec3(0.5f + unit(rng)));
+		meshes[i] = (uint32_t)(rng() % meshCount);
+	}
+
+	// Branching such that the last level of groups holds a handful of instances each
+	uint32_t branching = settings.depth > 0
+		? glm::max((uint32_t)std::ceil(std::pow((double)glm::max(settings.instances, 1u), 1.0 / (settings.depth + 1))), 2u)
+		: 1;
+	scene.nodes.reserve(settings.instances + settings.instances / glm::max(branching - 1, 1u) + 1);
+	scene.nodes.push_back({ UINT32_MAX, glm::mat4(1.0f), "root" });
+	HierarchyBuilder builder = { scene, placements, meshes, settings.depth, branching, rng };
+	builder.Emit(0, glm::mat4(1.0f), 0, 0, settings.instances);
+
+	for (uint32_t i = 0; i < settings.lights; i++)
+	{
+		Light light;
+		light.type = unit(rng) < 0.25f ? LightType::Spot : LightType::Point;
+		light.position = glm::vec3((unit(rng) * 2.0f - 1.0f) * half, 0.5f + unit(rng) * 5.5f, (unit(rng) * 2.0f - 1.0f) * half);
+		light.range = spacing * (1.5f + unit(rng) * 2.5f);
+		light.color = glm::vec3(unit(rng), unit(rng), unit(rng));
+		light.intensity = light.range * light.range;
+		light.direction = glm::normalize(glm::vec3(unit(rng) - 0.5f, -1.0f, unit(rng) - 0.5f));
+		light.outerCos = std::cos(glm::radians(20.0f + unit(rng) * 25.0f));
+		light.innerCos = light.outerCos + (1.0f - light.outerCos) * 0.5f;
+		scene.lights.push_back(light);
+	}
+}
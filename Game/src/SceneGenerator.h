@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "BakedScene.h"
+
+struct SceneGeneratorSettings
+{
+	uint32_t meshes = 32;		// unique meshes
+	uint32_t instances = 4096;
+	uint32_t materials = 16;
+	uint32_t textures = 8;
+	uint32_t lights = 64;
+	uint32_t depth = 3;			// levels of group nodes between the root and the instances
+	uint32_t detail = 16;		// segments around each shape, triangles grow with its square
+	uint32_t textureSize = 256;
+	uint32_t seed = 1;
+
+	// Comma separated key=value pairs with the names above (texture_size for textureSize).
+	// Keys not given keep their value; fails on unknown keys.
+	bool Parse(const std::string& spec);
+	std::string Describe() const;
+};
+
+// Synthesizes a scene for scaling tests. Meshes are spheres, boxes and tori of varying
+// detail. Instances go on a grid that grows with their count and hang under a tree of
+// group nodes, each group a contiguous strip of the grid. Textures are procedural patterns
+// and lights are scattered over the grid. The same settings give the same scene.
+void GenerateScene(const SceneGeneratorSettings& settings, BakedScene& scene);
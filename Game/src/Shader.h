@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Log.h"
+
+class Shader
+{
+public:
+	uint32_t ID;
+
+	Shader(std::string vertexPath, std::string fragmentPath)
+	{
+		// 1. Read Shader Code from File
+		std::string vertexCode,
+					fragmentCode;
+		std::ifstream vertexShaderFile, 
+					  fragmentShaderFile;
+
+		vertexShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+		fragmentShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+
+		try
+		{
+			// open 
+			vertexShaderFile.open(vertexPath);
+			fragmentShaderFile.open(fragmentPath);
+			std::stringstream vertexShaderStream, 
+							  fragmentShaderStream;
+
+			vertexShaderStream << vertexShaderFile.rdbuf();
+			fragmentShaderStream << fragmentShaderFile.rdbuf();
+
+			vertexShaderFile.close();
+			fragmentShaderFile.close();
+
+			vertexCode = vertexShaderStream.str();
+			fragmentCode = fragmentShaderStream.str();
+
+		}
+		catch (const std::ifstream::failure& e)
+		{
+			LOG_ERROR("Error Reading Shader: " << e.what());
+		}
+
+		const char* vShaderCode = vertexCode.c_str();
+		const char* fShaderCode = fragmentCode.c_str();
+
+		// 2. Compile Shader Code
+		uint32_t vertex, 
+				 fragment;
+		int32_t success;
+		char infoLog[512];
+
+		vertex = glCreateShader(GL_VERTEX_SHADER);
+		glShaderSource(vertex, 1, &vShaderCode, NULL);
+		glCompileShader(vertex);
+		glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			glGetShaderInfoLog(vertex, 512, NULL, infoLog);
+			LOG_ERROR("Error Compiling Vertex Shader:\n" << infoLog);
+		}
+
+		fragment = glCreateShader(GL_FRAGMENT_SHADER);
+		glShaderSource(fragment, 1, &fShaderCode, NULL);
+		glCompileShader(fragment);
+		glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			glGetShaderInfoLog(fragment, 512, NULL, infoLog);
+			LOG_ERROR("Error Compiling Fragment Shader:\n" << infoLog);
+		}
+
+		// create shader program
+		ID = glCreateProgram();
+		glAttachShader(ID, vertex);
+		glAttachShader(ID, fragment);
+		glLinkProgram(ID);
+		glGetProgramiv(ID, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			glGetProgramInfoLog(ID, 512, NULL, infoLog);
+			LOG_ERROR("Error Compiling Shader Program:\n" << infoLog);
+		}
+
+		glDeleteShader(vertex);
+		glDeleteShader(fragment);
+
+	}
+
+	explicit Shader(std::string computePath)
+	{
+		std::string computeCode;
+		std::ifstream computeShaderFile;
+		computeShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+
+		try
+		{
+			computeShaderFile.open(computePath);
+			std::stringstream computeShaderStream;
+			computeShaderStream << computeShaderFile.rdbuf();
+			computeShaderFile.close();
+			computeCode = computeShaderStream.str();
+		}
+		catch (const std::ifstream::failure& e)
+		{
+			LOG_ERROR("Error Reading Shader: " << e.what());
+		}
+
+		const char* cShaderCode = computeCode.c_str();
+		int32_t success;
+		char infoLog[512];
+
+		uint32_t compute = glCreateShader(GL_COMPUTE_SHADER);
+		glShaderSource(compute, 1, &cShaderCode, NULL);
+		glCompileShader(compute);
+		glGetShaderiv(compute, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			glGetShaderInfoLog(compute, 512, NULL, infoLog);
+			LOG_ERROR("Error Compiling Compute Shader:\n" << infoLog);
+		}
+
+		ID = glCreateProgram();
+		glAttachShader(ID, compute);
+		glLinkProgram(ID);
+		glGetProgramiv(ID, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			glGetProgramInfoLog(ID, 512, NULL, infoLog);
+			LOG_ERROR("Error Compiling Shader Program:\n" << infoLog);
+		}
+
+		glDeleteShader(compute);
+	}
+
+	void Use()
+	{
+		glUseProgram(ID);
+	}
+
+	void SetUniformBool(const std::string& name, bool value)
+	{
+		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+	}
+
+	void SetUniformInt(const std::string& name, int32_t value)
+	{
+		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	}
+
+	void SetUniformFloat(const std::string& name, float_t value)
+	{
+		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	}
+
+	void SetUniformVec3(const std::string& name, const glm::vec3& value)
+	{
+		glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
+	}
+
+	void SetUniformMat4(const std::string& name, const glm::mat4& value)
+	{
+		glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+	}
+};
@@ -0,0 +1,284 @@
+#include "Shadows.h"
+
+#include <cfloat>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "FramePacer.h"
+#include "Log.h"
+#include "MemoryTracker.h"
+#include "Profiler.h"
+
+void ShadowCascades::Init(uint32_t cascades, uint32_t resolution, float distance)
+{
+	m_cascades = glm::min(cascades, ShadowFrame::MaxCascades);
+	m_resolution = resolution;
+	m_distance = glm::clamp(distance, 0.001f, 1.0f);
+	Invalidate();
+}
+
+void ShadowCascades::Invalidate()
+{
+	m_boundsValid = false;
+	for (Cached& cached : m_cached)
+		cached.valid = false;
+}
+
+void ShadowCascades::BuildLightBounds(const Model& model)
+{
+	PROFILE_ZONE("Shadow light bounds");
+
+	glm::vec3 up = std::abs(m_lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	m_lightView = glm::lookAt(glm::vec3(0.0f), m_lightDirection, up);
+
+	// Box of the rotated box, from the center and the absolute rotation applied to the extents
+	glm::mat3 rotation = glm::mat3(m_lightView);
+	glm::mat3 absRotation;
+	for (int32_t c = 0; c < 3; c++)
+		absRotation[c] = glm::abs(rotation[c]);
+
+	m_lightMin.resize(model.instances.size());
+	m_lightMax.resize(model.instances.size());
+	m_sceneMin = glm::vec3(FLT_MAX);
+	m_sceneMax = glm::vec3(-FLT_MAX);
+	for (size_t i = 0; i < model.instances.size(); i++)
+	{
+		const MeshInstance& instance = model.instances[i];
+		if (instance.boundsMin.x > instance.boundsMax.x)
+		{
+			// No vertices, never overlaps
+			m_lightMin[i] = glm::vec3(FLT_MAX);
+			m_lightMax[i] = glm::vec3(-FLT_MAX);
+			continue;
+		}
+
+		glm::vec3 center = rotation * ((instance.boundsMin + instance.boundsMax) * 0.5f);
+		glm::vec3 extent = absRotation * ((instance.boundsMax - instance.boundsMin) * 0.5f);
+		m_lightMin[i] = center - extent;
+		m_lightMax[i] = center + extent;
+		m_sceneMin = glm::min(m_sceneMin, m_lightMin[i]);
+		m_sceneMax = glm::max(m_sceneMax, m_lightMax[i]);
+	}
+
+	if (model.instances.empty())
+	{
+		m_sceneMin = glm::vec3(0.0f);
+		m_sceneMax = glm::vec3(0.0f);
+	}
+	m_boundsValid = true;
+}
+
+ShadowCascades::Fit ShadowCascades::FitCascade(const Camera& camera, float aspect, float splitNear, float splitFar) const
+{
+	glm::vec3 forward = camera.Forward();
+	glm::vec3 right = camera.Right();
+	glm::vec3 up = glm::cross(right, forward);
+	float tanY = std::tan(glm::radians(camera.fov) * 0.5f);
+	float tanX = tanY * aspect;
+
+	glm::vec3 corners[8];
+	glm::vec3 center(0.0f);
+	for (uint32_t i = 0; i < 8; i++)
+	{
+		float depth = (i & 4) ? splitFar : splitNear;
+		float x = (i & 1) ? depth * tanX : -depth * tanX;
+		float y = (i & 2) ? depth * tanY : -depth * tanY;
+		corners[i] = camera.position + forward * depth + right * x + up * y;
+		center += corners[i];
+	}
+	center /= 8.0f;
+
+	// The slice is rigid, so the sphere only changes size through rounding error; round it away
+	float radius = 0.0f;
+	for (const glm::vec3& corner : corners)
+		radius = glm::max(radius, glm::length(corner - center));
+	float step = glm::max(camera.farPlane * m_distance / 1024.0f, 1e-4f);
+	radius = std::ceil(radius / step) * step;
+
+	Fit fit;
+	fit.texelSize = radius * 2.0f / (float)m_resolution;
+	fit.key.radius = radius;
+
+	// Whole texel steps across the light, whole radius steps along it
+	glm::vec3 lightCenter = glm::vec3(m_lightView * glm::vec4(center, 1.0f));
+	fit.key.x = (int32_t)std::floor(lightCenter.x / fit.texelSize);
+	fit.key.y = (int32_t)std::floor(lightCenter.y / fit.texelSize);
+	fit.key.z = (int32_t)std::floor((lightCenter.z - radius) / radius);
+
+	float x = fit.key.x * fit.texelSize;
+	float y = fit.key.y * fit.texelSize;
+	float minZ = fit.key.z * radius;
+	// Casters between the light and the cascade still throw shadows into it
+	float maxZ = glm::max(m_sceneMax.z, (fit.key.z + 3) * radius);
+	fit.boxMin = glm::vec3(x - radius, y - radius, minZ);
+	fit.boxMax = glm::vec3(x + radius, y + radius, maxZ);
+	return fit;
+}
+
+void ShadowCascades::CullCasters(const Fit& fit, std::vector<uint32_t>& casters) const
+{
+	casters.clear();
+	for (uint32_t i = 0; i < (uint32_t)m_lightMin.size(); i++)
+	{
+		const glm::vec3& min = m_lightMin[i];
+		const glm::vec3& max = m_lightMax[i];
+		if (min.x <= fit.boxMax.x && max.x >= fit.boxMin.x &&
+			min.y <= fit.boxMax.y && max.y >= fit.boxMin.y &&
+			min.z <= fit.boxMax.z && max.z >= fit.boxMin.z)
+			casters.push_back(i);
+	}
+}
+
+void ShadowCascades::Update(const Camera& camera, float aspect, const glm::vec3& lightDirection, const Model& model,
+	uint64_t frame, JobSystem& jobs, ShadowFrame& out)
+{
+	PROFILE_ZONE("Shadow cascades");
+	out.enabled = m_cascades > 0;
+	out.cascadeCount = m_cascades;
+	out.lightDirection = glm::normalize(lightDirection);
+	if (!out.enabled)
+		return;
+
+	if (!m_boundsValid || out.lightDirection != m_lightDirection || m_lightMin.size() != model.instances.size())
+	{
+		m_lightDirection = out.lightDirection;
+		BuildLightBounds(model);
+		for (Cached& cached : m_cached)
+			cached.valid = false;
+	}
+
+	float nearPlane = camera.nearPlane;
+	float farPlane = glm::max(camera.farPlane * m_distance, nearPlane * 2.0f);
+	float splitNear = nearPlane;
+	uint32_t refitCount = 0;
+	for (uint32_t i = 0; i < m_cascades; i++)
+	{
+		float t = (float)(i + 1) / (float)m_cascades;
+		float logSplit = nearPlane * std::pow(farPlane / nearPlane, t);
+		float uniformSplit = nearPlane + (farPlane - nearPlane) * t;
+		float splitFar = glm::mix(uniformSplit, logSplit, SplitLambda);
+
+		// Staggered so the slow cascades do not refit on the same frame
+		Cached& cached = m_cached[i];
+		if (!cached.valid || (frame + i) % UpdateInterval(i) == 0)
+		{
+			Fit fit = FitCascade(camera, aspect, splitNear, splitFar);
+			if (!cached.valid || !(fit.key == cached.key))
+			{
+				glm::mat4 projection = glm::ortho(fit.boxMin.x, fit.boxMax.x, fit.boxMin.y, fit.boxMax.y, -fit.boxMax.z, -fit.boxMin.z);
+				cached.valid = true;
+				cached.key = fit.key;
+				cached.cascade.viewProjection = projection * m_lightView;
+				cached.cascade.splitNear = splitNear;
+				cached.cascade.splitFar = splitFar;
+				cached.cascade.texelSize = fit.texelSize;
+				m_fits[i] = fit;
+				m_refit[refitCount++] = i;
+			}
+		}
+
+		ShadowCascade& cascade = out.cascades[i];
+		cascade.viewProjection = cached.cascade.viewProjection;
+		cascade.splitNear = cached.cascade.splitNear;
+		cascade.splitFar = cached.cascade.splitFar;
+		cascade.texelSize = cached.cascade.texelSize;
+		cascade.casterCount = cached.cascade.casterCount;
+		cascade.render = false;
+		cascade.cullMs = 0.0;
+		cascade.casters.clear();
+
+		splitNear = splitFar;
+	}
+
+	jobs.ParallelFor(refitCount, 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t r = begin; r < end; r++)
+		{
+			PROFILE_ZONE("Cull shadow casters");
+			uint64_t start = FramePacer::Now();
+			ShadowCascade& cascade = out.cascades[m_refit[r]];
+			CullCasters(m_fits[m_refit[r]], cascade.casters);
+			cascade.render = true;
+			cascade.casterCount = (uint32_t)cascade.casters.size();
+			cascade.cullMs = FramePacer::ToMilliseconds(FramePacer::Now() - start);
+		}
+	});
+
+	for (uint32_t r = 0; r < refitCount; r++)
+		m_cached[m_refit[r]].cascade.casterCount = out.cascades[m_refit[r]].casterCount;
+}
+
+void ShadowMaps::Init(uint32_t resolution, uint32_t cascades)
+{
+	m_resolution = resolution;
+	m_cascades = cascades;
+	if (cascades == 0)
+		return;
+
+	m_program = std::make_unique<Shader>("shaders/shadow.vert", "shaders/shadow.frag");
+	m_drawIndexLocation = glGetUniformLocation(m_program->ID, "drawIndex");
+	m_matrixLocation = glGetUniformLocation(m_program->ID, "lightViewProjection");
+
+	// Hardware 2x2 PCF through the compare sampler
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &m_texture);
+	glTextureStorage3D(m_texture, 1, GL_DEPTH_COMPONENT32F, resolution, resolution, cascades);
+	MemoryTracker::TrackGpu(GpuResource::Texture, m_texture, MemoryTracker::TextureBytes(resolution, resolution, cascades, 4, false), MemoryTag::Render, "shadow cascades");
+	glTextureParameteri(m_texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(m_texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(m_texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_texture, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTextureParameteri(m_texture, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+	glCreateFramebuffers(1, &m_framebuffer);
+	glNamedFramebufferDrawBuffer(m_framebuffer, GL_NONE);
+	glNamedFramebufferReadBuffer(m_framebuffer, GL_NONE);
+
+	LOG_INFO("Shadows: " << cascades << " cascades at " << resolution << "x" << resolution
+		<< ", " << Bytes() / (1024.0 * 1024.0) << " MB");
+}
+
+void ShadowMaps::Shutdown()
+{
+	if (m_framebuffer)
+		glDeleteFramebuffers(1, &m_framebuffer);
+	if (m_texture)
+	{
+		MemoryTracker::UntrackGpu(GpuResource::Texture, m_texture);
+		glDeleteTextures(1, &m_texture);
+	}
+	if (m_program)
+		glDeleteProgram(m_program->ID);
+	m_framebuffer = 0;
+	m_texture = 0;
+	m_program.reset();
+}
+
+void ShadowMaps::BeginPass()
+{
+	glDisable(GL_BLEND);
+	// Casters in front of the near plane are flattened onto it instead of clipped
+	glEnable(GL_DEPTH_CLAMP);
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(1.1f, 2.0f);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_resolution, m_resolution);
+}
+
+void ShadowMaps::BeginCascade(uint32_t cascade)
+{
+	glNamedFramebufferTextureLayer(m_framebuffer, GL_DEPTH_ATTACHMENT, m_texture, 0, cascade);
+	float farDepth = 1.0f;
+	glClearNamedFramebufferfv(m_framebuffer, GL_DEPTH, 0, &farDepth);
+}
+
+void ShadowMaps::EndPass(int32_t width, int32_t height, uint32_t target)
+{
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glDisable(GL_DEPTH_CLAMP);
+	glEnable(GL_BLEND);
+	glBindFramebuffer(GL_FRAMEBUFFER, target);
+	glViewport(0, 0, width, height);
+	glBindTextureUnit(TextureUnit, m_texture);
+}
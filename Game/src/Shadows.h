@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Camera.h"
+#include "JobSystem.h"
+#include "Model.h"
+#include "Shader.h"
+
+// One cascade of the sun's shadow map as the render thread sees it this frame
+struct ShadowCascade
+{
+	glm::mat4 viewProjection = glm::mat4(1.0f);	// what the layer was drawn with, used for sampling
+	float splitNear = 0.0f;			// view depth range the cascade covers
+	float splitFar = 0.0f;
+	float texelSize = 0.0f;			// world size of one shadow texel
+	bool render = false;			// redraw the layer this frame, otherwise it is cached
+	std::vector<uint32_t> casters;	// item indices, only filled when render is set
+	uint32_t casterCount = 0;		// casters in the layer as last drawn
+	double cullMs = 0.0;			// 0 when the cascade was not refit this frame
+};
+
+struct ShadowFrame
+{
+	static constexpr uint32_t MaxCascades = 4;
+
+	bool enabled = false;
+	uint32_t cascadeCount = 0;
+	glm::vec3 lightDirection = glm::vec3(0.0f, -1.0f, 0.0f);	// direction the light travels
+	ShadowCascade cascades[MaxCascades];
+};
+
+// CPU side of the cascaded shadow maps for the directional light.
+// The shadow range is split with the practical (log/uniform) scheme. Each cascade is fitted
+// with the bounding sphere of its frustum slice, which does not change size as the camera
+// turns, and its light space origin is snapped to whole texels so shadow edges do not
+// shimmer when the camera moves. Casters are culled per cascade against the light space box.
+// Distant cascades refit at reduced rates, and a cascade whose snapped box and light are
+// unchanged keeps last frame's layer. Scene geometry is static, so that is enough to cache.
+class ShadowCascades
+{
+public:
+	// distance is a fraction of the camera's far plane
+	void Init(uint32_t cascades, uint32_t resolution, float distance);
+	// Geometry changed; every cascade is refit and redrawn
+	void Invalidate();
+
+	// Fills out for this frame. Caster indices are instance indices of the model,
+	// which the snapshot's items follow one to one.
+	void Update(const Camera& camera, float aspect, const glm::vec3& lightDirection, const Model& model,
+		uint64_t frame, JobSystem& jobs, ShadowFrame& out);
+
+	uint32_t Cascades() const { return m_cascades; }
+	uint32_t Resolution() const { return m_resolution; }
+	// In the layer as last drawn
+	uint32_t CasterCount(uint32_t cascade) const { return m_cached[cascade].cascade.casterCount; }
+	// Refit every 1, 1, 2, 4 frames; nearer cascades show camera movement the most
+	static uint32_t UpdateInterval(uint32_t cascade) { return cascade < 2 ? 1 : 1u << (cascade - 1); }
+
+private:
+	static constexpr float SplitLambda = 0.75f;	// 1 is fully logarithmic
+
+	// Snapped light space box of a cascade; equal keys give an identical matrix
+	struct Key
+	{
+		int32_t x = 0;
+		int32_t y = 0;
+		int32_t z = 0;
+		float radius = 0.0f;
+
+		bool operator==(const Key& other) const { return x == other.x && y == other.y && z == other.z && radius == other.radius; }
+	};
+
+	struct Cached
+	{
+		bool valid = false;
+		Key key;
+		ShadowCascade cascade;	// casters unused
+	};
+
+	struct Fit
+	{
+		Key key;
+		glm::vec3 boxMin;		// light space
+		glm::vec3 boxMax;
+		float texelSize;
+	};
+
+	void BuildLightBounds(const Model& model);
+	Fit FitCascade(const Camera& camera, float aspect, float splitNear, float splitFar) const;
+	void CullCasters(const Fit& fit, std::vector<uint32_t>& casters) const;
+
+	uint32_t m_cascades = 0;
+	uint32_t m_resolution = 0;
+	float m_distance = 0.0f;
+
+	// Light space instance bounds, rebuilt only when the light turns
+	glm::vec3 m_lightDirection = glm::vec3(0.0f);
+	glm::mat4 m_lightView = glm::mat4(1.0f);
+	std::vector<glm::vec3> m_lightMin;
+	std::vector<glm::vec3> m_lightMax;
+	glm::vec3 m_sceneMin = glm::vec3(0.0f);
+	glm::vec3 m_sceneMax = glm::vec3(0.0f);
+	bool m_boundsValid = false;
+
+	Cached m_cached[ShadowFrame::MaxCascades];
+	Fit m_fits[ShadowFrame::MaxCascades];
+	uint32_t m_refit[ShadowFrame::MaxCascades] = {};
+};
+
+// GL side: one depth array layer per cascade, drawn with a depth only program
+class ShadowMaps
+{
+public:
+	static constexpr uint32_t TextureUnit = 8;	// must match the scene shaders
+
+	void Init(uint32_t resolution, uint32_t cascades);
+	void Shutdown();
+	bool Enabled() const { return m_texture != 0; }
+
+	// Depth only state for the shadow pass
+	void BeginPass();
+	// Targets and clears one layer
+	void BeginCascade(uint32_t cascade);
+	// Restores the main pass state on the target framebuffer and binds the maps for sampling
+	void EndPass(int32_t width, int32_t height, uint32_t target);
+
+	uint32_t Program() const { return m_program ? m_program->ID : 0; }
+	int32_t DrawIndexLocation() const { return m_drawIndexLocation; }
+	int32_t MatrixLocation() const { return m_matrixLocation; }
+	size_t Bytes() const { return (size_t)m_resolution * m_resolution * m_cascades * 4; }
+
+private:
+	std::unique_ptr<Shader> m_program;
+	int32_t m_drawIndexLocation = -1;
+	int32_t m_matrixLocation = -1;
+
+	uint32_t m_resolution = 0;
+	uint32_t m_cascades = 0;
+	uint32_t m_texture = 0;
+	uint32_t m_framebuffer = 0;
+};
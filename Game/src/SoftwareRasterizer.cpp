@@ -0,0 +1,642 @@
+#include "SoftwareRasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <stb_image.h>
+
+#include "FramePacer.h"
+#include "Log.h"
+#include "Profiler.h"
+#include "RenderSnapshot.h"
+
+// Vertices snap to 1/16 pixel, like GPUs do, so edge functions at pixel centers are
+// exact and a pixel on an edge shared by two triangles is drawn exactly once
+static constexpr float SubpixelSteps = 16.0f;
+static constexpr float EdgeTieBias = -1.0f / 512.0f;
+
+// Slices of the visible list per thread, so binning balances without much bin memory
+static constexpr uint32_t SlicesPerThread = 4;
+
+// Outcode bits, one per clip plane
+static constexpr uint32_t ClipLeft = 1;
+static constexpr uint32_t ClipRight = 2;
+static constexpr uint32_t ClipBottom = 4;
+static constexpr uint32_t ClipTop = 8;
+static constexpr uint32_t ClipNear = 16;
+static constexpr uint32_t ClipFar = 32;
+
+static uint32_t ClipCode(const glm::vec4& p)
+{
+	return (p.x < -p.w ? ClipLeft : 0u) | (p.x > p.w ? ClipRight : 0u)
+		| (p.y < -p.w ? ClipBottom : 0u) | (p.y > p.w ? ClipTop : 0u)
+		| (p.z < -p.w ? ClipNear : 0u) | (p.z > p.w ? ClipFar : 0u);
+}
+
+static uint32_t PackColor(const glm::vec4& color)
+{
+	glm::uvec4 c = glm::uvec4(glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f);
+	return c.r | (c.g << 8) | (c.b << 16) | (c.a << 24);
+}
+
+SoftwareRasterizer::SoftwareRasterizer()
+{
+	uint32_t white = 0xFFFFFFFFu;
+	AddTexture(1, 1, &white);
+}
+
+void SoftwareRasterizer::Resize(int32_t width, int32_t height)
+{
+	m_width = glm::max(width, 1);
+	m_height = glm::max(height, 1);
+	m_tilesX = (m_width + TileSize - 1) / TileSize;
+	m_tilesY = (m_height + TileSize - 1) / TileSize;
+	// Whole tiles, so 8 pixel groups never leave the buffer
+	m_stride = m_tilesX * TileSize;
+	m_rows = m_tilesY * TileSize;
+	m_color.assign((size_t)m_stride * m_rows, 0);
+	m_depth.assign((size_t)m_stride * m_rows, 1.0f);
+	m_tilePixels.assign(m_tilesX * m_tilesY, 0);
+}
+
+uint32_t SoftwareRasterizer::AddTexture(int32_t width, int32_t height, const uint32_t* texels)
+{
+	MipTexture texture;
+	texture.width = width;
+	texture.height = height;
+	texture.texels.assign(texels, texels + (size_t)width * height);
+	texture.offsets[0] = 0;
+	texture.levels = 1;
+
+	// Box filtered chain; odd sizes repeat their last row or column
+	int32_t w = width, h = height;
+	while ((w > 1 || h > 1) && texture.levels < MaxMipLevels)
+	{
+		int32_t nextW = glm::max(w / 2, 1);
+		int32_t nextH = glm::max(h / 2, 1);
+		uint32_t source = texture.offsets[texture.levels - 1];
+		uint32_t target = (uint32_t)texture.texels.size();
+		texture.texels.resize(target + (size_t)nextW * nextH);
+
+		for (int32_t y = 0; y < nextH; y++)
+		{
+			for (int32_t x = 0; x < nextW; x++)
+			{
+				int32_t x0 = glm::min(x * 2, w - 1), x1 = glm::min(x * 2 + 1, w - 1);
+				int32_t y0 = glm::min(y * 2, h - 1), y1 = glm::min(y * 2 + 1, h - 1);
+				const uint32_t quad[4] =
+				{
+					texture.texels[source + y0 * w + x0], texture.texels[source + y0 * w + x1],
+					texture.texels[source + y1 * w + x0], texture.texels[source + y1 * w + x1],
+				};
+
+				uint32_t result = 0;
+				for (uint32_t channel = 0; channel < 32; channel += 8)
+				{
+					uint32_t sum = 2;
+					for (uint32_t texel : quad)
+						sum += (texel >> channel) & 0xFF;
+					result |= (sum / 4) << channel;
+				}
+				texture.texels[target + y * nextW + x] = result;
+			}
+		}
+
+		texture.offsets[texture.levels++] = target;
+		w = nextW;
+		h = nextH;
+	}
+
+	m_textures.push_back(std::move(texture));
+	return (uint32_t)m_textures.size() - 1;
+}
+
+void SoftwareRasterizer::SetMeshTexture(uint32_t mesh, uint32_t texture)
+{
+	if (mesh >= m_meshTextures.size())
+		m_meshTextures.resize(mesh + 1, 0);
+	m_meshTextures[mesh] = texture < m_textures.size() ? texture : 0;
+}
+
+void SoftwareRasterizer::LoadTextures(const Model& model)
+{
+	PROFILE_ZONE("Load software textures");
+	m_meshTextures.assign(model.meshes.size(), 0);
+
+	std::vector<std::pair<std::string, uint32_t>> loaded;
+	for (uint32_t mesh = 0; mesh < (uint32_t)model.meshes.size(); mesh++)
+	{
+		for (const Texture& texture : model.meshes[mesh].textures)
+		{
+			if (texture.type != "texture_diffuse")
+				continue;
+
+			auto found = std::find_if(loaded.begin(), loaded.end(), [&](const auto& entry) { return entry.first == texture.path; });
+			if (found != loaded.end())
+			{
+				m_meshTextures[mesh] = found->second;
+				break;
+			}
+
+			int32_t width, height, components;
+			std::string file = model.directory + "/" + texture.path;
+			uint8_t* data = stbi_load(file.c_str(), &width, &height, &components, 4);
+			if (!data)
+			{
+				LOG_ERROR("Failed to load texture: " << file);
+				loaded.push_back({ texture.path, 0 });
+				break;
+			}
+
+			uint32_t index = AddTexture(width, height, reinterpret_cast<const uint32_t*>(data));
+			stbi_image_free(data);
+			loaded.push_back({ texture.path, index });
+			m_meshTextures[mesh] = index;
+			break;
+		}
+	}
+}
+
+void SoftwareRasterizer::LoadTextures(const BakedScene& scene)
+{
+	PROFILE_ZONE("Load software textures");
+	m_meshTextures.assign(scene.meshes.size(), 0);
+
+	std::vector<uint32_t> loaded(scene.textures.size(), 0);
+	for (uint32_t mesh = 0; mesh < (uint32_t)scene.meshes.size(); mesh++)
+	{
+		uint32_t material = scene.meshes[mesh].material;
+		if (material >= scene.materials.size() || scene.materials[material].diffuse < 0)
+			continue;
+
+		uint32_t texture = (uint32_t)scene.materials[material].diffuse;
+		if (loaded[texture] == 0)
+			loaded[texture] = AddTexture(scene.textures[texture].width, scene.textures[texture].height, scene.textures[texture].texels.data());
+		m_meshTextures[mesh] = loaded[texture];
+	}
+}
+
+void SoftwareRasterizer::TransformVertices(const Model& model, const RenderItem* items, const std::vector<uint32_t>& visible, const glm::mat4& viewProjection,
+	const glm::vec3& sunDirection, JobSystem& jobs)
+{
+	PROFILE_ZONE("Software vertices");
+	uint32_t count = (uint32_t)visible.size();
+	m_firstVertex.resize(count + 1);
+	uint32_t total = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		m_firstVertex[i] = total;
+		total += (uint32_t)model.meshes[items[visible[i]].mesh].vertices.size();
+	}
+	m_firstVertex[count] = total;
+	m_vertices.resize(total);
+
+	glm::vec3 toSun = -glm::normalize(sunDirection);
+	jobs.ParallelFor(count, 4, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const RenderItem& item = items[visible[i]];
+			const std::vector<Vertex>& vertices = model.meshes[item.mesh].vertices;
+			glm::mat4 clip = viewProjection * item.world;
+			glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(item.world)));
+
+			ClipVertex* out = m_vertices.data() + m_firstVertex[i];
+			for (const Vertex& vertex : vertices)
+			{
+				out->position = clip * glm::vec4(vertex.Position, 1.0f);
+				out->u = vertex.TexCoords.x;
+				out->v = vertex.TexCoords.y;
+				// Same ambient and sun split as scene.frag, without shadows or punctual lights
+				float diffuse = glm::max(glm::dot(glm::normalize(normalMatrix * vertex.Normal), toSun), 0.0f);
+				out->light = 0.25f + 0.75f * diffuse;
+				// Shared by several triangles, so projected once here
+				Project(*out);
+				out++;
+			}
+		}
+	});
+}
+
+void SoftwareRasterizer::Project(ClipVertex& vertex) const
+{
+	const glm::vec4& p = vertex.position;
+	vertex.invW = 1.0f / p.w;
+	vertex.x = std::floor((p.x * vertex.invW * 0.5f + 0.5f) * m_width * SubpixelSteps + 0.5f) / SubpixelSteps;
+	vertex.y = std::floor((0.5f - p.y * vertex.invW * 0.5f) * m_height * SubpixelSteps + 0.5f) / SubpixelSteps;
+	vertex.z = p.z * vertex.invW * 0.5f + 0.5f;
+}
+
+void SoftwareRasterizer::SetupTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, uint32_t texture, Slice& slice)
+{
+	const float x[3] = { a.x, b.x, c.x };
+	const float y[3] = { a.y, b.y, c.y };
+	const float z[3] = { a.z, b.z, c.z };
+	const float invW[3] = { a.invW, b.invW, c.invW };
+
+	// Counter clockwise in GL is negative here with y pointing down; back faces and slivers go
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (!(area < 0.0f))
+		return;
+
+	// Pixels whose centers are inside the bounds. Small triangles between centers end here.
+	// Clamped as floats first; vertices close to w = 0 land far outside the screen.
+	Triangle triangle;
+	triangle.minX = (int32_t)std::ceil(glm::max(glm::min(x[0], glm::min(x[1], x[2])), 0.0f) - 0.5f);
+	triangle.minY = (int32_t)std::ceil(glm::max(glm::min(y[0], glm::min(y[1], y[2])), 0.0f) - 0.5f);
+	triangle.maxX = (int32_t)std::floor(glm::min(glm::max(x[0], glm::max(x[1], x[2])), (float)m_width) - 0.5f);
+	triangle.maxY = (int32_t)std::floor(glm::min(glm::max(y[0], glm::max(y[1], y[2])), (float)m_height) - 0.5f);
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+		return;
+
+	// Swap two vertices so the edge functions are positive inside
+	uint32_t order[3] = { 0, 2, 1 };
+	area = -area;
+	float invArea = 1.0f / area;
+
+	for (uint32_t e = 0; e < 3; e++)
+	{
+		uint32_t from = order[(e + 1) % 3];
+		uint32_t to = order[(e + 2) % 3];
+		float dx = x[to] - x[from];
+		float dy = y[to] - y[from];
+		triangle.edgeA[e] = -dy;
+		triangle.edgeB[e] = dx;
+		triangle.edgeX[e] = x[from];
+		triangle.edgeY[e] = y[from];
+		// Top left rule: pixels exactly on other edges belong to the neighbouring triangle
+		bool topLeft = (dy == 0.0f && dx > 0.0f) || dy < 0.0f;
+		triangle.edgeBias[e] = topLeft ? 0.0f : EdgeTieBias;
+	}
+
+	// Barycentric weight of vertex order[e] is edge e over the area
+	triangle.originX = x[0];
+	triangle.originY = y[0];
+	auto plane = [&](float v0, float v1, float v2)
+	{
+		const float values[3] = { v0, v1, v2 };
+		Plane result;
+		result.base = values[0];
+		result.dx = 0.0f;
+		result.dy = 0.0f;
+		for (uint32_t e = 0; e < 3; e++)
+		{
+			result.dx += values[order[e]] * triangle.edgeA[e] * invArea;
+			result.dy += values[order[e]] * triangle.edgeB[e] * invArea;
+		}
+		return result;
+	};
+	triangle.z = plane(z[0], z[1], z[2]);
+	triangle.invW = plane(invW[0], invW[1], invW[2]);
+	triangle.uOverW = plane(a.u * invW[0], b.u * invW[1], c.u * invW[2]);
+	triangle.vOverW = plane(a.v * invW[0], b.v * invW[1], c.v * invW[2]);
+	triangle.lightOverW = plane(a.light * invW[0], b.light * invW[1], c.light * invW[2]);
+
+	// One mip level per triangle from its texel to pixel area ratio. Each level quarters the
+	// area, so the level is half the ratio's binary exponent.
+	const MipTexture& mip = m_textures[texture];
+	float ratio = std::abs((b.u - a.u) * (c.v - a.v) - (c.u - a.u) * (b.v - a.v)) * mip.width * mip.height * invArea;
+	int32_t exponent = 0;
+	std::frexp(ratio, &exponent);
+	triangle.texture = texture;
+	triangle.level = glm::min((uint32_t)glm::max(exponent - 1, 0) / 2, mip.levels - 1);
+
+	uint32_t index = (uint32_t)slice.triangles.size();
+	slice.triangles.push_back(triangle);
+	for (uint32_t ty = triangle.minY / TileSize; ty <= (uint32_t)triangle.maxY / TileSize; ty++)
+	{
+		for (uint32_t tx = triangle.minX / TileSize; tx <= (uint32_t)triangle.maxX / TileSize; tx++)
+			slice.bins[ty * m_tilesX + tx].push_back(index);
+	}
+}
+
+void SoftwareRasterizer::BinSlice(const Model& model, const RenderItem* items, const std::vector<uint32_t>& visible, Slice& slice)
+{
+	PROFILE_ZONE("Software binning");
+	slice.triangles.clear();
+	for (std::vector<uint32_t>& bin : slice.bins)
+		bin.clear();
+	slice.submitted = 0;
+
+	for (uint32_t i = slice.firstVisible; i < slice.firstVisible + slice.visibleCount; i++)
+	{
+		uint32_t mesh = items[visible[i]].mesh;
+		const std::vector<uint32_t>& indices = model.meshes[mesh].indices;
+		const ClipVertex* vertices = m_vertices.data() + m_firstVertex[i];
+		uint32_t texture = mesh < m_meshTextures.size() ? m_meshTextures[mesh] : 0;
+		slice.submitted += (uint32_t)(indices.size() / 3);
+
+		for (size_t t = 0; t + 2 < indices.size(); t += 3)
+		{
+			const ClipVertex* corners[3] = { &vertices[indices[t]], &vertices[indices[t + 1]], &vertices[indices[t + 2]] };
+			uint32_t codes[3] = { ClipCode(corners[0]->position), ClipCode(corners[1]->position), ClipCode(corners[2]->position) };
+			if (codes[0] & codes[1] & codes[2])
+				continue;
+
+			if (!((codes[0] | codes[1] | codes[2]) & ClipNear))
+			{
+				SetupTriangle(*corners[0], *corners[1], *corners[2], texture, slice);
+				continue;
+			}
+
+			// Near plane z = -w; a triangle clips to at most a quad
+			ClipVertex polygon[4];
+			uint32_t count = 0;
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				const ClipVertex& from = *corners[k];
+				const ClipVertex& to = *corners[(k + 1) % 3];
+				float fromDistance = from.position.z + from.position.w;
+				float toDistance = to.position.z + to.position.w;
+				if (fromDistance >= 0.0f)
+					polygon[count++] = from;
+				if ((fromDistance >= 0.0f) != (toDistance >= 0.0f))
+				{
+					float t = fromDistance / (fromDistance - toDistance);
+					ClipVertex& split = polygon[count++];
+					split.position = glm::mix(from.position, to.position, t);
+					split.u = glm::mix(from.u, to.u, t);
+					split.v = glm::mix(from.v, to.v, t);
+					split.light = glm::mix(from.light, to.light, t);
+					Project(split);
+				}
+			}
+			for (uint32_t k = 2; k < count; k++)
+				SetupTriangle(polygon[0], polygon[k - 1], polygon[k], texture, slice);
+		}
+	}
+}
+
+void SoftwareRasterizer::RasterizeTile(uint32_t tile, uint32_t clearColor)
+{
+	int32_t x0 = (int32_t)((tile % m_tilesX) * TileSize);
+	int32_t y0 = (int32_t)((tile / m_tilesX) * TileSize);
+	for (int32_t y = y0; y < y0 + (int32_t)TileSize; y++)
+	{
+		std::fill_n(m_color.data() + (size_t)y * m_stride + x0, TileSize, clearColor);
+		std::fill_n(m_depth.data() + (size_t)y * m_stride + x0, TileSize, 1.0f);
+	}
+
+	uint64_t pixels = 0;
+	int32_t x1 = x0 + (int32_t)TileSize - 1;
+	int32_t y1 = y0 + (int32_t)TileSize - 1;
+	for (const Slice& slice : m_slices)
+	{
+		for (uint32_t index : slice.bins[tile])
+		{
+			const Triangle& triangle = slice.triangles[index];
+			pixels += RasterizeTriangle(triangle, glm::max(triangle.minX, x0), glm::max(triangle.minY, y0),
+				glm::min(triangle.maxX, x1), glm::min(triangle.maxY, y1));
+		}
+	}
+	m_tilePixels[tile] = pixels;
+}
+
+#ifdef __AVX2__
+
+uint64_t SoftwareRasterizer::RasterizeTriangle(const Triangle& triangle, int32_t minX, int32_t minY, int32_t maxX, int32_t maxY)
+{
+	const MipTexture& texture = m_textures[triangle.texture];
+	int32_t textureW = glm::max(texture.width >> triangle.level, 1);
+	int32_t textureH = glm::max(texture.height >> triangle.level, 1);
+	const int32_t* texels = reinterpret_cast<const int32_t*>(texture.texels.data() + texture.offsets[triangle.level]);
+
+	const __m256 lanes = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256i byteMask = _mm256_set1_epi32(0xFF);
+	const __m256i maxChannel = _mm256_set1_epi32(255);
+	const __m256i alpha = _mm256_set1_epi32((int32_t)0xFF000000u);
+	const __m256 textureSize[2] = { _mm256_set1_ps((float)textureW), _mm256_set1_ps((float)textureH) };
+	const __m256i lastTexel[2] = { _mm256_set1_epi32(textureW - 1), _mm256_set1_epi32(textureH - 1) };
+	const __m256i textureRow = _mm256_set1_epi32(textureW);
+
+	__m256 edgeA[3], edgeX[3];
+	for (uint32_t e = 0; e < 3; e++)
+	{
+		edgeA[e] = _mm256_set1_ps(triangle.edgeA[e]);
+		edgeX[e] = _mm256_set1_ps(triangle.edgeX[e]);
+	}
+	const __m256 originX = _mm256_set1_ps(triangle.originX);
+	const __m256 zDx = _mm256_set1_ps(triangle.z.dx);
+	const __m256 invWDx = _mm256_set1_ps(triangle.invW.dx);
+	const __m256 uDx = _mm256_set1_ps(triangle.uOverW.dx);
+	const __m256 vDx = _mm256_set1_ps(triangle.vOverW.dx);
+	const __m256 lightDx = _mm256_set1_ps(triangle.lightOverW.dx);
+
+	uint64_t pixels = 0;
+	int32_t startX = minX & ~7;
+	for (int32_t y = minY; y <= maxY; y++)
+	{
+		float py = y + 0.5f;
+		float rowY = py - triangle.originY;
+		__m256 rowEdge[3];
+		for (uint32_t e = 0; e < 3; e++)
+			rowEdge[e] = _mm256_set1_ps(triangle.edgeB[e] * (py - triangle.edgeY[e]) + triangle.edgeBias[e]);
+		__m256 rowZ = _mm256_set1_ps(triangle.z.base + triangle.z.dy * rowY);
+		__m256 rowInvW = _mm256_set1_ps(triangle.invW.base + triangle.invW.dy * rowY);
+		__m256 rowU = _mm256_set1_ps(triangle.uOverW.base + triangle.uOverW.dy * rowY);
+		__m256 rowV = _mm256_set1_ps(triangle.vOverW.base + triangle.vOverW.dy * rowY);
+		__m256 rowLight = _mm256_set1_ps(triangle.lightOverW.base + triangle.lightOverW.dy * rowY);
+
+		uint32_t* colorRow = m_color.data() + (size_t)y * m_stride;
+		float* depthRow = m_depth.data() + (size_t)y * m_stride;
+		for (int32_t x = startX; x <= maxX; x += 8)
+		{
+			__m256 px = _mm256_add_ps(_mm256_set1_ps((float)x), lanes);
+			__m256 inside = _mm256_cmp_ps(_mm256_fmadd_ps(edgeA[0], _mm256_sub_ps(px, edgeX[0]), rowEdge[0]), zero, _CMP_GE_OQ);
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_fmadd_ps(edgeA[1], _mm256_sub_ps(px, edgeX[1]), rowEdge[1]), zero, _CMP_GE_OQ));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_fmadd_ps(edgeA[2], _mm256_sub_ps(px, edgeX[2]), rowEdge[2]), zero, _CMP_GE_OQ));
+			if (_mm256_movemask_ps(inside) == 0)
+				continue;
+
+			__m256 dx = _mm256_sub_ps(px, originX);
+			__m256 z = _mm256_fmadd_ps(zDx, dx, rowZ);
+			__m256 depth = _mm256_loadu_ps(depthRow + x);
+			__m256 pass = _mm256_and_ps(inside, _mm256_cmp_ps(z, depth, _CMP_LT_OQ));
+			int32_t mask = _mm256_movemask_ps(pass);
+			if (mask == 0)
+				continue;
+
+			__m256 w = _mm256_div_ps(one, _mm256_fmadd_ps(invWDx, dx, rowInvW));
+			__m256 u = _mm256_mul_ps(_mm256_fmadd_ps(uDx, dx, rowU), w);
+			__m256 v = _mm256_mul_ps(_mm256_fmadd_ps(vDx, dx, rowV), w);
+			__m256 light = _mm256_mul_ps(_mm256_fmadd_ps(lightDx, dx, rowLight), w);
+
+			// Repeat wrap, then point sample
+			u = _mm256_sub_ps(u, _mm256_floor_ps(u));
+			v = _mm256_sub_ps(v, _mm256_floor_ps(v));
+			__m256i tx = _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(u, textureSize[0])), lastTexel[0]);
+			__m256i ty = _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(v, textureSize[1])), lastTexel[1]);
+			__m256i index = _mm256_add_epi32(_mm256_mullo_epi32(ty, textureRow), tx);
+			__m256i texel = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), texels, index, _mm256_castps_si256(pass), 4);
+
+			__m256i color = alpha;
+			for (int32_t shift = 0; shift < 24; shift += 8)
+			{
+				__m256i channel = _mm256_and_si256(_mm256_srli_epi32(texel, shift), byteMask);
+				channel = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(channel), light));
+				channel = _mm256_min_epi32(channel, maxChannel);
+				color = _mm256_or_si256(color, _mm256_sll_epi32(channel, _mm_cvtsi32_si128(shift)));
+			}
+
+			__m256 oldColor = _mm256_loadu_ps(reinterpret_cast<const float*>(colorRow + x));
+			_mm256_storeu_ps(reinterpret_cast<float*>(colorRow + x), _mm256_blendv_ps(oldColor, _mm256_castsi256_ps(color), pass));
+			_mm256_storeu_ps(depthRow + x, _mm256_blendv_ps(depth, z, pass));
+			for (; mask; mask &= mask - 1)
+				pixels++;
+		}
+	}
+	return pixels;
+}
+
+#else
+
+uint64_t SoftwareRasterizer::RasterizeTriangle(const Triangle& triangle, int32_t minX, int32_t minY, int32_t maxX, int32_t maxY)
+{
+	const MipTexture& texture = m_textures[triangle.texture];
+	int32_t textureW = glm::max(texture.width >> triangle.level, 1);
+	int32_t textureH = glm::max(texture.height >> triangle.level, 1);
+	const uint32_t* texels = texture.texels.data() + texture.offsets[triangle.level];
+
+	uint64_t pixels = 0;
+	for (int32_t y = minY; y <= maxY; y++)
+	{
+		float py = y + 0.5f;
+		float rowY = py - triangle.originY;
+		uint32_t* colorRow = m_color.data() + (size_t)y * m_stride;
+		float* depthRow = m_depth.data() + (size_t)y * m_stride;
+		for (int32_t x = minX; x <= maxX; x++)
+		{
+			float px = x + 0.5f;
+			bool inside = true;
+			for (uint32_t e = 0; e < 3; e++)
+				inside &= triangle.edgeA[e] * (px - triangle.edgeX[e]) + triangle.edgeB[e] * (py - triangle.edgeY[e]) + triangle.edgeBias[e] >= 0.0f;
+			if (!inside)
+				continue;
+
+			float dx = px - triangle.originX;
+			float z = triangle.z.base + triangle.z.dx * dx + triangle.z.dy * rowY;
+			if (!(z < depthRow[x]))
+				continue;
+
+			float w = 1.0f / (triangle.invW.base + triangle.invW.dx * dx + triangle.invW.dy * rowY);
+			float u = (triangle.uOverW.base + triangle.uOverW.dx * dx + triangle.uOverW.dy * rowY) * w;
+			float v = (triangle.vOverW.base + triangle.vOverW.dx * dx + triangle.vOverW.dy * rowY) * w;
+			float light = (triangle.lightOverW.base + triangle.lightOverW.dx * dx + triangle.lightOverW.dy * rowY) * w;
+
+			int32_t tx = glm::min((int32_t)((u - std::floor(u)) * textureW), textureW - 1);
+			int32_t ty = glm::min((int32_t)((v - std::floor(v)) * textureH), textureH - 1);
+			uint32_t texel = texels[ty * textureW + tx];
+
+			uint32_t color = 0xFF000000u;
+			for (uint32_t shift = 0; shift < 24; shift += 8)
+			{
+				uint32_t channel = (uint32_t)glm::min((int32_t)std::lround(((texel >> shift) & 0xFF) * light), 255);
+				color |= channel << shift;
+			}
+			colorRow[x] = color;
+			depthRow[x] = z;
+			pixels++;
+		}
+	}
+	return pixels;
+}
+
+#endif
+
+void SoftwareRasterizer::Render(const Model& model, const RenderItem* items, const std::vector<uint32_t>& visible, const glm::mat4& viewProjection,
+	const glm::vec3& sunDirection, const glm::vec4& clearColor, JobSystem& jobs)
+{
+	PROFILE_ZONE("Software rasterizer");
+	uint64_t start = FramePacer::Now();
+	m_stats = SoftwareRasterStats();
+	if (m_color.empty())
+		Resize(m_width, m_height);
+
+	TransformVertices(model, items, visible, viewProjection, sunDirection, jobs);
+	uint64_t transformed = FramePacer::Now();
+
+	// Slices get about the same number of triangles each
+	uint32_t count = (uint32_t)visible.size();
+	uint64_t triangles = 0;
+	for (uint32_t index : visible)
+		triangles += model.meshes[items[index].mesh].indices.size() / 3;
+	uint32_t sliceCount = glm::max(glm::min((jobs.WorkerCount() + 1) * SlicesPerThread, count), 1u);
+	m_slices.resize(sliceCount);
+
+	uint64_t perSlice = triangles / sliceCount + 1;
+	uint32_t next = 0;
+	for (uint32_t s = 0; s < sliceCount; s++)
+	{
+		Slice& slice = m_slices[s];
+		slice.bins.resize(m_tilesX * m_tilesY);
+		slice.firstVisible = next;
+		uint64_t sliceTriangles = 0;
+		while (next < count && (sliceTriangles < perSlice || s + 1 == sliceCount))
+			sliceTriangles += model.meshes[items[visible[next++]].mesh].indices.size() / 3;
+		slice.visibleCount = next - slice.firstVisible;
+	}
+
+	jobs.ParallelFor(sliceCount, 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t s = begin; s < end; s++)
+			BinSlice(model, items, visible, m_slices[s]);
+	});
+	uint64_t binned = FramePacer::Now();
+
+	uint32_t clear = PackColor(clearColor);
+	jobs.ParallelFor(m_tilesX * m_tilesY, 1, [&](uint32_t begin, uint32_t end)
+	{
+		PROFILE_ZONE("Software tiles");
+		for (uint32_t tile = begin; tile < end; tile++)
+			RasterizeTile(tile, clear);
+	});
+	uint64_t finished = FramePacer::Now();
+
+	for (const Slice& slice : m_slices)
+	{
+		m_stats.triangles += slice.submitted;
+		m_stats.rasterized += (uint32_t)slice.triangles.size();
+		for (const std::vector<uint32_t>& bin : slice.bins)
+			m_stats.bins += (uint32_t)bin.size();
+	}
+	for (uint64_t pixels : m_tilePixels)
+		m_stats.pixels += pixels;
+
+	m_stats.vertexMs = FramePacer::ToMilliseconds(transformed - start);
+	m_stats.binMs = FramePacer::ToMilliseconds(binned - transformed);
+	m_stats.rasterMs = FramePacer::ToMilliseconds(finished - binned);
+	m_stats.totalMs = FramePacer::ToMilliseconds(finished - start);
+}
+
+bool SoftwareRasterizer::WritePpm(const std::string& path) const
+{
+	FILE* file = std::fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		LOG_ERROR("Software rasterizer: could not write " << path);
+		return false;
+	}
+
+	std::fprintf(file, "P6\n%d %d\n255\n", m_width, m_height);
+	std::vector<uint8_t> row((size_t)m_width * 3);
+	for (int32_t y = 0; y < m_height; y++)
+	{
+		const uint32_t* source = m_color.data() + (size_t)y * m_stride;
+		for (int32_t x = 0; x < m_width; x++)
+		{
+			row[x * 3 + 0] = (uint8_t)(source[x] & 0xFF);
+			row[x * 3 + 1] = (uint8_t)((source[x] >> 8) & 0xFF);
+			row[x * 3 + 2] = (uint8_t)((source[x] >> 16) & 0xFF);
+		}
+		std::fwrite(row.data(), 1, row.size(), file);
+	}
+	std::fclose(file);
+	return true;
+}
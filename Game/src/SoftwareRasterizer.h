@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "JobSystem.h"
+#include "Model.h"
+
+struct RenderItem;
+
+struct SoftwareRasterStats
+{
+	uint32_t triangles = 0;		// submitted
+	uint32_t rasterized = 0;	// left after clipping, culling and setup
+	uint64_t pixels = 0;		// passed the depth test and were shaded
+	uint32_t bins = 0;			// triangle references over all tiles
+	double vertexMs = 0.0;
+	double binMs = 0.0;
+	double rasterMs = 0.0;
+	double totalMs = 0.0;
+};
+
+// CPU rasterizer for the same meshes, textures and instance transforms the GL renderer
+// draws, for machines without a GL driver and as a deterministic reference. Shading is
+// the forward shader's ambient plus sun term per vertex times the diffuse texture.
+//
+// Vertices are transformed per instance in parallel. Triangles are then clipped against
+// the near plane, set up and binned into 64x64 pixel tiles; binning is split into slices
+// of the visible list so each slice has its own bins and the order stays deterministic.
+// Finally each tile is its own job: it walks the slices' bins in order and rasterizes with
+// 8 wide edge functions, interpolating 1/w, u/w, v/w and light/w for perspective correct
+// attributes. Textures are point sampled from one mip level picked per triangle.
+class SoftwareRasterizer
+{
+public:
+	static constexpr uint32_t TileSize = 64;
+	static constexpr uint32_t MaxMipLevels = 16;
+
+	SoftwareRasterizer();
+
+	void Resize(int32_t width, int32_t height);
+
+	// Decodes each mesh's first diffuse texture again from the model directory, since the
+	// model only keeps GL names. Meshes without one are drawn white.
+	void LoadTextures(const Model& model);
+	// Baked and generated scenes carry their decoded textures
+	void LoadTextures(const BakedScene& scene);
+	// RGBA8 texels, rows top down like stb_image; returns the texture index
+	uint32_t AddTexture(int32_t width, int32_t height, const uint32_t* texels);
+	void SetMeshTexture(uint32_t mesh, uint32_t texture);
+
+	// Draws the visible items into the color and depth buffers; the model supplies their meshes
+	void Render(const Model& model, const RenderItem* items, const std::vector<uint32_t>& visible, const glm::mat4& viewProjection,
+		const glm::vec3& sunDirection, const glm::vec4& clearColor, JobSystem& jobs);
+
+	int32_t Width() const { return m_width; }
+	int32_t Height() const { return m_height; }
+	// Pixels between rows of Color(); rows go top down
+	uint32_t Stride() const { return m_stride; }
+	// RGBA8, red in the low byte
+	const uint32_t* Color() const { return m_color.data(); }
+	bool WritePpm(const std::string& path) const;
+
+	const SoftwareRasterStats& Stats() const { return m_stats; }
+
+private:
+	struct MipTexture
+	{
+		int32_t width = 0;
+		int32_t height = 0;
+		uint32_t levels = 0;
+		uint32_t offsets[MaxMipLevels] = {};
+		std::vector<uint32_t> texels;	// every level, largest first
+	};
+
+	struct ClipVertex
+	{
+		glm::vec4 position;		// clip space
+		float u, v, light;
+		float x, y, z, invW;	// snapped pixels, depth and 1/w; only valid in front of the near plane
+	};
+
+	// Attribute planes are value = base + dx * (x - originX) + dy * (y - originY)
+	struct Plane
+	{
+		float base, dx, dy;
+	};
+
+	struct Triangle
+	{
+		float edgeA[3], edgeB[3], edgeX[3], edgeY[3], edgeBias[3];
+		float originX, originY;
+		Plane z, invW, uOverW, vOverW, lightOverW;
+		int32_t minX, minY, maxX, maxY;
+		uint32_t texture;
+		uint32_t level;
+	};
+
+	struct Slice
+	{
+		uint32_t firstVisible = 0;
+		uint32_t visibleCount = 0;
+		uint32_t submitted = 0;
+		std::vector<Triangle> triangles;
+		std::vector<std::vector<uint32_t>> bins;	// per tile, indices into triangles
+	};
+
+	void TransformVertices(const Model& model, const RenderItem* items, const std::vector<uint32_t>& visible, const glm::mat4& viewProjection,
+		const glm::vec3& sunDirection, JobSystem& jobs);
+	void BinSlice(const Model& model, const RenderItem* items, const std::vector<uint32_t>& visible, Slice& slice);
+	void Project(ClipVertex& vertex) const;
+	void SetupTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, uint32_t texture, Slice& slice);
+	void RasterizeTile(uint32_t tile, uint32_t clearColor);
+	uint64_t RasterizeTriangle(const Triangle& triangle, int32_t minX, int32_t minY, int32_t maxX, int32_t maxY);
+
+	int32_t m_width = 0;
+	int32_t m_height = 0;
+	uint32_t m_stride = 0;
+	uint32_t m_rows = 0;
+	uint32_t m_tilesX = 0;
+	uint32_t m_tilesY = 0;
+	std::vector<uint32_t> m_color;
+	std::vector<float> m_depth;
+
+	std::vector<MipTexture> m_textures;	// the first is a white texel
+	std::vector<uint32_t> m_meshTextures;
+
+	std::vector<uint32_t> m_firstVertex;	// per visible instance, into m_vertices
+	std::vector<ClipVertex> m_vertices;
+	std::vector<Slice> m_slices;
+	std::vector<uint64_t> m_tilePixels;
+
+	SoftwareRasterStats m_stats;
+};
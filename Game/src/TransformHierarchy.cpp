@@ -0,0 +1,165 @@
+#include "TransformHierarchy.h"
+
+#include <cstring>
+
+#include "FramePacer.h"
+#include "Log.h"
+#include "Profiler.h"
+
+void TransformHierarchy::Clear()
+{
+	m_parents.clear();
+	m_subtreeEnd.clear();
+	m_local.clear();
+	m_world.clear();
+	m_dirty.clear();
+	m_names.clear();
+}
+
+void TransformHierarchy::Reserve(uint32_t nodes)
+{
+	m_parents.reserve(nodes);
+	m_subtreeEnd.reserve(nodes);
+	m_local.reserve(nodes);
+	m_world.reserve(nodes);
+	m_dirty.reserve(nodes);
+}
+
+uint32_t TransformHierarchy::AddNode(uint32_t parent, const glm::mat4& local, const std::string& name)
+{
+	uint32_t node = Count();
+	if (parent != NoParent && (parent >= node || m_subtreeEnd[parent] != node))
+	{
+		LOG_WARN("TransformHierarchy: node " << name << " added out of depth first order");
+		parent = NoParent;
+	}
+
+	// The new node extends the subtree of every ancestor
+	for (uint32_t ancestor = parent; ancestor != NoParent; ancestor = m_parents[ancestor])
+		m_subtreeEnd[ancestor] = node + 1;
+
+	m_parents.push_back(parent);
+	m_subtreeEnd.push_back(node + 1);
+	m_local.push_back(local);
+	m_world.push_back(local);
+	m_dirty.push_back(1);
+	if (!name.empty() || !m_names.empty())
+	{
+		m_names.resize(node);
+		m_names.push_back(name);
+	}
+	return node;
+}
+
+void TransformHierarchy::SetLocal(uint32_t node, const glm::mat4& local)
+{
+	m_local[node] = local;
+	m_dirty[node] = 1;
+}
+
+const std::string& TransformHierarchy::Name(uint32_t node) const
+{
+	static const std::string unnamed;
+	return node < m_names.size() ? m_names[node] : unnamed;
+}
+
+uint32_t TransformHierarchy::Find(const std::string& name) const
+{
+	for (uint32_t i = 0; i < (uint32_t)m_names.size(); i++)
+	{
+		if (m_names[i] == name)
+			return i;
+	}
+	return NoParent;
+}
+
+// Dirty nodes that are not inside another dirty subtree become ranges. Ranges above
+// MinJobNodes are split: their root is updated here and each child becomes a range.
+void TransformHierarchy::CollectRanges()
+{
+	m_ranges.clear();
+	m_stats.subtrees = 0;
+	uint32_t count = Count();
+	for (uint32_t i = 0; i < count;)
+	{
+		if (!m_dirty[i])
+		{
+			// Clean nodes are the common case; skip them eight at a time
+			uint64_t flags = 0;
+			if (i + 8 <= count)
+				std::memcpy(&flags, &m_dirty[i], sizeof(flags));
+			i += flags == 0 && i + 8 <= count ? 8 : 1;
+			continue;
+		}
+
+		m_stats.subtrees++;
+		m_split.clear();
+		m_split.push_back(i);
+		while (!m_split.empty())
+		{
+			uint32_t root = m_split.back();
+			m_split.pop_back();
+			uint32_t end = m_subtreeEnd[root];
+			if (end - root <= MinJobNodes)
+			{
+				m_ranges.push_back({ root, end });
+				continue;
+			}
+
+			UpdateRange({ root, root + 1 });
+			m_stats.updated++;
+			for (uint32_t child = root + 1; child < end; child = m_subtreeEnd[child])
+				m_split.push_back(child);
+		}
+		i = m_subtreeEnd[i];
+	}
+}
+
+void TransformHierarchy::UpdateRange(const Range& range)
+{
+	// Parents come first, so each parent's world matrix is final by the time its children read it
+	for (uint32_t i = range.begin; i < range.end; i++)
+	{
+		uint32_t parent = m_parents[i];
+		m_world[i] = parent == NoParent ? m_local[i] : m_world[parent] * m_local[i];
+	}
+	std::memset(m_dirty.data() + range.begin, 0, range.end - range.begin);
+}
+
+void TransformHierarchy::Update(JobSystem& jobs)
+{
+	PROFILE_ZONE("Update transforms");
+	uint64_t start = FramePacer::Now();
+
+	m_stats.updated = 0;
+	CollectRanges();
+	for (const Range& range : m_ranges)
+		m_stats.updated += range.end - range.begin;
+
+	// Small ranges are grouped so a job holds roughly MinJobNodes nodes
+	uint32_t chunk = glm::max(1u, (uint32_t)(m_ranges.size() * MinJobNodes / glm::max(m_stats.updated, 1u)));
+	m_stats.jobs = ((uint32_t)m_ranges.size() + chunk - 1) / chunk;
+	jobs.ParallelFor((uint32_t)m_ranges.size(), chunk, [this](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t r = begin; r < end; r++)
+			UpdateRange(m_ranges[r]);
+	});
+
+	m_stats.ms = FramePacer::ToMilliseconds(FramePacer::Now() - start);
+}
+
+void TransformHierarchy::Update()
+{
+	uint64_t start = FramePacer::Now();
+
+	m_stats.updated = 0;
+	CollectRanges();
+	for (const Range& range : m_ranges)
+	{
+		UpdateRange(range);
+		m_stats.updated += range.end - range.begin;
+	}
+	m_stats.jobs = 0;
+
+	m_stats.ms = FramePacer::ToMilliseconds(FramePacer::Now() - start);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "JobSystem.h"
+
+struct TransformStats
+{
+	uint32_t subtrees = 0;	// dirty subtree roots found
+	uint32_t updated = 0;	// world matrices recomputed
+	uint32_t jobs = 0;		// work items handed to the job system
+	double ms = 0.0;
+};
+
+// Scene graph as flat arrays in depth first order, so every parent comes before its
+// children and a node's subtree is the contiguous range [node, SubtreeEnd(node)).
+// Parents, local and world matrices, dirty flags and names are separate streams.
+// Update only recomputes the subtrees under nodes whose local matrix changed; large
+// subtrees are split at their children so independent ranges can run in parallel.
+class TransformHierarchy
+{
+public:
+	static constexpr uint32_t NoParent = UINT32_MAX;
+	static constexpr uint32_t MinJobNodes = 4096;	// subtrees are split down to about this size
+
+	void Clear();
+	void Reserve(uint32_t nodes);
+
+	// Nodes are added depth first: the parent must be the last added node or one of its ancestors
+	uint32_t AddNode(uint32_t parent, const glm::mat4& local, const std::string& name = std::string());
+
+	void SetLocal(uint32_t node, const glm::mat4& local);
+	void MarkDirty(uint32_t node) { m_dirty[node] = 1; }
+
+	// Brings every world matrix up to date
+	void Update(JobSystem& jobs);
+	void Update();
+
+	uint32_t Count() const { return (uint32_t)m_parents.size(); }
+	uint32_t Parent(uint32_t node) const { return m_parents[node]; }
+	uint32_t SubtreeEnd(uint32_t node) const { return m_subtreeEnd[node]; }
+	const glm::mat4& Local(uint32_t node) const { return m_local[node]; }
+	const glm::mat4& World(uint32_t node) const { return m_world[node]; }
+	const std::string& Name(uint32_t node) const;
+	// First node with the name, or NoParent
+	uint32_t Find(const std::string& name) const;
+	const TransformStats& Stats() const { return m_stats; }
+
+private:
+	// Subtree whose root's parent is already final
+	struct Range
+	{
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	void CollectRanges();
+	void UpdateRange(const Range& range);
+
+	std::vector<uint32_t> m_parents;
+	std::vector<uint32_t> m_subtreeEnd;
+	std::vector<glm::mat4> m_local;
+	std::vector<glm::mat4> m_world;
+	std::vector<uint8_t> m_dirty;
+	std::vector<std::string> m_names;	// empty until a node has a name
+
+	std::vector<Range> m_ranges;
+	std::vector<uint32_t> m_split;
+	TransformStats m_stats;
+};
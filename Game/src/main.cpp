@@ -1,25 +1,48 @@
+#include <cctype>
 #include <fstream>
+#include <random>
 #include <sstream>
-#include <iostream>
 #include <string>
 #include <vector>
 
 #define SDL_MAIN_HANDLED
 #include <SDL.h>
 
-#define GLEW_STATIC
 #include <GL/glew.h>
 
-#include <glm\glm.hpp>
+#include <glm/glm.hpp>
 
 #include <cstdio>
-#include <rapidjson\rapidjson.h>
-#include <rapidjson\document.h>
-#include <rapidjson\filereadstream.h>
-
-#include <assimp\Importer.hpp>
-#include <assimp\scene.h>
-#include <assimp\postprocess.h>
+#include <json.hpp>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "BakedScene.h"
+#include "Bvh.h"
+#include "Camera.h"
+#include "FrameArena.h"
+#include "FramePacer.h"
+#include "FrustumCulling.h"
+#include "HeadlessContext.h"
+#include "JobSystem.h"
+#include "LightCulling.h"
+#include "LightmapBaker.h"
+#include "Log.h"
+#include "MemoryTracker.h"
+#include "Model.h"
+#include "OcclusionCulling.h"
+#include "Overlay.h"
+#include "Profiler.h"
+#include "RenderSnapshot.h"
+#include "Renderer.h"
+#include "RenderThread.h"
+#include "SceneBenchmark.h"
+#include "SceneGenerator.h"
+#include "SceneEntities.h"
+#include "Shadows.h"
+#include "SoftwareRasterizer.h"
 
 struct Config
 {
@@ -27,350 +50,918 @@ struct Config
 	static inline int32_t screen_height = 600;
 	static inline bool fullscreen = false;
 	static inline bool vsync = false;
+	static inline bool adaptive_vsync = true;
+	static inline int32_t frame_cap = 0;
+	static inline double update_rate = 60.0;
+	static inline bool idle_mode = false;
+	static inline int32_t idle_timeout = 100;
+	static inline double stats_interval = 0.0;
+	static inline bool render_thread = true;
+	static inline double sim_load_ms = 0.0;
+	static inline double render_load_ms = 0.0;
+	static inline int32_t worker_threads = -1;	// -1 picks one per core
+	static inline int32_t frames_in_flight = 3;
+	static inline bool gpu_profiler = true;
+	static inline std::string trace_file = "trace.json";	// written on F9
+	static inline bool overlay = true;	// toggled with F1
+	static inline int32_t stress_lights = 0;	// random extra lights inside the scene bounds
+	static inline RenderPath render_path = RenderPath::Forward;
+	static inline bool shadows = true;
+	static inline int32_t shadow_cascades = 4;
+	static inline int32_t shadow_resolution = 2048;
+	static inline double shadow_distance = 0.3;	// fraction of the camera far plane
+	static inline bool frustum_culling = true;
+	static inline bool occlusion_culling = true;
+	static inline int32_t occluder_triangles = 16384;	// budget for the software rasterizer
+	static inline bool scene_bvh = true;	// ray and overlap queries over the scene triangles
+	static inline bool headless = false;	// no window: offscreen context, fixed frame count
+	static inline int32_t headless_frames = 600;
+	static inline std::string capture_directory = "";	// headless frames are written here when set
+	static inline int32_t capture_interval = 60;	// every Nth frame
+	static inline bool software_renderer = false;	// CPU rasterizer instead of GL, needs no GL driver
+	static inline int32_t benchmark_frames = 1000;	// measured frames of --bench-scene, after warmup
+	static inline std::string camera_path = "";	// flown by --bench-scene; empty orbits the scene
 	static inline std::string win_title = "Whatever";
-	static inline std::string scene = "";
+	static inline std::string scene = "";	// assimp formats, or a baked .scene file
+	static inline std::string generate_scene = "";	// generator settings; when set, used instead of scene
 } Config;
 
 struct State
 {
 	static inline SDL_Window* m_window;
 	static inline SDL_GLContext m_glContext;
-	static inline int32_t m_time = 0;
-	static inline int32_t m_deltaTime = 0;
+	static inline FramePacer m_pacer;
+	static inline uint64_t m_time = 0;
+	static inline double m_deltaTime = 0.0;	// seconds, fixed step while inside Update()
+	static inline double m_alpha = 0.0;		// render interpolation between the last two updates
+	static inline bool m_dirty = true;		// something changed that needs a new frame
+	static inline bool m_idle = false;
+	static inline Model m_model;
+	static inline BakedScene m_baked;	// kept until the software rasterizer took its textures
+	static inline Camera m_camera;
+	static inline Camera m_prevCamera;
+	static inline Renderer m_renderer;
+	static inline RenderThread m_renderThread;
+	static inline JobSystem m_jobs;
+	static inline LightCuller m_lightCuller;
+	static inline ShadowCascades m_shadows;
+	static inline FrustumCuller m_frustum;
+	static inline OcclusionCuller m_occlusion;
+	static inline Bvh m_sceneBvh;
+	static inline Registry m_entities;
+	static inline HeadlessContext m_headless;
+	static inline SoftwareRasterizer m_software;
+	static inline glm::vec3 m_sunDirection = glm::normalize(glm::vec3(-0.4f, -1.0f, -0.3f));
+	static inline SampleWindow m_fenceWaits;	// render thread time blocked on GPU fences, ms
+	static inline SampleWindow m_frameAllocations;	// heap allocations per frame, all threads
+	static inline uint64_t m_traceAllocationsAfter = 0;	// frames before --check-allocations starts tracing
+	static inline uint64_t m_allocatingFrames = 0;	// frames that allocated while tracing
+	static inline std::vector<GpuScopeAverage> m_gpuScopes;
+	static inline bool m_gpuTimesCpuMeasured = false;
+	static inline CommandStats m_commandStats;
+	static inline double m_overlayRenderMs = 0.0;
+	static inline size_t m_frameResourceBytes = 0;
+	static inline Overlay m_overlay;
+	static inline SceneBenchmark m_benchmark;
+	static inline CameraPath m_cameraPath;	// played back while benchmarking, or being recorded
+	static inline bool m_recordingPath = false;
+	static inline uint64_t m_recordStart = 0;
 } State;
 
 
-struct Vertex
+void GLAPIENTRY MessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam)
 {
-	glm::vec3 Position;
-	glm::vec3 Normal;
-	glm::vec3 TexCoords;
-};
+	// Runs inside the GL call with GL_DEBUG_OUTPUT_SYNCHRONOUS, so it only queues the line
+	if (severity == GL_DEBUG_SEVERITY_HIGH)
+		LOG_ERROR("[OpenGL Error](" << type << ") " << message);
+	else if (severity == GL_DEBUG_SEVERITY_NOTIFICATION)
+		LOG_DEBUG("[OpenGL](" << type << ") " << message);
+	else
+		LOG_WARN("[OpenGL Warning](" << type << ") " << message);
+}
 
-struct Texture 
+void ParseConfig()
 {
-	uint32_t id;
-	std::string type;
-};
+	std::ifstream stream("config.json");
+	nlohmann::json _configDoc = stream ? nlohmann::json::parse(stream, nullptr, false) : nlohmann::json::object();
+	if (_configDoc.is_discarded())
+	{
+		LOG_ERROR("config.json is not valid JSON, using the defaults");
+		return;
+	}
 
-class Shader
-{
-public:
-	uint32_t ID;
+	if (_configDoc.contains("screen_width") && _configDoc["screen_width"].is_number_integer())
+		Config::screen_width = _configDoc["screen_width"].get<int32_t>();
+	
+	if (_configDoc.contains("screen_height") && _configDoc["screen_height"].is_number_integer())
+		Config::screen_height = _configDoc["screen_height"].get<int32_t>();
+	
+	if (_configDoc.contains("fullscreen") && _configDoc["fullscreen"].is_boolean())
+		Config::fullscreen = _configDoc["fullscreen"].get<bool>();
+	
+	if (_configDoc.contains("vsync") && _configDoc["vsync"].is_boolean())
+		Config::vsync = _configDoc["vsync"].get<bool>();
+	
+	if (_configDoc.contains("adaptive_vsync") && _configDoc["adaptive_vsync"].is_boolean())
+		Config::adaptive_vsync = _configDoc["adaptive_vsync"].get<bool>();
 
-	Shader(std::string vertexPath, std::string fragmentPath)
-	{
-		// 1. Read Shader Code from File
-		std::string vertexCode,
-					fragmentCode;
-		std::ifstream vertexShaderFile, 
-					  fragmentShaderFile;
+	if (_configDoc.contains("frame_cap") && _configDoc["frame_cap"].is_number_integer())
+		Config::frame_cap = _configDoc["frame_cap"].get<int32_t>();
 
-		vertexShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-		fragmentShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+	if (_configDoc.contains("update_rate") && _configDoc["update_rate"].is_number())
+		Config::update_rate = _configDoc["update_rate"].get<double>();
 
-		try
-		{
-			// open 
-			vertexShaderFile.open(vertexPath);
-			fragmentShaderFile.open(fragmentPath);
-			std::stringstream vertexShaderStream, 
-							  fragmentShaderStream;
+	if (_configDoc.contains("idle_mode") && _configDoc["idle_mode"].is_boolean())
+		Config::idle_mode = _configDoc["idle_mode"].get<bool>();
 
-			vertexShaderStream << vertexShaderFile.rdbuf();
-			fragmentShaderStream << fragmentShaderFile.rdbuf();
+	if (_configDoc.contains("idle_timeout") && _configDoc["idle_timeout"].is_number_integer())
+		Config::idle_timeout = _configDoc["idle_timeout"].get<int32_t>();
 
-			vertexShaderFile.close();
-			fragmentShaderFile.close();
+	if (_configDoc.contains("stats_interval") && _configDoc["stats_interval"].is_number())
+		Config::stats_interval = _configDoc["stats_interval"].get<double>();
 
-			vertexCode = vertexShaderStream.str();
-			fragmentCode = fragmentShaderStream.str();
+	if (_configDoc.contains("render_thread") && _configDoc["render_thread"].is_boolean())
+		Config::render_thread = _configDoc["render_thread"].get<bool>();
 
-		}
-		catch (std::ifstream::failure e)
-		{
-			std::cout << "Error Reading Shader: " << e.what() << std::endl;
-		}
+	if (_configDoc.contains("sim_load_ms") && _configDoc["sim_load_ms"].is_number())
+		Config::sim_load_ms = _configDoc["sim_load_ms"].get<double>();
 
-		const char* vShaderCode = vertexCode.c_str();
-		const char* fShaderCode = fragmentCode.c_str();
+	if (_configDoc.contains("render_load_ms") && _configDoc["render_load_ms"].is_number())
+		Config::render_load_ms = _configDoc["render_load_ms"].get<double>();
 
-		// 2. Compile Shader Code
-		uint32_t vertex, 
-				 fragment;
-		int32_t success;
-		char infoLog[512];
+	if (_configDoc.contains("worker_threads") && _configDoc["worker_threads"].is_number_integer())
+		Config::worker_threads = _configDoc["worker_threads"].get<int32_t>();
 
-		vertex = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(vertex, 1, &vShaderCode, NULL);
-		glCompileShader(vertex);
-		glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-		if (!success)
-		{
-			glGetShaderInfoLog(vertex, 512, NULL, infoLog);
-			std::cout << "Error Compiling Vertex Shader: " << std::endl << infoLog << std::endl;
-		}
+	if (_configDoc.contains("frames_in_flight") && _configDoc["frames_in_flight"].is_number_integer())
+		Config::frames_in_flight = _configDoc["frames_in_flight"].get<int32_t>();
 
-		fragment = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(fragment, 1, &fShaderCode, NULL);
-		glCompileShader(fragment);
-		glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-		if (!success)
-		{
-			glGetShaderInfoLog(fragment, 512, NULL, infoLog);
-			std::cout << "Error Compiling Fragment Shader: " << std::endl << infoLog << std::endl;
-		}
+	if (_configDoc.contains("gpu_profiler") && _configDoc["gpu_profiler"].is_boolean())
+		Config::gpu_profiler = _configDoc["gpu_profiler"].get<bool>();
+	
+	if (_configDoc.contains("trace_file") && _configDoc["trace_file"].is_string())
+		Config::trace_file = _configDoc["trace_file"].get<std::string>();
 
-		// create shader program
-		ID = glCreateProgram();
-		glAttachShader(ID, vertex);
-		glAttachShader(ID, fragment);
-		glLinkProgram(ID);
-		glGetProgramiv(ID, GL_LINK_STATUS, &success);
-		if (!success)
-		{
-			glGetProgramInfoLog(ID, 512, NULL, infoLog);
-			std::cout << "Error Compiling Shader Program: " << std::endl << infoLog << std::endl;
-		}
+	if (_configDoc.contains("overlay") && _configDoc["overlay"].is_boolean())
+		Config::overlay = _configDoc["overlay"].get<bool>();
 
-		glDeleteShader(vertex);
-		glDeleteShader(fragment);
+	if (_configDoc.contains("stress_lights") && _configDoc["stress_lights"].is_number_integer())
+		Config::stress_lights = _configDoc["stress_lights"].get<int32_t>();
 
-	}
+	if (_configDoc.contains("render_path") && _configDoc["render_path"].is_string())
+		Config::render_path = _configDoc["render_path"].get<std::string>() == "deferred" ? RenderPath::Deferred : RenderPath::Forward;
 
-	void Use()
-	{
-		glUseProgram(ID);
-	}
+	if (_configDoc.contains("shadows") && _configDoc["shadows"].is_boolean())
+		Config::shadows = _configDoc["shadows"].get<bool>();
 
-	void SetUniformBool(const std::string& name, bool value)
-	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
-	}
+	if (_configDoc.contains("shadow_cascades") && _configDoc["shadow_cascades"].is_number_integer())
+		Config::shadow_cascades = _configDoc["shadow_cascades"].get<int32_t>();
 
-	void SetUniformInt(const std::string& name, int32_t value)
-	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
-	}
+	if (_configDoc.contains("shadow_resolution") && _configDoc["shadow_resolution"].is_number_integer())
+		Config::shadow_resolution = _configDoc["shadow_resolution"].get<int32_t>();
+
+	if (_configDoc.contains("shadow_distance") && _configDoc["shadow_distance"].is_number())
+		Config::shadow_distance = _configDoc["shadow_distance"].get<double>();
+
+	if (_configDoc.contains("frustum_culling") && _configDoc["frustum_culling"].is_boolean())
+		Config::frustum_culling = _configDoc["frustum_culling"].get<bool>();
+
+	if (_configDoc.contains("occlusion_culling") && _configDoc["occlusion_culling"].is_boolean())
+		Config::occlusion_culling = _configDoc["occlusion_culling"].get<bool>();
+
+	if (_configDoc.contains("occluder_triangles") && _configDoc["occluder_triangles"].is_number_integer())
+		Config::occluder_triangles = _configDoc["occluder_triangles"].get<int32_t>();
+
+	if (_configDoc.contains("scene_bvh") && _configDoc["scene_bvh"].is_boolean())
+		Config::scene_bvh = _configDoc["scene_bvh"].get<bool>();
 
-	void SetUniformFloat(const std::string& name, float_t value)
+	if (_configDoc.contains("headless") && _configDoc["headless"].is_boolean())
+		Config::headless = _configDoc["headless"].get<bool>();
+
+	if (_configDoc.contains("headless_frames") && _configDoc["headless_frames"].is_number_integer())
+		Config::headless_frames = _configDoc["headless_frames"].get<int32_t>();
+
+	if (_configDoc.contains("capture_directory") && _configDoc["capture_directory"].is_string())
+		Config::capture_directory = _configDoc["capture_directory"].get<std::string>();
+
+	if (_configDoc.contains("capture_interval") && _configDoc["capture_interval"].is_number_integer())
+		Config::capture_interval = _configDoc["capture_interval"].get<int32_t>();
+
+	if (_configDoc.contains("software_renderer") && _configDoc["software_renderer"].is_boolean())
+		Config::software_renderer = _configDoc["software_renderer"].get<bool>();
+
+	if (_configDoc.contains("benchmark_frames") && _configDoc["benchmark_frames"].is_number_integer())
+		Config::benchmark_frames = _configDoc["benchmark_frames"].get<int32_t>();
+
+	if (_configDoc.contains("camera_path") && _configDoc["camera_path"].is_string())
+		Config::camera_path = _configDoc["camera_path"].get<std::string>();
+
+	if (_configDoc.contains("win_title") && _configDoc["win_title"].is_string())
+		Config::win_title = _configDoc["win_title"].get<std::string>();
+
+	if (_configDoc.contains("scene") && _configDoc["scene"].is_string())
+		Config::scene = _configDoc["scene"].get<std::string>();
+
+	if (_configDoc.contains("generate_scene") && _configDoc["generate_scene"].is_string())
+		Config::generate_scene = _configDoc["generate_scene"].get<std::string>();
+	
+}
+
+bool ImportScene(const std::string& file, const std::string& directory)
+{
+	MemoryScope scope(MemoryTag::Import);
+
+	// Assimp Setup
+	Assimp::Importer importer;
+
+	const aiScene* scene = nullptr;
 	{
-		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+		PROFILE_ZONE("Import");
+		scene = importer.ReadFile(file, aiProcess_CalcTangentSpace | aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_SortByPType);
+	}
+	// If the import failed, report it
+	if (nullptr == scene) {
+		LOG_ERROR("Failed to import: " << file << ": " << importer.GetErrorString());
+		return false;
 	}
-};
 
-class Mesh {
-public:
-	std::vector<Vertex> vertices;
-	std::vector<uint32_t> indices;
-	std::vector<Texture> textures;
+	LOG_INFO("Loaded:");
+	LOG_INFO("  Meshes: " << scene->mNumMeshes);
+	LOG_INFO("  Materials: " << scene->mNumMaterials);
+	LOG_INFO("  Textures: " << scene->mNumTextures);
+	LOG_INFO("  Lights: " << scene->mNumLights);
+	LOG_INFO("  Cameras: " << scene->mNumCameras);
+	LOG_INFO("  Animations: " << scene->mNumAnimations);
+
+	// Assimp's own count, which also covers builds where it lives in a DLL our operator new does not see
+	aiMemoryInfo memory;
+	importer.GetMemoryRequirements(memory);
+	LOG_INFO("  Import memory: " << memory.total / (1024.0 * 1024.0) << " MB");
+
+	LOG_INFO("Constructing Scene ");
+	State::m_model.Build(scene, directory, !Config::software_renderer);
+	return true;
+}
+
+void PrintBakedScene(const BakedScene& scene)
+{
+	LOG_INFO("  Meshes: " << scene.meshes.size());
+	LOG_INFO("  Materials: " << scene.materials.size());
+	LOG_INFO("  Textures: " << scene.textures.size());
+	LOG_INFO("  Instances: " << scene.instances.size() << ", " << scene.TriangleCount() << " triangles");
+	LOG_INFO("  Size: " << scene.Bytes() / (1024.0 * 1024.0) << " MB");
+}
+
+// Bakes lightmaps into the scene with every thread the config allows. With scaling, the
+// bake runs at 1, 2, 4 ... threads first, on copies of the scene, and the last run is kept.
+bool BakeLightmaps(BakedScene& scene, const std::string& spec, bool scaling)
+{
+	LightmapSettings settings;
+	settings.sunDirection = State::m_sunDirection;
+	if (!settings.Parse(spec))
+		return false;
+	LOG_INFO("Baking lightmaps: " << settings.Describe());
 
-	Mesh(std::vector<Vertex> vertices, std::vector<uint32_t> indices, std::vector<Texture> textures)
+	uint32_t threads = (Config::worker_threads >= 0 ? (uint32_t)Config::worker_threads : JobSystem::DefaultWorkerCount()) + 1;
+	JobSystem jobs;
+	LightmapBaker baker;
+	double singleMs = 0.0;
+	for (uint32_t count = scaling ? 1 : threads; ; count = glm::min(count * 2, threads))
 	{
-		this->vertices = vertices;
-		this->indices = indices;
-		this->textures = textures;
+		bool last = count == threads;
+		BakedScene copy;
+		if (!last)
+			copy = scene;
+
+		jobs.Init(count - 1);
+		if (!baker.Bake(last ? scene : copy, settings, jobs))
+			return false;
 
-		SetupMesh();
-	};
+		const LightmapStats& stats = baker.Stats();
+		if (count == 1)
+			singleMs = stats.totalMs;
+		if (scaling)
+			LOG_INFO("  " << count << " threads: " << stats.totalMs << "ms, trace " << stats.traceMs << "ms, "
+				<< singleMs / stats.totalMs << "x speedup, " << 100.0 * singleMs / stats.totalMs / count << "% efficiency");
+		if (last)
+			break;
+	}
+	jobs.Shutdown();
+
+	const LightmapStats& stats = baker.Stats();
+	LOG_INFO("  Charts: " << stats.charts << ", pages: " << stats.pages << ", texels: " << stats.texels);
+	LOG_INFO("  Rays: " << stats.rays << ", " << stats.rays / std::max(stats.traceMs, 1e-3) / 1000.0 << " Mrays/s on " << threads << " threads");
+	LOG_INFO("  Unwrap " << stats.unwrapMs << "ms, pack " << stats.packMs << "ms, BVH " << stats.bvhMs << "ms, trace "
+		<< stats.traceMs << "ms, filter " << stats.filterMs << "ms, total " << stats.totalMs << "ms");
+	return true;
+}
+
+// Builds the model from the generator, a baked file or an assimp import, then frames it
+void LoadScene(const std::string file)
+{
+	PROFILE_ZONE("LoadScene");
+	MemoryScope scope(MemoryTag::Scene);
 
-	void Draw(Shader &shader)
+	std::string directory = ".";
+	size_t slash = file.find_last_of("/\\");
+	if (slash != std::string::npos)
+		directory = file.substr(0, slash);
+
+	if (!Config::generate_scene.empty())
 	{
-		int32_t diffuseNr = 1, 
-				specularNr = 1;
-		for (int32_t i = 0; i < textures.size(); i++)
+		SceneGeneratorSettings settings;
+		if (!settings.Parse(Config::generate_scene))
+			return;
+		LOG_INFO("Generating scene: " << settings.Describe());
 		{
-			glActiveTexture(GL_TEXTURE0 + 1);
-			std::string number;
-			std::string name = textures[i].type;
-			if (name == "texture_diffuse")
-			{
-				number = std::to_string(diffuseNr++);
-			}
-			else if (name == "texture_specular")
-			{
-				number = std::to_string(specularNr++);
-			}
-
-			shader.SetUniformFloat(("material." + name + number).c_str(), i);
-			glBindTexture(GL_TEXTURE_2D, textures[i].id);
+			MemoryScope importScope(MemoryTag::Import);
+			GenerateScene(settings, State::m_baked);
 		}
+		PrintBakedScene(State::m_baked);
+		State::m_model.Build(State::m_baked, ".", !Config::software_renderer);
+	}
+	else if (BakedScene::IsBakedFile(file))
+	{
+		LOG_INFO("Loading baked scene: " << file);
+		MemoryScope importScope(MemoryTag::Import);
+		if (!State::m_baked.Read(file))
+			return;
+		PrintBakedScene(State::m_baked);
+		State::m_model.Build(State::m_baked, directory, !Config::software_renderer);
+	}
+	else
+	{
+		LOG_INFO("Loading scene data: " << file);
+		if (!ImportScene(file, directory))
+			return;
+	}
 
-		glActiveTexture(GL_TEXTURE0);
+	LOG_INFO("  Nodes: " << State::m_model.nodes.Count());
+	LOG_INFO("  Point/spot lights: " << State::m_model.lights.size());
 
-		// draw mesh 
-		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
-	};
-private:
-	uint32_t VAO, VBO, EBO;
-	void SetupMesh()
+	if (Config::scene_bvh)
 	{
-		glGenVertexArrays(1, &VAO);
-		glGenBuffers(1, &VBO);
-		glGenBuffers(1, &EBO);
-
+		State::m_sceneBvh.Build(State::m_model);
+		const BvhStats& bvh = State::m_sceneBvh.Stats();
+		LOG_INFO("  BVH: " << bvh.triangles << " triangles, " << bvh.nodes << " nodes, "
+			<< bvh.bytes / (1024.0 * 1024.0) << " MB, built in " << bvh.buildMs << "ms");
+	}
 
-		glBindVertexArray(VAO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+	// Frame the whole scene
+	glm::vec3 center = (State::m_model.boundsMin + State::m_model.boundsMax) * 0.5f;
+	float radius = glm::max(glm::length(State::m_model.boundsMax - State::m_model.boundsMin) * 0.5f, 1.0f);
+	State::m_camera.position = center + glm::vec3(0.0f, radius * 0.5f, radius * 2.0f);
+	State::m_camera.pitch = -14.0f;
+	State::m_camera.nearPlane = radius * 0.001f;
+	State::m_camera.farPlane = radius * 10.0f;
+	State::m_prevCamera = State::m_camera;
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(int32_t), &indices[0], GL_STATIC_DRAW);
+	// Light
+}
 
-		// vert pos
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-		// vert norm
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-		// vert tex coords
-		glEnableVertexAttribArray(2);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+// Scatters coloured point and spot lights through the scene bounds, for light culling tests
+void AddStressLights(uint32_t count)
+{
+	std::mt19937 rng(1337);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
 
-		glBindVertexArray(0);
-	};
-};
+	glm::vec3 size = State::m_model.boundsMax - State::m_model.boundsMin;
+	float radius = glm::max(glm::length(size) * 0.5f, 1.0f);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		Light light;
+		light.type = unit(rng) < 0.25f ? LightType::Spot : LightType::Point;
+		light.position = State::m_model.boundsMin + size * glm::vec3(unit(rng), unit(rng), unit(rng));
+		light.range = radius * (0.02f + unit(rng) * 0.08f);
+		light.color = glm::vec3(unit(rng), unit(rng), unit(rng));
+		light.intensity = light.range * light.range;
+		light.direction = glm::normalize(glm::vec3(unit(rng) - 0.5f, -1.0f, unit(rng) - 0.5f));
+		light.outerCos = std::cos(glm::radians(20.0f + unit(rng) * 25.0f));
+		light.innerCos = light.outerCos + (1.0f - light.outerCos) * 0.5f;
+		State::m_model.lights.push_back(light);
+	}
+}
 
-class Model
+void Update(double deltaTime)
 {
-public:
-	
-};
+	PROFILE_ZONE("Update");
+	State::m_deltaTime = deltaTime;
+	State::m_prevCamera = State::m_camera;
+
+	const uint8_t* keys = SDL_GetKeyboardState(nullptr);
+	glm::vec3 move(0.0f);
+	if (keys[SDL_SCANCODE_W]) move += State::m_camera.Forward();
+	if (keys[SDL_SCANCODE_S]) move -= State::m_camera.Forward();
+	if (keys[SDL_SCANCODE_D]) move += State::m_camera.Right();
+	if (keys[SDL_SCANCODE_A]) move -= State::m_camera.Right();
+	if (keys[SDL_SCANCODE_E]) move.y += 1.0f;
+	if (keys[SDL_SCANCODE_Q]) move.y -= 1.0f;
+
+	// Anything that moves must set State::m_dirty, otherwise idle mode stops presenting
+	if (glm::length(move) > 0.0f)
+	{
+		float speed = State::m_camera.farPlane * 0.05f;
+		State::m_camera.position += glm::normalize(move) * speed * (float)deltaTime;
+		State::m_dirty = true;
+	}
+}
 
+// Visible items per recorded command list
+static constexpr uint32_t DrawChunkSize = 256;
 
-void GLAPIENTRY MessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam)
+void RecordCommands(RenderSnapshot& snapshot)
 {
-	std::cout << "[OpenGL Error](" << type << ") " << message << std::endl;
+	PROFILE_ZONE("RecordCommands");
+	const std::vector<DrawBinding>& bindings = State::m_renderer.Bindings();
+	const SceneUniforms& uniforms = State::m_renderer.Uniforms();
+
+	uint32_t visible = (uint32_t)snapshot.visible.size();
+	uint32_t chunks = (visible + DrawChunkSize - 1) / DrawChunkSize;
+	snapshot.commandLists.resize(1 + chunks);
+
+	RecordFrameSetup(snapshot.commandLists[0], uniforms);
+	State::m_jobs.ParallelFor(visible, DrawChunkSize, [&](uint32_t begin, uint32_t end)
+	{
+		CommandList& list = snapshot.commandLists[1 + begin / DrawChunkSize];
+		list.Reset();
+		RecordMeshDraws(list, bindings, uniforms, snapshot.items.data(), snapshot.visible.data() + begin, end - begin);
+	});
+
+	// Only cascades that are redrawn this frame get commands
+	snapshot.shadowLists.resize(snapshot.shadows.cascadeCount);
+	State::m_jobs.ParallelFor(snapshot.shadows.cascadeCount, 1, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const ShadowCascade& cascade = snapshot.shadows.cascades[i];
+			CommandList& list = snapshot.shadowLists[i];
+			list.Reset();
+			if (!cascade.render)
+				continue;
+
+			list.UseProgram(State::m_renderer.ShadowUniforms().program);
+			list.SetUniformMat4(State::m_renderer.ShadowMatrixLocation(), cascade.viewProjection);
+			RecordMeshDraws(list, State::m_renderer.ShadowBindings(), State::m_renderer.ShadowUniforms(),
+				snapshot.items.data(), cascade.casters.data(), cascade.casters.size());
+		}
+	});
 }
 
-void ParseConfig()
+void BuildSnapshot(RenderSnapshot& snapshot)
 {
-	FILE* fp = fopen("config.json", "rb");
-	char readBuffer[65536];
-	rapidjson::FileReadStream is(fp, readBuffer, sizeof(readBuffer));
+	PROFILE_ZONE("BuildSnapshot");
+	snapshot.frame = State::m_pacer.Frames();
+	snapshot.inputTime = State::m_pacer.InputTime();
+	snapshot.presentTime = 0;
+	snapshot.width = Config::screen_width;
+	snapshot.height = Config::screen_height;
+	snapshot.renderLoadMs = Config::render_load_ms;
+
+	Camera camera = Camera::Lerp(State::m_prevCamera, State::m_camera, (float)State::m_alpha);
+	snapshot.view = camera.View();
+	snapshot.projection = camera.Projection((float)Config::screen_width / (float)Config::screen_height);
+	snapshot.cameraPosition = camera.position;
+
+	// Lights come from the scene's entities. The deferred path culls per tile on the GPU
+	// and only needs the light list.
+	const std::vector<Light>& lights = State::m_entities.Pool<Light>().Components();
+	if (State::m_renderer.Path() == RenderPath::Deferred)
+	{
+		LightCuller::Pack(lights, snapshot.lights);
+	}
+	else
+	{
+		State::m_lightCuller.SetProjection(snapshot.projection, camera.nearPlane, camera.farPlane);
+		State::m_lightCuller.Cull(lights, snapshot.view, State::m_jobs, snapshot.lights);
+	}
 
-	rapidjson::Document _configDoc;
-	_configDoc.ParseStream(is);
+	// Casters index instances, which items below follow one to one
+	float aspect = (float)Config::screen_width / (float)Config::screen_height;
+	State::m_shadows.Update(camera, aspect, State::m_sunDirection, State::m_model, snapshot.frame, State::m_jobs, snapshot.shadows);
 
-	fclose(fp);
+	// Draws come from the instance entities; MeshRef::instance places each where the
+	// culling and caster indices expect it
+	snapshot.items.resize(State::m_entities.Pool<MeshRef>().Size());
+	snapshot.visible.clear();
+	State::m_entities.Each<MeshRef, WorldTransform>([&](Entity, MeshRef& ref, WorldTransform& transform)
+	{
+		snapshot.items[ref.instance] = { ref.mesh, transform.matrix };
+	});
 
-	if (_configDoc.HasMember("screen_width") && _configDoc["screen_width"].IsInt())
-		Config::screen_width = _configDoc["screen_width"].GetInt();
-	
-	if (_configDoc.HasMember("screen_height") && _configDoc["screen_height"].IsInt())
-		Config::screen_height = _configDoc["screen_height"].GetInt();
-	
-	if (_configDoc.HasMember("fullscreen") && _configDoc["fullscreen"].IsBool())
-		Config::fullscreen = _configDoc["fullscreen"].GetBool();
-	
-	if (_configDoc.HasMember("vsync") && _configDoc["vsync"].IsBool())
-		Config::vsync = _configDoc["vsync"].GetBool();
-	
-	if (_configDoc.HasMember("win_title") && _configDoc["win_title"].IsString())
-		Config::win_title = _configDoc["win_title"].GetString();
+	glm::mat4 viewProjection = snapshot.projection * snapshot.view;
+	if (Config::frustum_culling)
+	{
+		State::m_frustum.SetFrustum(viewProjection);
+		State::m_frustum.Cull(State::m_model.instanceBounds, State::m_jobs, snapshot.visible);
+	}
+	else
+	{
+		for (uint32_t i = 0; i < (uint32_t)snapshot.items.size(); i++)
+			snapshot.visible.push_back(i);
+	}
 
-	if (_configDoc.HasMember("scene") && _configDoc["scene"].IsString())
-		Config::scene = _configDoc["scene"].GetString();
-	
+	if (Config::occlusion_culling)
+	{
+		State::m_occlusion.Rasterize(viewProjection, camera.nearPlane, State::m_jobs);
+		State::m_occlusion.CullInstances(State::m_model, State::m_jobs, snapshot.visible);
+	}
+
+	if (!Config::software_renderer)
+		RecordCommands(snapshot);
+
+	OverlayStats stats;
+	stats.frameTimes = &State::m_pacer.FrameTimes();
+	stats.frame = State::m_pacer.Stats();
+	stats.commands = State::m_commandStats;
+	stats.lights = (uint32_t)snapshot.lights.lights.size();
+	stats.lightIndices = (uint32_t)snapshot.lights.indices.size();
+	stats.renderPath = DeferredPath::Name(State::m_renderer.Path());
+	stats.gbufferBytesPerPixel = State::m_renderer.GBufferBytesPerPixel();
+	stats.shadows = &snapshot.shadows;
+	stats.frustum = Config::frustum_culling ? &State::m_frustum.Stats() : nullptr;
+	stats.occlusion = Config::occlusion_culling ? &State::m_occlusion.Stats() : nullptr;
+	stats.gpuScopes = &State::m_gpuScopes;
+	stats.gpuTimesCpuMeasured = State::m_gpuTimesCpuMeasured;
+	stats.fenceWaitMs = State::m_fenceWaits.Count() > 0 ? State::m_fenceWaits.Last() : 0.0;
+	stats.overlayRenderMs = State::m_overlayRenderMs;
+	stats.pendingJobs = State::m_jobs.PendingJobs();
+	stats.workerThreads = State::m_jobs.WorkerCount();
+	stats.queuedSnapshots = State::m_renderThread.Running() ? State::m_renderThread.QueuedSnapshots() : 0;
+	stats.frameResourceBytes = State::m_frameResourceBytes;
+	State::m_overlay.Build(stats, snapshot.overlay);
 }
 
-void LoadScene(const std::string file)
+void HandleEvent(const SDL_Event& event, bool& quit)
 {
-	std::cout << "Loading scene data: " << file << std::endl;
-	// Assimp Setup
-	Assimp::Importer importer;
-
-	const aiScene* scene = importer.ReadFile(file, aiProcess_CalcTangentSpace | aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_SortByPType);
-	// If the import failed, report it
-	if (nullptr == scene) {
-		std::cout << "Failed to import: " << file << ": " << importer.GetErrorString() << std::endl;
+	State::m_dirty = true;
+	if (State::m_overlay.ProcessEvent(event))
 		return;
+
+	switch (event.type)
+	{
+	case SDL_QUIT:
+		quit = true;
+		break;
+	case SDL_KEYDOWN:
+		if (event.key.keysym.sym == SDLK_F9 && !event.key.repeat)
+			Profiler::WriteChromeTrace(Config::trace_file);
+		if (event.key.keysym.sym == SDLK_F1 && !event.key.repeat)
+			State::m_overlay.Toggle();
+		if (event.key.keysym.sym == SDLK_F10 && !event.key.repeat)
+			MemoryTracker::Report("F10");
+		break;
+	case SDL_MOUSEMOTION:
+		if (event.motion.state & SDL_BUTTON_RMASK)
+		{
+			State::m_camera.yaw += event.motion.xrel * 0.1f;
+			State::m_camera.pitch = glm::clamp(State::m_camera.pitch - event.motion.yrel * 0.1f, -89.0f, 89.0f);
+		}
+		break;
 	}
+}
 
-	std::cout << "Loaded:" << std::endl
-		<< "  Meshes: " << scene->mNumMeshes << std::endl
-		<< "  Materials: " << scene->mNumMaterials << std::endl
-		<< "  Textures: " << scene->mNumTextures << std::endl
-		<< "  Lights: " << scene->mNumLights << std::endl
-		<< "  Cameras: " << scene->mNumCameras << std::endl
-		<< "  Animations: " << scene->mNumAnimations << std::endl
-	;
+// Picks up what the render thread wrote back into a snapshot it finished with
+void CollectRenderResults(const RenderSnapshot& snapshot)
+{
+	if (snapshot.presentTime == 0)
+		return;
 
-	std::cout << "Constructing Scene " << std::endl;
+	State::m_pacer.RecordLatency(snapshot.inputTime, snapshot.presentTime);
+	if (snapshot.gpuFrameMs >= 0.0)
+		State::m_benchmark.AddGpuFrame(snapshot.gpuFrameMs);
+	State::m_fenceWaits.Push(snapshot.fenceWaitMs);
+	State::m_gpuScopes.assign(snapshot.gpuScopes.begin(), snapshot.gpuScopes.end());
+	State::m_gpuTimesCpuMeasured = snapshot.gpuTimesCpuMeasured;
+	State::m_commandStats = snapshot.stats;
+	State::m_overlayRenderMs = snapshot.overlayRenderMs;
+	State::m_frameResourceBytes = snapshot.frameResourceBytes;
+}
 
+void PrintFrameStats()
+{
+	FrameStats stats = State::m_pacer.Stats();
+	LOG_INFO("Frame: " << stats.frameMsAvg << "ms avg (" << stats.fps << " fps)"
+		<< " min " << stats.frameMsMin << " max " << stats.frameMsMax << " p99 " << stats.frameMsP99
+		<< " jitter " << stats.jitterMs << "ms"
+		<< " latency " << stats.latencyMsAvg << "ms avg " << stats.latencyMsMax << "ms max");
+
+	// Steady state frames should not touch the heap; temporaries go to the frame arena
+	const ArenaStats& arena = FrameArena::Local().Stats();
+	LOG_INFO("  Allocations: " << State::m_frameAllocations.Average() << " avg " << State::m_frameAllocations.Max() << " max "
+		<< State::m_frameAllocations.Last() << " last per frame, arena " << arena.highWater / 1024 << " KB high water of "
+		<< arena.capacity / 1024 << " KB, " << arena.overflows << " overflows");
+
+	// Waiting on fences means the GPU is the bottleneck
+
+	double fenceWait = State::m_fenceWaits.Average();
+	LOG_INFO("  Fence wait: " << fenceWait << "ms avg " << State::m_fenceWaits.Max() << "ms max ("
+		<< (fenceWait > stats.frameMsAvg * 0.1 ? "GPU" : "CPU") << " bound)");
+
+	if (!State::m_gpuScopes.empty())
+		LOG_INFO("  GPU" << (State::m_gpuTimesCpuMeasured ? " (CPU measured):" : ":"));
+	for (const GpuScopeAverage& scope : State::m_gpuScopes)
+		LOG_INFO("    " << std::string(scope.depth * 2, ' ') << scope.name << ": " << scope.ms << "ms");
+
+	if (Config::frustum_culling)
+	{
+		const FrustumStats& frustum = State::m_frustum.Stats();
+		LOG_INFO("  Frustum: " << frustum.visible << "/" << frustum.tested << " visible, " << frustum.ms << "ms");
+	}
 
+	if (Config::occlusion_culling)
+	{
+		const OcclusionStats& occlusion = State::m_occlusion.Stats();
+		LOG_INFO("  Occlusion: " << occlusion.culled << "/" << occlusion.tested << " culled, "
+			<< occlusion.triangles << " occluder triangles, rasterize " << occlusion.rasterizeMs << "ms, test " << occlusion.testMs << "ms");
+	}
 
-	// Light
-}
+	if (Config::software_renderer)
+	{
+		const SoftwareRasterStats& software = State::m_software.Stats();
+		LOG_INFO("  Software: " << software.rasterized << "/" << software.triangles << " triangles, " << software.pixels << " pixels, "
+			<< "vertex " << software.vertexMs << "ms, bin " << software.binMs << "ms, raster " << software.rasterMs << "ms, "
+			<< software.triangles / glm::max(software.totalMs * 1e3, 1e-9) << " Mtri/s, "
+			<< software.pixels / glm::max(software.rasterMs * 1e3, 1e-9) << " Mpix/s");
+	}
 
-void Clear()
-{
-	glClearColor(0.39f, 0.58f, 0.93f, 1.0f);
-	glClear(GL_COLOR_BUFFER_BIT);
+	// One line built over a loop, so the line is used directly instead of LOG_INFO
+	if (State::m_shadows.Cascades() > 0 && Log::Enabled(LogLevel::Info))
+	{
+		LogLine line;
+		line.Stream() << "  Shadow casters:";
+		for (uint32_t i = 0; i < State::m_shadows.Cascades(); i++)
+			line.Stream() << " " << State::m_shadows.CasterCount(i);
+	}
 }
 
-void Update()
+// Draws the snapshot with the CPU rasterizer, then shows it in the window or writes it out
+void RenderSoftwareFrame(const RenderSnapshot& snapshot)
 {
-	
-	
+	PROFILE_ZONE("RenderSoftwareFrame");
+	State::m_software.Render(State::m_model, snapshot.items.data(), snapshot.visible, snapshot.projection * snapshot.view, State::m_sunDirection, snapshot.clearColor, State::m_jobs);
+
+	if (snapshot.captureFrame >= 0)
+	{
+		char name[64];
+		std::snprintf(name, sizeof(name), "/frame_%05lld.ppm", (long long)snapshot.captureFrame);
+		State::m_software.WritePpm(Config::capture_directory + name);
+	}
+
+	SDL_Surface* surface = State::m_window ? SDL_GetWindowSurface(State::m_window) : nullptr;
+	if (!surface || SDL_LockSurface(surface) != 0)
+		return;
 
+	int32_t width = glm::min(surface->w, State::m_software.Width());
+	int32_t height = glm::min(surface->h, State::m_software.Height());
+	SDL_ConvertPixels(width, height, SDL_PIXELFORMAT_RGBA32, State::m_software.Color(), State::m_software.Stride() * 4,
+		surface->format->format, surface->pixels, surface->pitch);
+	SDL_UnlockSurface(surface);
+	SDL_UpdateWindowSurface(State::m_window);
 }
 
-void LateUpdate()
+// Puts the camera where the benchmark path is on this frame. Both ends of the interpolation
+// are set so the view only depends on the frame number, not on how many updates ran.
+void FollowCameraPath(uint64_t frame)
 {
-	glFlush();
+	State::m_cameraPath.Sample(State::m_benchmark.Progress(frame), State::m_camera);
+	State::m_prevCamera = State::m_camera;
+	State::m_dirty = true;
 }
 
-void Present()
+// Adds a key at most 30 times a second while the camera is flown by hand
+void RecordCameraPath()
 {
-	SDL_GL_SwapWindow(State::m_window);
+	double time = FramePacer::ToSeconds(FramePacer::Now() - State::m_recordStart);
+	if (State::m_cameraPath.Empty() || time - State::m_cameraPath.EndTime() >= 1.0 / 30.0)
+		State::m_cameraPath.Add(time, State::m_camera);
 }
 
-int main()
+// Frame number to write to disk, or -1
+int64_t CaptureFrame(uint64_t frame)
 {
-	ParseConfig();
-	std::cout << "Launching " << Config::win_title << std::endl;
+	if (!Config::headless || Config::capture_directory.empty() || Config::capture_interval <= 0)
+		return -1;
+	return frame % Config::capture_interval == 0 ? (int64_t)frame : -1;
+}
 
+// Runs the frame loop until quit, or for maxFrames presented frames when non zero
+void RunFrames(bool threaded, uint64_t maxFrames)
+{
 	bool quit = false;
 	SDL_Event event;
+	RenderSnapshot serialSnapshot;
+
+	if (threaded)
+		State::m_renderThread.Start(State::m_window, State::m_glContext, &State::m_renderer, Config::headless ? &State::m_headless : nullptr);
+
+	State::m_pacer.Init(Config::update_rate, Config::frame_cap);
+	State::m_time = FramePacer::Now();
+	State::m_dirty = true;
+	uint64_t lastStats = State::m_time;
+	uint64_t frames = 0;
+	State::m_frameAllocations.Clear();
+	int64_t allocations = MemoryTracker::AllocationCount();
+	while (!quit && (maxFrames == 0 || frames < maxFrames))
+	{
+		uint64_t frameStart = FramePacer::Now();
+		FrameArena::Local().Reset();
+
+		// Nothing changed last frame: block until something happens instead of spinning
+		if (State::m_idle)
+		{
+			if (SDL_WaitEventTimeout(&event, Config::idle_timeout))
+			{
+				State::m_pacer.MarkInput();
+				HandleEvent(event, quit);
+			}
+			State::m_pacer.Resync();
+		}
 
-	SDL_Init(SDL_INIT_EVERYTHING);
+		while (SDL_PollEvent(&event))
+		{
+			State::m_pacer.MarkInput();
+			HandleEvent(event, quit);
+		}
 
-	
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 6);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
-	
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_NORMALIZE);
-	glEnable(GL_COLOR_MATERIAL);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		PROFILE_ZONE("Frame");
+
+		// Simulation thread work: updates and building the snapshot, not waiting on the render thread
+		uint64_t simStart = FramePacer::Now();
+		uint32_t updates = State::m_pacer.BeginFrame();
+		for (uint32_t i = 0; i < updates; i++)
+			Update(State::m_pacer.FixedDelta());
+		State::m_alpha = State::m_pacer.Alpha();
+
+		if (State::m_benchmark.Active())
+			FollowCameraPath(frames);
+		else if (State::m_recordingPath)
+			RecordCameraPath();
+
+		if (Config::sim_load_ms > 0.0)
+			FramePacer::SpinFor(Config::sim_load_ms);
+		uint64_t simTicks = FramePacer::Now() - simStart;
+
+		State::m_idle = Config::idle_mode && !State::m_dirty;
+		if (State::m_idle)
+			continue;
+		State::m_dirty = false;
+
+		if (threaded)
+		{
+			// The render thread may still be drawing the previous snapshot; this one overlaps it
+			RenderSnapshot* snapshot = State::m_renderThread.Acquire();
+			CollectRenderResults(*snapshot);
+			uint64_t buildStart = FramePacer::Now();
+			BuildSnapshot(*snapshot);
+			simTicks += FramePacer::Now() - buildStart;
+			snapshot->captureFrame = CaptureFrame(frames);
+			State::m_renderThread.Submit(snapshot);
+		}
+		else
+		{
+			uint64_t buildStart = FramePacer::Now();
+			BuildSnapshot(serialSnapshot);
+			simTicks += FramePacer::Now() - buildStart;
+			serialSnapshot.captureFrame = CaptureFrame(frames);
+			if (Config::software_renderer)
+				RenderSoftwareFrame(serialSnapshot);
+			else
+				State::m_renderer.RenderFrame(serialSnapshot, State::m_window);
+			serialSnapshot.presentTime = FramePacer::Now();
+			CollectRenderResults(serialSnapshot);
+		}
+		frames++;
+
+		State::m_pacer.EndFrame();
+		State::m_time = State::m_pacer.FrameStart();
+		State::m_benchmark.AddFrame(FramePacer::ToMilliseconds(FramePacer::Now() - frameStart), FramePacer::ToMilliseconds(simTicks));
+
+		int64_t allocationsNow = MemoryTracker::AllocationCount();
+		int64_t frameAllocations = allocationsNow - allocations;
+		State::m_frameAllocations.Push((double)frameAllocations);
+		allocations = allocationsNow;
+
+		if (State::m_traceAllocationsAfter > 0)
+		{
+			if (frames == State::m_traceAllocationsAfter)
+				MemoryTracker::TraceAllocations(true);
+			else if (frames > State::m_traceAllocationsAfter && frameAllocations > 0)
+			{
+				if (State::m_allocatingFrames++ == 0)
+					LOG_WARN("Frame " << frames << " allocated " << frameAllocations << " times");
+			}
+		}
 
+		if (Config::stats_interval > 0.0 && FramePacer::ToSeconds(State::m_time - lastStats) >= Config::stats_interval)
+		{
+			PrintFrameStats();
+			lastStats = State::m_time;
+		}
+	}
+
+	// Stopping the render thread is not part of any frame
+	if (State::m_traceAllocationsAfter > 0)
+		MemoryTracker::TraceAllocations(false);
+	if (threaded)
+		State::m_renderThread.Stop();
+}
 
-	SDL_Window* m_window = SDL_CreateWindow(Config::win_title.c_str(), SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, Config::screen_width, Config::screen_height, SDL_WINDOW_OPENGL);
-	if (!m_window) 
+// Compares serial and threaded frame times under the same synthetic load on both threads
+void RunThreadBenchmark(uint64_t frames)
+{
+	if (Config::sim_load_ms <= 0.0)
+		Config::sim_load_ms = 4.0;
+	if (Config::render_load_ms <= 0.0)
+		Config::render_load_ms = 4.0;
+	Config::frame_cap = 0;
+	Config::idle_mode = false;
+	SDL_GL_SetSwapInterval(0);
+
+	LOG_INFO("Thread benchmark: " << frames << " frames, sim load " << Config::sim_load_ms
+		<< "ms, render load " << Config::render_load_ms << "ms");
+
+	for (bool threaded : { false, true })
 	{
-		std::cout << "Could not create window: " << SDL_GetError() << std::endl;
-		return 0;
+		RunFrames(threaded, frames);
+		FrameStats stats = State::m_pacer.Stats();
+		LOG_INFO((threaded ? "  threaded: " : "  serial:   ")
+			<< stats.frameMsAvg << "ms avg, " << stats.frameMsMin << "ms min, "
+			<< stats.frameMsP99 << "ms p99 (" << stats.fps << " fps)");
 	}
-	State::m_window = m_window;
+}
 
-	SDL_GLContext m_glContext = SDL_GL_CreateContext(m_window);
-	if (!m_glContext)
+// Once the warmup frames settled every buffer's capacity, no frame should allocate. Fails
+// if one did and prints where the allocations came from.
+bool CheckAllocations(uint64_t warmupFrames)
+{
+	if (!ENABLE_MEMORY_TRACKING)
 	{
-		std::cout << "Could not create context: " << SDL_GetError() << std::endl;
-		return 0;
+		LOG_ERROR("Allocation check: needs ENABLE_MEMORY_TRACKING to see operator new");
+		return false;
+	}
+	// A scene that failed to load draws nothing and would pass
+	if (State::m_model.instances.empty())
+	{
+		LOG_ERROR("Allocation check: the scene has no instances");
+		return false;
+	}
+
+	uint64_t frames = (uint64_t)glm::max(Config::headless_frames, 1);
+	LOG_INFO("Allocation check: " << frames << " frames after " << warmupFrames << " warmup");
+
+	State::m_traceAllocationsAfter = warmupFrames;
+	State::m_allocatingFrames = 0;
+	RunFrames(Config::render_thread, warmupFrames + frames);
+	State::m_traceAllocationsAfter = 0;
+
+	uint64_t traced = MemoryTracker::ReportTracedAllocations();
+	if (State::m_allocatingFrames == 0 && traced == 0)
+	{
+		LOG_INFO("Allocation check passed: no allocations in " << frames << " steady state frames");
+		return true;
+	}
+	LOG_ERROR("Allocation check failed: " << State::m_allocatingFrames << " of " << frames << " frames allocated, "
+		<< traced << " allocations in all");
+	return false;
+}
+
+// Flies the camera path for a fixed number of frames and writes the timings as JSON
+bool RunSceneBenchmark(const std::string& output, double loadMs)
+{
+	if (!Config::camera_path.empty())
+	{
+		if (!State::m_cameraPath.Load(Config::camera_path))
+			return false;
+	}
+	else
+	{
+		State::m_cameraPath.Orbit(State::m_model.boundsMin, State::m_model.boundsMax);
 	}
-	State::m_glContext = m_glContext;
 
+	State::m_benchmark.Begin(Config::generate_scene.empty() ? Config::scene : "generated:" + Config::generate_scene, (uint32_t)glm::max(Config::benchmark_frames, 1));
+	State::m_benchmark.SetLoadMs(loadMs);
+	State::m_benchmark.SetInfo("camera_path", Config::camera_path.empty() ? "orbit" : Config::camera_path);
+	State::m_benchmark.SetInfo("render_path", Config::software_renderer ? "software" : DeferredPath::Name(Config::render_path));
+	State::m_benchmark.SetInfo("resolution", std::to_string(Config::screen_width) + "x" + std::to_string(Config::screen_height));
+	State::m_benchmark.SetInfo("render_thread", Config::render_thread ? "on" : "off");
+	State::m_benchmark.SetInfo("worker_threads", std::to_string(State::m_jobs.WorkerCount()));
+	State::m_benchmark.SetInfo("headless", Config::headless ? "on" : "off");
+
+	LOG_INFO("Scene benchmark: " << Config::benchmark_frames << " frames after " << SceneBenchmark::WarmupFrames << " warmup, "
+		<< (Config::camera_path.empty() ? std::string("orbit") : Config::camera_path) << " path with " << State::m_cameraPath.Count() << " keys");
+
+	RunFrames(Config::render_thread, State::m_benchmark.TotalFrames());
+	State::m_benchmark.End();
+	State::m_benchmark.Print();
+	return State::m_benchmark.Write(output);
+}
+
+// Loads GL, makes the context current and sets up vsync
+bool InitGL()
+{
 	glewExperimental = GL_TRUE;
 	GLenum err = glewInit();
 	if (err != GLEW_OK) {
-		std::cout << "glew failed to initialize: " << glewGetErrorString(err) << std::endl;
+		LOG_ERROR("glew failed to initialize: " << glewGetErrorString(err));
 		return false;
 	}
 
@@ -378,7 +969,7 @@ int main()
 	// Enable debug output
 	if (glDebugMessageCallback)
 	{
-		std::cout << "Registering OpenGL Debug callback" << std::endl;
+		LOG_INFO("Registering OpenGL Debug callback");
 		glEnable(GL_DEBUG_OUTPUT);
 		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
 		glDebugMessageCallback(MessageCallback, nullptr);
@@ -387,53 +978,307 @@ int main()
 	}
 	else 
 	{
-		std::cout << "glDebugMessageCallback not available" << std::endl;
+		LOG_WARN("glDebugMessageCallback not available");
 	}
 #endif
 
-	SDL_GL_MakeCurrent(State::m_window, State::m_glContext);
+	if (!Config::headless)
+		SDL_GL_MakeCurrent(State::m_window, State::m_glContext);
 
-	std::cout << "GLVERSION: " << glGetString(GL_VERSION) << std::endl;
+	LOG_INFO("GLVERSION: " << glGetString(GL_VERSION));
 
-	// VSync
-	if (Config::vsync)
+	// VSync, preferring adaptive (late frames tear instead of waiting a whole interval)
+	if (Config::headless)
+	{
+		// Nothing to present to
+	}
+	else if (Config::vsync)
 	{
-		if (SDL_GL_SetSwapInterval(1) < 0)
+		if (!Config::adaptive_vsync || SDL_GL_SetSwapInterval(-1) < 0)
 		{
-			std::cout << "Couldn't set vsync" << std::endl;
-			return false;
+			if (SDL_GL_SetSwapInterval(1) < 0)
+			{
+				LOG_WARN("Couldn't set vsync");
+				return false;
+			}
 		}
 	}
-	
+	else
+	{
+		SDL_GL_SetSwapInterval(0);
+	}
 
+	return true;
+}
 
-	LoadScene(Config::scene);
+int main(int argc, char* argv[])
+{
+	// Comparing two result files needs neither the config nor a window
+	if (argc >= 4 && std::string(argv[1]) == "--bench-compare")
+	{
+		int32_t regressions = SceneBenchmark::Compare(argv[2], argv[3]);
+		return regressions < 0 ? 2 : (regressions > 0 ? 1 : 0);
+	}
 
-	State::m_time = SDL_GetTicks();
-	while (!quit)
+	Profiler::SetThreadName("Main");
+	// From here lines are written on the log thread; early returns are covered by atexit
+	Log::Init();
+	ParseConfig();
+	LOG_INFO("Launching " << Config::win_title);
+
+	uint64_t benchFrames = 0;
+	int32_t frameCount = 0;
+	std::string exitTrace;
+	std::string benchOutput;
+	std::string recordPath;
+	std::string bakeOutput;
+	std::string lightmapSpec;
+	bool bakeLightmaps = false;
+	bool lightmapScaling = false;
+	uint64_t allocationWarmup = 0;
+	for (int32_t i = 1; i < argc; i++)
 	{
-		SDL_WaitEvent(&event);
+		if (std::string(argv[i]) == "--bench-threads")
+			benchFrames = (i + 1 < argc) ? std::stoull(argv[++i]) : 600;
+		else if (std::string(argv[i]) == "--trace" && i + 1 < argc)
+			exitTrace = argv[++i];
+		else if (std::string(argv[i]) == "--headless")
+			Config::headless = true;
+		else if (std::string(argv[i]) == "--frames" && i + 1 < argc)
+			frameCount = std::stoi(argv[++i]);
+		else if (std::string(argv[i]) == "--capture" && i + 1 < argc)
+			Config::capture_directory = argv[++i];
+		else if (std::string(argv[i]) == "--software")
+			Config::software_renderer = true;
+		else if (std::string(argv[i]) == "--bench-scene" && i + 1 < argc)
+			benchOutput = argv[++i];
+		else if (std::string(argv[i]) == "--camera-path" && i + 1 < argc)
+			Config::camera_path = argv[++i];
+		else if (std::string(argv[i]) == "--record-path" && i + 1 < argc)
+			recordPath = argv[++i];
+		else if (std::string(argv[i]) == "--generate" && i + 1 < argc)
+			Config::generate_scene = argv[++i];
+		else if (std::string(argv[i]) == "--bake" && i + 1 < argc)
+			bakeOutput = argv[++i];
+		else if (std::string(argv[i]) == "--lightmaps")
+		{
+			bakeLightmaps = true;
+			if (i + 1 < argc && std::string(argv[i + 1]).compare(0, 2, "--") != 0)
+				lightmapSpec = argv[++i];
+		}
+		else if (std::string(argv[i]) == "--lightmap-scaling")
+			bakeLightmaps = lightmapScaling = true;
+		else if (std::string(argv[i]) == "--check-allocations")
+			allocationWarmup = (i + 1 < argc && std::isdigit((unsigned char)argv[i + 1][0])) ? std::stoull(argv[++i]) : 60;
+	}
 
-		switch (event.type)
+	// Baking a generated scene, or lightmaps into a baked one, needs no window or GL
+	if (!bakeOutput.empty())
+	{
+		SceneGeneratorSettings settings;
+		if (!Config::generate_scene.empty() && settings.Parse(Config::generate_scene))
 		{
-		case SDL_QUIT:
-			quit = true;
-			break;
+			LOG_INFO("Generating scene: " << settings.Describe());
+			GenerateScene(settings, State::m_baked);
+		}
+		else if (bakeLightmaps && Config::generate_scene.empty() && BakedScene::IsBakedFile(Config::scene))
+		{
+			LOG_INFO("Loading baked scene: " << Config::scene);
+			if (!State::m_baked.Read(Config::scene))
+				return 1;
 		}
+		else
+		{
+			LOG_ERROR("--bake writes a generated scene, pass its settings with --generate; with --lightmaps it can also light the baked scene in the config");
+			return 1;
+		}
+		PrintBakedScene(State::m_baked);
+		if (bakeLightmaps && !BakeLightmaps(State::m_baked, lightmapSpec, lightmapScaling))
+			return 1;
+		if (!State::m_baked.Write(bakeOutput))
+			return 1;
+		LOG_INFO("Baked scene written to " << bakeOutput);
+		return 0;
+	}
 
-		uint32_t now = SDL_GetTicks();
-		State::m_deltaTime = now - State::m_time;
+	if (frameCount > 0)
+	{
+		Config::headless_frames = frameCount;
+		Config::benchmark_frames = frameCount;
+	}
+
+	// Anything that holds frames back or draws on top would be measured too
+	if (!benchOutput.empty())
+	{
+		Config::vsync = false;
+		Config::frame_cap = 0;
+		Config::idle_mode = false;
+		Config::stats_interval = 0.0;
+		Config::overlay = false;
+		benchFrames = 0;
+		recordPath.clear();
+	}
 
-		Clear();
-		Update();
-		LateUpdate();
-		Present();
+	// A headless run whose only output is the allocation report
+	if (allocationWarmup > 0)
+	{
+		Config::headless = true;
+		Config::stats_interval = 0.0;
+		benchOutput.clear();
+		benchFrames = 0;
+		recordPath.clear();
+	}
 
-		State::m_time = now;
+	// Software frames are drawn on the simulation thread's workers; there is no GL thread
+	if (Config::software_renderer)
+	{
+		Config::render_thread = false;
+		benchFrames = 0;
 	}
 
+	// Headless runs have no display to open, and nothing would wake an idle frame loop
+	SDL_Init(Config::headless ? SDL_INIT_TIMER | SDL_INIT_EVENTS : SDL_INIT_EVERYTHING);
+	State::m_jobs.Init(Config::worker_threads >= 0 ? Config::worker_threads : JobSystem::DefaultWorkerCount());
+
+	if (Config::headless)
+	{
+		Config::idle_mode = false;
+		Config::overlay = false;
+		const char* backend = Config::software_renderer ? "software rasterizer" : HeadlessContext::Backend();
+		LOG_INFO("Headless: " << (backend ? backend : "not available") << ", " << Config::headless_frames << " frames");
+		if (!Config::software_renderer && !State::m_headless.Create(Config::screen_width, Config::screen_height))
+			return 1;
+	}
+	else
+	{
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 6);
+		SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+		SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+		SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+
+		// The software rasterizer blits into the window surface instead
+		uint32_t windowFlags = Config::software_renderer ? 0 : SDL_WINDOW_OPENGL;
+		SDL_Window* m_window = SDL_CreateWindow(Config::win_title.c_str(), SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, Config::screen_width, Config::screen_height, windowFlags);
+		if (!m_window) 
+		{
+			LOG_ERROR("Could not create window: " << SDL_GetError());
+			return 0;
+		}
+		State::m_window = m_window;
+
+		if (!Config::software_renderer)
+		{
+			SDL_GLContext m_glContext = SDL_GL_CreateContext(m_window);
+			if (!m_glContext)
+			{
+				LOG_ERROR("Could not create context: " << SDL_GetError());
+				return 0;
+			}
+			State::m_glContext = m_glContext;
+		}
+	}
+
+	if (!Config::software_renderer && !InitGL())
+		return 0;
+
+	uint64_t loadStart = FramePacer::Now();
+	LoadScene(Config::scene);
+	if (Config::stress_lights > 0)
+		AddStressLights(Config::stress_lights);
+	{
+		MemoryScope sceneScope(MemoryTag::Scene);
+		CreateSceneEntities(State::m_model, State::m_entities);
+		LOG_INFO("Entities: " << State::m_entities.AliveCount());
+		uint32_t cascades = Config::shadows && !Config::software_renderer ? (uint32_t)glm::clamp(Config::shadow_cascades, 1, (int32_t)ShadowFrame::MaxCascades) : 0;
+		State::m_shadows.Init(cascades, Config::shadow_resolution, (float)Config::shadow_distance);
+		if (Config::software_renderer)
+		{
+			// The rasterizer's texture copies are renderer state, the model's texture tag empties with the model
+			MemoryScope renderScope(MemoryTag::Render);
+			State::m_software.Resize(Config::screen_width, Config::screen_height);
+			if (!State::m_baked.Empty())
+				State::m_software.LoadTextures(State::m_baked);
+			else
+				State::m_software.LoadTextures(State::m_model);
+		}
+		else
+		{
+			MemoryScope renderScope(MemoryTag::Render);
+			State::m_renderer.Init(&State::m_model, Config::frames_in_flight, Config::gpu_profiler, Config::render_path, Config::screen_width, Config::screen_height);
+			State::m_renderer.InitShadows(Config::shadow_resolution, cascades);
+		}
+		State::m_baked = BakedScene();
+		if (Config::occlusion_culling)
+		{
+			State::m_occlusion.SelectOccluders(State::m_model, Config::occluder_triangles);
+			LOG_INFO("Occluders: " << State::m_occlusion.OccluderCount() << " meshes, " << State::m_occlusion.OccluderTriangles() << " triangles");
+		}
+		// Everything that reads the CPU copies has run; the software rasterizer keeps them
+		if (!Config::software_renderer)
+			State::m_model.ReleaseCpuMeshes();
+	}
+	LOG_INFO("Render path: " << (Config::software_renderer ? "software" : DeferredPath::Name(Config::render_path)));
+	if (Config::software_renderer)
+	{
+		// Captures and the window surface come straight from the rasterizer's buffer
+	}
+	else if (Config::headless)
+	{
+		if (!State::m_headless.CreateTarget())
+			return 1;
+		State::m_headless.SetCaptureDirectory(Config::capture_directory);
+		State::m_renderer.SetHeadless(&State::m_headless);
+	}
+	else
+		State::m_overlay.Init(State::m_window, State::m_glContext, Config::overlay);
+
+	double loadMs = FramePacer::ToMilliseconds(FramePacer::Now() - loadStart);
+	LOG_INFO("Load time: " << loadMs << "ms");
+	MemoryTracker::Report("load");
+
+	int32_t exitCode = 0;
+	if (!benchOutput.empty())
+	{
+		if (!RunSceneBenchmark(benchOutput, loadMs))
+			exitCode = 1;
+	}
+	else if (benchFrames > 0)
+		RunThreadBenchmark(benchFrames);
+	else if (allocationWarmup > 0)
+	{
+		if (!CheckAllocations(allocationWarmup))
+			exitCode = 1;
+	}
+	else if (Config::headless)
+	{
+		RunFrames(Config::render_thread, (uint64_t)glm::max(Config::headless_frames, 1));
+		PrintFrameStats();
+	}
+	else
+	{
+		State::m_recordingPath = !recordPath.empty();
+		State::m_recordStart = FramePacer::Now();
+		RunFrames(Config::render_thread, 0);
+		if (State::m_recordingPath && State::m_cameraPath.Save(recordPath))
+			LOG_INFO("Camera path with " << State::m_cameraPath.Count() << " keys written to " << recordPath);
+	}
+
+	State::m_overlay.Shutdown();
+	if (!Config::software_renderer)
+		State::m_renderer.Shutdown();
+	State::m_model.Release();
+	State::m_headless.Destroy();
+	State::m_jobs.Shutdown();
 	SDL_Quit();
 
-	return 0;
+	if (!exitTrace.empty())
+		Profiler::WriteChromeTrace(exitTrace);
+
+	// The model was the only owner of these
+	MemoryTracker::ReportLeaks({ MemoryTag::Import, MemoryTag::Meshes, MemoryTag::Textures });
+
+	Log::Shutdown();
+	return exitCode;
 }
 
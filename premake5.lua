@@ -10,10 +10,24 @@ workspace "OpenGLScene"
 
 outputdir = "%{cfg.buildcfg}-%{cfg.system}-%{cfg.architecture}"
 
+newoption
+{
+    trigger = "headless",
+    value = "API",
+    description = "Context behind --headless on Linux",
+    allowed = 
+    {
+        { "egl", "EGL surfaceless platform" },
+        { "osmesa", "OSMesa" }
+    },
+    default = "egl"
+}
+
 project "Game"
     location "Game"
     kind "ConsoleApp"
     language "C++"
+    cppdialect "C++17"
 
     targetdir ("bin/" .. outputdir .. "/%{prj.name}")
     objdir ("bin-obj/" .. outputdir .. "/%{prj.name}")
@@ -22,6 +36,12 @@ project "Game"
     {
         "%{prj.name}/src/**.h",
         "%{prj.name}/src/**.cpp",
+        "Vendor/imgui/imgui.cpp",
+        "Vendor/imgui/imgui_draw.cpp",
+        "Vendor/imgui/imgui_tables.cpp",
+        "Vendor/imgui/imgui_widgets.cpp",
+        "Vendor/imgui/backends/imgui_impl_sdl.cpp",
+        "Vendor/imgui/backends/imgui_impl_opengl3.cpp",
     }
 
     includedirs
@@ -32,38 +52,162 @@ project "Game"
         "Vendor/glew/include",
         "Vendor/spdlog/include",
         "Vendor/glm",
-        "Vendor/assimp/include"
+        "Vendor/assimp/include",
+        "Vendor/imgui",
+        "Vendor/imgui/backends"
     }
 
-    libdirs
+    defines
     {
-        "Vendor/sdl2/lib/x64",
-        "Vendor/glew/lib/Release/x64",
-        "Vendor/assimp/lib/RelWithDebInfo"
+        "GLEW_STATIC",
+        "IMGUI_IMPL_OPENGL_LOADER_GLEW"
     }
 
-    links 
+    -- Light culling and other hot loops have AVX2 paths with scalar fallbacks
+    vectorextensions "AVX2"
+
+    filter "system:windows"
+        staticruntime "On"
+        systemversion "latest"
+        nuget { "Microsoft.glTF.CPP:1.6.3.1" }
+
+        libdirs
+        {
+            "Vendor/sdl2/lib/x64",
+            "Vendor/glew/lib/Release/x64",
+            "Vendor/assimp/lib/RelWithDebInfo"
+        }
+
+        links 
+        {
+            "glew32s",
+            "SDL2main",
+            "SDL2", 
+            "opengl32",
+            "zlibstatic",
+            "IrrXML",
+            "assimp-vc142-mt"
+        }
+
+        defines 
+        {
+            "_CONSOLE"
+        }
+
+        -- Symbol names for allocation traces
+        links { "dbghelp" }
+
+    -- System packages. Exports function names for backtrace_symbols in allocation traces.
+    filter "system:linux"
+        links { "GLEW", "SDL2", "GL", "assimp", "pthread", "dl" }
+        linkoptions { "-rdynamic" }
+
+    -- Headless runs (--headless) make their context without a window. GLEW must be built
+    -- for the same API, it cannot load functions through GLX there.
+    filter { "system:linux", "options:headless=egl" }
+        defines { "HEADLESS_EGL", "GLEW_EGL" }
+        links { "EGL" }
+
+    filter { "system:linux", "options:headless=osmesa" }
+        defines { "HEADLESS_OSMESA", "GLEW_OSMESA" }
+        links { "OSMesa" }
+
+    filter "configurations:Debug"
+        defines "_DEBUG"
+        symbols "On"
+
+    filter "configurations:Release"
+        defines "_RELEASE"
+        optimize "On"
+
+    filter "configurations:Dist"
+        defines { "_RELEASE", "ENABLE_OVERLAY=0", "ENABLE_MEMORY_TRACKING=0" }
+        symbols "On"
+
+    -- The performance overlay is compiled out of Dist builds
+    filter { "configurations:Dist", "files:Vendor/imgui/**.cpp" }
+        flags "ExcludeFromBuild"
+
+project "Benchmarks"
+    location "Benchmarks"
+    kind "ConsoleApp"
+    language "C++"
+    cppdialect "C++17"
+
+    targetdir ("bin/" .. outputdir .. "/%{prj.name}")
+    objdir ("bin-obj/" .. outputdir .. "/%{prj.name}")
+
+    -- Engine sources are compiled in directly; nothing here may need a GL context
+    files 
+    {
+        "%{prj.name}/src/**.h",
+        "%{prj.name}/src/**.cpp",
+        "Game/src/**.h",
+        "Game/src/**.cpp",
+    }
+
+    removefiles
+    {
+        "Game/src/main.cpp"
+    }
+
+    includedirs
+    {
+        "Game/src",
+        "Vendor/stb/include",
+        "Vendor/nlohmann/include",
+        "Vendor/sdl2/include",
+        "Vendor/glew/include",
+        "Vendor/spdlog/include",
+        "Vendor/glm",
+        "Vendor/assimp/include",
+        "Vendor/imgui"
+    }
+
+    defines
     {
-        "glew32s",
-        "SDL2main",
-        "SDL2", 
-        "opengl32",
-        "zlibstatic",
-        "IrrXML",
-        "assimp-vc142-mt"
+        "GLEW_STATIC",
+        "ENABLE_OVERLAY=0"
     }
 
+    -- Light culling and other hot loops have AVX2 paths with scalar fallbacks
+    vectorextensions "AVX2"
+
     filter "system:windows"
-        cppdialect "C++17"
         staticruntime "On"
         systemversion "latest"
-        nuget { "Microsoft.glTF.CPP:1.6.3.1", "rapidjson.temprelease:0.0.2.20" }
+        nuget { "Microsoft.glTF.CPP:1.6.3.1" }
+
+        libdirs
+        {
+            "Vendor/sdl2/lib/x64",
+            "Vendor/glew/lib/Release/x64",
+            "Vendor/assimp/lib/RelWithDebInfo"
+        }
+
+        links 
+        {
+            "glew32s",
+            "SDL2main",
+            "SDL2", 
+            "opengl32",
+            "zlibstatic",
+            "IrrXML",
+            "assimp-vc142-mt"
+        }
 
         defines 
         {
             "_CONSOLE"
         }
 
+        -- Symbol names for allocation traces
+        links { "dbghelp" }
+
+    filter "system:linux"
+        links { "GLEW", "SDL2", "GL", "assimp", "pthread", "dl" }
+        linkoptions { "-rdynamic" }
+
     filter "configurations:Debug"
         defines "_DEBUG"
         symbols "On"
@@ -74,4 +218,4 @@ project "Game"
 
     filter "configurations:Dist"
         defines "_RELEASE"
-        symbols "On"
\ No newline at end of file
+        symbols "On"
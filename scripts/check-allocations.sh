@@ -0,0 +1,42 @@
+#!/bin/sh
+# Runs the game's steady state allocation check headless on the software rasterizer
+# and on GL, each with the scene from config.json and with a generated scene, and
+# exits non-zero if any run allocated in a frame after warmup or could not run at all.
+#
+#   scripts/check-allocations.sh [game binary] [frames]
+#
+# The binary defaults to the Release build. It needs memory tracking, which Dist
+# compiles out, and for the GL run a headless context (premake --headless=egl or
+# osmesa). Runs from Game/ so config.json, its scene and the shaders are found.
+
+root=$(cd "$(dirname "$0")/.." && pwd)
+game=${1:-"$root/bin/Release-linux-x86_64/Game/Game"}
+frames=${2:-200}
+generated="instances=2000,lights=256"
+
+if [ ! -x "$game" ]; then
+	echo "check-allocations: no game binary at $game" >&2
+	exit 2
+fi
+
+cd "$root/Game" || exit 2
+
+failed=""
+for path in software gl; do
+	[ "$path" = software ] && software="--software" || software=""
+	for scene in config generated; do
+		echo "== $path, $scene scene =="
+		if [ "$scene" = config ]; then
+			"$game" --check-allocations $software --frames "$frames"
+		else
+			"$game" --check-allocations $software --generate "$generated" --frames "$frames"
+		fi
+		[ $? -eq 0 ] || failed="$failed $path/$scene"
+	done
+done
+
+if [ -n "$failed" ]; then
+	echo "check-allocations: failed on$failed" >&2
+	exit 1
+fi
+echo "check-allocations: passed"